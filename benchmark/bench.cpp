@@ -371,6 +371,7 @@
 // Usage examples:
 //   ./bench --name mako --port 6380 --out mako_results.csv
 //   ./bench --name redis --port 6378 --out redis_results.csv
+//   ./bench --name mako --port 6380 --dist hotspot --hot-keys 1 --hot-pct 90
 
 #include <hiredis/hiredis.h>
 #include <algorithm>
@@ -398,6 +399,25 @@ struct Target {
     int port{6380};
 };
 
+// Which key each request picks: uniform over the keyspace, or hotspot where
+// hot_pct percent of requests go to the first hot_keys keys
+struct KeyDist {
+    bool hotspot{false};
+    uint64_t hot_keys{1};
+    int hot_pct{90};
+
+    std::string name() const {
+        if (!hotspot) return "1-to-10-byte-decimal";
+        return "hotspot-" + std::to_string(hot_pct) + "pct-on-" + std::to_string(hot_keys);
+    }
+    size_t pick(uint64_t r, size_t key_count) const {
+        if (hotspot && static_cast<int>((r >> 32) % 100) < hot_pct) {
+            return static_cast<size_t>(r % std::min<uint64_t>(hot_keys, key_count));
+        }
+        return static_cast<size_t>(r % key_count);
+    }
+};
+
 struct Args {
     Target t;
     uint64_t keys{1'000'000};                 // 1M keys by default
@@ -406,22 +426,25 @@ struct Args {
     int duration_sec{60};                     // 60 seconds per workload
     std::string out_csv{"masstree_style_results.csv"};
     bool skip_preload{false};
+    bool server_populate{false};              // preload with DEBUG POPULATE instead of SETs
     int preload_report_interval{50'000};      // Report every 50k keys
+    KeyDist dist;
+    double rate{0};                           // open loop: total requests/sec, 0 = closed loop
 };
 
 struct BenchRow {
     Target t;
     std::string workload;    // "get" or "put"
-    std::string key_dist;    // "1-to-10-byte-decimal"
+    std::string key_dist;    // "1-to-10-byte-decimal" or "hotspot-<pct>pct-on-<n>"
     int threads;
     int value_size;
     double duration_sec;
     uint64_t total_ops;
     double ops_per_sec;
     double ops_per_sec_per_thread;
-    double p50_us;  // unused for now (0)
-    double p95_us;  // unused for now (0)
-    double p99_us;  // unused for now (0)
+    double p50_us;  // from the scheduled send time when open loop
+    double p95_us;
+    double p99_us;
 };
 
 struct CsvWriter {
@@ -444,7 +467,9 @@ struct CsvWriter {
             << r.total_ops << ','
             << std::fixed << std::setprecision(2) << r.ops_per_sec << ','
             << std::fixed << std::setprecision(2) << r.ops_per_sec_per_thread << ','
-            << 0.0 << ',' << 0.0 << ',' << 0.0 << '\n';
+            << std::fixed << std::setprecision(2) << r.p50_us << ','
+            << std::fixed << std::setprecision(2) << r.p95_us << ','
+            << std::fixed << std::setprecision(2) << r.p99_us << '\n';
         ofs.flush();
     }
 private:
@@ -559,11 +584,89 @@ static void preload(const Target &t,
     redisFree(c);
 }
 
-// ===== Worker thread stats (throughput-only) =====
+// ===== Server-side preload: the server generates the keys itself =====
+// DEBUG POPULATE count key size creates key:0 .. key:count-1, the same names
+// as build_keys(), so one round trip replaces count SETs.
+static void server_populate(const Target &t, uint64_t total_keys, int value_size) {
+    std::cout << "\n=== Populating " << total_keys << " keys with " << value_size
+              << "-byte values on the server (DEBUG POPULATE) ===" << std::endl;
+
+    redisContext *c = connect_retry(t.host, t.port);
+    if (!c) {
+        throw std::runtime_error("Populate connect failed");
+    }
+
+    auto start_time = Clock::now();
+    redisReply *r = (redisReply *)redisCommand(c, "DEBUG POPULATE %llu key %d",
+                                               (unsigned long long)total_keys, value_size);
+    if (!r || r->type == REDIS_REPLY_ERROR) {
+        std::string err = r ? std::string(r->str, r->len) : std::string(c->errstr);
+        if (r) freeReplyObject(r);
+        redisFree(c);
+        throw std::runtime_error("DEBUG POPULATE failed: " + err +
+                                 " (drop --server-populate to preload over the wire)");
+    }
+    double elapsed = std::chrono::duration<double>(Clock::now() - start_time).count();
+    if (r->str && r->len > 0) {
+        std::cout << "  Server: " << std::string(r->str, r->len) << "\n";
+    }
+    freeReplyObject(r);
+
+    std::cout << "  Populate complete: " << total_keys << " keys in " << std::fixed
+              << std::setprecision(2) << elapsed << "s (" << std::setprecision(0)
+              << (total_keys / std::max(elapsed, 1e-9)) << " keys/sec)\n";
+
+    redisFree(c);
+}
+
+// ===== Worker thread stats =====
 struct WorkerStats {
     uint64_t ops{0};
+    uint64_t busy{0};             // requests the server shed with a BUSY error
+    std::vector<float> lats_us;
 };
 
+static double pct_us(std::vector<float> &v, double p) {
+    if (v.empty()) return 0.0;
+    size_t idx = std::min(v.size() - 1, static_cast<size_t>(p * v.size()));
+    std::nth_element(v.begin(), v.begin() + idx, v.end());
+    return v[idx];
+}
+
+// Open-loop pacing: requests are due on a fixed schedule whether or not
+// earlier replies are back, and latency counts from the due time, so a stalled
+// server shows up as queueing delay instead of as a lower send rate.
+// Closed loop (rate 0) sends each request as soon as the previous one returns.
+struct Pacer {
+    bool open;
+    Clock::duration interval;
+    Clock::time_point next;
+
+    explicit Pacer(double rate_per_thread)
+        : open(rate_per_thread > 0),
+          interval(open ? std::chrono::duration_cast<Clock::duration>(
+                              std::chrono::duration<double>(1.0 / rate_per_thread))
+                        : Clock::duration::zero()),
+          next(Clock::now()) {}
+
+    // Waits until the next request is due and returns its due time
+    Clock::time_point wait() {
+        if (!open) return Clock::now();
+        std::this_thread::sleep_until(next);
+        Clock::time_point due = next;
+        next += interval;
+        return due;
+    }
+};
+
+static void record_reply(WorkerStats &stats, const redisReply *reply, Clock::time_point due) {
+    if (reply->type == REDIS_REPLY_ERROR && std::strncmp(reply->str, "BUSY", 4) == 0) {
+        stats.busy++;
+    }
+    stats.lats_us.push_back(std::chrono::duration<float, std::micro>(Clock::now() - due).count());
+    stats.ops++;
+}
+
 // ===== Lightweight RNG: xorshift64* =====
 static inline uint64_t xorshift64(uint64_t &state) {
     // state must be non-zero
@@ -575,10 +678,12 @@ static inline uint64_t xorshift64(uint64_t &state) {
     return x;
 }
 
-// ===== GET workload (no pipelining, throughput-only) =====
+// ===== GET workload (no pipelining) =====
 static WorkerStats get_worker(const Target &t,
                               const std::vector<std::string> &keys,
+                              const KeyDist &dist,
                               int duration_sec,
+                              double rate_per_thread,
                               uint64_t seed,
                               std::atomic<bool> &start_flag) {
     WorkerStats stats;
@@ -597,25 +702,29 @@ static WorkerStats get_worker(const Target &t,
         std::this_thread::yield();
     }
 
+    Pacer pacer(rate_per_thread);
     while (Clock::now() < end_time && !g_stop.load()) {
         uint64_t r = xorshift64(rng_state);
-        size_t idx = static_cast<size_t>(r % key_count);
+        size_t idx = dist.pick(r, key_count);
         const std::string &key = keys[idx];
 
+        Clock::time_point due = pacer.wait();
         redisReply *reply = (redisReply *)redisCommand(c, "GET %s", key.c_str());
         if (!reply) break;
+        record_reply(stats, reply, due);
         freeReplyObject(reply);
-        stats.ops++;
     }
 
     redisFree(c);
     return stats;
 }
 
-// ===== PUT workload (no pipelining, throughput-only) =====
+// ===== PUT workload (no pipelining) =====
 static WorkerStats put_worker(const Target &t,
                               const std::vector<std::string> &keys,
+                              const KeyDist &dist,
                               int duration_sec,
+                              double rate_per_thread,
                               int value_size,
                               uint64_t seed,
                               std::atomic<bool> &start_flag) {
@@ -636,16 +745,18 @@ static WorkerStats put_worker(const Target &t,
         std::this_thread::yield();
     }
 
+    Pacer pacer(rate_per_thread);
     while (Clock::now() < end_time && !g_stop.load()) {
         uint64_t r = xorshift64(rng_state);
-        size_t idx = static_cast<size_t>(r % key_count);
+        size_t idx = dist.pick(r, key_count);
         const std::string &key = keys[idx];
 
+        Clock::time_point due = pacer.wait();
         redisReply *reply = (redisReply *)redisCommand(
             c, "SET %s %b", key.c_str(), val.data(), (size_t)value_size);
         if (!reply) break;
+        record_reply(stats, reply, due);
         freeReplyObject(reply);
-        stats.ops++;
     }
 
     redisFree(c);
@@ -655,9 +766,11 @@ static WorkerStats put_worker(const Target &t,
 // ===== Benchmark execution =====
 static BenchRow run_get_workload(const Target &t,
                                  const std::vector<std::string> &keys,
+                                 const KeyDist &dist,
                                  int threads,
                                  int value_size,
-                                 int duration_sec) {
+                                 int duration_sec,
+                                 double rate) {
     std::cout << "\n[GET] threads=" << threads
               << " duration=" << duration_sec << "s" << std::flush;
 
@@ -668,7 +781,7 @@ static BenchRow run_get_workload(const Target &t,
     for (int i = 0; i < threads; i++) {
         uint64_t seed = 0xC0FFEEULL + (uint64_t)i * 1337ULL;
         workers.emplace_back([&, i, seed]() {
-            stats[i] = get_worker(t, keys, duration_sec, seed, start_flag);
+            stats[i] = get_worker(t, keys, dist, duration_sec, rate / threads, seed, start_flag);
         });
     }
 
@@ -684,34 +797,45 @@ static BenchRow run_get_workload(const Target &t,
         std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time).count() /
         1000.0;
 
-    uint64_t total_ops = 0;
-    for (const auto &s : stats) {
+    uint64_t total_ops = 0, busy = 0;
+    std::vector<float> lats;
+    for (auto &s : stats) {
         total_ops += s.ops;
+        busy += s.busy;
+        lats.insert(lats.end(), s.lats_us.begin(), s.lats_us.end());
+        std::vector<float>().swap(s.lats_us);
     }
 
     BenchRow row;
     row.t = t;
     row.workload = "get";
-    row.key_dist = "1-to-10-byte-decimal";
+    row.key_dist = dist.name();
     row.threads = threads;
     row.value_size = value_size;
     row.duration_sec = actual_duration;
     row.total_ops = total_ops;
     row.ops_per_sec = total_ops / actual_duration;
     row.ops_per_sec_per_thread = row.ops_per_sec / threads;
-    row.p50_us = row.p95_us = row.p99_us = 0.0;
+    row.p50_us = pct_us(lats, 0.50);
+    row.p95_us = pct_us(lats, 0.95);
+    row.p99_us = pct_us(lats, 0.99);
 
     std::cout << " => " << std::fixed << std::setprecision(2)
-              << (row.ops_per_sec / 1'000'000.0) << " Mops/sec\n";
+              << (row.ops_per_sec / 1'000'000.0) << " Mops/sec, p50/p95/p99 "
+              << row.p50_us << "/" << row.p95_us << "/" << row.p99_us << " us";
+    if (busy) std::cout << ", " << busy << " BUSY";
+    std::cout << "\n";
 
     return row;
 }
 
 static BenchRow run_put_workload(const Target &t,
                                  const std::vector<std::string> &keys,
+                                 const KeyDist &dist,
                                  int threads,
                                  int value_size,
-                                 int duration_sec) {
+                                 int duration_sec,
+                                 double rate) {
     std::cout << "\n[PUT] threads=" << threads
               << " duration=" << duration_sec << "s" << std::flush;
 
@@ -722,7 +846,7 @@ static BenchRow run_put_workload(const Target &t,
     for (int i = 0; i < threads; i++) {
         uint64_t seed = 0xBEEFULL + (uint64_t)i * 1337ULL;
         workers.emplace_back([&, i, seed]() {
-            stats[i] = put_worker(t, keys, duration_sec, value_size, seed, start_flag);
+            stats[i] = put_worker(t, keys, dist, duration_sec, rate / threads, value_size, seed, start_flag);
         });
     }
 
@@ -738,25 +862,34 @@ static BenchRow run_put_workload(const Target &t,
         std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time).count() /
         1000.0;
 
-    uint64_t total_ops = 0;
-    for (const auto &s : stats) {
+    uint64_t total_ops = 0, busy = 0;
+    std::vector<float> lats;
+    for (auto &s : stats) {
         total_ops += s.ops;
+        busy += s.busy;
+        lats.insert(lats.end(), s.lats_us.begin(), s.lats_us.end());
+        std::vector<float>().swap(s.lats_us);
     }
 
     BenchRow row;
     row.t = t;
     row.workload = "put";
-    row.key_dist = "1-to-10-byte-decimal";
+    row.key_dist = dist.name();
     row.threads = threads;
     row.value_size = value_size;
     row.duration_sec = actual_duration;
     row.total_ops = total_ops;
     row.ops_per_sec = total_ops / actual_duration;
     row.ops_per_sec_per_thread = row.ops_per_sec / threads;
-    row.p50_us = row.p95_us = row.p99_us = 0.0;
+    row.p50_us = pct_us(lats, 0.50);
+    row.p95_us = pct_us(lats, 0.95);
+    row.p99_us = pct_us(lats, 0.99);
 
     std::cout << " => " << std::fixed << std::setprecision(2)
-              << (row.ops_per_sec / 1'000'000.0) << " Mops/sec\n";
+              << (row.ops_per_sec / 1'000'000.0) << " Mops/sec, p50/p95/p99 "
+              << row.p50_us << "/" << row.p95_us << "/" << row.p99_us << " us";
+    if (busy) std::cout << ", " << busy << " BUSY";
+    std::cout << "\n";
 
     return row;
 }
@@ -770,16 +903,27 @@ struct MasstreeStyleBench {
         auto keys = build_keys(a.keys);
 
         // Preload phase
-        if (!a.skip_preload) {
-            preload(a.t, keys, a.value_size, a.preload_report_interval);
-        } else {
+        if (a.skip_preload) {
             std::cout << "\n=== Skipping preload (--skip-preload) ===" << std::endl;
+        } else if (a.server_populate) {
+            server_populate(a.t, a.keys, a.value_size);
+        } else {
+            preload(a.t, keys, a.value_size, a.preload_report_interval);
         }
 
         std::cout << "\n=== Starting Masstree-style benchmark ===" << std::endl;
-        std::cout << "Key distribution: 1-to-10-byte decimal (uniform over preloaded set)" << std::endl;
+        if (a.dist.hotspot) {
+            std::cout << "Key distribution: hotspot, " << a.dist.hot_pct << "% of requests on "
+                      << a.dist.hot_keys << " key(s), the rest uniform" << std::endl;
+        } else {
+            std::cout << "Key distribution: 1-to-10-byte decimal (uniform over preloaded set)" << std::endl;
+        }
         std::cout << "Value size: " << a.value_size << " bytes" << std::endl;
         std::cout << "Duration: " << a.duration_sec << " seconds per workload" << std::endl;
+        if (a.rate > 0) {
+            std::cout << "Open loop: " << a.rate << " requests/sec per workload, split over the client threads"
+                      << std::endl;
+        }
         std::cout << "Client thread counts: ";
         for (int t : a.thread_counts) std::cout << t << " ";
         std::cout << "\n" << std::endl;
@@ -790,14 +934,14 @@ struct MasstreeStyleBench {
         std::cout << "\n====== GET WORKLOAD ======" << std::endl;
         for (int tc : a.thread_counts) {
             if (g_stop.load()) break;
-            BenchRow row = run_get_workload(a.t, keys, tc, a.value_size, a.duration_sec);
+            BenchRow row = run_get_workload(a.t, keys, a.dist, tc, a.value_size, a.duration_sec, a.rate);
             csv.write(row);
         }
 
         std::cout << "\n====== PUT WORKLOAD ======" << std::endl;
         for (int tc : a.thread_counts) {
             if (g_stop.load()) break;
-            BenchRow row = run_put_workload(a.t, keys, tc, a.value_size, a.duration_sec);
+            BenchRow row = run_put_workload(a.t, keys, a.dist, tc, a.value_size, a.duration_sec, a.rate);
             csv.write(row);
         }
 
@@ -824,6 +968,12 @@ static void usage(const char *prog) {
         << "  --duration N          Workload duration in seconds (default: 60)\n"
         << "  --out FILE            Output CSV file (default: masstree_style_results.csv)\n"
         << "  --skip-preload        Skip preload phase (assumes data already loaded)\n"
+        << "  --server-populate     Preload with one DEBUG POPULATE, keys generated by the server\n"
+        << "  --dist uniform|hotspot  Key distribution (default: uniform)\n"
+        << "  --hot-keys N          Hotspot: number of hot keys (default: 1)\n"
+        << "  --hot-pct P           Hotspot: percent of requests on the hot keys (default: 90)\n"
+        << "  --rate N              Open loop: N requests/sec in total, latency from the scheduled\n"
+        << "                        send time (default: 0 = closed loop)\n"
         << "\nExamples:\n"
         << "  # Quick test:\n"
         << "  " << prog << " --name mako --port 6380 --keys 100000 --duration 10\n"
@@ -832,7 +982,16 @@ static void usage(const char *prog) {
         << "  " << prog << " --name mako --port 6380 --keys 1000000 --duration 60 --out mako_results.csv\n"
         << "\n"
         << "  # Compare with Redis:\n"
-        << "  " << prog << " --name redis --port 6378 --out redis_results.csv\n";
+        << "  " << prog << " --name redis --port 6378 --out redis_results.csv\n"
+        << "\n"
+        << "  # One viral key (hot key read replicas):\n"
+        << "  " << prog << " --name mako --port 6380 --dist hotspot --hot-keys 1 --hot-pct 90\n"
+        << "\n"
+        << "  # Large keyspace without the preload round trips:\n"
+        << "  " << prog << " --name mako --port 6380 --keys 20000000 --server-populate\n"
+        << "\n"
+        << "  # Overload (p99 with admission control):\n"
+        << "  " << prog << " --name mako --port 6380 --threads 64 --rate 500000 --skip-preload\n";
 }
 
 static std::vector<int> parse_int_list(const std::string &s) {
@@ -877,6 +1036,22 @@ static void parse_args(int argc, char **argv, Args &a) {
             need_value(); a.out_csv = argv[++i];
         } else if (arg == "--skip-preload") {
             a.skip_preload = true;
+        } else if (arg == "--server-populate") {
+            a.server_populate = true;
+        } else if (arg == "--dist") {
+            need_value();
+            std::string d = argv[++i];
+            if (d != "uniform" && d != "hotspot") {
+                std::cerr << "Error: --dist must be uniform or hotspot\n";
+                std::exit(1);
+            }
+            a.dist.hotspot = d == "hotspot";
+        } else if (arg == "--hot-keys") {
+            need_value(); a.dist.hot_keys = std::max<uint64_t>(1, std::stoull(argv[++i]));
+        } else if (arg == "--hot-pct") {
+            need_value(); a.dist.hot_pct = std::stoi(argv[++i]);
+        } else if (arg == "--rate") {
+            need_value(); a.rate = std::stod(argv[++i]);
         } else {
             std::cerr << "Error: Unknown option: " << arg << "\n";
             usage(argv[0]);
@@ -904,7 +1079,9 @@ int main(int argc, char **argv) {
               << "Keys: " << args.keys << "\n"
               << "Value size: " << args.value_size << " bytes\n"
               << "Duration: " << args.duration_sec << " seconds per workload\n"
-              << "Preload: Single-threaded (unless --skip-preload)\n"
+              << "Preload: " << (args.skip_preload ? "skipped"
+                                 : args.server_populate ? "DEBUG POPULATE on the server"
+                                                        : "single-threaded SETs") << "\n"
               << "========================================\n";
 
     try {
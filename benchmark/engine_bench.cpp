@@ -0,0 +1,1574 @@
+// engine_bench.cpp
+// Build: built by mako/CMakeLists.txt as `engine_bench` (links the mako_engine library)
+//   cd mako/build && make engine_bench
+//
+// In-process micro benchmarks for the KVStore data structures. No sockets and
+// no Rust layer are involved, so the numbers isolate the engine itself.
+//
+// Usage examples:
+//   ./engine_bench --suite pubsub --subscribers 10000 --messages 1000
+//   ./engine_bench --suite bitop --bitmaps 10 --mb 128
+//   ./engine_bench --suite bloom --items 1000000 --error 0.01
+//   ./engine_bench --suite stream --entries 1000000 --reads 1000 --window 100
+//   ./engine_bench --suite timeseries --samples 1000000 --bucket 60000
+//   ./engine_bench --suite vector --vectors 100000 --dim 128 --queries 200 --nlist 256
+//   ./engine_bench --suite index --hashes 100000 --queries 100
+//   ./engine_bench --suite json --fields 1000 --ops 100000
+//   ./engine_bench --suite geo --points 1000000 --queries 1000 --radius 2000
+//   ./engine_bench --suite hotkeys --keys 100000 --ops 5000000 --threads 4
+//   ./engine_bench --suite replicas --keys 100000 --ops 2000000 --threads 4 --hot-pct 90
+//   ./engine_bench --suite counters --ops 4000000 --threads 4
+//   ./engine_bench --suite coalesce --keys 100000 --ops 2000000 --threads 8 --hot-pct 90
+//   ./engine_bench --suite admission --threads 8 --seconds 2 --load 150 --deadline-us 2000
+//   ./engine_bench --suite slowreads --keys 200000 --seconds 2
+//   ./engine_bench --suite chunked --members 2000000 --rounds 3
+//   ./engine_bench --suite resultcache --keys 100 --elements 1000 --ops 200000 --threads 4 --write-pct 1
+//   ./engine_bench --suite script --keys 10 --decisions 20000 --threads 8 --limit 1500 --rtt-us 50
+//   ./engine_bench --suite throttle --keys 100000 --decisions 2000000
+//   ./engine_bench --suite bulkload --keys 2000000 --threads 4
+//   ./engine_bench --suite populate --keys 2000000 --size 8 --threads 4
+//   ./engine_bench --suite dump --keys 2000000 --size 64 --threads 4
+
+#include "kv_store.h"
+#include "bitops.h"
+#include "bloom_filter.h"
+#include "geo_set.h"
+#include "single_flight.h"
+#include "executor.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <future>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include <unistd.h>
+
+using Clock = std::chrono::steady_clock;
+
+struct Args {
+    std::string suite;
+    std::map<std::string, std::string> opts;   // suite specific --name value pairs
+};
+
+static long long opt_int(const Args &a, const std::string &name, long long def) {
+    auto it = a.opts.find(name);
+    return it == a.opts.end() ? def : std::stoll(it->second);
+}
+
+static double elapsed_sec(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+static uint64_t now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               Clock::now().time_since_epoch())
+        .count();
+}
+
+static double percentile_us(std::vector<uint64_t> &samples_ns, double p) {
+    if (samples_ns.empty()) return 0.0;
+    size_t idx = static_cast<size_t>(p * (samples_ns.size() - 1));
+    std::nth_element(samples_ns.begin(), samples_ns.begin() + idx, samples_ns.end());
+    return samples_ns[idx] / 1000.0;
+}
+
+// ===== pubsub: 1 publisher fanning out to N subscribers =====
+static void run_pubsub(const Args &a) {
+    const uint64_t subscribers = opt_int(a, "subscribers", 10000);
+    const uint64_t messages = opt_int(a, "messages", 1000);
+    const size_t payload = std::max<long long>(opt_int(a, "payload", 64), 20);
+
+    KVStore kv;
+    PubSub &ps = kv.pubsub();
+    for (uint64_t id = 1; id <= subscribers; id++) {
+        kv.subscribe(id, "news");
+    }
+
+    std::cout << "Subscribers: " << subscribers << ", messages: " << messages
+              << ", payload: " << payload << " bytes" << std::endl;
+
+    // One consumer thread plays all subscriber connections and drains their queues
+    std::atomic<bool> done{false};
+    std::vector<uint64_t> latencies;
+    latencies.reserve(subscribers * messages);
+    std::thread consumer([&]() {
+        std::vector<PubSub::Message> batch;
+        uint64_t delivered = 0;
+        while (delivered < subscribers * messages) {
+            for (uint64_t id = 1; id <= subscribers; id++) {
+                batch.clear();
+                ps.drain(id, batch);
+                uint64_t now = now_ns();
+                for (const auto &frame : batch) {
+                    // The payload sits right before the trailing CRLF and starts with the publish time
+                    const char *p = frame->data() + frame->size() - 2 - payload;
+                    latencies.push_back(now - std::strtoull(p, nullptr, 10));
+                }
+                delivered += batch.size();
+            }
+        }
+        done.store(true);
+    });
+
+    std::string msg(payload, 'x');
+    auto start = Clock::now();
+    for (uint64_t i = 0; i < messages; i++) {
+        std::string ts = std::to_string(now_ns());
+        ts.resize(20, ' ');
+        msg.replace(0, ts.size(), ts);
+        kv.publish("news", msg);
+    }
+    double publish_sec = elapsed_sec(start);
+    consumer.join();
+    double total_sec = elapsed_sec(start);
+
+    std::cout << std::fixed << std::setprecision(2)
+              << "  publish:   " << (messages / publish_sec) << " msgs/sec ("
+              << (subscribers * messages / publish_sec / 1e6) << " M deliveries/sec)\n"
+              << "  end-to-end: " << (subscribers * messages / total_sec / 1e6)
+              << " M deliveries/sec\n"
+              << "  delivery latency p50=" << percentile_us(latencies, 0.50)
+              << "us p99=" << percentile_us(latencies, 0.99)
+              << "us max=" << percentile_us(latencies, 1.0) << "us\n";
+}
+
+// ===== bitop: BITOP/BITCOUNT over large bitmaps, per kernel set =====
+static void run_bitop(const Args &a) {
+    const int bitmaps = static_cast<int>(opt_int(a, "bitmaps", 10));
+    const size_t bytes = static_cast<size_t>(opt_int(a, "mb", 128)) << 20;
+
+    KVStore kv;
+    std::mt19937_64 rng(42);
+    std::string keys;
+    std::vector<bitops::Source> sources;
+    for (int i = 0; i < bitmaps; i++) {
+        std::string bm(bytes, '\0');
+        for (size_t off = 0; off + 8 <= bytes; off += 8) {
+            uint64_t r = rng();
+            std::memcpy(&bm[off], &r, 8);
+        }
+        std::string key = "bm:" + std::to_string(i);
+        kv.set(key, bm);
+        keys += (i ? "," : "") + key;
+    }
+    for (int i = 0; i < bitmaps; i++) {
+        // set() copied the value in; point the kernels at the stored buffers
+        auto views = kv.getrange_view("bm:" + std::to_string(i), 0, -1);
+        sources.push_back({reinterpret_cast<const uint8_t *>(views[0].data()), views[0].size()});
+    }
+
+    std::cout << "Bitmaps: " << bitmaps << " x " << (bytes >> 20) << " MB (best kernels: "
+              << bitops::kernels().name << ")" << std::endl;
+
+    const double input_gb = bitmaps * static_cast<double>(bytes) / 1e9;
+    for (bitops::Isa isa : {bitops::Isa::Scalar, bitops::Isa::Popcnt, bitops::Isa::Avx2}) {
+        const bitops::Kernels &k = bitops::kernels_for(isa);
+        if (k.isa != isa) {
+            std::cout << "  (skipping unsupported ISA)" << std::endl;
+            continue;
+        }
+        std::string dst;
+        for (auto op : {bitops::Op::And, bitops::Op::Or, bitops::Op::Xor}) {
+            const char *name = op == bitops::Op::And ? "AND" : op == bitops::Op::Or ? "OR" : "XOR";
+            auto start = Clock::now();
+            bitops::bitop(k, op, sources, dst);
+            double sec = elapsed_sec(start);
+            std::cout << std::fixed << std::setprecision(3) << "  [" << k.name << "] BITOP " << name
+                      << ": " << sec << "s (" << (input_gb / sec) << " GB/s input)\n";
+        }
+        auto start = Clock::now();
+        uint64_t bits = k.popcount(sources[0].data, sources[0].len);
+        double sec = elapsed_sec(start);
+        std::cout << std::fixed << std::setprecision(3) << "  [" << k.name << "] BITCOUNT: " << sec
+                  << "s (" << (bytes / sec / 1e9) << " GB/s, " << bits << " bits)\n";
+    }
+
+    // End-to-end through the command path (dispatches to the best kernels)
+    auto start = Clock::now();
+    KVStore::Result r = kv.bitop("AND", "bm:dest", keys);
+    double sec = elapsed_sec(start);
+    std::cout << std::fixed << std::setprecision(3) << "  KVStore::bitop AND -> " << r.value
+              << " bytes in " << sec << "s (" << (input_gb / sec) << " GB/s input)\n";
+}
+
+// ===== bloom: membership filter vs unordered_set =====
+static size_t g_alloc_bytes = 0;
+
+// Counts the heap bytes held by a node container (nodes and bucket array)
+template <typename T>
+struct CountingAllocator {
+    using value_type = T;
+    CountingAllocator() = default;
+    template <typename U>
+    CountingAllocator(const CountingAllocator<U> &) {}
+    T *allocate(size_t n) {
+        g_alloc_bytes += n * sizeof(T);
+        return std::allocator<T>().allocate(n);
+    }
+    void deallocate(T *p, size_t n) {
+        g_alloc_bytes -= n * sizeof(T);
+        std::allocator<T>().deallocate(p, n);
+    }
+    template <typename U>
+    bool operator==(const CountingAllocator<U> &) const { return true; }
+    template <typename U>
+    bool operator!=(const CountingAllocator<U> &) const { return false; }
+};
+
+static void run_bloom(const Args &a) {
+    const uint64_t items = opt_int(a, "items", 1000000);
+    auto it = a.opts.find("error");
+    const double error = it == a.opts.end() ? 0.01 : std::stod(it->second);
+
+    // Ids long enough to defeat the small string optimization, like real ids
+    std::vector<std::string> present, absent;
+    present.reserve(items);
+    absent.reserve(items);
+    for (uint64_t i = 0; i < items; i++) {
+        present.push_back("user:session:" + std::to_string(i * 2));
+        absent.push_back("user:session:" + std::to_string(i * 2 + 1));
+    }
+    std::mt19937_64 rng(7);
+    std::shuffle(present.begin(), present.end(), rng);
+    std::shuffle(absent.begin(), absent.end(), rng);
+
+    std::cout << "Items: " << items << ", target error: " << error << std::endl;
+
+    using CountingSet = std::unordered_set<std::string, std::hash<std::string>, std::equal_to<std::string>,
+                                           CountingAllocator<std::string>>;
+    CountingSet set;
+    auto start = Clock::now();
+    for (const auto &s : present) set.insert(s);
+    double set_insert = elapsed_sec(start);
+    // Out-of-line string buffers are not seen by the allocator; add them by hand
+    size_t set_bytes = g_alloc_bytes;
+    for (const auto &s : set) {
+        if (s.capacity() > 15) set_bytes += s.capacity() + 1;
+    }
+
+    ScalableBloomFilter presized(items, error);
+    start = Clock::now();
+    for (const auto &s : present) presized.add(s);
+    double bf_insert = elapsed_sec(start);
+
+    // Default-sized filter that has to grow through chained layers
+    ScalableBloomFilter scaled(ScalableBloomFilter::kDefaultCapacity, error);
+    start = Clock::now();
+    for (const auto &s : present) scaled.add(s);
+    double scaled_insert = elapsed_sec(start);
+
+    auto lookup = [&](const char *name, auto &&contains, size_t bytes, double insert_sec) {
+        uint64_t hits = 0, false_pos = 0;
+        auto t0 = Clock::now();
+        for (const auto &s : present) hits += contains(s);
+        for (const auto &s : absent) false_pos += contains(s);
+        double sec = elapsed_sec(t0);
+        std::cout << std::fixed << std::setprecision(2) << "  " << std::left << std::setw(22) << name
+                  << std::right << " mem=" << std::setw(8) << (bytes / 1048576.0) << " MB ("
+                  << std::setprecision(1) << (8.0 * bytes / items) << " bits/item)"
+                  << std::setprecision(2) << " insert=" << (items / insert_sec / 1e6) << " M/s"
+                  << " lookup=" << (2 * items / sec / 1e6) << " M/s"
+                  << std::setprecision(3) << " fp=" << (100.0 * false_pos / items) << "%"
+                  << (hits == items ? "" : " (MISSED PRESENT ITEMS)") << "\n";
+    };
+
+    lookup("unordered_set", [&](const std::string &s) { return set.count(s) != 0; }, set_bytes, set_insert);
+    lookup("bloom (presized)", [&](const std::string &s) { return presized.contains(s); },
+           presized.memory_bytes(), bf_insert);
+    std::string name = "bloom (" + std::to_string(scaled.layers()) + " layers)";
+    lookup(name.c_str(), [&](const std::string &s) { return scaled.contains(s); }, scaled.memory_bytes(),
+           scaled_insert);
+}
+
+// ===== stream: XRANGE over packed nodes vs LRANGE over a list =====
+static void run_stream(const Args &a) {
+    const uint64_t entries = opt_int(a, "entries", 1000000);
+    const uint64_t reads = opt_int(a, "reads", 1000);
+    const uint64_t window = opt_int(a, "window", 100);
+
+    KVStore kv;
+    std::string payload = "sensor:42,temp:21.5,unit:celsius";
+    auto start = Clock::now();
+    for (uint64_t i = 1; i <= entries; i++) {
+        kv.xadd("events", std::to_string(i) + "-0", payload);
+    }
+    double xadd_sec = elapsed_sec(start);
+    start = Clock::now();
+    for (uint64_t i = 1; i <= entries; i++) {
+        kv.rpush("events:list", payload);
+    }
+    double rpush_sec = elapsed_sec(start);
+
+    std::cout << "Entries: " << entries << ", reads: " << reads << " x " << window << " entries" << std::endl;
+    std::cout << std::fixed << std::setprecision(2) << "  append: XADD " << (entries / xadd_sec / 1e6)
+              << " M/s, RPUSH " << (entries / rpush_sec / 1e6) << " M/s\n";
+
+    // Uniformly random windows, so most reads start deep inside the log
+    std::mt19937_64 rng(1);
+    std::vector<uint64_t> offsets(reads);
+    for (auto &o : offsets) o = rng() % (entries - window + 1);
+
+    size_t bytes = 0;
+    std::vector<uint64_t> lat;
+    start = Clock::now();
+    for (uint64_t o : offsets) {
+        uint64_t t0 = now_ns();
+        bytes += kv.xrange("events", std::to_string(o + 1), "+", window).value.size();
+        lat.push_back(now_ns() - t0);
+    }
+    double x_sec = elapsed_sec(start);
+    std::cout << "  XRANGE: " << (reads / x_sec) << " reads/sec p50=" << percentile_us(lat, 0.5)
+              << "us p99=" << percentile_us(lat, 0.99) << "us\n";
+
+    lat.clear();
+    start = Clock::now();
+    for (uint64_t o : offsets) {
+        uint64_t t0 = now_ns();
+        bytes += kv.lrange("events:list", static_cast<int>(o), static_cast<int>(o + window - 1)).value.size();
+        lat.push_back(now_ns() - t0);
+    }
+    double l_sec = elapsed_sec(start);
+    std::cout << "  LRANGE: " << (reads / l_sec) << " reads/sec p50=" << percentile_us(lat, 0.5)
+              << "us p99=" << percentile_us(lat, 0.99) << "us\n"
+              << "  (" << bytes << " bytes returned)\n";
+}
+
+// ===== timeseries: compressed chunks vs a hash of timestamp -> value =====
+static void run_timeseries(const Args &a) {
+    const uint64_t samples = opt_int(a, "samples", 1000000);
+    const int64_t bucket = opt_int(a, "bucket", 60000);
+
+    // A gauge sampled every second with occasional jitter, one decimal place
+    std::mt19937_64 rng(5);
+    std::vector<int64_t> times(samples);
+    std::vector<double> values(samples);
+    int64_t t = 1700000000000LL;
+    double v = 50.0;
+    for (uint64_t i = 0; i < samples; i++) {
+        t += 1000 + (rng() % 20 == 0 ? static_cast<int64_t>(rng() % 40) - 20 : 0);
+        v = std::round((v + (static_cast<int>(rng() % 21) - 10) / 10.0) * 10.0) / 10.0;
+        times[i] = t;
+        values[i] = v;
+    }
+    std::cout << "Samples: " << samples << ", bucket: " << bucket << " ms" << std::endl;
+
+    TimeSeries ts;
+    auto start = Clock::now();
+    for (uint64_t i = 0; i < samples; i++) ts.add(times[i], values[i]);
+    double add_sec = elapsed_sec(start);
+
+    // The layout this replaces: a hash field per timestamp holding the value as text
+    using CountingHash = std::unordered_map<std::string, std::string, std::hash<std::string>,
+                                            std::equal_to<std::string>,
+                                            CountingAllocator<std::pair<const std::string, std::string>>>;
+    g_alloc_bytes = 0;
+    CountingHash hash;
+    start = Clock::now();
+    for (uint64_t i = 0; i < samples; i++) {
+        std::ostringstream val;
+        val << values[i];
+        hash.emplace(std::to_string(times[i]), val.str());
+    }
+    double hash_sec = elapsed_sec(start);
+    size_t hash_bytes = g_alloc_bytes;
+    for (const auto &p : hash) {
+        if (p.first.capacity() > 15) hash_bytes += p.first.capacity() + 1;
+        if (p.second.capacity() > 15) hash_bytes += p.second.capacity() + 1;
+    }
+
+    std::cout << std::fixed << std::setprecision(2) << "  timeseries: " << (ts.memory_bytes() / 1048576.0)
+              << " MB (" << (double)ts.memory_bytes() / samples << " bytes/sample, " << ts.chunks()
+              << " chunks), add " << (samples / add_sec / 1e6) << " M/s\n"
+              << "  hash:       " << (hash_bytes / 1048576.0) << " MB (" << (double)hash_bytes / samples
+              << " bytes/sample), add " << (samples / hash_sec / 1e6) << " M/s\n";
+
+    std::vector<TimeSeries::Sample> out;
+    for (auto agg : {TimeSeries::Aggregation::None, TimeSeries::Aggregation::Avg,
+                     TimeSeries::Aggregation::Max}) {
+        const char *name = agg == TimeSeries::Aggregation::None ? "raw" : agg == TimeSeries::Aggregation::Avg ? "avg" : "max";
+        out.clear();
+        start = Clock::now();
+        ts.range(0, INT64_MAX, agg, bucket, out);
+        double sec = elapsed_sec(start);
+        std::cout << "  TS.RANGE " << std::left << std::setw(4) << name << std::right << ": "
+                  << (samples / sec / 1e6) << " M samples/sec decoded -> " << out.size() << " points\n";
+    }
+
+    // Same avg query against the hash: scan every field and parse it
+    start = Clock::now();
+    std::map<int64_t, std::pair<double, size_t>> buckets;
+    for (const auto &p : hash) {
+        int64_t ts_ms = std::stoll(p.first);
+        auto &b = buckets[ts_ms - ts_ms % bucket];
+        b.first += std::stod(p.second);
+        b.second++;
+    }
+    double scan_sec = elapsed_sec(start);
+    std::cout << "  hash scan avg: " << (samples / scan_sec / 1e6) << " M samples/sec -> " << buckets.size()
+              << " points\n";
+
+    // The aggregation kernels alone, over already decoded values
+    for (const TimeSeries::Kernels *k : {&TimeSeries::scalar_kernels(), &TimeSeries::kernels()}) {
+        double sink = 0;
+        const int rounds = 20;
+        start = Clock::now();
+        for (int r = 0; r < rounds; r++) {
+            sink += k->sum(values.data(), samples) + k->max(values.data(), samples);
+        }
+        double sec = elapsed_sec(start);
+        std::cout << "  kernels [" << k->name << "] sum+max: " << (2.0 * rounds * samples / sec / 1e9)
+                  << " G values/sec (" << sink << ")\n";
+    }
+}
+
+// ===== vector: exact vs IVF k-nearest-neighbor search =====
+static void run_vector(const Args &a) {
+    const size_t n = opt_int(a, "vectors", 100000);
+    const size_t dim = opt_int(a, "dim", 128);
+    const size_t queries = opt_int(a, "queries", 200);
+    const size_t nlist = opt_int(a, "nlist", 256);
+    const size_t k = opt_int(a, "k", 10);
+
+    // Gaussian clusters, which is what embeddings look like to IVF (uniform
+    // random vectors have no structure for k-means to find)
+    const size_t clusters = 1000;
+    std::mt19937 rng(11);
+    std::normal_distribution<float> nd;
+    std::vector<float> centers(clusters * dim);
+    for (auto &x : centers) x = nd(rng);
+    auto sample = [&](float *out) {
+        const float *c = centers.data() + (rng() % clusters) * dim;
+        for (size_t d = 0; d < dim; d++) out[d] = c[d] + 0.3f * nd(rng);
+    };
+
+    std::vector<float> data(n * dim);
+    std::vector<std::string> ids(n);
+    for (size_t i = 0; i < n; i++) {
+        sample(data.data() + i * dim);
+        ids[i] = std::to_string(i);
+    }
+    VectorSet vs(dim, VectorSet::Metric::L2);
+    auto start = Clock::now();
+    for (size_t i = 0; i < n; i++) vs.add(ids[i], data.data() + i * dim);
+    double add_sec = elapsed_sec(start);
+    std::vector<float> qs(queries * dim);
+    for (size_t q = 0; q < queries; q++) sample(qs.data() + q * dim);
+
+    std::cout << "Vectors: " << n << " x " << dim << " float32, queries: " << queries << ", k: " << k
+              << " (kernels: " << VectorSet::kernels().name << ")" << std::endl;
+    std::cout << std::fixed << std::setprecision(2) << "  add: " << (n / add_sec / 1e6) << " M/s, "
+              << (vs.memory_bytes() / 1048576.0) << " MB\n";
+
+    std::vector<std::vector<VectorSet::Match>> truth(queries);
+    start = Clock::now();
+    for (size_t q = 0; q < queries; q++) vs.knn(qs.data() + q * dim, k, 0, truth[q]);
+    double exact_sec = elapsed_sec(start);
+    std::cout << "  exact:         " << std::setw(9) << (queries / exact_sec) << " QPS  recall@" << k
+              << "=1.000  (" << (n * dim * sizeof(float) * queries / exact_sec / 1e9) << " GB/s scanned)\n";
+
+    start = Clock::now();
+    vs.build_ivf(nlist);
+    std::cout << "  IVF build (" << nlist << " lists): " << elapsed_sec(start) << "s\n";
+
+    for (size_t nprobe : {1, 4, 16, 64}) {
+        if (nprobe > nlist) break;
+        std::vector<VectorSet::Match> got;
+        size_t hits = 0;
+        start = Clock::now();
+        for (size_t q = 0; q < queries; q++) {
+            got.clear();
+            vs.knn(qs.data() + q * dim, k, nprobe, got);
+            for (const auto &m : got) {
+                for (const auto &t : truth[q]) hits += m.id == t.id;
+            }
+        }
+        double sec = elapsed_sec(start);
+        std::cout << "  IVF nprobe=" << std::left << std::setw(3) << nprobe << std::right << std::setw(9)
+                  << (queries / sec) << " QPS  recall@" << k << "=" << std::setprecision(3)
+                  << (double)hits / (queries * k) << std::setprecision(2) << "\n";
+    }
+}
+
+// ===== index: secondary index queries vs scanning every hash =====
+static void run_index(const Args &a) {
+    const uint64_t hashes = opt_int(a, "hashes", 100000);
+    const uint64_t queries = opt_int(a, "queries", 100);
+    const int categories = 50;
+
+    std::mt19937_64 rng(9);
+    std::vector<std::string> prices(hashes), cats(hashes);
+    for (uint64_t i = 0; i < hashes; i++) {
+        prices[i] = std::to_string(rng() % 100000 / 100.0);
+        cats[i] = "cat" + std::to_string(rng() % categories);
+    }
+    auto load = [&](KVStore &kv) {
+        auto start = Clock::now();
+        for (uint64_t i = 0; i < hashes; i++) {
+            std::string key = "item:" + std::to_string(i);
+            kv.hset(key, "name", "product " + std::to_string(i));
+            kv.hset(key, "price", prices[i]);
+            kv.hset(key, "cat", cats[i]);
+        }
+        return elapsed_sec(start);
+    };
+
+    KVStore plain, indexed;
+    indexed.idx_create("byprice", "item:", "price", "NUMERIC");
+    indexed.idx_create("bycat", "item:", "cat", "TAG");
+    double plain_sec = load(plain);
+    double indexed_sec = load(indexed);
+    std::cout << "Hashes: " << hashes << " (3 fields), queries: " << queries << std::endl;
+    std::cout << std::fixed << std::setprecision(2) << "  HSET: " << (3 * hashes / plain_sec / 1e6)
+              << " M/s without indexes, " << (3 * hashes / indexed_sec / 1e6) << " M/s with 2 indexes\n";
+
+    // Each numeric query selects a 1% price window
+    std::vector<double> lows(queries);
+    for (auto &l : lows) l = (rng() % 99000) / 100.0;
+    size_t matched = 0;
+    auto start = Clock::now();
+    for (double lo : lows) {
+        std::string r = indexed.idx_query("byprice", std::to_string(lo) + "," + std::to_string(lo + 10)).value;
+        matched += r.empty() ? 0 : std::count(r.begin(), r.end(), ',') + 1;
+    }
+    double idx_num = elapsed_sec(start);
+    start = Clock::now();
+    for (uint64_t q = 0; q < queries; q++) {
+        std::string r = indexed.idx_query("bycat", "cat" + std::to_string(q % categories)).value;
+        matched += r.empty() ? 0 : std::count(r.begin(), r.end(), ',') + 1;
+    }
+    double idx_tag = elapsed_sec(start);
+
+    // What clients do today: HGETALL every hash and filter (minus the network)
+    const uint64_t scan_queries = std::max<uint64_t>(1, queries / 20);
+    start = Clock::now();
+    for (uint64_t q = 0; q < scan_queries; q++) {
+        double lo = lows[q];
+        for (uint64_t i = 0; i < hashes; i++) {
+            std::string all = plain.hgetall("item:" + std::to_string(i)).value;
+            size_t p = all.find("price:");
+            double price = std::strtod(all.c_str() + p + 6, nullptr);
+            matched += price >= lo && price <= lo + 10;
+        }
+    }
+    double scan = elapsed_sec(start) / scan_queries;
+
+    std::cout << "  numeric range (1%): " << (queries / idx_num) << " queries/sec ("
+              << (idx_num / queries * 1e6) << " us each)\n"
+              << "  tag match (1/" << categories << "):   " << (queries / idx_tag) << " queries/sec ("
+              << (idx_tag / queries * 1e6) << " us each)\n"
+              << "  HGETALL scan:       " << (1.0 / scan) << " queries/sec (" << (scan * 1e6)
+              << " us each)\n  (" << matched << " matches)\n";
+}
+
+// ===== json: path updates on the binary encoding vs re-parsing text =====
+static void run_json(const Args &a) {
+    const uint64_t fields = opt_int(a, "fields", 1000);
+    const uint64_t ops = opt_int(a, "ops", 100000);
+
+    std::string text = "{\"counter\":0,\"fields\":{";
+    for (uint64_t i = 0; i < fields; i++) {
+        if (i) text += ",";
+        text += "\"f" + std::to_string(i) + "\":{\"name\":\"value " + std::to_string(i) +
+                "\",\"score\":" + std::to_string(i) + ",\"tags\":[\"a\",\"b\"]}";
+    }
+    text += "}}";
+
+    KVStore kv;
+    kv.json_set("doc", "$", text);
+    std::mt19937_64 rng(5);
+    std::vector<std::string> paths(ops);
+    for (auto &p : paths) p = "$.fields.f" + std::to_string(rng() % fields);
+    std::cout << "Document: " << fields << " fields, " << text.size() << " bytes of JSON, ops: " << ops
+              << std::endl;
+
+    auto bench = [&](const char *name, const std::function<void(uint64_t)> &op) {
+        auto start = Clock::now();
+        for (uint64_t i = 0; i < ops; i++) op(i);
+        double sec = elapsed_sec(start);
+        std::cout << std::fixed << std::setprecision(2) << "  " << std::left << std::setw(30) << name
+                  << std::right << std::setw(10) << (ops / sec / 1e3) << " K ops/sec ("
+                  << (sec / ops * 1e6) << " us each)\n";
+    };
+    size_t bytes = 0;
+    bench("JSON.GET field", [&](uint64_t i) { bytes += kv.json_get("doc", paths[i] + ".name").value.size(); });
+    bench("JSON.NUMINCRBY (in place)", [&](uint64_t i) { kv.json_numincrby("doc", paths[i] + ".score", "1"); });
+    bench("JSON.SET same size (in place)", [&](uint64_t i) { kv.json_set("doc", paths[i] + ".tags[0]", "\"z\""); });
+    bench("JSON.SET resize (splice)", [&](uint64_t i) {
+        kv.json_set("doc", paths[i] + ".tags[1]", i % 2 ? "\"bb\"" : "\"b\"");
+    });
+    bench("JSON.SET new member (splice)", [&](uint64_t i) {
+        kv.json_set("doc", paths[i] + ".n" + std::to_string(i), "1");
+    });
+
+    // A JSON type that stores text has to parse and print the whole document per update
+    const uint64_t text_ops = std::max<uint64_t>(1, ops / 100);
+    kv.set("doc:text", text);
+    auto start = Clock::now();
+    for (uint64_t i = 0; i < text_ops; i++) {
+        JsonDoc doc;
+        std::string error, out;
+        doc.parse(kv.get("doc:text").value, error);
+        std::string incremented;
+        doc.numincrby(paths[i] + ".score", 1, true, 1, incremented);
+        doc.get("$", out);
+        kv.set("doc:text", out);
+    }
+    double sec = elapsed_sec(start);
+    std::cout << "  " << std::left << std::setw(30) << "text parse+update+print" << std::right << std::setw(10)
+              << (text_ops / sec / 1e3) << " K ops/sec (" << (sec / text_ops * 1e6) << " us each)\n"
+              << "  (" << bytes << " bytes read)\n";
+}
+
+// ===== geo: geohash range search vs a client-side scan =====
+static void run_geo(const Args &a) {
+    const uint64_t points = opt_int(a, "points", 1000000);
+    const uint64_t queries = opt_int(a, "queries", 1000);
+    const double radius = static_cast<double>(opt_int(a, "radius", 2000));
+
+    // Drivers spread over a 60km x 60km metro area
+    std::mt19937_64 rng(11);
+    std::uniform_real_distribution<double> lon(-74.3, -73.6), lat(40.4, 40.95);
+    std::vector<GeoSet::Point> coords(points);
+    for (auto &c : coords) c = {lon(rng), lat(rng)};
+
+    GeoSet geo;
+    auto start = Clock::now();
+    for (uint64_t i = 0; i < points; i++) {
+        geo.add("driver:" + std::to_string(i), coords[i]);
+    }
+    double add_sec = elapsed_sec(start);
+    std::cout << "Points: " << points << ", queries: " << queries << " x " << radius << "m radius" << std::endl;
+    std::cout << std::fixed << std::setprecision(2) << "  GEOADD: " << (points / add_sec / 1e6) << " M/s, "
+              << (geo.memory_bytes() / 1048576.0) << " MB\n";
+
+    std::vector<GeoSet::Query> qs(queries);
+    for (auto &q : qs) {
+        q.center = {lon(rng), lat(rng)};
+        q.radius_m = radius;
+    }
+    size_t found = 0, examined = 0, ranges = 0;
+    std::vector<GeoSet::Match> out;
+    std::vector<std::pair<uint64_t, uint64_t>> cover;
+    std::vector<uint64_t> lat_ns;
+    start = Clock::now();
+    for (const auto &q : qs) {
+        uint64_t t0 = now_ns();
+        out.clear();
+        examined += geo.search(q, out);
+        lat_ns.push_back(now_ns() - t0);
+        found += out.size();
+    }
+    double search_sec = elapsed_sec(start);
+    for (const auto &q : qs) {
+        GeoSet::cover(q, cover);
+        ranges += cover.size();
+    }
+    std::cout << "  GEOSEARCH: " << (queries / search_sec) << " queries/sec p50=" << percentile_us(lat_ns, 0.5)
+              << "us p99=" << percentile_us(lat_ns, 0.99) << "us\n"
+              << "    " << (double(ranges) / queries) << " hash ranges, " << (double(examined) / queries)
+              << " candidates and " << (double(found) / queries) << " matches per query\n";
+
+    // What clients do today: fetch every position and filter
+    const uint64_t scan_queries = std::max<uint64_t>(1, queries / 50);
+    size_t scanned = 0;
+    start = Clock::now();
+    for (uint64_t i = 0; i < scan_queries; i++) {
+        for (const auto &c : coords) {
+            scanned += GeoSet::distance(qs[i].center, c) <= radius;
+        }
+    }
+    double scan = elapsed_sec(start) / scan_queries;
+    std::cout << "  full scan: " << (1.0 / scan) << " queries/sec (" << (scan * 1e3) << " ms each, " << scanned
+              << " matches)\n";
+}
+
+// ===== hotkeys: sampling overhead on GET and top-k accuracy under a Zipf load =====
+static void run_hotkeys(const Args &a) {
+    const uint64_t keys = opt_int(a, "keys", 100000);
+    const uint64_t ops = opt_int(a, "ops", 5000000);
+    const int threads = static_cast<int>(opt_int(a, "threads", 4));
+
+    // Zipf(1.0) over the key space, drawn up front
+    std::vector<double> cdf(keys);
+    double sum = 0;
+    for (uint64_t i = 0; i < keys; i++) cdf[i] = (sum += 1.0 / (i + 1));
+    std::mt19937_64 rng(13);
+    std::uniform_real_distribution<double> u(0, sum);
+    std::vector<uint32_t> trace(ops);
+    std::vector<uint64_t> exact(keys, 0);
+    for (auto &t : trace) {
+        t = static_cast<uint32_t>(std::lower_bound(cdf.begin(), cdf.end(), u(rng)) - cdf.begin());
+        exact[t]++;
+    }
+    std::vector<std::string> names(keys);
+    for (uint64_t i = 0; i < keys; i++) names[i] = "key:" + std::to_string(i);
+
+    KVStore kv;
+    for (const auto &n : names) kv.set(n, "v");
+    std::cout << "Keys: " << keys << " (Zipf 1.0), GET ops: " << ops << std::endl;
+
+    size_t bytes = 0;
+    auto run = [&](const char *sample) {
+        kv.hotkeys(std::string("SAMPLE,") + sample);
+        auto start = Clock::now();
+        for (uint32_t t : trace) bytes += kv.execute_operation("get", names[t], "").value.size();
+        return elapsed_sec(start) / ops * 1e9;
+    };
+    double off = run("0");
+    double every16 = run("16");
+    double every1 = run("1");
+    double every16_again = run("16");
+    std::cout << std::fixed << std::setprecision(1) << "  GET: " << off << " ns/op untracked, "
+              << std::min(every16, every16_again) << " ns/op sampling 1/16, " << every1 << " ns/op sampling every op\n";
+
+    // Top-10 from the sampled sketch (state left by the last 1/16 run) against exact counts
+    std::vector<HotKeys::Entry> top;
+    kv.hot_keys().top(10, top);
+    std::vector<uint64_t> order(keys);
+    for (uint64_t i = 0; i < keys; i++) order[i] = i;
+    std::partial_sort(order.begin(), order.begin() + 10, order.end(),
+                      [&](uint64_t x, uint64_t y) { return exact[x] > exact[y]; });
+    size_t hits = 0;
+    double err = 0;
+    for (const auto &e : top) {
+        uint64_t id = std::stoull(e.key.substr(4));
+        for (size_t i = 0; i < 10; i++) hits += order[i] == id;
+        err += std::fabs(double(e.count) - double(exact[id])) / double(exact[id]);
+    }
+    std::cout << "  top-10 recall: " << hits << "/10, mean count error " << (top.empty() ? 0 : 100 * err / top.size())
+              << "%\n";
+
+    // Per-worker trackers: record() from several threads at once
+    for (int n : {1, threads}) {
+        HotKeys hk(HotKeys::kDefaultSampleEvery);
+        std::vector<std::thread> workers;
+        auto start = Clock::now();
+        for (int w = 0; w < n; w++) {
+            workers.emplace_back([&, w]() {
+                for (uint64_t i = w; i < ops; i += n) hk.record(names[trace[i]]);
+            });
+        }
+        for (auto &w : workers) w.join();
+        double sec = elapsed_sec(start);
+        std::cout << "  record() with " << n << " thread(s): " << (ops / sec / 1e6) << " M ops/sec\n";
+    }
+    std::cout << "  (" << bytes << " bytes read)\n";
+}
+
+// ===== replicas: hotspot GETs through the engine lock vs per-worker replicas =====
+static void run_replicas(const Args &a) {
+    const uint64_t keys = opt_int(a, "keys", 100000);
+    const uint64_t ops = opt_int(a, "ops", 2000000);
+    const int threads = static_cast<int>(opt_int(a, "threads", 4));
+    const uint64_t hot_pct = opt_int(a, "hot-pct", 90);
+
+    std::vector<std::string> names(keys);
+    for (uint64_t i = 0; i < keys; i++) names[i] = "key:" + std::to_string(i);
+    std::cout << "Keys: " << keys << ", GETs: " << ops << ", " << hot_pct << "% on key:0" << std::endl;
+
+    // Same wrapper path as cpp_execute_request_sync, with and without the replica check
+    for (bool replicated : {false, true}) {
+        for (int n : {1, threads}) {
+            KVStore kv;
+            std::mutex mu;
+            for (const auto &k : names) kv.set(k, std::string(64, 'v'));
+            kv.hotkeys(replicated ? "REPLICATE,1000" : "REPLICATE,0");
+            // Warm the tracker, then publish the hot set like the refresh timer does
+            for (int i = 0; i < 20000; i++) kv.execute_operation("get", names[0], "");
+            kv.refresh_replicas();
+
+            std::atomic<uint64_t> bytes{0};
+            std::vector<std::thread> workers;
+            auto start = Clock::now();
+            for (int w = 0; w < n; w++) {
+                workers.emplace_back([&, w]() {
+                    uint64_t state = 0x9E3779B97F4A7C15ULL * (w + 1), local_bytes = 0;
+                    std::string value;
+                    for (uint64_t i = w; i < ops; i += n) {
+                        state ^= state << 13;
+                        state ^= state >> 7;
+                        state ^= state << 17;
+                        const std::string &key = state % 100 < hot_pct ? names[0] : names[state % keys];
+                        if (replicated && kv.read_replica(key, value)) {
+                            local_bytes += value.size();
+                            continue;
+                        }
+                        std::lock_guard<std::mutex> lock(mu);
+                        KVStore::Result r = kv.execute_operation("get", key, "");
+                        if (replicated && r.success) kv.fill_replica(key, r.value);
+                        local_bytes += r.value.size();
+                    }
+                    bytes += local_bytes;
+                });
+            }
+            for (auto &w : workers) w.join();
+            double sec = elapsed_sec(start);
+            std::cout << std::fixed << std::setprecision(2) << "  " << (replicated ? "replicas   " : "engine lock")
+                      << " threads=" << n << ": " << (ops / sec / 1e6) << " M GET/s";
+            if (replicated) {
+                uint64_t hits = kv.replicas().hits(), misses = kv.replicas().misses();
+                std::cout << " (replica hit rate " << (100.0 * hits / std::max<uint64_t>(1, hits + misses))
+                          << "% of hot reads)";
+            }
+            std::cout << "  [" << bytes.load() << " bytes]\n";
+        }
+    }
+}
+
+// ===== counters: INCR of one key through the engine lock vs a sharded counter =====
+static void run_counters(const Args &a) {
+    const uint64_t ops = opt_int(a, "ops", 4000000);
+    const int threads = static_cast<int>(opt_int(a, "threads", 4));
+    std::cout << "INCRs: " << ops << " on one key" << std::endl;
+
+    // Same wrapper path as cpp_execute_request_sync, with and without the sharded check
+    for (bool sharded : {false, true}) {
+        for (int n : {1, threads}) {
+            KVStore kv;
+            std::mutex mu;
+            kv.counters(sharded ? "AUTO,64" : "AUTO,0");
+            kv.set("rate", "0");
+
+            std::vector<std::thread> workers;
+            auto start = Clock::now();
+            for (int w = 0; w < n; w++) {
+                workers.emplace_back([&, w]() {
+                    std::string total;
+                    for (uint64_t i = w; i < ops; i += n) {
+                        if (kv.sharded_counter("incr", "rate", "", total)) {
+                            continue;
+                        }
+                        std::unique_lock<std::mutex> lock(mu, std::try_to_lock);
+                        bool contended = !lock.owns_lock();
+                        if (contended) lock.lock();
+                        KVStore::Result r = kv.execute_operation("incr", "rate", "");
+                        if (contended && r.success) kv.note_incr_contention("incr", "rate");
+                    }
+                });
+            }
+            for (auto &w : workers) w.join();
+            double sec = elapsed_sec(start);
+            std::string final_value = kv.get("rate").value;
+            std::cout << std::fixed << std::setprecision(2) << "  " << (sharded ? "auto-shard " : "engine lock")
+                      << " threads=" << n << ": " << (ops / sec / 1e6) << " M INCR/s, value " << final_value
+                      << (kv.sharded_counters().contains("rate") ? " (sharded)" : "") << "\n";
+        }
+    }
+}
+
+// ===== coalesce: hotspot reads through the engine lock with and without single-flight =====
+static void run_coalesce(const Args &a) {
+    const uint64_t keys = opt_int(a, "keys", 100000);
+    const uint64_t ops = opt_int(a, "ops", 2000000);
+    const int threads = static_cast<int>(opt_int(a, "threads", 8));
+    const uint64_t hot_pct = opt_int(a, "hot-pct", 90);
+
+    std::vector<std::string> names(keys);
+    for (uint64_t i = 0; i < keys; i++) names[i] = "key:" + std::to_string(i);
+    std::cout << "Keys: " << keys << ", reads: " << ops << ", " << hot_pct << "% on key:0 (LRANGE of 100 items)"
+              << std::endl;
+
+    // Same wrapper path as cpp_execute_request_sync; replicas are off so every read reaches the engine
+    for (bool coalesce : {false, true}) {
+        for (int n : {1, threads}) {
+            KVStore kv;
+            SingleFlight flights;
+            std::mutex mu;
+            kv.hotkeys("REPLICATE,0");
+            for (const auto &k : names) kv.rpush(k, "item");
+            for (int i = 0; i < 99; i++) kv.rpush(names[0], "item" + std::to_string(i));
+            std::atomic<uint64_t> executions{0};
+
+            std::vector<std::thread> workers;
+            auto start = Clock::now();
+            for (int w = 0; w < n; w++) {
+                workers.emplace_back([&, w]() {
+                    uint64_t state = 0x9E3779B97F4A7C15ULL * (w + 1), local_exec = 0;
+                    for (uint64_t i = w; i < ops; i += n) {
+                        state ^= state << 13;
+                        state ^= state >> 7;
+                        state ^= state << 17;
+                        const std::string &key = state % 100 < hot_pct ? names[0] : names[state % keys];
+                        std::unique_lock<std::mutex> lock(mu, std::try_to_lock);
+                        if (!lock.owns_lock() && coalesce) {
+                            flights.run("lrange", key, "0,-1", kv.key_version(key), [&]() {
+                                std::lock_guard<std::mutex> engine(mu);
+                                SingleFlight::Reply r;
+                                r.version = kv.key_version(key);
+                                KVStore::Result res = kv.execute_operation("lrange", key, "0,-1");
+                                local_exec++;
+                                r.value = std::move(res.value);
+                                r.success = res.success;
+                                return r;
+                            });
+                            continue;
+                        }
+                        if (!lock.owns_lock()) lock.lock();
+                        kv.execute_operation("lrange", key, "0,-1");
+                        local_exec++;
+                    }
+                    executions += local_exec;
+                });
+            }
+            for (auto &w : workers) w.join();
+            double sec = elapsed_sec(start);
+            std::cout << std::fixed << std::setprecision(2) << "  " << (coalesce ? "single-flight" : "engine lock  ")
+                      << " threads=" << n << ": " << (ops / sec / 1e6) << " M reads/s, " << std::setprecision(3)
+                      << (static_cast<double>(executions.load()) / ops) << " engine executions per read";
+            if (coalesce) std::cout << " (" << flights.coalesced() << " coalesced)";
+            std::cout << "\n";
+        }
+    }
+}
+
+// ===== admission: open-loop overload with and without load shedding =====
+static void run_admission(const Args &a) {
+    const int threads = static_cast<int>(opt_int(a, "threads", 8));
+    const uint64_t seconds = opt_int(a, "seconds", 2);
+    const uint64_t load_pct = opt_int(a, "load", 150);
+    const uint64_t deadline_us = opt_int(a, "deadline-us", 2000);
+
+    KVStore kv;
+    std::mutex mu;
+    kv.hotkeys("REPLICATE,0");
+    for (int i = 0; i < 200; i++) kv.rpush("list", "item" + std::to_string(i));
+
+    // Capacity: closed loop from one thread
+    uint64_t n = 0;
+    auto start = Clock::now();
+    while (elapsed_sec(start) < 0.5) {
+        kv.execute_operation("lrange", "list", "0,-1");
+        n++;
+    }
+    const double capacity = n / elapsed_sec(start);
+    const double rate = capacity * load_pct / 100.0;
+    std::cout << "Capacity: " << std::fixed << std::setprecision(0) << capacity << " LRANGE/s; offering "
+              << rate << "/s open loop from " << threads << " threads for " << seconds << "s" << std::endl;
+
+    // Same wrapper path as cpp_execute_request_sync. A request arrives at its
+    // scheduled time, as if it had been waiting in its connection's buffer since.
+    for (bool shed : {false, true}) {
+        kv.admission(shed ? "DEADLINE," + std::to_string(deadline_us) : "DEADLINE,0");
+        AdmissionControl &ac = kv.admission_control();
+        std::vector<std::vector<uint64_t>> lats(threads);
+        std::atomic<uint64_t> dropped{0};
+        std::vector<std::thread> workers;
+        auto begin = Clock::now();
+        auto end = begin + std::chrono::seconds(seconds);
+        for (int w = 0; w < threads; w++) {
+            workers.emplace_back([&, w]() {
+                auto interval = std::chrono::duration_cast<Clock::duration>(
+                    std::chrono::duration<double>(threads / rate));
+                auto due = begin + interval * w / threads;
+                uint64_t local_dropped = 0;
+                for (; due < end; due += interval) {
+                    std::this_thread::sleep_until(due);
+                    if (!ac.enter()) {
+                        local_dropped++;
+                        continue;
+                    }
+                    std::unique_lock<std::mutex> lock(mu);
+                    ac.leave();
+                    if (ac.expired(due)) {
+                        local_dropped++;
+                        continue;
+                    }
+                    kv.execute_operation("lrange", "list", "0,-1");
+                    lock.unlock();
+                    lats[w].push_back(
+                        std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - due).count());
+                }
+                dropped += local_dropped;
+            });
+        }
+        for (auto &w : workers) w.join();
+        double sec = elapsed_sec(begin);
+        std::vector<uint64_t> all;
+        for (auto &l : lats) all.insert(all.end(), l.begin(), l.end());
+        std::string label = shed ? "deadline " + std::to_string(deadline_us) + "us" : "no shedding";
+        std::cout << std::fixed << std::setprecision(0) << "  " << std::left << std::setw(16) << label << std::right
+                  << ": served " << (all.size() / sec) << "/s, BUSY " << dropped.load() << ", p50/p95/p99 "
+                  << std::setprecision(1) << percentile_us(all, 0.50) << "/" << percentile_us(all, 0.95) << "/"
+                  << percentile_us(all, 0.99) << " us\n";
+    }
+}
+
+// ===== slowreads: GET/SET latency while KEYS runs, inline vs on the background pool =====
+static void run_slowreads(const Args &a) {
+    const uint64_t keys = opt_int(a, "keys", 200000);
+    const uint64_t seconds = opt_int(a, "seconds", 2);
+
+    std::vector<std::string> names(keys);
+    for (uint64_t i = 0; i < keys; i++) names[i] = "key:" + std::to_string(i);
+    std::cout << "Keys: " << keys << "; one client loops KEYS *, one GET and one SET client for " << seconds << "s"
+              << std::endl;
+
+    for (bool offload : {false, true}) {
+        KVStore kv;
+        std::mutex mu;
+        Executor pool(2);
+        kv.hotkeys("REPLICATE,0");
+        for (const auto &k : names) kv.set(k, std::string(16, 'v'));
+
+        // Same path as cpp_execute_request_sync: inline, KEYS matches and formats under
+        // the lock; offloaded, it only copies the key names and the pool does the rest
+        std::atomic<bool> stop{false};
+        std::atomic<uint64_t> scans{0};
+        std::thread slow([&]() {
+            while (!stop.load()) {
+                std::unique_lock<std::mutex> lock(mu);
+                if (offload && kv.read_cost("keys") >= KVStore::kSlowReadElements) {
+                    KVStore::ReadJob job = kv.prepare_read("keys", "*");
+                    lock.unlock();
+                    std::promise<size_t> done;
+                    pool.submit([&]() { done.set_value(job().value.size()); });
+                    done.get_future().get();
+                } else {
+                    kv.execute_operation("keys", "*", "");
+                }
+                scans++;
+            }
+        });
+        auto client = [&](const char *op, std::vector<uint64_t> &lats) {
+            uint64_t state = op[0] == 'g' ? 0x9E3779B97F4A7C15ULL : 0xD1B54A32D192ED03ULL;
+            while (!stop.load()) {
+                state ^= state << 13;
+                state ^= state >> 7;
+                state ^= state << 17;
+                const std::string &key = names[state % keys];
+                uint64_t t0 = now_ns();
+                {
+                    std::lock_guard<std::mutex> lock(mu);
+                    kv.execute_operation(op, key, "v");
+                }
+                lats.push_back(now_ns() - t0);
+            }
+        };
+        std::vector<uint64_t> get_lats, set_lats;
+        std::thread getter(client, "get", std::ref(get_lats));
+        std::thread setter(client, "set", std::ref(set_lats));
+        std::this_thread::sleep_for(std::chrono::seconds(seconds));
+        stop = true;
+        slow.join();
+        getter.join();
+        setter.join();
+
+        // Each scan stalls at most one GET and one SET, so the tail is in p99.9/max
+        auto line = [](const char *op, std::vector<uint64_t> &lats) {
+            std::cout << ", " << op << " " << lats.size() << " p99/p99.9/max " << percentile_us(lats, 0.99) << "/"
+                      << percentile_us(lats, 0.999) << "/" << percentile_us(lats, 1.0) << " us";
+        };
+        std::cout << std::fixed << std::setprecision(1) << "  " << (offload ? "offloaded" : "inline   ")
+                  << ": KEYS " << scans.load();
+        line("GET", get_lats);
+        line("SET", set_lats);
+        std::cout << "\n";
+    }
+}
+
+// ===== chunked: GET latency while SMEMBERS and DEL walk a large set, whole vs in slices =====
+static void run_chunked(const Args &a) {
+    const uint64_t members = opt_int(a, "members", 2000000);
+    const uint64_t rounds = opt_int(a, "rounds", 3);
+    const long long budget = opt_int(a, "budget-us", 100);
+
+    std::cout << "Set of " << members << " members; " << rounds
+              << " rounds of SADD (1000 per call), SMEMBERS, DEL against a GET client; slice budget " << budget
+              << "us" << std::endl;
+
+    for (bool sliced : {false, true}) {
+        KVStore kv;
+        std::mutex mu;
+        kv.hotkeys("REPLICATE,0");
+        kv.chunking("BUDGET," + std::to_string(budget));
+        for (int i = 0; i < 1000; i++) kv.set("key:" + std::to_string(i), "v");
+
+        // Same path as cpp_execute_request_sync: the lock is released between slices
+        auto run = [&](const char *op) {
+            std::unique_lock<std::mutex> lock(mu);
+            std::shared_ptr<KVStore::Cursor> cursor = sliced ? kv.begin_chunked(op, "big") : nullptr;
+            if (!cursor) {
+                return kv.execute_operation(op, "big", "");
+            }
+            while (!kv.step_chunked(*cursor)) {
+                lock.unlock();
+                std::this_thread::yield();
+                lock.lock();
+            }
+            lock.unlock();
+            return KVStore::chunked_reply(*cursor);
+        };
+
+        // GETs are timed only while SMEMBERS/DEL run; SADD's rehashes are the same either way
+        std::atomic<bool> stop{false}, timing{false};
+        double smembers_ms = 0, del_ms = 0;
+        std::thread big([&]() {
+            for (uint64_t r = 0; r < rounds; r++) {
+                for (uint64_t i = 0; i < members; i += 1000) {
+                    std::string batch;
+                    for (uint64_t j = i; j < std::min(members, i + 1000); j++) {
+                        if (j > i) batch += ',';
+                        batch += std::to_string(j);
+                    }
+                    std::lock_guard<std::mutex> lock(mu);
+                    kv.execute_operation("sadd", "big", batch);
+                }
+                timing = true;
+                uint64_t t0 = now_ns();
+                run("smembers");
+                uint64_t t1 = now_ns();
+                run("del");
+                timing = false;
+                smembers_ms += (t1 - t0) / 1e6;
+                del_ms += (now_ns() - t1) / 1e6;
+            }
+            stop = true;
+        });
+        std::vector<uint64_t> lats;
+        uint64_t state = 0x9E3779B97F4A7C15ULL;
+        while (!stop.load()) {
+            state ^= state << 13;
+            state ^= state >> 7;
+            state ^= state << 17;
+            std::string key = "key:" + std::to_string(state % 1000);
+            uint64_t t0 = now_ns();
+            {
+                std::lock_guard<std::mutex> lock(mu);
+                kv.execute_operation("get", key, "");
+            }
+            if (timing.load()) lats.push_back(now_ns() - t0);
+        }
+        big.join();
+
+        std::cout << std::fixed << std::setprecision(1) << "  " << (sliced ? "sliced" : "whole ")
+                  << ": SMEMBERS " << smembers_ms / rounds << " ms, DEL " << del_ms / rounds << " ms; GET "
+                  << lats.size() << " p99/p99.9/max " << percentile_us(lats, 0.99) << "/"
+                  << percentile_us(lats, 0.999) << "/" << percentile_us(lats, 1.0) << " us";
+        if (sliced) std::cout << "; " << kv.chunking("").value;
+        std::cout << "\n";
+    }
+}
+
+// ===== resultcache: repeated SINTER/HGETALL/LRANGE over rarely written keys, with and without the cache =====
+static void run_resultcache(const Args &a) {
+    const uint64_t keys = opt_int(a, "keys", 100);
+    const uint64_t elements = opt_int(a, "elements", 1000);
+    const uint64_t ops = opt_int(a, "ops", 200000);
+    const int threads = opt_int(a, "threads", 4);
+    const double write_pct = opt_int(a, "write-pct", 1);
+
+    std::cout << keys << " sets, hashes and lists of " << elements << " elements; " << ops << " reads from "
+              << threads << " threads, " << write_pct << "% writes" << std::endl;
+
+    for (bool cached : {false, true}) {
+        KVStore kv;
+        std::mutex mu;
+        for (uint64_t k = 0; k < keys; k++) {
+            std::string id = std::to_string(k), members, items;
+            for (uint64_t e = 0; e < elements; e++) {
+                std::string m = std::to_string((e * 7 + k) % (elements * 2));
+                members += (e ? "," : "") + m;
+                items += (e ? "," : "") + m;
+                kv.hset("hash:" + id, "f" + std::to_string(e), m);
+            }
+            kv.sadd("set:" + id, members);
+            kv.execute_operation("rpush", "list:" + id, items);
+        }
+        if (cached) kv.resultcache("ON");
+
+        // Same path as cpp_execute_request_sync: cache lookup without the lock, else
+        // stamp, execute and store under it
+        std::atomic<uint64_t> next{0};
+        auto worker = [&](int t) {
+            uint64_t state = 0x9E3779B97F4A7C15ULL * (t + 1);
+            while (next.fetch_add(1) < ops) {
+                state ^= state << 13;
+                state ^= state >> 7;
+                state ^= state << 17;
+                std::string id = std::to_string(state % keys);
+                std::string other = std::to_string((state >> 20) % keys);
+                if ((state >> 40) % 10000 < write_pct * 100) {
+                    std::lock_guard<std::mutex> lock(mu);
+                    kv.execute_operation("sadd", "set:" + id, std::to_string(state % 100000));
+                    continue;
+                }
+                std::string op, key, value;
+                switch ((state >> 32) % 3) {
+                case 0: op = "sinter"; key = "set:" + id; value = "set:" + other; break;
+                case 1: op = "hgetall"; key = "hash:" + id; break;
+                default: op = "lrange"; key = "list:" + id; value = "0,-1"; break;
+                }
+                std::string reply;
+                if (kv.cached_read(op, key, value, reply)) continue;
+                std::lock_guard<std::mutex> lock(mu);
+                ResultCache::Stamp stamp = kv.read_stamp(op, key, value);
+                kv.cache_read(op, key, value, stamp, kv.execute_operation(op, key, value));
+            }
+        };
+        uint64_t t0 = now_ns();
+        std::vector<std::thread> pool;
+        for (int t = 0; t < threads; t++) pool.emplace_back(worker, t);
+        for (auto &th : pool) th.join();
+        double secs = (now_ns() - t0) / 1e9;
+
+        std::cout << std::fixed << std::setprecision(0) << "  " << (cached ? "cache on " : "cache off") << ": "
+                  << ops / secs << " ops/sec";
+        if (cached) std::cout << "; " << kv.resultcache("").value;
+        std::cout << "\n";
+    }
+}
+
+// ===== script: rate limiter as GET + WATCH/MULTI round trips vs one EVALSHA =====
+static void run_script(const Args &a) {
+    const uint64_t keys = opt_int(a, "keys", 10);
+    const uint64_t decisions = opt_int(a, "decisions", 20000);
+    const int threads = opt_int(a, "threads", 8);
+    const int64_t limit = opt_int(a, "limit", 1500);
+    const uint64_t rtt_us = opt_int(a, "rtt-us", 50);
+
+    static const char kLimiter[] = "k1 'incr' call1\n"
+                                   "dup 1 = if k1 a2 'expire' call2 drop then\n"
+                                   "a1 > if 0 else 1 then";
+    std::cout << decisions << " rate limit decisions (limit " << limit << " per key, " << keys << " keys) from "
+              << threads << " threads; each round trip costs " << rtt_us << "us" << std::endl;
+
+    for (bool scripted : {false, true}) {
+        KVStore kv;
+        std::mutex mu;
+        std::string sha = kv.script_load(kLimiter).value;
+        const std::string args = "," + std::to_string(limit) + ",60";
+
+        // A client round trip: sleep for the network, then run under the engine lock
+        std::atomic<uint64_t> next{0}, trips{0}, retries{0}, allowed{0};
+        auto trip = [&](const std::function<void()> &body) {
+            std::this_thread::sleep_for(std::chrono::microseconds(rtt_us));
+            trips++;
+            std::lock_guard<std::mutex> lock(mu);
+            body();
+        };
+        auto worker = [&](int t) {
+            uint64_t state = 0x9E3779B97F4A7C15ULL * (t + 1);
+            while (next.fetch_add(1) < decisions) {
+                state ^= state << 13;
+                state ^= state >> 7;
+                state ^= state << 17;
+                std::string key = "rl:" + std::to_string(state % keys);
+                if (scripted) {
+                    trip([&]() { allowed += kv.evalsha(sha, "1," + key + args).value == "1"; });
+                    continue;
+                }
+                // WATCH key + GET, then MULTI/SET/EXPIRE/EXEC that aborts if the key changed
+                for (;;) {
+                    uint64_t version = 0;
+                    int64_t count = 0;
+                    trip([&]() {
+                        version = kv.key_version(key);
+                        KVStore::Result r = kv.execute_operation("get", key, "");
+                        count = r.success ? std::stoll(r.value) : 0;
+                    });
+                    if (count >= limit) break;
+                    bool committed = false;
+                    trip([&]() {
+                        if (kv.key_version(key) != version) return;
+                        kv.execute_operation("set", key, std::to_string(count + 1));
+                        if (count == 0) kv.execute_operation("expire", key, "60");
+                        committed = true;
+                    });
+                    if (committed) {
+                        allowed++;
+                        break;
+                    }
+                    retries++;
+                }
+            }
+        };
+        uint64_t t0 = now_ns();
+        std::vector<std::thread> pool;
+        for (int t = 0; t < threads; t++) pool.emplace_back(worker, t);
+        for (auto &th : pool) th.join();
+        double secs = (now_ns() - t0) / 1e9;
+
+        std::cout << std::fixed << std::setprecision(2) << "  " << (scripted ? "evalsha    " : "round trips")
+                  << ": " << std::setprecision(0) << decisions / secs << " decisions/sec, " << std::setprecision(2)
+                  << double(trips.load()) / decisions << " round trips and " << double(retries.load()) / decisions
+                  << " WATCH retries per decision, " << allowed.load() << " allowed (max " << limit * keys << ")\n";
+    }
+}
+
+// ===== throttle: GCRA THROTTLE vs the INCR + EXPIRE fixed window =====
+static void run_throttle(const Args &a) {
+    const uint64_t keys = opt_int(a, "keys", 100000);
+    const uint64_t decisions = opt_int(a, "decisions", 2000000);
+
+    std::vector<std::string> names(keys);
+    for (uint64_t i = 0; i < keys; i++) names[i] = "rl:" + std::to_string(i);
+    std::cout << decisions << " rate limit decisions over " << keys << " keys (100 per 60s each)" << std::endl;
+
+    for (bool gcra : {false, true}) {
+        KVStore kv;
+        uint64_t state = 0x9E3779B97F4A7C15ULL, limited = 0;
+        uint64_t t0 = now_ns();
+        for (uint64_t i = 0; i < decisions; i++) {
+            state ^= state << 13;
+            state ^= state >> 7;
+            state ^= state << 17;
+            const std::string &key = names[state % keys];
+            if (gcra) {
+                limited += kv.execute_operation("throttle", key, "99,100,60").value[0] == '1';
+            } else {
+                // What clients send today: INCR, and EXPIRE to start the window
+                KVStore::Result r = kv.execute_operation("incr", key, "");
+                kv.execute_operation("expire", key, "60");
+                limited += std::stoll(r.value) > 100;
+            }
+        }
+        double secs = (now_ns() - t0) / 1e9;
+        std::cout << std::fixed << std::setprecision(0) << "  " << (gcra ? "THROTTLE    " : "INCR+EXPIRE ") << ": "
+                  << decisions / secs << " decisions/sec, " << std::setprecision(1) << secs * 1e9 / decisions
+                  << " ns each, " << limited << " limited\n";
+    }
+}
+
+// ===== bulkload: BULKLOAD of a local file vs one SET per row =====
+static void run_bulkload(const Args &a) {
+    const uint64_t keys = opt_int(a, "keys", 2000000);
+    const size_t threads = opt_int(a, "threads", 4);
+    const std::string dir = a.opts.count("dir") ? a.opts.at("dir") : "/tmp";
+
+    // Keys in random order, as a dump of a hash-ordered store would be
+    std::vector<uint64_t> order(keys);
+    for (uint64_t i = 0; i < keys; i++) order[i] = i;
+    std::shuffle(order.begin(), order.end(), std::mt19937_64(42));
+    std::vector<std::pair<std::string, std::string>> rows(keys);
+    for (uint64_t i = 0; i < keys; i++) {
+        char key[32];
+        std::snprintf(key, sizeof(key), "key:%012llu", static_cast<unsigned long long>(order[i]));
+        rows[i] = {key, "value:" + std::to_string(order[i] * 2654435761ULL)};
+    }
+    std::cout << keys << " keys, " << threads << " loader threads" << std::endl;
+
+    {
+        KVStore kv;
+        Clock::time_point start = Clock::now();
+        for (const auto &row : rows) kv.execute_operation("set", row.first, row.second);
+        double secs = elapsed_sec(start);
+        std::cout << std::fixed << std::setprecision(0) << "  SET per row          : " << keys / secs
+                  << " rows/sec (in process, no parsing or round trips)\n";
+    }
+
+    const struct {
+        BulkLoader::Format format;
+        const char *name;
+        const char *ext;
+    } kFormats[] = {{BulkLoader::kResp, "RESP", "resp"}, {BulkLoader::kCsv, "CSV", "csv"},
+                    {BulkLoader::kBinary, "BINARY", "bin"}};
+    for (const auto &f : kFormats) {
+        std::string path = dir + "/engine_bench_bulkload." + f.ext;
+        {
+            std::string data = BulkLoader::header(f.format);
+            for (const auto &row : rows) BulkLoader::encode(f.format, row.first, row.second, data);
+            FILE *out = std::fopen(path.c_str(), "wb");
+            if (out == nullptr || std::fwrite(data.data(), 1, data.size(), out) != data.size()) {
+                throw std::runtime_error("cannot write " + path);
+            }
+            std::fclose(out);
+        }
+        for (size_t n : {size_t(1), threads}) {
+            KVStore kv;
+            Clock::time_point start = Clock::now();
+            KVStore::Result r = kv.bulkload(path, std::string(f.name) + ",THREADS," + std::to_string(n));
+            double secs = elapsed_sec(start);
+            if (!r.success || kv.size() != keys) throw std::runtime_error(r.value);
+            std::cout << "  BULKLOAD " << std::left << std::setw(6) << f.name << " x" << std::setw(3) << n
+                      << std::right << ": " << keys / secs << " rows/sec (" << r.value << ")\n";
+        }
+        std::remove(path.c_str());
+    }
+}
+
+// ===== populate: DEBUG POPULATE vs one SET per key =====
+static void run_populate(const Args &a) {
+    const uint64_t keys = opt_int(a, "keys", 2000000);
+    const uint64_t size = opt_int(a, "size", 8);
+    const uint64_t threads = opt_int(a, "threads", 4);
+    std::cout << keys << " keys with " << size << "-byte values" << std::endl;
+
+    {
+        // What bench.cpp's preload() asks of the engine, minus the round trips
+        KVStore kv;
+        std::string value(size, 'X');
+        Clock::time_point start = Clock::now();
+        for (uint64_t i = 0; i < keys; i++) kv.execute_operation("set", "key:" + std::to_string(i), value);
+        double secs = elapsed_sec(start);
+        std::cout << std::fixed << std::setprecision(0) << "  SET per key             : " << keys / secs
+                  << " keys/sec (in process, no round trips)\n";
+    }
+    const std::string n = std::to_string(threads), value = "key," + std::to_string(size);
+    const std::pair<std::string, std::string> kRuns[] = {
+        {"POPULATE x1", value + ",THREADS,1"},
+        {"POPULATE x" + n, value + ",THREADS," + n},
+        {"POPULATE x" + n + " mixed", value + ",STRING,70,HASH,10,LIST,10,SET,10,TTL,3600,20,THREADS," + n},
+    };
+    for (const auto &run : kRuns) {
+        KVStore kv;
+        Clock::time_point start = Clock::now();
+        KVStore::Result r = kv.debug_populate(std::to_string(keys), run.second);
+        double secs = elapsed_sec(start);
+        if (!r.success) throw std::runtime_error(r.value);
+        std::cout << "  " << std::left << std::setw(24) << run.first << std::right << ": " << keys / secs
+                  << " keys/sec (" << r.value << ")\n";
+    }
+}
+
+// ===== dump: EXPORT/IMPORT of the keyspace vs reading every key out =====
+static void run_dump(const Args &a) {
+    const uint64_t keys = opt_int(a, "keys", 2000000);
+    const uint64_t size = opt_int(a, "size", 64);
+    const uint64_t threads = opt_int(a, "threads", 4);
+    const std::string dir = (a.opts.count("dir") ? a.opts.at("dir") : "/tmp") + "/engine_bench_dump";
+    const std::string spec = "key," + std::to_string(size) + ",STRING,70,HASH,10,LIST,10,SET,10,TTL,3600,20";
+    std::cout << keys << " keys with " << size << "-byte values (70% strings, 10% each hashes, lists, sets; "
+              << "20% with a TTL)" << std::endl;
+
+    KVStore kv;
+    KVStore::Result populated = kv.debug_populate(std::to_string(keys), spec);
+    if (!populated.success) throw std::runtime_error(populated.value);
+
+    {
+        // What a client walking the keyspace asks of the engine, minus the
+        // round trips: the key names, then each value and its TTL
+        std::string path = dir + ".txt";
+        FILE *out = std::fopen(path.c_str(), "wb");
+        if (out == nullptr) throw std::runtime_error("cannot write " + path);
+        Clock::time_point start = Clock::now();
+        std::string names = kv.execute_operation("keys", "*", "").value;
+        uint64_t bytes = 0;
+        for (size_t pos = 0; pos < names.size();) {
+            size_t comma = std::min(names.find(',', pos), names.size());
+            std::string key = names.substr(pos, comma - pos);
+            pos = comma + 1;
+            KVStore::Result value = kv.execute_operation("get", key, "");
+            if (!value.success) value = kv.execute_operation("hgetall", key, "");
+            if (value.value.empty()) value = kv.execute_operation("lrange", key, "0,-1");
+            if (!value.success || value.value.empty()) value = kv.execute_operation("smembers", key, "");
+            std::string line = key + " " + kv.execute_operation("ttl", key, "").value + " " + value.value + "\n";
+            bytes += std::fwrite(line.data(), 1, line.size(), out);
+        }
+        std::fclose(out);
+        double secs = elapsed_sec(start);
+        std::remove(path.c_str());
+        std::cout << std::fixed << std::setprecision(1) << "  KEYS + reads        : " << bytes / secs / 1e6
+                  << " MB/s (" << bytes << " bytes in " << secs * 1000 << " ms, engine held throughout)\n";
+    }
+
+    for (uint64_t n : {uint64_t(1), threads}) {
+        const std::string args = "THREADS," + std::to_string(n);
+        Clock::time_point start = Clock::now();
+        KVStore::Result exported = kv.keyspace_export(dir, args);
+        double secs = elapsed_sec(start);
+        if (!exported.success) throw std::runtime_error(exported.value);
+        std::cout << "  EXPORT x" << std::left << std::setw(12) << n << std::right << ": " << secs * 1000
+                  << " ms (" << exported.value << ")\n";
+
+        KVStore copy;
+        start = Clock::now();
+        KVStore::Result imported = copy.keyspace_import(dir, args);
+        secs = elapsed_sec(start);
+        if (!imported.success || copy.read_cost("keys") != kv.read_cost("keys")) {
+            throw std::runtime_error(imported.value);
+        }
+        std::cout << "  IMPORT x" << std::left << std::setw(12) << n << std::right << ": " << secs * 1000
+                  << " ms (" << imported.value << ")\n";
+    }
+    KeyspaceDump::remove_parts(dir, 0);
+    rmdir(dir.c_str());
+}
+
+// ===== CLI =====
+struct Suite {
+    const char *name;
+    void (*run)(const Args &);
+    const char *help;
+};
+
+static const Suite kSuites[] = {
+    {"pubsub", run_pubsub, "--subscribers N (10000) --messages N (1000) --payload BYTES (64)"},
+    {"bitop", run_bitop, "--bitmaps N (10) --mb SIZE_PER_BITMAP (128)"},
+    {"bloom", run_bloom, "--items N (1000000) --error RATE (0.01)"},
+    {"stream", run_stream, "--entries N (1000000) --reads N (1000) --window N (100)"},
+    {"timeseries", run_timeseries, "--samples N (1000000) --bucket MS (60000)"},
+    {"vector", run_vector, "--vectors N (100000) --dim D (128) --queries N (200) --nlist N (256) --k N (10)"},
+    {"index", run_index, "--hashes N (100000) --queries N (100)"},
+    {"json", run_json, "--fields N (1000) --ops N (100000)"},
+    {"geo", run_geo, "--points N (1000000) --queries N (1000) --radius METERS (2000)"},
+    {"hotkeys", run_hotkeys, "--keys N (100000) --ops N (5000000) --threads N (4)"},
+    {"replicas", run_replicas, "--keys N (100000) --ops N (2000000) --threads N (4) --hot-pct P (90)"},
+    {"counters", run_counters, "--ops N (4000000) --threads N (4)"},
+    {"coalesce", run_coalesce, "--keys N (100000) --ops N (2000000) --threads N (8) --hot-pct P (90)"},
+    {"admission", run_admission, "--threads N (8) --seconds N (2) --load PCT_OF_CAPACITY (150) --deadline-us N (2000)"},
+    {"slowreads", run_slowreads, "--keys N (200000) --seconds N (2)"},
+    {"chunked", run_chunked, "--members N (2000000) --rounds N (3) --budget-us N (100)"},
+    {"resultcache", run_resultcache,
+     "--keys N (100) --elements N (1000) --ops N (200000) --threads N (4) --write-pct P (1)"},
+    {"script", run_script,
+     "--keys N (10) --decisions N (20000) --threads N (8) --limit N (1500) --rtt-us N (50)"},
+    {"throttle", run_throttle, "--keys N (100000) --decisions N (2000000)"},
+    {"bulkload", run_bulkload, "--keys N (2000000) --threads N (4) --dir PATH (/tmp)"},
+    {"populate", run_populate, "--keys N (2000000) --size BYTES (8) --threads N (4)"},
+    {"dump", run_dump, "--keys N (2000000) --size BYTES (64) --threads N (4) --dir PATH (/tmp)"},
+};
+
+static void usage(const char *prog) {
+    std::cerr << "Usage: " << prog << " --suite NAME [suite options]\n"
+              << "Suites:\n";
+    for (const auto &s : kSuites) {
+        std::cerr << "  " << std::left << std::setw(10) << s.name << s.help << "\n";
+    }
+}
+
+int main(int argc, char **argv) {
+    Args a;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg.rfind("--", 0) != 0 || i + 1 >= argc) {
+            usage(argv[0]);
+            return 1;
+        }
+        if (arg == "--suite") {
+            a.suite = argv[++i];
+        } else {
+            a.opts[arg.substr(2)] = argv[++i];
+        }
+    }
+
+    for (const auto &s : kSuites) {
+        if (a.suite == s.name) {
+            try {
+                std::cout << "=== engine_bench: " << s.name << " ===" << std::endl;
+                s.run(a);
+            } catch (const std::exception &e) {
+                std::cerr << "ERROR: " << e.what() << std::endl;
+                return 1;
+            }
+            return 0;
+        }
+    }
+    usage(argv[0]);
+    return 1;
+}
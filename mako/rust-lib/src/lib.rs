@@ -1,15 +1,37 @@
 use std::net::{TcpListener, TcpStream, SocketAddr};
-use std::io::{Read, Write, BufWriter};
+use std::io::{Read, Write, BufWriter, ErrorKind};
+use std::collections::{HashMap, HashSet};
+use std::ffi::{c_char, c_int, c_short, c_ulong, c_void, CStr, CString};
+use std::os::unix::io::AsRawFd;
+use std::os::unix::net::UnixStream;
+use std::time::{Duration, Instant};
 use bytes::Bytes;
 use redis_protocol::resp3::{types::BytesFrame, types::DecodedFrame};
 use socket2::{Socket, Domain, Type, Protocol};
-use std::sync::Arc;
-use std::sync::atomic::{AtomicUsize, Ordering};
+use std::sync::{Arc, Condvar, Mutex, OnceLock};
+use std::sync::atomic::{AtomicU64, AtomicUsize, Ordering};
 use std::sync::Barrier;
 
 mod resp3_handler;
 use resp3_handler::Resp3Handler;
 
+// ===== Connection limits =====
+
+/// Initial query buffer per connection; it grows on demand
+const QUERY_BUFFER_INITIAL: usize = 16 * 1024;
+/// Unparsed input a connection may buffer before it is closed
+const QUERY_BUFFER_LIMIT: usize = 16 * 1024 * 1024;
+/// Pending replies per connection before they are flushed to the socket
+const OUTPUT_BUFFER_LIMIT: usize = 64 * 1024;
+/// How often a blocked connection checks whether its client went away
+const BLOCKED_POLL_INTERVAL: Duration = Duration::from_millis(100);
+
+/// Connections waiting in BLPOP/BRPOP/BLMOVE, and how many may wait. Each
+/// holds its worker, so one worker is always left to run the push that would
+/// wake them (rust_init sets the cap to the worker count less one).
+static BLOCKED_CLIENTS: AtomicUsize = AtomicUsize::new(0);
+static MAX_BLOCKED_CLIENTS: AtomicUsize = AtomicUsize::new(0);
+
 // ===== FFI Types (must match transaction_ffi.h) =====
 
 const TXN_OP_GET: u32 = 1;
@@ -44,12 +66,46 @@ struct TxnResponse {
     results: *mut TxnOpResult,
 }
 
+// Reply types of cpp_execute_request_sync (EngineReplyType in rust_wrapper.h)
+const ENGINE_REPLY_NIL: u32 = 0;
+const ENGINE_REPLY_STATUS: u32 = 1;
+const ENGINE_REPLY_INTEGER: u32 = 2;
+const ENGINE_REPLY_BULK: u32 = 3;
+
+#[repr(C)]
+struct EngineReply {
+    reply_type: u32,
+    data: *mut u8,
+    len: usize,
+}
+
 extern "C" {
     fn cpp_worker_thread_init(thread_id: usize);
 
     // All operations (single or batched) go through the transaction interface
     fn cpp_execute_transaction(request: *const TxnRequest, response: *mut TxnResponse) -> bool;
     fn cpp_free_transaction_response(response: *mut TxnResponse);
+
+    // Every other command goes through the engine's request path (rust_wrapper.h)
+    fn cpp_execute_request_sync(operation: *const c_char, key: *const u8, key_len: usize, value: *const u8,
+                                value_len: usize, waited_us: i64, reply: *mut EngineReply) -> bool;
+    fn cpp_free_reply(reply: *mut EngineReply);
+
+    // Pub/Sub: subscriptions and per-client message queues live in the engine
+    fn cpp_pubsub_command(client_id: u64, operation: *const c_char, channels: *const c_char,
+                          count: *mut u64) -> bool;
+    fn cpp_pubsub_next_message(client_id: u64, data: *mut *const u8, len: *mut usize,
+                               handle: *mut *mut c_void) -> bool;
+    fn cpp_pubsub_release_message(handle: *mut c_void);
+    fn cpp_pubsub_overflowed(client_id: u64) -> bool;
+    fn cpp_pubsub_client_closed(client_id: u64);
+    fn cpp_pubsub_set_ready_callback(cb: extern "C" fn(u64));
+
+    // Blocking list commands; cb fires exactly once, maybe later on another thread
+    fn cpp_execute_blocking(operation: *const c_char, keys: *const c_char, args: *const c_char, timeout_ms: i64,
+                            cb: extern "C" fn(*mut c_void, bool, *const c_char, *const c_char, usize),
+                            ctx: *mut c_void, block_id: *mut u64) -> bool;
+    fn cpp_cancel_blocking(block_id: u64);
 }
 
 // ===== OpCode and Command =====
@@ -57,13 +113,20 @@ extern "C" {
 #[derive(Copy, Clone, PartialEq)]
 #[repr(u32)]
 enum OpCode {
-    Invalid = 0,
     Get     = 1,
     Set     = 2,
     Ping    = 3,
     Multi   = 4,
     Exec    = 5,
     Discard = 6,
+    Subscribe    = 7,
+    Unsubscribe  = 8,
+    PSubscribe   = 9,
+    PUnsubscribe = 10,
+    /// Any other command, passed to the engine as it is
+    Forward = 11,
+    /// BLPOP / BRPOP / BLMOVE
+    Blocking = 12,
 }
 
 #[derive(Clone)]
@@ -71,6 +134,8 @@ struct Command {
     op: OpCode,
     key: Bytes,
     val: Option<Bytes>,
+    /// Pub/Sub and forwarded commands: the command name and every argument
+    args: Vec<Bytes>,
 }
 
 // ===== Transaction State =====
@@ -109,6 +174,85 @@ impl TransactionState {
     }
 }
 
+// ===== Pub/Sub State =====
+
+static NEXT_CLIENT_ID: AtomicU64 = AtomicU64::new(1);
+
+/// Per-connection Pub/Sub state. The engine keeps the subscriptions; the
+/// names are kept here too for the replies to an UNSUBSCRIBE without channels.
+struct PubSubState {
+    client_id: u64,
+    channels: HashSet<Bytes>,
+    patterns: HashSet<Bytes>,
+    /// Subscribed at some point, so messages may be waiting in the engine
+    joined: bool,
+}
+
+impl PubSubState {
+    fn new() -> Self {
+        PubSubState {
+            client_id: NEXT_CLIENT_ID.fetch_add(1, Ordering::Relaxed),
+            channels: HashSet::new(),
+            patterns: HashSet::new(),
+            joined: false,
+        }
+    }
+
+    fn subscribed(&self) -> bool {
+        !self.channels.is_empty() || !self.patterns.is_empty()
+    }
+}
+
+impl Drop for PubSubState {
+    fn drop(&mut self) {
+        if self.joined {
+            unsafe { cpp_pubsub_client_closed(self.client_id) };
+        }
+    }
+}
+
+/// A client connection and the state its commands carry, which moves with it
+/// from a worker to the subscriber thread and back to a thread of its own
+struct Connection {
+    stream: TcpStream,
+    resp3: Resp3Handler,
+    txn_state: TransactionState,
+    pubsub: PubSubState,
+    /// When the buffered commands were read, for the engine's admission deadline
+    read_at: Instant,
+}
+
+impl Connection {
+    fn new(stream: TcpStream) -> Self {
+        Connection {
+            stream,
+            resp3: Resp3Handler::new(QUERY_BUFFER_INITIAL, QUERY_BUFFER_LIMIT),
+            txn_state: TransactionState::new(),
+            pubsub: PubSubState::new(),
+            read_at: Instant::now(),
+        }
+    }
+
+    /// Runs the next buffered command; false once none is complete
+    fn run_command<W: Write>(&mut self, writer: &mut W) -> std::io::Result<bool> {
+        match self.resp3.next_frame() {
+            Ok(Some(frame)) => {
+                match parse_resp3(frame) {
+                    Some(cmd) => handle_command(&cmd, &mut self.txn_state, &mut self.pubsub, &self.stream,
+                                                self.read_at, writer)?,
+                    None => write_err(writer, "unsupported command")?,
+                }
+                Ok(true)
+            }
+            Ok(None) => Ok(false),
+            Err(_) => {
+                write_err(writer, "protocol error")?;
+                Ok(false)
+            }
+        }
+    }
+}
+
 // ===== Helpers =====
 
 #[inline]
@@ -128,7 +272,26 @@ fn parse_opcode(name: &[u8]) -> OpCode {
     else if ascii_eq_ci(name, b"MULTI") { OpCode::Multi }
     else if ascii_eq_ci(name, b"EXEC") { OpCode::Exec }
     else if ascii_eq_ci(name, b"DISCARD") { OpCode::Discard }
-    else { OpCode::Invalid }
+    else if ascii_eq_ci(name, b"SUBSCRIBE") { OpCode::Subscribe }
+    else if ascii_eq_ci(name, b"UNSUBSCRIBE") { OpCode::Unsubscribe }
+    else if ascii_eq_ci(name, b"PSUBSCRIBE") { OpCode::PSubscribe }
+    else if ascii_eq_ci(name, b"PUNSUBSCRIBE") { OpCode::PUnsubscribe }
+    else if ascii_eq_ci(name, b"BLPOP") || ascii_eq_ci(name, b"BRPOP") || ascii_eq_ci(name, b"BLMOVE") { OpCode::Blocking }
+    else { OpCode::Forward }
+}
+
+#[inline]
+fn frame_bytes(frame: &BytesFrame) -> Option<Bytes> {
+    match frame {
+        BytesFrame::BlobString { data, .. } | BytesFrame::SimpleString { data, .. } => Some(data.clone()),
+        _ => None,
+    }
+}
+
+/// A C string for the engine; None if the bytes hold a NUL
+#[inline]
+fn c_arg(data: &[u8]) -> Option<CString> {
+    CString::new(data).ok()
 }
 
 /// Parse RESP3 frame into Command
@@ -153,7 +316,7 @@ fn parse_resp3(frame: DecodedFrame<BytesFrame>) -> Option<Command> {
                 BlobString { data, .. } | SimpleString { data, .. } => Bytes::copy_from_slice(data),
                 _ => return None,
             };
-            Some(Command { op, key, val: None })
+            Some(Command { op, key, val: None, args: Vec::new() })
         }
         OpCode::Set => {
             if parts.len() < 3 { return None; }
@@ -165,12 +328,16 @@ fn parse_resp3(frame: DecodedFrame<BytesFrame>) -> Option<Command> {
                 BlobString { data, .. } | SimpleString { data, .. } => Bytes::copy_from_slice(data),
                 _ => return None,
             };
-            Some(Command { op, key, val: Some(val) })
+            Some(Command { op, key, val: Some(val), args: Vec::new() })
         }
         OpCode::Ping | OpCode::Multi | OpCode::Exec | OpCode::Discard => {
-            Some(Command { op, key: Bytes::new(), val: None })
+            Some(Command { op, key: Bytes::new(), val: None, args: Vec::new() })
+        }
+        OpCode::Subscribe | OpCode::Unsubscribe | OpCode::PSubscribe | OpCode::PUnsubscribe | OpCode::Forward |
+        OpCode::Blocking => {
+            let args = parts.iter().map(frame_bytes).collect::<Option<Vec<Bytes>>>()?;
+            Some(Command { op, key: Bytes::new(), val: None, args })
         }
-        OpCode::Invalid => None,
     }
 }
 
@@ -191,6 +358,14 @@ fn write_queued<W: Write>(w: &mut W) -> std::io::Result<()> {
     w.write_all(b"+QUEUED\r\n")
 }
 
+/// A status or integer reply the engine formatted: prefix, text, CRLF
+#[inline]
+fn write_line<W: Write>(w: &mut W, prefix: &[u8], data: &[u8]) -> std::io::Result<()> {
+    w.write_all(prefix)?;
+    w.write_all(data)?;
+    w.write_all(b"\r\n")
+}
+
 #[inline]
 fn write_nil_bulk<W: Write>(w: &mut W) -> std::io::Result<()> {
     w.write_all(b"$-1\r\n")
@@ -221,6 +396,39 @@ fn write_array_header<W: Write>(w: &mut W, len: usize) -> std::io::Result<()> {
     w.write_all(b"\r\n")
 }
 
+#[inline]
+fn write_integer<W: Write>(w: &mut W, n: u64) -> std::io::Result<()> {
+    let mut buf = itoa::Buffer::new();
+    w.write_all(b":")?;
+    w.write_all(buf.format(n).as_bytes())?;
+    w.write_all(b"\r\n")
+}
+
+/// An engine error: "ERROR: msg" goes out as -ERR msg, a shed request's
+/// "BUSY ..." as -BUSY ...
+fn write_engine_err<W: Write>(w: &mut W, msg: &[u8]) -> std::io::Result<()> {
+    if msg.starts_with(b"BUSY") {
+        w.write_all(b"-")?;
+        w.write_all(msg)?;
+        return w.write_all(b"\r\n");
+    }
+    let msg = msg.strip_prefix(b"ERROR: ").unwrap_or(msg);
+    w.write_all(b"-ERR ")?;
+    w.write_all(msg)?;
+    w.write_all(b"\r\n")
+}
+
+/// One reply of a (P)SUBSCRIBE / (P)UNSUBSCRIBE: kind, channel (nil if none), count
+fn write_subscription<W: Write>(w: &mut W, kind: &[u8], channel: Option<&[u8]>, count: u64) -> std::io::Result<()> {
+    write_array_header(w, 3)?;
+    write_bulk(w, kind)?;
+    match channel {
+        Some(name) => write_bulk(w, name)?,
+        None => write_nil_bulk(w)?,
+    }
+    write_integer(w, count)
+}
+
 // ===== Transaction FFI =====
 
 /// Helper to build TxnOperation array from commands
@@ -245,50 +453,567 @@ fn build_txn_ops(commands: &[Command]) -> Vec<TxnOperation> {
     }).collect()
 }
 
-/// Execute a single command as a transaction (for non-MULTI operations)
-/// Returns the result directly without array wrapper
-fn ffi_execute_single<W: Write>(cmd: &Command, writer: &mut W) -> std::io::Result<()> {
-    let ops = build_txn_ops(&[cmd.clone()]);
+// ===== Request Path FFI =====
+
+/// Runs one operation through cpp_execute_request_sync, where the engine's
+/// read replicas, sharded counters, read coalescing, admission control, slow
+/// read pool, chunked execution and result cache apply. Key and value go
+/// over as (ptr, len), and the engine types its reply: a status, an integer,
+/// a bulk string, a nil (a GET of a missing key) or an error. The admission
+/// deadline counts from read_at, when the request came off the socket.
+fn ffi_request<W: Write>(op: &[u8], key: &[u8], value: &[u8], read_at: Instant, writer: &mut W)
+                         -> std::io::Result<()> {
+    let op = match c_arg(op) {
+        Some(op) => op,
+        None => return write_err(writer, "unknown command"),
+    };
+    let mut reply = EngineReply { reply_type: ENGINE_REPLY_NIL, data: std::ptr::null_mut(), len: 0 };
+    unsafe {
+        let waited_us = read_at.elapsed().as_micros() as i64;
+        cpp_execute_request_sync(op.as_ptr(), key.as_ptr(), key.len(), value.as_ptr(), value.len(), waited_us,
+                                 &mut reply);
+    }
+    let data: &[u8] = if reply.data.is_null() {
+        b""
+    } else {
+        unsafe { std::slice::from_raw_parts(reply.data, reply.len) }
+    };
+    let written = match reply.reply_type {
+        ENGINE_REPLY_NIL => write_nil_bulk(writer),
+        ENGINE_REPLY_STATUS => write_line(writer, b"+", data),
+        ENGINE_REPLY_INTEGER => write_line(writer, b":", data),
+        ENGINE_REPLY_BULK => write_bulk(writer, data),
+        _ => write_engine_err(writer, data),
+    };
+    unsafe { cpp_free_reply(&mut reply) };
+    written
+}
 
-    let request = TxnRequest {
-        num_ops: ops.len(),
-        ops: ops.as_ptr(),
+/// Commands whose first argument names the operation: DEBUG POPULATE is the
+/// engine's debug.populate
+const CONTAINER_COMMANDS: &[&[u8]] = &[b"debug", b"script"];
+
+/// Operations that take no key, only a value
+const KEYLESS_COMMANDS: &[&[u8]] = &[
+    b"script.load", b"script.exists", b"script.flush", b"admission", b"hotkeys", b"counters",
+    b"chunking", b"resultcache",
+];
+
+/// Operations that split off this many leading arguments and take the rest
+/// of the value whole, so their last argument may hold the separator. They
+/// take exactly one more argument than that; HSET splits at ':'.
+const WHOLE_LAST_ARG: &[(&[u8], usize)] = &[
+    (b"append", 0), (b"publish", 0), (b"hget", 0), (b"hexists", 0), (b"hdel", 0), (b"sismember", 0),
+    (b"bf.add", 0), (b"bf.exists", 0), (b"json.get", 0), (b"json.type", 0), (b"script.load", 0),
+    (b"setrange", 1), (b"json.set", 1), (b"json.numincrby", 1), (b"hset", 1),
+];
+
+/// Passes a command the front end has no handling of to the engine the way
+/// its operations take them: the lowercased name, the first argument as the
+/// key and the rest joined with ',' (HSET's field and value with ':', XADD's
+/// fields and values as field:value). The engine splits the value again, so
+/// an argument holding its separator is refused instead of being misparsed.
+fn ffi_forward<W: Write>(args: &[Bytes], read_at: Instant, writer: &mut W) -> std::io::Result<()> {
+    let mut op = args[0].to_ascii_lowercase();
+    let mut args = args;
+    if args.len() > 1 && CONTAINER_COMMANDS.contains(&op.as_slice()) {
+        op.push(b'.');
+        op.extend_from_slice(&args[1].to_ascii_lowercase());
+        args = &args[1..];
+    }
+    let (key, rest): (&[u8], &[Bytes]) = if KEYLESS_COMMANDS.contains(&op.as_slice()) {
+        (b"", &args[1..])
+    } else if args.len() > 1 {
+        (&args[1], &args[2..])
+    } else {
+        (b"", &[])
     };
+    let sep = if op == b"hset" { b':' } else { b',' };
+    let whole = WHOLE_LAST_ARG.iter().find(|(name, _)| *name == op.as_slice()).map(|&(_, leading)| leading);
+    let xadd = op == b"xadd";
+    if whole.map_or(false, |leading| rest.len() != leading + 1) || (xadd && rest.len() % 2 == 0) {
+        return write_err(writer, "wrong number of arguments");
+    }
+    let mut value = Vec::new();
+    for (i, arg) in rest.iter().enumerate() {
+        // XADD's id, then each field after ',' and its value after ':'
+        let sep = if xadd && i > 0 && i % 2 == 0 { b':' } else { sep };
+        let field = (op == b"hset" && i == 0) || (xadd && i % 2 == 1);
+        let splits = (op != b"hset" && arg.contains(&b',')) || (field && arg.contains(&b':'));
+        if splits && whole != Some(i) {
+            return write_err(writer, "arguments may not contain ','; hash and stream fields may not contain ':'");
+        }
+        if i > 0 {
+            value.push(sep);
+        }
+        value.extend_from_slice(arg);
+    }
+    ffi_request(&op, key, &value, read_at, writer)
+}
 
-    let mut response = TxnResponse {
-        transaction_success: false,
-        num_results: 0,
-        results: std::ptr::null_mut(),
+// ===== Blocking FFI =====
+
+/// KVStore::kNoWait: serve the command if a list has data, else fail at once
+const BLOCK_NO_WAIT: i64 = -1;
+
+/// One of the MAX_BLOCKED_CLIENTS places, given back when dropped
+struct BlockedPlace;
+
+impl BlockedPlace {
+    fn take() -> Option<BlockedPlace> {
+        let max = MAX_BLOCKED_CLIENTS.load(Ordering::Relaxed);
+        BLOCKED_CLIENTS.fetch_update(Ordering::AcqRel, Ordering::Relaxed, |n| if n < max { Some(n + 1) } else { None })
+            .ok()
+            .map(|_| BlockedPlace)
+    }
+}
+
+impl Drop for BlockedPlace {
+    fn drop(&mut self) {
+        BLOCKED_CLIENTS.fetch_sub(1, Ordering::AcqRel);
+    }
+}
+
+/// True once the client closed its end or the connection failed; input it
+/// pipelined meanwhile stays unread
+fn peer_closed(stream: &TcpStream) -> bool {
+    let mut byte = [0u8; 1];
+    if stream.set_nonblocking(true).is_err() {
+        return false;
+    }
+    let closed = match stream.peek(&mut byte) {
+        Ok(n) => n == 0,
+        Err(e) => e.kind() != ErrorKind::WouldBlock && e.kind() != ErrorKind::Interrupted,
     };
+    let _ = stream.set_nonblocking(false);
+    closed
+}
 
-    let call_ok = unsafe { cpp_execute_transaction(&request, &mut response) };
+/// Where a blocked command's outcome lands: found, key, value
+struct BlockSlot {
+    outcome: Mutex<Option<(bool, Bytes, Bytes)>>,
+    ready: Condvar,
+}
 
-    if !call_ok || !response.transaction_success || response.num_results == 0 {
-        unsafe { cpp_free_transaction_response(&mut response) };
-        write_err(writer, "backend")?;
-        return Ok(());
+/// The cpp_execute_blocking() callback. It runs under the engine lock, maybe
+/// on the thread of the client whose push woke us, so it only hands over.
+extern "C" fn block_done(ctx: *mut c_void, found: bool, key: *const c_char, value: *const c_char, value_len: usize) {
+    // Takes back the reference given to cpp_execute_blocking()
+    let slot = unsafe { Arc::from_raw(ctx as *const BlockSlot) };
+    let (key, value) = if found {
+        (Bytes::copy_from_slice(unsafe { CStr::from_ptr(key) }.to_bytes()),
+         Bytes::copy_from_slice(unsafe { std::slice::from_raw_parts(value as *const u8, value_len) }))
+    } else {
+        (Bytes::new(), Bytes::new())
+    };
+    *slot.outcome.lock().unwrap() = Some((found, key, value));
+    slot.ready.notify_one();
+}
+
+/// BLPOP key [key ...] timeout, BRPOP the same, BLMOVE source destination
+/// LEFT|RIGHT LEFT|RIGHT timeout. The timeout is in seconds, 0 for none. Like
+/// any blocked Redis client, the connection waits until the engine hands it a
+/// value or the timeout fires; replies queued before it are sent first. The
+/// wait is cancelled if the client disconnects. Past MAX_BLOCKED_CLIENTS the
+/// command is served only if a list has data, else it fails.
+fn ffi_blocking<W: Write>(args: &[Bytes], stream: &TcpStream, writer: &mut W) -> std::io::Result<()> {
+    let op = args[0].to_ascii_lowercase();
+    let is_move = op == b"blmove";
+    if args.len() < 3 || (is_move && args.len() != 6) {
+        return write_err(writer, "wrong number of arguments");
     }
+    let timeout_ms = match std::str::from_utf8(&args[args.len() - 1]).ok().and_then(|t| t.parse::<f64>().ok()) {
+        Some(t) if t.is_finite() && t >= 0.0 => (t * 1000.0).ceil() as i64,
+        _ => return write_err(writer, "timeout is not a float or out of range"),
+    };
+    let keys = &args[1..if is_move { 3 } else { args.len() - 1 }];
+    if keys.iter().any(|key| key.contains(&b',')) {
+        return write_err(writer, "keys may not contain ','");
+    }
+    let ends = if is_move {
+        let side = |arg: &Bytes| ascii_eq_ci(arg, b"LEFT") || ascii_eq_ci(arg, b"RIGHT");
+        if !side(&args[3]) || !side(&args[4]) {
+            return write_err(writer, "syntax error");
+        }
+        [args[3].as_ref(), args[4].as_ref()].join(&b","[..])
+    } else {
+        Vec::new()
+    };
+    let (op, keys, ends) = match (c_arg(&op), c_arg(&keys.join(&b","[..])), c_arg(&ends)) {
+        (Some(op), Some(keys), Some(ends)) => (op, keys, ends),
+        _ => return write_err(writer, "arguments may not contain NUL bytes"),
+    };
+
+    writer.flush()?;
+    let place = BlockedPlace::take();
+    let timeout_ms = if place.is_some() { timeout_ms } else { BLOCK_NO_WAIT };
+    let slot = Arc::new(BlockSlot { outcome: Mutex::new(None), ready: Condvar::new() });
+    let ctx = Arc::into_raw(Arc::clone(&slot)) as *mut c_void;
+    let mut block_id = 0u64;
+    if !unsafe {
+        cpp_execute_blocking(op.as_ptr(), keys.as_ptr(), ends.as_ptr(), timeout_ms, block_done, ctx, &mut block_id)
+    } {
+        drop(unsafe { Arc::from_raw(ctx as *const BlockSlot) });   // the callback will not run
+        return write_err(writer, "blocking command failed");
+    }
+    let mut outcome = slot.outcome.lock().unwrap();
+    while outcome.is_none() {
+        let (guard, waited) = slot.ready.wait_timeout(outcome, BLOCKED_POLL_INTERVAL).unwrap();
+        outcome = guard;
+        if outcome.is_none() && waited.timed_out() && peer_closed(stream) {
+            // The callback runs in the cancel, or ran already, and takes the slot's lock
+            drop(outcome);
+            unsafe { cpp_cancel_blocking(block_id) };
+            return Ok(());
+        }
+    }
+    let (found, key, value) = outcome.take().unwrap();
+    if !found && place.is_none() {
+        return write_err(writer, "max number of blocked clients reached");
+    }
+    match (found, is_move) {
+        (false, false) => writer.write_all(b"*-1\r\n"),
+        (false, true) => write_nil_bulk(writer),
+        (true, false) => {
+            write_array_header(writer, 2)?;
+            write_bulk(writer, &key)?;
+            write_bulk(writer, &value)
+        }
+        (true, true) => write_bulk(writer, &value),
+    }
+}
 
-    let result = unsafe { &*response.results };
+// ===== Pub/Sub FFI =====
 
-    if !result.success {
-        write_err(writer, "operation failed")?;
-    } else if cmd.op == OpCode::Get {
-        if result.data_len > 0 && !result.data_ptr.is_null() {
-            let data = unsafe { std::slice::from_raw_parts(result.data_ptr, result.data_len) };
-            write_bulk(writer, data)?;
+/// SUBSCRIBE / PSUBSCRIBE: one reply per channel with the running count
+fn ffi_subscribe<W: Write>(cmd: &Command, pubsub: &mut PubSubState, writer: &mut W) -> std::io::Result<()> {
+    let (op, kind): (&[u8], &[u8]) = if cmd.op == OpCode::Subscribe {
+        (b"subscribe\0", b"subscribe")
+    } else {
+        (b"psubscribe\0", b"psubscribe")
+    };
+    let names = &cmd.args[1..];
+    if names.is_empty() {
+        return write_err(writer, "wrong number of arguments");
+    }
+    // The engine takes a comma-separated list, so one name goes at a time
+    if names.iter().any(|name| name.contains(&b',')) {
+        return write_err(writer, "channel names may not contain ','");
+    }
+    pubsub.joined = true;
+    for name in names {
+        let channel = match c_arg(name) {
+            Some(channel) => channel,
+            None => return write_err(writer, "channel names may not contain NUL bytes"),
+        };
+        let mut count = 0u64;
+        if !unsafe { cpp_pubsub_command(pubsub.client_id, op.as_ptr() as *const c_char, channel.as_ptr(), &mut count) } {
+            return write_err(writer, "subscribe failed");
+        }
+        if cmd.op == OpCode::Subscribe {
+            pubsub.channels.insert(name.clone());
         } else {
-            write_nil_bulk(writer)?;
+            pubsub.patterns.insert(name.clone());
         }
+        write_subscription(writer, kind, Some(name), count)?;
+    }
+    Ok(())
+}
+
+/// UNSUBSCRIBE / PUNSUBSCRIBE; without channels, from every one of them
+fn ffi_unsubscribe<W: Write>(cmd: &Command, pubsub: &mut PubSubState, writer: &mut W) -> std::io::Result<()> {
+    let channels = cmd.op == OpCode::Unsubscribe;
+    let (op, kind): (&[u8], &[u8]) = if channels {
+        (b"unsubscribe\0", b"unsubscribe")
     } else {
-        // SET returns OK
-        write_simple_ok(writer)?;
+        (b"punsubscribe\0", b"punsubscribe")
+    };
+    let names: Vec<Bytes> = if cmd.args.len() > 1 {
+        cmd.args[1..].to_vec()
+    } else if channels {
+        pubsub.channels.drain().collect()
+    } else {
+        pubsub.patterns.drain().collect()
+    };
+    let all = cmd.args.len() == 1;
+    if names.iter().any(|name| name.contains(&b',')) {
+        return write_err(writer, "channel names may not contain ','");
     }
+    let list = if all { CString::default() } else {
+        match c_arg(&names.join(&b","[..])) {
+            Some(list) => list,
+            None => return write_err(writer, "channel names may not contain NUL bytes"),
+        }
+    };
 
-    unsafe { cpp_free_transaction_response(&mut response) };
+    let mut count = 0u64;
+    if !unsafe { cpp_pubsub_command(pubsub.client_id, op.as_ptr() as *const c_char, list.as_ptr(), &mut count) } {
+        return write_err(writer, "unsubscribe failed");
+    }
+    if names.is_empty() {
+        return write_subscription(writer, kind, None, count);
+    }
+    // The engine reports the count once all are gone; each reply shows it as
+    // it was after that channel
+    let mut subscribed: Vec<bool> = Vec::with_capacity(names.len());
+    for name in &names {
+        subscribed.push(all || if channels { pubsub.channels.remove(name) } else { pubsub.patterns.remove(name) });
+    }
+    let mut left = count + subscribed.iter().filter(|s| **s).count() as u64;
+    for (name, was) in names.iter().zip(subscribed) {
+        if was {
+            left -= 1;
+        }
+        write_subscription(writer, kind, Some(name), left)?;
+    }
     Ok(())
 }
 
+/// Writes the messages published to the connection's channels since the last
+/// call, stopping once about `limit` bytes went out; true if none are left
+fn forward_messages<W: Write>(pubsub: &PubSubState, writer: &mut W, limit: usize) -> std::io::Result<bool> {
+    let mut data: *const u8 = std::ptr::null();
+    let mut len = 0usize;
+    let mut handle: *mut c_void = std::ptr::null_mut();
+    let mut forwarded = 0usize;
+    while forwarded < limit {
+        if !unsafe { cpp_pubsub_next_message(pubsub.client_id, &mut data, &mut len, &mut handle) } {
+            return Ok(true);
+        }
+        let written = writer.write_all(unsafe { std::slice::from_raw_parts(data, len) });
+        unsafe { cpp_pubsub_release_message(handle) };
+        written?;
+        forwarded += len;
+    }
+    Ok(false)
+}
+
+/// True if the engine dropped the client's messages because it fell too far behind
+fn subscriber_overflowed(pubsub: &PubSubState) -> bool {
+    unsafe { cpp_pubsub_overflowed(pubsub.client_id) }
+}
+
+// ===== Subscriber Thread =====
+
+#[repr(C)]
+struct PollFd {
+    fd: c_int,
+    events: c_short,
+    revents: c_short,
+}
+
+const POLLIN: c_short = 0x001;
+const POLLOUT: c_short = 0x004;
+
+extern "C" {
+    fn poll(fds: *mut PollFd, nfds: c_ulong, timeout: c_int) -> c_int;
+}
+
+/// Subscribed connections are served by one thread rather than each holding
+/// a worker. It sleeps in poll(2) on their sockets and on a wakeup socket,
+/// which a worker writes when it hands a connection over and the engine's
+/// ready callback when a message lands in a subscriber's empty queue.
+struct SubscriberHub {
+    adopted: Mutex<Vec<Connection>>,
+    ready: Mutex<Vec<u64>>,
+    wake: UnixStream,
+}
+
+static SUBSCRIBER_HUB: OnceLock<SubscriberHub> = OnceLock::new();
+
+impl SubscriberHub {
+    /// Starts the subscriber thread and has the engine report to it
+    fn start() -> std::io::Result<()> {
+        let (wake, wakeup) = UnixStream::pair()?;
+        wake.set_nonblocking(true)?;
+        wakeup.set_nonblocking(true)?;
+        let hub = SubscriberHub { adopted: Mutex::new(Vec::new()), ready: Mutex::new(Vec::new()), wake };
+        if SUBSCRIBER_HUB.set(hub).is_err() {
+            return Ok(());
+        }
+        std::thread::Builder::new()
+            .name("mako-subscribers".to_string())
+            .spawn(move || subscriber_loop(wakeup))?;
+        unsafe { cpp_pubsub_set_ready_callback(subscriber_ready) };
+        Ok(())
+    }
+
+    fn adopt(conn: Connection) {
+        let hub = SUBSCRIBER_HUB.get().expect("subscriber thread not started");
+        let mut adopted = hub.adopted.lock().unwrap();
+        adopted.push(conn);
+        if adopted.len() == 1 {
+            hub.wake();
+        }
+    }
+
+    fn wake(&self) {
+        // A full socket already holds a wakeup
+        let _ = (&self.wake).write(&[1]);
+    }
+}
+
+/// The engine's ready callback. It runs under the engine lock on the
+/// publishing thread, so it only notes the client and wakes the thread.
+extern "C" fn subscriber_ready(client_id: u64) {
+    if let Some(hub) = SUBSCRIBER_HUB.get() {
+        let mut ready = hub.ready.lock().unwrap();
+        ready.push(client_id);
+        if ready.len() == 1 {
+            hub.wake();
+        }
+    }
+}
+
+/// A connection on the subscriber thread
+struct Subscriber {
+    conn: Connection,
+    /// Replies and messages the socket has not taken yet
+    out: Vec<u8>,
+    /// The engine may hold messages for it
+    pending: bool,
+    /// Something happened on it since it was last served
+    woken: bool,
+}
+
+enum Served {
+    Keep,
+    Close,
+    /// No longer subscribed: back to a thread of its own
+    Leave,
+}
+
+impl Subscriber {
+    /// Runs the commands it sent, takes its messages while the socket keeps
+    /// up, and writes what it can without blocking. Messages stay queued in
+    /// the engine while `out` is full, so a slow reader meets the engine's
+    /// limit on queued bytes.
+    fn serve(&mut self, read_buf: &mut [u8]) -> Served {
+        loop {
+            match self.conn.stream.read(read_buf) {
+                Ok(0) => return Served::Close,
+                Ok(n) => {
+                    if !self.conn.resp3.read_bytes(&read_buf[..n]) {
+                        let _ = write_err(&mut self.out, "Protocol error: query buffer limit exceeded");
+                        let _ = self.conn.stream.write(&self.out);
+                        return Served::Close;
+                    }
+                }
+                Err(e) if e.kind() == ErrorKind::WouldBlock => break,
+                Err(e) if e.kind() == ErrorKind::Interrupted => {}
+                Err(_) => return Served::Close,
+            }
+        }
+        while self.conn.pubsub.subscribed() && matches!(self.conn.run_command(&mut self.out), Ok(true)) {}
+        if subscriber_overflowed(&self.conn.pubsub) {
+            return Served::Close;
+        }
+        if !self.conn.pubsub.subscribed() {
+            return Served::Leave;
+        }
+        loop {
+            if self.pending && self.out.len() < OUTPUT_BUFFER_LIMIT {
+                let room = OUTPUT_BUFFER_LIMIT - self.out.len();
+                self.pending = !matches!(forward_messages(&self.conn.pubsub, &mut self.out, room), Ok(true));
+            }
+            if self.out.is_empty() {
+                return Served::Keep;
+            }
+            match self.conn.stream.write(&self.out) {
+                Ok(0) => return Served::Close,
+                Ok(n) => {
+                    self.out.drain(..n);
+                }
+                Err(e) if e.kind() == ErrorKind::WouldBlock => return Served::Keep,
+                Err(e) if e.kind() == ErrorKind::Interrupted => {}
+                Err(_) => return Served::Close,
+            }
+        }
+    }
+
+    fn leave(self) {
+        let Subscriber { conn, out, .. } = self;
+        let spawned = std::thread::Builder::new().name("mako-client".to_string()).spawn(move || {
+            let mut result = conn.stream.set_nonblocking(false);
+            if result.is_ok() {
+                result = (&conn.stream).write_all(&out);
+            }
+            if let Err(e) = result.and_then(|_| serve_client(conn)) {
+                eprintln!("Client handling error: {e}");
+            }
+        });
+        if let Err(e) = spawned {
+            eprintln!("Failed to spawn client thread: {e}");
+        }
+    }
+}
+
+fn subscriber_loop(wakeup: UnixStream) {
+    let hub = SUBSCRIBER_HUB.get().expect("subscriber thread not started");
+    let mut subscribers: HashMap<u64, Subscriber> = HashMap::new();
+    let mut fds: Vec<PollFd> = Vec::new();
+    let mut ids: Vec<u64> = Vec::new();
+    let mut read_buf = vec![0u8; 16384];
+    let mut drain = [0u8; 64];
+
+    loop {
+        fds.clear();
+        ids.clear();
+        fds.push(PollFd { fd: wakeup.as_raw_fd(), events: POLLIN, revents: 0 });
+        for (id, sub) in &subscribers {
+            let events = if sub.out.is_empty() { POLLIN } else { POLLIN | POLLOUT };
+            fds.push(PollFd { fd: sub.conn.stream.as_raw_fd(), events, revents: 0 });
+            ids.push(*id);
+        }
+        if unsafe { poll(fds.as_mut_ptr(), fds.len() as c_ulong, -1) } < 0 {
+            continue;   // EINTR
+        }
+
+        while matches!((&wakeup).read(&mut drain), Ok(n) if n > 0) {}
+        // Adopted before the ready list is read, so a message that arrives
+        // during the handover still finds its subscriber
+        for conn in std::mem::take(&mut *hub.adopted.lock().unwrap()) {
+            if conn.stream.set_nonblocking(true).is_ok() {
+                let sub = Subscriber { conn, out: Vec::new(), pending: true, woken: true };
+                subscribers.insert(sub.conn.pubsub.client_id, sub);
+            }
+        }
+        for id in std::mem::take(&mut *hub.ready.lock().unwrap()) {
+            if let Some(sub) = subscribers.get_mut(&id) {
+                sub.pending = true;
+                sub.woken = true;
+            }
+        }
+        for (fd, id) in fds[1..].iter().zip(&ids) {
+            if fd.revents != 0 {
+                if let Some(sub) = subscribers.get_mut(id) {
+                    sub.woken = true;
+                }
+            }
+        }
+
+        let mut finished = Vec::new();
+        for (id, sub) in subscribers.iter_mut() {
+            if !sub.woken {
+                continue;
+            }
+            sub.woken = false;
+            match sub.serve(&mut read_buf) {
+                Served::Keep => {}
+                Served::Close => finished.push((*id, false)),
+                Served::Leave => finished.push((*id, true)),
+            }
+        }
+        for (id, leave) in finished {
+            if let Some(sub) = subscribers.remove(&id) {
+                if leave {
+                    sub.leave();
+                }
+            }
+        }
+    }
+}
+
 /// Execute buffered commands as a single transaction (for MULTI/EXEC)
 /// Returns results wrapped in an array
 fn ffi_execute_transaction<W: Write>(commands: &[Command], writer: &mut W) -> std::io::Result<()> {
@@ -370,6 +1095,11 @@ pub extern "C" fn rust_init(n_threads: usize) -> bool {
     let addr = "127.0.0.1:6380";
     let barrier = Arc::new(Barrier::new(n_threads));
     let ready_count = Arc::new(AtomicUsize::new(0));
+    MAX_BLOCKED_CLIENTS.store(n_threads.saturating_sub(1), Ordering::Relaxed);
+    if let Err(e) = SubscriberHub::start() {
+        eprintln!("Failed to start the subscriber thread: {e}");
+        return false;
+    }
 
     println!("Starting {} thread-per-core workers on {} (SO_REUSEPORT, 100% SYNC, MULTI/EXEC support)",
              n_threads, addr);
@@ -401,9 +1131,9 @@ pub extern "C" fn rust_init(n_threads: usize) -> bool {
 
                 loop {
                     match listener.accept() {
-                        Ok((mut stream, _)) => {
+                        Ok((stream, _)) => {
                             let _ = stream.set_nodelay(true);
-                            if let Err(e) = handle_client_sync(&mut stream) {
+                            if let Err(e) = handle_client_sync(stream) {
                                 eprintln!("Client handling error: {e}");
                             }
                         }
@@ -419,38 +1149,54 @@ pub extern "C" fn rust_init(n_threads: usize) -> bool {
     true
 }
 
-/// Handle client with MULTI/EXEC transaction support
-fn handle_client_sync(stream: &mut TcpStream) -> std::io::Result<()> {
-    let mut resp3 = Resp3Handler::new(10 * 1024 * 1024);
+/// Serves a client accepted by a worker
+fn handle_client_sync(stream: TcpStream) -> std::io::Result<()> {
+    serve_client(Connection::new(stream))
+}
+
+/// Reads and runs a connection's commands until it closes or subscribes; a
+/// subscribed connection is handed to the subscriber thread so that it does
+/// not hold the thread serving it
+fn serve_client(mut conn: Connection) -> std::io::Result<()> {
     let mut read_buf = [0u8; 16384];
-    let mut writer = BufWriter::with_capacity(16384, stream.try_clone()?);
-    let mut txn_state = TransactionState::new();
+    let mut writer = BufWriter::with_capacity(OUTPUT_BUFFER_LIMIT, conn.stream.try_clone()?);
 
     loop {
-        match stream.read(&mut read_buf) {
-            Ok(0) => break,
-            Ok(n) => resp3.read_bytes(&read_buf[..n]),
-            Err(e) => return Err(e),
+        // Commands buffered by an earlier read, or by the subscriber thread
+        while !conn.pubsub.subscribed() && conn.run_command(&mut writer)? {
+            // A long pipeline must not pile up replies without bound
+            if writer.buffer().len() >= OUTPUT_BUFFER_LIMIT / 2 {
+                writer.flush()?;
+            }
+        }
+        // Messages published before an UNSUBSCRIBE took effect. Like Redis,
+        // a subscriber that fell behind past its limit is closed.
+        if conn.pubsub.joined {
+            forward_messages(&conn.pubsub, &mut writer, usize::MAX)?;
+            if subscriber_overflowed(&conn.pubsub) {
+                writer.flush()?;
+                break;
+            }
+        }
+        writer.flush()?;
+        if conn.pubsub.subscribed() {
+            drop(writer);
+            SubscriberHub::adopt(conn);
+            return Ok(());
         }
 
-        loop {
-            match resp3.next_frame() {
-                Ok(Some(frame)) => {
-                    if let Some(cmd) = parse_resp3(frame) {
-                        handle_command(&cmd, &mut txn_state, &mut writer)?;
-                    } else {
-                        write_err(&mut writer, "unsupported command")?;
-                    }
-                }
-                Ok(None) => break,
-                Err(_) => {
-                    write_err(&mut writer, "protocol error")?;
+        match conn.stream.read(&mut read_buf) {
+            Ok(0) => break,
+            Ok(n) => {
+                conn.read_at = Instant::now();
+                if !conn.resp3.read_bytes(&read_buf[..n]) {
+                    write_err(&mut writer, "Protocol error: query buffer limit exceeded")?;
+                    writer.flush()?;
                     break;
                 }
             }
+            Err(e) => return Err(e),
         }
-
-        writer.flush()?;
     }
 
     Ok(())
@@ -460,8 +1206,19 @@ fn handle_client_sync(stream: &mut TcpStream) -> std::io::Result<()> {
 fn handle_command<W: Write>(
     cmd: &Command,
     txn_state: &mut TransactionState,
+    pubsub: &mut PubSubState,
+    stream: &TcpStream,
+    read_at: Instant,
     writer: &mut W
 ) -> std::io::Result<()> {
+    let pubsub_op = matches!(cmd.op, OpCode::Subscribe | OpCode::Unsubscribe | OpCode::PSubscribe | OpCode::PUnsubscribe);
+    if pubsub.subscribed() && !pubsub_op && cmd.op != OpCode::Ping {
+        return write_err(writer, "only (P)SUBSCRIBE / (P)UNSUBSCRIBE / PING are allowed in this context");
+    }
+    if txn_state.in_multi && (pubsub_op || cmd.op == OpCode::Forward || cmd.op == OpCode::Blocking) {
+        // The transaction interface carries GET and SET only
+        return write_err(writer, "only GET and SET can be queued in MULTI");
+    }
     match cmd.op {
         OpCode::Ping => {
             // PING is always executed immediately
@@ -496,14 +1253,23 @@ fn handle_command<W: Write>(
                 // Queue command for later execution
                 txn_state.queue_command(cmd.clone());
                 write_queued(writer)?;
+            } else if cmd.op == OpCode::Get {
+                ffi_request(b"get", &cmd.key, b"", read_at, writer)?;
             } else {
-                // Execute immediately as single-operation transaction
-                // Uses ffi_execute_single which returns result without array wrapper
-                ffi_execute_single(cmd, writer)?;
+                ffi_request(b"set", &cmd.key, cmd.val.as_deref().unwrap_or(b""), read_at, writer)?;
             }
         }
-        OpCode::Invalid => {
-            write_err(writer, "unknown command")?;
+        OpCode::Subscribe | OpCode::PSubscribe => {
+            ffi_subscribe(cmd, pubsub, writer)?;
+        }
+        OpCode::Unsubscribe | OpCode::PUnsubscribe => {
+            ffi_unsubscribe(cmd, pubsub, writer)?;
+        }
+        OpCode::Forward => {
+            ffi_forward(&cmd.args, read_at, writer)?;
+        }
+        OpCode::Blocking => {
+            ffi_blocking(&cmd.args, stream, writer)?;
         }
     }
     Ok(())
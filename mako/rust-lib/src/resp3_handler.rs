@@ -26,12 +26,14 @@ use redis_protocol::error::RedisProtocolError;
 /// Handler that buffers incoming bytes and parses complete RESP3 frames.
 pub struct Resp3Handler {
     buf: BytesMut,
+    limit: usize,
 }
 
 impl Resp3Handler {
-    /// Create a new handler with a buffer of given capacity.
-    pub fn new(capacity: usize) -> Self {
-        Self { buf: BytesMut::with_capacity(capacity) }
+    /// Create a new handler with a buffer of given initial capacity that may
+    /// grow to `limit` bytes of unparsed input.
+    pub fn new(capacity: usize, limit: usize) -> Self {
+        Self { buf: BytesMut::with_capacity(capacity.min(limit)), limit }
     }
 
     pub fn print_buffer(&self) {
@@ -40,8 +42,15 @@ impl Resp3Handler {
     }
 
     /// Buffer reads raw bytes (to be parsed).
-    pub fn read_bytes(&mut self, data: &[u8]) {
+    ///
+    /// Returns false, leaving the buffer unchanged, if that would take the
+    /// unparsed input past the limit; the caller should drop the connection.
+    pub fn read_bytes(&mut self, data: &[u8]) -> bool {
+        if self.buf.len() + data.len() > self.limit {
+            return false;
+        }
         self.buf.extend_from_slice(data);
+        true
     }
 
     /// Attempt to parse the next available frame.
@@ -0,0 +1,27 @@
+#include "admission.h"
+
+AdmissionControl::AdmissionControl()
+    : max_queue_(kDefaultMaxQueue), deadline_us_(0), queued_(0), shed_full_(0), shed_late_(0) {}
+
+bool AdmissionControl::enter() {
+    size_t limit = max_queue();
+    size_t before = queued_.fetch_add(1, std::memory_order_relaxed);
+    if (limit > 0 && before >= limit) {
+        queued_.fetch_sub(1, std::memory_order_relaxed);
+        shed_full_.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    return true;
+}
+
+bool AdmissionControl::expired(Clock::time_point arrival) {
+    int64_t limit = deadline_us();
+    if (limit <= 0 || arrival == Clock::time_point()) {
+        return false;
+    }
+    if (Clock::now() - arrival <= std::chrono::microseconds(limit)) {
+        return false;
+    }
+    shed_late_.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
@@ -0,0 +1,61 @@
+#ifndef _ADMISSION_H_
+#define _ADMISSION_H_
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+// Load shedding in front of the engine lock.
+//
+// Every request that needs the engine counts itself into the queue before it
+// waits for the lock and out once it holds it. When max_queue requests are
+// already waiting a new one is refused straight away, and a request that has
+// waited past the deadline is dropped instead of executed late; both get a
+// BUSY error. Under overload the queue, and so the latency of the requests
+// that do run, stays bounded instead of growing with the backlog.
+//
+// The queue only holds callers waiting for the lock. In mako_server a worker
+// runs one request at a time, so at most one per worker waits and a cap at or
+// above the worker count never refuses anything there; the backlog is instead
+// the pipelined requests read but not yet run, which the deadline covers since
+// the front end dates each request from the socket read that completed it.
+// The cap is for in-process callers with more threads than that.
+class AdmissionControl {
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    static const size_t kDefaultMaxQueue = 1024;
+
+    AdmissionControl();
+
+    // False (BUSY) if the queue is full; otherwise the caller must leave()
+    bool enter();
+    void leave() { queued_.fetch_sub(1, std::memory_order_relaxed); }
+
+    // Arrival stamp for expired() of a request that already waited waited_us
+    // before it got here; free when no deadline is set
+    Clock::time_point arrival(int64_t waited_us = 0) const {
+        return deadline_us() > 0 ? Clock::now() - std::chrono::microseconds(waited_us) : Clock::time_point();
+    }
+    // True (and counted) if a request that arrived at `arrival` is past the deadline
+    bool expired(Clock::time_point arrival);
+
+    void set_max_queue(size_t n) { max_queue_.store(n, std::memory_order_relaxed); }   // 0 = unbounded
+    void set_deadline_us(int64_t us) { deadline_us_.store(us, std::memory_order_relaxed); }   // 0 = none
+    size_t max_queue() const { return max_queue_.load(std::memory_order_relaxed); }
+    int64_t deadline_us() const { return deadline_us_.load(std::memory_order_relaxed); }
+
+    size_t queued() const { return queued_.load(std::memory_order_relaxed); }
+    uint64_t shed_full() const { return shed_full_.load(std::memory_order_relaxed); }
+    uint64_t shed_late() const { return shed_late_.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<size_t> max_queue_;
+    std::atomic<int64_t> deadline_us_;
+    std::atomic<size_t> queued_;
+    std::atomic<uint64_t> shed_full_;
+    std::atomic<uint64_t> shed_late_;
+};
+
+#endif
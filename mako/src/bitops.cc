@@ -0,0 +1,248 @@
+#include "bitops.h"
+#include "cpu_features.h"
+#include <algorithm>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define MAKO_X86 1
+#endif
+
+namespace bitops {
+
+namespace {
+
+// Block size for multi-source BITOP: the destination block stays in L2
+// while every source is folded into it.
+const size_t kBlockBytes = 64 * 1024;
+
+inline uint64_t load64(const uint8_t* p) {
+    uint64_t v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+inline void store64(uint8_t* p, uint64_t v) {
+    std::memcpy(p, &v, sizeof(v));
+}
+
+// ===== Scalar kernels =====
+
+uint64_t popcount_scalar(const uint8_t* data, size_t len) {
+    uint64_t total = 0;
+    size_t i = 0;
+    for (; i + 8 <= len; i += 8) {
+        total += __builtin_popcountll(load64(data + i));
+    }
+    for (; i < len; i++) {
+        total += __builtin_popcount(data[i]);
+    }
+    return total;
+}
+
+template <typename F>
+inline void combine_scalar(uint8_t* dst, const uint8_t* src, size_t len, F f) {
+    size_t i = 0;
+    for (; i + 8 <= len; i += 8) {
+        store64(dst + i, f(load64(dst + i), load64(src + i)));
+    }
+    for (; i < len; i++) {
+        dst[i] = static_cast<uint8_t>(f(dst[i], src[i]));
+    }
+}
+
+void and_scalar(uint8_t* dst, const uint8_t* src, size_t len) {
+    combine_scalar(dst, src, len, [](uint64_t a, uint64_t b) { return a & b; });
+}
+
+void or_scalar(uint8_t* dst, const uint8_t* src, size_t len) {
+    combine_scalar(dst, src, len, [](uint64_t a, uint64_t b) { return a | b; });
+}
+
+void xor_scalar(uint8_t* dst, const uint8_t* src, size_t len) {
+    combine_scalar(dst, src, len, [](uint64_t a, uint64_t b) { return a ^ b; });
+}
+
+void not_scalar(uint8_t* dst, const uint8_t* src, size_t len) {
+    combine_scalar(dst, src, len, [](uint64_t, uint64_t b) { return ~b; });
+}
+
+#ifdef MAKO_X86
+
+// ===== POPCNT kernels =====
+
+__attribute__((target("popcnt")))
+uint64_t popcount_popcnt(const uint8_t* data, size_t len) {
+    // Four independent accumulators hide the popcnt latency
+    uint64_t c0 = 0, c1 = 0, c2 = 0, c3 = 0;
+    size_t i = 0;
+    for (; i + 32 <= len; i += 32) {
+        c0 += __builtin_popcountll(load64(data + i));
+        c1 += __builtin_popcountll(load64(data + i + 8));
+        c2 += __builtin_popcountll(load64(data + i + 16));
+        c3 += __builtin_popcountll(load64(data + i + 24));
+    }
+    for (; i + 8 <= len; i += 8) {
+        c0 += __builtin_popcountll(load64(data + i));
+    }
+    for (; i < len; i++) {
+        c0 += __builtin_popcount(data[i]);
+    }
+    return c0 + c1 + c2 + c3;
+}
+
+// ===== AVX2 kernels =====
+
+// Nibble lookup popcount (Mula et al.): pshufb counts each nibble, byte sums
+// are widened with vpsadbw every 8 iterations before they can overflow.
+__attribute__((target("avx2")))
+uint64_t popcount_avx2(const uint8_t* data, size_t len) {
+    const __m256i lookup = _mm256_setr_epi8(
+        0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+        0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+    const __m256i low_mask = _mm256_set1_epi8(0x0f);
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i acc = zero;
+    size_t i = 0;
+    while (i + 32 <= len) {
+        __m256i local = zero;
+        for (int j = 0; j < 8 && i + 32 <= len; j++, i += 32) {
+            __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+            __m256i lo = _mm256_and_si256(v, low_mask);
+            __m256i hi = _mm256_and_si256(_mm256_srli_epi16(v, 4), low_mask);
+            local = _mm256_add_epi8(local, _mm256_shuffle_epi8(lookup, lo));
+            local = _mm256_add_epi8(local, _mm256_shuffle_epi8(lookup, hi));
+        }
+        acc = _mm256_add_epi64(acc, _mm256_sad_epu8(local, zero));
+    }
+    uint64_t total = static_cast<uint64_t>(_mm256_extract_epi64(acc, 0)) +
+                     static_cast<uint64_t>(_mm256_extract_epi64(acc, 1)) +
+                     static_cast<uint64_t>(_mm256_extract_epi64(acc, 2)) +
+                     static_cast<uint64_t>(_mm256_extract_epi64(acc, 3));
+    return total + popcount_scalar(data + i, len - i);
+}
+
+#define MAKO_AVX2_COMBINE(NAME, EXPR, SCALAR)                                         \
+    __attribute__((target("avx2")))                                                  \
+    void NAME(uint8_t* dst, const uint8_t* src, size_t len) {                        \
+        size_t i = 0;                                                                \
+        for (; i + 32 <= len; i += 32) {                                             \
+            __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(dst + i)); \
+            __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i)); \
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), EXPR);          \
+        }                                                                            \
+        SCALAR(dst + i, src + i, len - i);                                           \
+    }
+
+MAKO_AVX2_COMBINE(and_avx2, _mm256_and_si256(a, b), and_scalar)
+MAKO_AVX2_COMBINE(or_avx2, _mm256_or_si256(a, b), or_scalar)
+MAKO_AVX2_COMBINE(xor_avx2, _mm256_xor_si256(a, b), xor_scalar)
+
+#undef MAKO_AVX2_COMBINE
+
+__attribute__((target("avx2")))
+void not_avx2(uint8_t* dst, const uint8_t* src, size_t len) {
+    const __m256i ones = _mm256_set1_epi8(-1);
+    size_t i = 0;
+    for (; i + 32 <= len; i += 32) {
+        __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), _mm256_xor_si256(b, ones));
+    }
+    not_scalar(dst + i, src + i, len - i);
+}
+
+#endif // MAKO_X86
+
+const Kernels kScalar = {Isa::Scalar, "scalar", popcount_scalar,
+                         and_scalar, or_scalar, xor_scalar, not_scalar};
+
+#ifdef MAKO_X86
+const Kernels kPopcnt = {Isa::Popcnt, "popcnt", popcount_popcnt,
+                         and_scalar, or_scalar, xor_scalar, not_scalar};
+const Kernels kAvx2 = {Isa::Avx2, "avx2", popcount_avx2,
+                       and_avx2, or_avx2, xor_avx2, not_avx2};
+#endif
+
+} // namespace
+
+const Kernels& kernels_for(Isa isa) {
+#ifdef MAKO_X86
+    if (isa == Isa::Avx2 && cpu_has_avx2()) return kAvx2;
+    if (isa != Isa::Scalar && cpu_has_popcnt()) return kPopcnt;
+#else
+    (void)isa;
+#endif
+    return kScalar;
+}
+
+const Kernels& kernels() {
+    static const Kernels& best = kernels_for(Isa::Avx2);
+    return best;
+}
+
+void bitop(const Kernels& k, Op op, const std::vector<Source>& sources, std::string& dst) {
+    dst.clear();
+    if (sources.empty()) {
+        return;
+    }
+    size_t max_len = 0;
+    for (const auto& s : sources) {
+        max_len = std::max(max_len, s.len);
+    }
+    dst.resize(max_len, '\0');
+    uint8_t* out = reinterpret_cast<uint8_t*>(&dst[0]);
+
+    if (op == Op::Not) {
+        k.not_into(out, sources[0].data, sources[0].len);
+        return;
+    }
+
+    for (size_t block = 0; block < max_len; block += kBlockBytes) {
+        size_t n = std::min(kBlockBytes, max_len - block);
+        uint8_t* out_block = out + block;
+
+        const Source& first = sources[0];
+        if (first.len > block) {
+            std::memcpy(out_block, first.data + block, std::min(n, first.len - block));
+        }
+
+        for (size_t s = 1; s < sources.size(); s++) {
+            const Source& src = sources[s];
+            size_t overlap = src.len > block ? std::min(n, src.len - block) : 0;
+            switch (op) {
+            case Op::And:
+                k.and_into(out_block, src.data + block, overlap);
+                // Missing bytes of a shorter source are zero
+                std::memset(out_block + overlap, 0, n - overlap);
+                break;
+            case Op::Or:
+                k.or_into(out_block, src.data + block, overlap);
+                break;
+            case Op::Xor:
+                k.xor_into(out_block, src.data + block, overlap);
+                break;
+            case Op::Not:
+                break;
+            }
+        }
+    }
+}
+
+int64_t bitpos(const uint8_t* data, size_t len, bool bit) {
+    // Skip whole words that cannot contain the bit
+    const uint64_t skip = bit ? 0 : ~0ULL;
+    size_t i = 0;
+    while (i + 8 <= len && load64(data + i) == skip) {
+        i += 8;
+    }
+    for (; i < len; i++) {
+        unsigned byte = bit ? data[i] : static_cast<uint8_t>(~data[i]);
+        if (byte != 0) {
+            // Bit 0 is the most significant bit of the byte
+            return static_cast<int64_t>(i * 8 + (__builtin_clz(byte) - 24));
+        }
+    }
+    return -1;
+}
+
+} // namespace bitops
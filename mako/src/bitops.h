@@ -0,0 +1,51 @@
+#ifndef _BITOPS_H_
+#define _BITOPS_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Bitmap kernels for SETBIT/BITCOUNT/BITPOS/BITOP. Each kernel has a scalar
+// version plus POPCNT/AVX2 versions; kernels() picks the best set for the
+// running CPU once and the engine calls through that table.
+namespace bitops {
+
+enum class Isa { Scalar, Popcnt, Avx2 };
+
+enum class Op { And, Or, Xor, Not };
+
+struct Kernels {
+    Isa isa;
+    const char* name;
+    uint64_t (*popcount)(const uint8_t* data, size_t len);
+    // dst[i] = dst[i] op src[i] for i < len
+    void (*and_into)(uint8_t* dst, const uint8_t* src, size_t len);
+    void (*or_into)(uint8_t* dst, const uint8_t* src, size_t len);
+    void (*xor_into)(uint8_t* dst, const uint8_t* src, size_t len);
+    // dst[i] = ~src[i]
+    void (*not_into)(uint8_t* dst, const uint8_t* src, size_t len);
+};
+
+// Best kernels supported by this CPU (resolved on first call)
+const Kernels& kernels();
+
+// Kernels for a specific ISA; falls back to scalar if the CPU lacks it
+const Kernels& kernels_for(Isa isa);
+
+struct Source {
+    const uint8_t* data;
+    size_t len;
+};
+
+// Computes op over the sources into dst (resized to the longest source;
+// shorter sources count as zero-padded). Works in cache-sized blocks so the
+// destination block stays hot while every source is folded into it.
+void bitop(const Kernels& k, Op op, const std::vector<Source>& sources, std::string& dst);
+
+// Index of the first bit equal to `bit` in data[0, len), or -1
+int64_t bitpos(const uint8_t* data, size_t len, bool bit);
+
+} // namespace bitops
+
+#endif
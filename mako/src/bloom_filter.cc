@@ -0,0 +1,203 @@
+#include "bloom_filter.h"
+#include "cpu_features.h"
+#include "hash.h"
+#include <cmath>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define MAKO_X86 1
+#endif
+
+namespace {
+
+// Odd multipliers from the Parquet split-block Bloom filter spec
+const uint32_t kSalt[8] = {0x47b6137bU, 0x44974d91U, 0x8824ad5bU, 0xa2b7289dU,
+                           0x705495c7U, 0x2df1424bU, 0x9efc4947U, 0x5c6bfb31U};
+
+// Bit i of the mask has one bit set in word i
+inline void make_mask_scalar(uint32_t key, uint32_t mask[8]) {
+    for (int i = 0; i < 8; i++) {
+        mask[i] = 1U << ((key * kSalt[i]) >> 27);
+    }
+}
+
+void insert_scalar(uint32_t* words, uint32_t key) {
+    uint32_t mask[8];
+    make_mask_scalar(key, mask);
+    for (int i = 0; i < 8; i++) {
+        words[i] |= mask[i];
+    }
+}
+
+bool check_scalar(const uint32_t* words, uint32_t key) {
+    uint32_t mask[8];
+    make_mask_scalar(key, mask);
+    for (int i = 0; i < 8; i++) {
+        if ((words[i] & mask[i]) == 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+#ifdef MAKO_X86
+__attribute__((target("avx2")))
+inline __m256i make_mask_avx2(uint32_t key) {
+    const __m256i salts = _mm256_setr_epi32(
+        static_cast<int>(kSalt[0]), static_cast<int>(kSalt[1]), static_cast<int>(kSalt[2]),
+        static_cast<int>(kSalt[3]), static_cast<int>(kSalt[4]), static_cast<int>(kSalt[5]),
+        static_cast<int>(kSalt[6]), static_cast<int>(kSalt[7]));
+    __m256i k = _mm256_set1_epi32(static_cast<int>(key));
+    __m256i shifts = _mm256_srli_epi32(_mm256_mullo_epi32(k, salts), 27);
+    return _mm256_sllv_epi32(_mm256_set1_epi32(1), shifts);
+}
+
+__attribute__((target("avx2")))
+void insert_avx2(uint32_t* words, uint32_t key) {
+    __m256i* block = reinterpret_cast<__m256i*>(words);
+    _mm256_store_si256(block, _mm256_or_si256(_mm256_load_si256(block), make_mask_avx2(key)));
+}
+
+__attribute__((target("avx2")))
+bool check_avx2(const uint32_t* words, uint32_t key) {
+    __m256i block = _mm256_load_si256(reinterpret_cast<const __m256i*>(words));
+    // testc: every mask bit is also set in the block
+    return _mm256_testc_si256(block, make_mask_avx2(key)) != 0;
+}
+#endif
+
+struct BlockKernels {
+    void (*insert)(uint32_t*, uint32_t);
+    bool (*check)(const uint32_t*, uint32_t);
+};
+
+const BlockKernels& block_kernels() {
+#ifdef MAKO_X86
+    static const BlockKernels k = cpu_has_avx2() ? BlockKernels{insert_avx2, check_avx2}
+                                                 : BlockKernels{insert_scalar, check_scalar};
+#else
+    static const BlockKernels k = {insert_scalar, check_scalar};
+#endif
+    return k;
+}
+
+// False positive rate of a split-block filter holding `load` items per block
+// on average. Block loads are Poisson distributed, and a block with j items
+// has each of its eight words set at one of 32 positions, so
+// fpr = sum_j Poisson(j; load) * (1 - (31/32)^j)^8
+double split_block_fpr(double load) {
+    double term = std::exp(-load);   // Poisson(0)
+    double fpr = 0.0;
+    double upper = load + 10.0 * std::sqrt(load) + 10.0;
+    for (int j = 1; j < upper; j++) {
+        term *= load / j;
+        fpr += term * std::pow(1.0 - std::pow(31.0 / 32.0, j), 8);
+    }
+    return fpr;
+}
+
+} // namespace
+
+BlockedBloomFilter::BlockedBloomFilter(uint64_t capacity, double error_rate)
+    : capacity_(capacity ? capacity : 1), error_rate_(error_rate), size_(0) {
+    // Blocking makes the filter less accurate than a classic one of the same
+    // size (some blocks get more than their share of items), so pick the
+    // largest per-block load that still meets the error rate
+    double lo = 0.0, hi = 256.0;
+    for (int i = 0; i < 40; i++) {
+        double mid = (lo + hi) / 2;
+        if (split_block_fpr(mid) <= error_rate_) {
+            lo = mid;
+        } else {
+            hi = mid;
+        }
+    }
+    double load = lo > 0.01 ? lo : 0.01;
+    num_blocks_ = static_cast<size_t>(std::ceil(static_cast<double>(capacity_) / load));
+    if (num_blocks_ == 0) num_blocks_ = 1;
+
+    // Over-allocate one cache line and align by hand so no block straddles lines
+    storage_.reset(new Block[num_blocks_ + 2]());
+    uintptr_t addr = reinterpret_cast<uintptr_t>(storage_.get());
+    blocks_ = reinterpret_cast<Block*>((addr + 63) & ~uintptr_t(63));
+}
+
+size_t BlockedBloomFilter::block_index(uint64_t hash) const {
+    // Multiply-shift range reduction of the high half (no modulo)
+    return static_cast<size_t>(((hash >> 32) * static_cast<uint64_t>(num_blocks_)) >> 32);
+}
+
+bool BlockedBloomFilter::add(uint64_t hash) {
+    uint32_t* words = blocks_[block_index(hash)].words;
+    uint32_t key = static_cast<uint32_t>(hash);
+    const BlockKernels& k = block_kernels();
+    if (k.check(words, key)) {
+        return false;
+    }
+    k.insert(words, key);
+    size_++;
+    return true;
+}
+
+bool BlockedBloomFilter::contains(uint64_t hash) const {
+    return block_kernels().check(blocks_[block_index(hash)].words, static_cast<uint32_t>(hash));
+}
+
+ScalableBloomFilter::ScalableBloomFilter(uint64_t capacity, double error_rate)
+    : initial_capacity_(capacity ? capacity : kDefaultCapacity),
+      // The layers' error rates form a geometric series; starting at
+      // error_rate * (1 - kTightening) keeps their sum under error_rate
+      initial_error_rate_(error_rate * (1.0 - kTightening)) {
+    layers_.emplace_back(new BlockedBloomFilter(initial_capacity_, initial_error_rate_));
+}
+
+uint64_t ScalableBloomFilter::hash(const std::string& item) {
+    return murmur64a(item.data(), item.size(), 0x5bd1e9955bd1e995ULL);
+}
+
+bool ScalableBloomFilter::add(const std::string& item) {
+    uint64_t h = hash(item);
+    // Older layers are checked first so an item is never counted twice
+    for (size_t i = 0; i + 1 < layers_.size(); i++) {
+        if (layers_[i]->contains(h)) {
+            return false;
+        }
+    }
+    BlockedBloomFilter* last = layers_.back().get();
+    if (last->size() >= last->capacity()) {
+        if (last->contains(h)) {
+            return false;
+        }
+        layers_.emplace_back(new BlockedBloomFilter(last->capacity() * kExpansion,
+                                                    last->error_rate() * kTightening));
+        last = layers_.back().get();
+    }
+    return last->add(h);
+}
+
+bool ScalableBloomFilter::contains(const std::string& item) const {
+    uint64_t h = hash(item);
+    // Newest layers hold most of the items
+    for (auto it = layers_.rbegin(); it != layers_.rend(); ++it) {
+        if ((*it)->contains(h)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+uint64_t ScalableBloomFilter::size() const {
+    uint64_t total = 0;
+    for (const auto& layer : layers_) {
+        total += layer->size();
+    }
+    return total;
+}
+
+size_t ScalableBloomFilter::memory_bytes() const {
+    size_t total = 0;
+    for (const auto& layer : layers_) {
+        total += layer->memory_bytes();
+    }
+    return total;
+}
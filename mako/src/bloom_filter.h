@@ -0,0 +1,79 @@
+#ifndef _BLOOM_FILTER_H_
+#define _BLOOM_FILTER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Split-block Bloom filter (the Parquet/Impala layout).
+//
+// The filter is an array of 256-bit blocks aligned to cache lines. One
+// 64-bit hash picks the block and eight 32-bit salts slice the low half into
+// one bit per 32-bit word of that block, so an insert or lookup touches a
+// single cache line. The eight bit positions are computed in one AVX2
+// multiply/shift when the CPU has it.
+class BlockedBloomFilter {
+public:
+    static const size_t kBlockBytes = 32;
+
+    BlockedBloomFilter(uint64_t capacity, double error_rate);
+
+    BlockedBloomFilter(const BlockedBloomFilter&) = delete;
+    BlockedBloomFilter& operator=(const BlockedBloomFilter&) = delete;
+
+    // Returns false if the item was (probably) already present
+    bool add(uint64_t hash);
+    bool contains(uint64_t hash) const;
+
+    uint64_t capacity() const { return capacity_; }
+    uint64_t size() const { return size_; }
+    double error_rate() const { return error_rate_; }
+    size_t memory_bytes() const { return num_blocks_ * kBlockBytes; }
+
+private:
+    struct alignas(32) Block {
+        uint32_t words[8];
+    };
+
+    size_t block_index(uint64_t hash) const;
+
+    uint64_t capacity_;
+    double error_rate_;
+    uint64_t size_;
+    size_t num_blocks_;
+    std::unique_ptr<Block[]> storage_;
+    Block* blocks_;   // storage_ rounded up to a cache line boundary
+};
+
+// Scalable Bloom filter (Almeida et al.): when the newest layer reaches its
+// capacity a new layer is chained with kExpansion times the capacity and a
+// kTightening times smaller error rate. The first layer gets
+// error_rate * (1 - kTightening) so the compound rate stays under error_rate.
+class ScalableBloomFilter {
+public:
+    static const uint64_t kDefaultCapacity = 100;
+    static constexpr double kDefaultErrorRate = 0.01;
+    static const uint64_t kExpansion = 2;
+    static constexpr double kTightening = 0.5;
+
+    ScalableBloomFilter(uint64_t capacity = kDefaultCapacity, double error_rate = kDefaultErrorRate);
+
+    // Returns true if the item was newly added
+    bool add(const std::string& item);
+    bool contains(const std::string& item) const;
+
+    uint64_t size() const;
+    size_t layers() const { return layers_.size(); }
+    size_t memory_bytes() const;
+
+    static uint64_t hash(const std::string& item);
+
+private:
+    uint64_t initial_capacity_;
+    double initial_error_rate_;
+    std::vector<std::unique_ptr<BlockedBloomFilter>> layers_;
+};
+
+#endif
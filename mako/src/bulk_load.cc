@@ -0,0 +1,707 @@
+#include "bulk_load.h"
+#include "hash.h"
+#include "mapped_file.h"
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <chrono>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <numeric>
+#include <queue>
+#include <thread>
+#include <strings.h>
+
+namespace {
+
+typedef BulkLoader::Format Format;
+
+// Smaller chunks are not worth a thread
+const size_t kMinChunkBytes = 1 << 20;
+
+std::vector<std::string> split_args(const std::string& args) {
+    std::vector<std::string> parts;
+    size_t pos = 0;
+    while (!args.empty() && pos <= args.size()) {
+        size_t comma = args.find(',', pos);
+        if (comma == std::string::npos) {
+            comma = args.size();
+        }
+        parts.push_back(args.substr(pos, comma - pos));
+        pos = comma + 1;
+    }
+    return parts;
+}
+
+std::string upper(std::string s) {
+    std::transform(s.begin(), s.end(), s.begin(), ::toupper);
+    return s;
+}
+
+// A whole decimal number, with no sign or trailing text
+bool parse_count(const std::string& s, unsigned long long& n) {
+    if (s.empty() || s[0] < '0' || s[0] > '9') {
+        return false;
+    }
+    char* stop;
+    errno = 0;
+    n = std::strtoull(s.c_str(), &stop, 10);
+    return *stop == '\0' && errno != ERANGE;
+}
+
+size_t default_threads() {
+    return std::min<size_t>(std::max(1u, std::thread::hardware_concurrency()), BulkLoader::kMaxThreads);
+}
+
+bool parse_threads(const std::string& s, size_t& threads, std::string& error) {
+    unsigned long long n;
+    if (!parse_count(s, n) || n == 0) {
+        error = "ERROR: THREADS must be a positive integer";
+        return false;
+    }
+    threads = static_cast<size_t>(std::min<unsigned long long>(n, BulkLoader::kMaxThreads));
+    return true;
+}
+
+bool parse_format(const std::string& name, Format& format) {
+    if (name == "RESP") {
+        format = BulkLoader::kResp;
+    } else if (name == "CSV") {
+        format = BulkLoader::kCsv;
+    } else if (name == "BINARY") {
+        format = BulkLoader::kBinary;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+bool format_from_path(const std::string& path, Format& format) {
+    size_t dot = path.rfind('.');
+    if (dot == std::string::npos || path.find('/', dot) != std::string::npos) {
+        return false;
+    }
+    std::string ext = path.substr(dot + 1);
+    std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+    if (ext == "resp" || ext == "aof") {
+        format = BulkLoader::kResp;
+    } else if (ext == "csv") {
+        format = BulkLoader::kCsv;
+    } else if (ext == "bin") {
+        format = BulkLoader::kBinary;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+// A parsed key or value: points into the mapped file, or into `text` when
+// the CSV field had to be unescaped
+struct Field {
+    const char* data;
+    size_t size;
+    std::string text;
+};
+
+// RESP: a '*' or '$' header with a decimal length, terminated by \r\n
+bool resp_length(const char*& p, const char* end, char type, size_t& n) {
+    if (p == end || *p != type) {
+        return false;
+    }
+    ++p;
+    n = 0;
+    const char* digits = p;
+    while (p < end && *p >= '0' && *p <= '9') {
+        if (n > (SIZE_MAX - 9) / 10) {
+            return false;
+        }
+        n = n * 10 + static_cast<size_t>(*p - '0');
+        ++p;
+    }
+    if (p == digits || end - p < 2 || p[0] != '\r' || p[1] != '\n') {
+        return false;
+    }
+    p += 2;
+    return true;
+}
+
+bool resp_bulk(const char*& p, const char* end, Field& field) {
+    size_t n;
+    if (!resp_length(p, end, '$', n) || static_cast<size_t>(end - p) < n + 2 || p[n] != '\r' || p[n + 1] != '\n') {
+        return false;
+    }
+    field.data = p;
+    field.size = n;
+    p += n + 2;
+    return true;
+}
+
+bool resp_record(const char*& p, const char* end, Field& key, Field& value) {
+    size_t n;
+    Field command;
+    return resp_length(p, end, '*', n) && n == 3 && resp_bulk(p, end, command) && command.size == 3 &&
+           strncasecmp(command.data, "SET", 3) == 0 && resp_bulk(p, end, key) && resp_bulk(p, end, value);
+}
+
+bool binary_record(const char*& p, const char* end, Field& key, Field& value) {
+    if (end - p < 8) {
+        return false;
+    }
+    const uint8_t* h = reinterpret_cast<const uint8_t*>(p);
+    size_t klen = h[0] | h[1] << 8 | h[2] << 16 | static_cast<size_t>(h[3]) << 24;
+    size_t vlen = h[4] | h[5] << 8 | h[6] << 16 | static_cast<size_t>(h[7]) << 24;
+    if (static_cast<size_t>(end - p) - 8 < klen + vlen) {
+        return false;
+    }
+    key.data = p + 8;
+    key.size = klen;
+    value.data = key.data + klen;
+    value.size = vlen;
+    p = value.data + vlen;
+    return true;
+}
+
+// One CSV field of the line [p, line_end); stops on the separating comma
+bool csv_field(const char*& p, const char* line_end, Field& field) {
+    if (p < line_end && *p == '"') {
+        field.text.clear();
+        ++p;
+        while (true) {
+            const char* quote = static_cast<const char*>(std::memchr(p, '"', line_end - p));
+            if (quote == nullptr) {
+                return false;
+            }
+            field.text.append(p, quote);
+            p = quote + 1;
+            if (p < line_end && *p == '"') {
+                field.text.push_back('"');
+                ++p;
+                continue;
+            }
+            break;
+        }
+        field.data = field.text.data();
+        field.size = field.text.size();
+        return p == line_end || *p == ',';
+    }
+    const char* comma = static_cast<const char*>(std::memchr(p, ',', line_end - p));
+    const char* stop = comma != nullptr ? comma : line_end;
+    field.data = p;
+    field.size = stop - p;
+    p = stop;
+    return true;
+}
+
+// Sets blank for an empty line, which is skipped
+bool csv_record(const char*& p, const char* end, Field& key, Field& value, bool& blank) {
+    const char* newline = static_cast<const char*>(std::memchr(p, '\n', end - p));
+    const char* next = newline != nullptr ? newline + 1 : end;
+    const char* line_end = newline != nullptr ? newline : end;
+    if (line_end > p && line_end[-1] == '\r') {
+        --line_end;
+    }
+    blank = line_end == p;
+    if (blank) {
+        p = next;
+        return true;
+    }
+    if (!csv_field(p, line_end, key) || p == line_end) {
+        return false;
+    }
+    ++p;   // the comma
+    if (!csv_field(p, line_end, value) || p != line_end) {
+        return false;
+    }
+    p = next;
+    return true;
+}
+
+bool next_record(Format format, const char*& p, const char* end, Field& key, Field& value, bool& blank) {
+    blank = false;
+    switch (format) {
+    case BulkLoader::kResp: return resp_record(p, end, key, value);
+    case BulkLoader::kBinary: return binary_record(p, end, key, value);
+    default: return csv_record(p, end, key, value, blank);
+    }
+}
+
+// Cuts [begin, end) into `chunks` pieces that start on record boundaries.
+// CSV records start after a newline; RESP and BINARY records can only be
+// found by walking the length headers from the start, which reads just the
+// headers, not the keys and values.
+std::vector<const char*> cut_chunks(Format format, const char* begin, const char* end, size_t chunks) {
+    std::vector<const char*> cuts(1, begin);
+    size_t step = (end - begin) / chunks;
+    if (format == BulkLoader::kCsv) {
+        for (size_t i = 1; i < chunks; i++) {
+            const char* at = std::max(cuts.back(), begin + i * step);
+            const char* newline = static_cast<const char*>(std::memchr(at, '\n', end - at));
+            if (newline == nullptr) {
+                break;
+            }
+            if (newline + 1 < end) {
+                cuts.push_back(newline + 1);
+            }
+        }
+    } else {
+        const char* p = begin;
+        const char* next_cut = begin + step;
+        Field key, value;
+        bool blank;
+        while (cuts.size() < chunks && p < end && next_record(format, p, end, key, value, blank)) {
+            if (p >= next_cut && p < end) {
+                cuts.push_back(p);
+                next_cut = p + step;
+            }
+        }
+    }
+    cuts.push_back(end);
+    return cuts;
+}
+
+// First 8 bytes of s from `from` on, zero padded, as a big-endian number so
+// integer order is byte order
+uint64_t key_prefix(const std::string& s, size_t from) {
+    unsigned char bytes[8] = {0};
+    if (s.size() > from) {
+        std::memcpy(bytes, s.data() + from, std::min<size_t>(s.size() - from, 8));
+    }
+    uint64_t v = 0;
+    for (unsigned char b : bytes) {
+        v = v << 8 | b;
+    }
+    return v;
+}
+
+// One thread's share of the file: its rows, and once sorted, each row's key
+// prefix (see Ref)
+struct Chunk {
+    BulkLoader::Run rows;
+    std::vector<std::pair<uint64_t, uint64_t>> prefixes;
+    size_t bad_at;   // offset of the first malformed record, or SIZE_MAX
+
+    Chunk() : bad_at(SIZE_MAX) {}
+};
+
+// A row in a sort or merge. Chasing key pointers for every comparison is
+// slow, so a ref holds the key's first 16 bytes inline, which decide most
+// comparisons; ties fall back to the keys, then to file order (chunk, row).
+struct Ref {
+    uint64_t hi;
+    uint64_t lo;
+    size_t chunk;
+    size_t row;
+};
+
+struct RefLess {
+    const std::vector<Chunk>* chunks;
+
+    bool operator()(const Ref& a, const Ref& b) const {
+        if (a.hi != b.hi) {
+            return a.hi < b.hi;
+        }
+        if (a.lo != b.lo) {
+            return a.lo < b.lo;
+        }
+        const std::string& ka = (*chunks)[a.chunk].rows[a.row].first;
+        const std::string& kb = (*chunks)[b.chunk].rows[b.row].first;
+        // Up to 16 bytes the prefixes hold the whole key, so only length remains
+        int c = ka.size() > 16 || kb.size() > 16 ? ka.compare(kb) : (ka.size() > kb.size()) - (ka.size() < kb.size());
+        if (c != 0) {
+            return c < 0;
+        }
+        return a.chunk != b.chunk ? a.chunk < b.chunk : a.row < b.row;
+    }
+};
+
+// Sorts chunks[i] by sorting refs to its rows and then moving each row once
+void sort_chunk(std::vector<Chunk>& chunks, size_t i) {
+    Chunk& chunk = chunks[i];
+    std::vector<Ref> refs(chunk.rows.size());
+    for (size_t row = 0; row < refs.size(); row++) {
+        const std::string& key = chunk.rows[row].first;
+        refs[row] = Ref{key_prefix(key, 0), key_prefix(key, 8), i, row};
+    }
+    std::sort(refs.begin(), refs.end(), RefLess{&chunks});
+    BulkLoader::Run sorted;
+    sorted.reserve(refs.size());
+    chunk.prefixes.reserve(refs.size());
+    for (const Ref& ref : refs) {
+        sorted.push_back(std::move(chunk.rows[ref.row]));
+        chunk.prefixes.emplace_back(ref.hi, ref.lo);
+    }
+    chunk.rows.swap(sorted);
+}
+
+// Merges the sorted chunks into rows, emptying them
+void merge_chunks(std::vector<Chunk>& chunks, size_t total, BulkLoader::Run& rows) {
+    if (chunks.size() == 1) {
+        rows.swap(chunks[0].rows);
+        return;
+    }
+    auto head_of = [&chunks](size_t i, size_t row) {
+        return Ref{chunks[i].prefixes[row].first, chunks[i].prefixes[row].second, i, row};
+    };
+    RefLess less{&chunks};
+    auto after = [&less](const Ref& a, const Ref& b) { return less(b, a); };
+    std::priority_queue<Ref, std::vector<Ref>, decltype(after)> heads(after);
+    for (size_t i = 0; i < chunks.size(); i++) {
+        if (!chunks[i].rows.empty()) {
+            heads.push(head_of(i, 0));
+        }
+    }
+    rows.reserve(total);
+    while (!heads.empty()) {
+        Ref head = heads.top();
+        heads.pop();
+        Chunk& chunk = chunks[head.chunk];
+        rows.push_back(std::move(chunk.rows[head.row]));
+        if (head.row + 1 < chunk.rows.size()) {
+            heads.push(head_of(head.chunk, head.row + 1));
+        } else {
+            chunk = Chunk();
+        }
+    }
+}
+
+// Parses [begin, end) into chunks[i] and sorts it
+void parse_chunk(Format format, const char* base, const char* begin, const char* end, std::vector<Chunk>& chunks,
+                 size_t i) {
+    Chunk& chunk = chunks[i];
+    const char* p = begin;
+    Field key, value;
+    bool blank;
+    while (p < end) {
+        const char* record = p;
+        if (!next_record(format, p, end, key, value, blank)) {
+            chunk.bad_at = record - base;
+            return;
+        }
+        if (!blank) {
+            chunk.rows.emplace_back(std::string(key.data, key.size), std::string(value.data, value.size));
+        }
+    }
+    sort_chunk(chunks, i);
+}
+
+// DEBUG POPULATE keys are prefix:n for n in [0, count); their byte order is
+// the order of the decimal strings, 0 1 10 100 ... 11 110 ... 2 20 ..., so
+// they can be generated in order instead of sorted. Numbers in that order
+// are walked like a trie of digits.
+
+// How many of [0, count) start with the digits of p (p > 0)
+uint64_t lex_subtree(uint64_t p, uint64_t count) {
+    uint64_t size = 0;
+    for (uint64_t lo = p, hi = p + 1; lo < count;) {
+        size += std::min(hi, count) - lo;
+        if (lo > (UINT64_MAX - 9) / 10 || hi > (UINT64_MAX - 9) / 10) {
+            break;
+        }
+        lo *= 10;
+        hi *= 10;
+    }
+    return size;
+}
+
+// The k-th of [0, count) in decimal string order
+uint64_t lex_nth(uint64_t k, uint64_t count) {
+    if (k == 0) {
+        return 0;
+    }
+    uint64_t n = 1;
+    k--;   // the k-th of [1, count) from here on
+    while (k > 0) {
+        uint64_t below = lex_subtree(n, count);
+        if (below <= k) {
+            k -= below;
+            n++;
+        } else {
+            k--;
+            n *= 10;
+        }
+    }
+    return n;
+}
+
+// The one after n of [0, count) in decimal string order
+uint64_t lex_next(uint64_t n, uint64_t count) {
+    if (n == 0) {
+        return 1;
+    }
+    if (n <= (count - 1) / 10) {
+        return n * 10;
+    }
+    while (n % 10 == 9 || n + 1 >= count) {
+        n /= 10;
+    }
+    return n + 1;
+}
+
+// Rows [first, last) of a DEBUG POPULATE, in key order, into rows[first, last)
+void generate_rows(const BulkLoader::Populate& spec, uint64_t first, uint64_t last, BulkLoader::Run& rows) {
+    std::string key = spec.prefix + ":";
+    size_t stem = key.size();
+    uint64_t n = lex_nth(first, spec.count);
+    for (uint64_t i = first; i < last; i++) {
+        if (i > first) {
+            n = lex_next(n, spec.count);
+        }
+        std::string digits = std::to_string(n);
+        key.resize(stem);
+        key += digits;
+        std::string value = "value:" + digits;
+        if (spec.size > 0) {
+            value.resize(spec.size, 'x');
+        }
+        rows[i].first = key;
+        rows[i].second = std::move(value);
+    }
+}
+
+void append_resp_bulk(const std::string& s, std::string& out) {
+    out.push_back('$');
+    out.append(std::to_string(s.size()));
+    out.append("\r\n");
+    out.append(s);
+    out.append("\r\n");
+}
+
+bool append_csv_field(const std::string& s, std::string& out) {
+    if (s.find_first_of("\r\n") != std::string::npos) {
+        return false;
+    }
+    if (s.find_first_of(",\"") == std::string::npos) {
+        out.append(s);
+        return true;
+    }
+    out.push_back('"');
+    for (char c : s) {
+        if (c == '"') {
+            out.push_back('"');
+        }
+        out.push_back(c);
+    }
+    out.push_back('"');
+    return true;
+}
+
+void append_u32(size_t n, std::string& out) {
+    for (int shift = 0; shift < 32; shift += 8) {
+        out.push_back(static_cast<char>((n >> shift) & 0xff));
+    }
+}
+
+} // namespace
+
+const char BulkLoader::kBinaryMagic[9] = "MAKOBLK1";
+const size_t BulkLoader::kMaxThreads;
+
+bool BulkLoader::read(const std::string& path, const std::string& args, Load& load, std::string& error) {
+    auto start = std::chrono::steady_clock::now();
+
+    std::vector<std::string> parts = split_args(args);
+    Format format = kResp;
+    bool have_format = false;
+    size_t threads = default_threads();
+    for (size_t i = 0; i < parts.size(); i++) {
+        std::string word = upper(parts[i]);
+        if (word == "THREADS" && i + 1 < parts.size()) {
+            if (!parse_threads(parts[++i], threads, error)) {
+                return false;
+            }
+        } else if (!have_format && parse_format(word, format)) {
+            have_format = true;
+        } else {
+            error = "ERROR: BULKLOAD takes [RESP|CSV|BINARY] [THREADS n]";
+            return false;
+        }
+    }
+    if (!have_format && !format_from_path(path, format)) {
+        error = "ERROR: cannot tell the format of " + path + "; give RESP, CSV or BINARY";
+        return false;
+    }
+
+    MappedFile file;
+    if (!file.open(path, error)) {
+        return false;
+    }
+    const char* begin = file.begin();
+    if (format == kBinary) {
+        if (file.size() < 8 || std::memcmp(begin, kBinaryMagic, 8) != 0) {
+            error = "ERROR: " + path + " is not a BINARY load file";
+            return false;
+        }
+        begin += 8;
+    }
+
+    size_t chunks = std::max<size_t>(1, std::min(threads, static_cast<size_t>(file.end() - begin) / kMinChunkBytes));
+    std::vector<const char*> cuts = cut_chunks(format, begin, file.end(), chunks);
+    chunks = cuts.size() - 1;
+
+    std::vector<Chunk> parsed(chunks);
+    std::vector<std::thread> workers;
+    for (size_t i = 1; i < chunks; i++) {
+        workers.emplace_back(parse_chunk, format, file.begin(), cuts[i], cuts[i + 1], std::ref(parsed), i);
+    }
+    parse_chunk(format, file.begin(), cuts[0], cuts[1], parsed, 0);
+    for (auto& worker : workers) {
+        worker.join();
+    }
+
+    size_t total = 0;
+    for (const Chunk& chunk : parsed) {
+        if (chunk.bad_at != SIZE_MAX) {
+            static const char* const kNames[] = {"RESP", "CSV", "BINARY"};
+            error = std::string("ERROR: malformed ") + kNames[format] + " record at byte " +
+                    std::to_string(chunk.bad_at) + (format == kResp ? " (only SET commands can be loaded)" : "");
+            return false;
+        }
+        total += chunk.rows.size();
+    }
+    merge_chunks(parsed, total, load.rows);
+    load.bytes = file.size();
+    load.threads = chunks;
+    load.parse_us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start)
+                        .count();
+    return true;
+}
+
+BulkLoader::Populate::Populate()
+    : count(0), prefix("key"), size(0), weights{100, 0, 0, 0}, elements(4), ttl_seconds(0), ttl_pct(0),
+      threads(default_threads()) {}
+
+BulkLoader::Populate::Type BulkLoader::Populate::pick(const std::string& key, bool& expires) const {
+    uint64_t h = murmur64a(key.data(), key.size(), 0);
+    expires = ttl_pct > 0 && (h >> 32) % 100 < ttl_pct;
+    uint64_t total = 0;
+    for (unsigned w : weights) {
+        total += w;
+    }
+    uint64_t at = (h & 0xffffffff) % total;
+    for (int type = kString; type < kTypes; type++) {
+        if (at < weights[type]) {
+            return static_cast<Type>(type);
+        }
+        at -= weights[type];
+    }
+    return kString;
+}
+
+bool BulkLoader::parse_populate(const std::string& count, const std::string& args, Populate& spec,
+                                std::string& error) {
+    unsigned long long n;
+    if (!parse_count(count, n)) {
+        error = "ERROR: count must be a non-negative integer";
+        return false;
+    }
+    spec.count = n;
+    std::vector<std::string> parts = split_args(args);
+    size_t i = 0;
+    if (i < parts.size() && !parts[i].empty()) {
+        spec.prefix = parts[i];
+    }
+    i++;
+    if (i < parts.size() && parse_count(parts[i], n)) {
+        spec.size = static_cast<size_t>(n);
+        i++;
+    }
+    static const char* const kTypeNames[] = {"STRING", "HASH", "LIST", "SET"};
+    bool weighted = false;
+    for (; i < parts.size(); i++) {
+        std::string word = upper(parts[i]);
+        size_t left = parts.size() - i - 1;
+        const char* const* type = std::find(kTypeNames, kTypeNames + Populate::kTypes, word);
+        if (type != kTypeNames + Populate::kTypes && left >= 1 && parse_count(parts[i + 1], n) && n <= 1000000) {
+            if (!weighted) {
+                std::fill(spec.weights, spec.weights + Populate::kTypes, 0);
+                weighted = true;
+            }
+            spec.weights[type - kTypeNames] = static_cast<unsigned>(n);
+            i++;
+        } else if (word == "ELEMENTS" && left >= 1 && parse_count(parts[i + 1], n) && n > 0) {
+            spec.elements = static_cast<size_t>(n);
+            i++;
+        } else if (word == "TTL" && left >= 2 && parse_count(parts[i + 1], n) && n > 0 && n <= INT32_MAX) {
+            spec.ttl_seconds = static_cast<int64_t>(n);
+            if (!parse_count(parts[i + 2], n) || n > 100) {
+                error = "ERROR: TTL takes seconds and a percentage of keys (0-100)";
+                return false;
+            }
+            spec.ttl_pct = static_cast<unsigned>(n);
+            i += 2;
+        } else if (word == "THREADS" && left >= 1) {
+            if (!parse_threads(parts[++i], spec.threads, error)) {
+                return false;
+            }
+        } else {
+            error = "ERROR: DEBUG POPULATE takes count [prefix] [size] [STRING|HASH|LIST|SET weight]... "
+                    "[ELEMENTS n] [TTL seconds pct] [THREADS n]";
+            return false;
+        }
+    }
+    if (std::accumulate(spec.weights, spec.weights + Populate::kTypes, 0ULL) == 0) {
+        error = "ERROR: at least one type needs a positive weight";
+        return false;
+    }
+    return true;
+}
+
+void BulkLoader::generate(const Populate& spec, Load& load) {
+    auto start = std::chrono::steady_clock::now();
+    const uint64_t kMinChunkRows = 65536;
+    size_t chunks = static_cast<size_t>(std::max<uint64_t>(1, std::min<uint64_t>(spec.threads, spec.count / kMinChunkRows)));
+    auto first = [&](size_t i) { return spec.count / chunks * i + std::min<uint64_t>(i, spec.count % chunks); };
+
+    // Each thread fills its own slice of the rows, which come out sorted
+    load.rows.resize(spec.count);
+    std::vector<std::thread> workers;
+    for (size_t i = 1; i < chunks; i++) {
+        workers.emplace_back(generate_rows, std::cref(spec), first(i), first(i + 1), std::ref(load.rows));
+    }
+    generate_rows(spec, first(0), first(1), load.rows);
+    for (auto& worker : workers) {
+        worker.join();
+    }
+
+    load.bytes = 0;
+    for (const auto& row : load.rows) {
+        load.bytes += row.first.size() + row.second.size();
+    }
+    load.threads = chunks;
+    load.parse_us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start)
+                        .count();
+}
+
+std::string BulkLoader::header(Format format) {
+    return format == kBinary ? std::string(kBinaryMagic, 8) : std::string();
+}
+
+bool BulkLoader::encode(Format format, const std::string& key, const std::string& value, std::string& out) {
+    switch (format) {
+    case kResp:
+        out.append("*3\r\n$3\r\nSET\r\n");
+        append_resp_bulk(key, out);
+        append_resp_bulk(value, out);
+        return true;
+    case kCsv: {
+        size_t mark = out.size();
+        if (!append_csv_field(key, out) || (out.push_back(','), !append_csv_field(value, out))) {
+            out.resize(mark);
+            return false;
+        }
+        out.push_back('\n');
+        return true;
+    }
+    default:
+        if (key.size() > UINT32_MAX || value.size() > UINT32_MAX) {
+            return false;
+        }
+        append_u32(key.size(), out);
+        append_u32(value.size(), out);
+        out.append(key);
+        out.append(value);
+        return true;
+    }
+}
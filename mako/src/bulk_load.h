@@ -0,0 +1,81 @@
+#ifndef _BULK_LOAD_H_
+#define _BULK_LOAD_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Parallel parsing of a local file of key/value pairs for BULKLOAD, and
+// generation of synthetic ones for DEBUG POPULATE.
+//
+// Formats:
+//   RESP    SET commands as sent by redis-cli --pipe: *3\r\n$3\r\nSET\r\n$<n>\r\n<key>\r\n$<n>\r\n<value>\r\n
+//   CSV     one key,value record per line; a field may be "quoted" with "" for a quote,
+//           so it can hold commas, but a record never spans lines
+//   BINARY  the 8 byte magic kBinaryMagic, then per record a little-endian
+//           uint32 key length, uint32 value length, the key and the value
+//
+// The file is mapped and cut into one chunk per thread on record boundaries.
+// Each thread parses its chunk and sorts the rows by key, and the sorted runs
+// are merged into one, so the engine can add them to its ordered keyspace in
+// one pass, appending at a known position instead of searching the tree for
+// every key. Nothing here touches the engine: read() runs without the engine
+// lock.
+class BulkLoader {
+public:
+    enum Format { kResp, kCsv, kBinary };
+
+    static const char kBinaryMagic[9];
+    static const size_t kMaxThreads = 64;
+
+    typedef std::vector<std::pair<std::string, std::string>> Run;
+
+    struct Load {
+        Run rows;   // sorted by key; equal keys keep their file order
+        size_t bytes;
+        size_t threads;
+        int64_t parse_us;
+
+        Load() : bytes(0), threads(0), parse_us(0) {}
+    };
+
+    // args is "[RESP|CSV|BINARY][,THREADS,n]"; without a format it is taken
+    // from the extension (.resp/.aof, .csv, .bin). False with error set.
+    static bool read(const std::string& path, const std::string& args, Load& load, std::string& error);
+
+    // DEBUG POPULATE: keys prefix:0 .. prefix:count-1, each a string, hash,
+    // list or set picked by a hash of the key in proportion to the weights,
+    // and ttl_pct percent of them (also by hash) expiring after ttl_seconds
+    struct Populate {
+        enum Type { kString, kHash, kList, kSet, kTypes };
+
+        uint64_t count;
+        std::string prefix;
+        size_t size;                // value:i padded with 'x' or cut to size bytes; 0 leaves it
+        unsigned weights[kTypes];
+        size_t elements;            // fields, items or members per hash, list or set
+        int64_t ttl_seconds;
+        unsigned ttl_pct;
+        size_t threads;
+
+        Populate();
+        Type pick(const std::string& key, bool& expires) const;
+    };
+
+    // count, and args "[prefix[,size]][,STRING|HASH|LIST|SET,weight]...
+    // [,ELEMENTS,n][,TTL,seconds,pct][,THREADS,n]"; false with error set
+    static bool parse_populate(const std::string& count, const std::string& args, Populate& spec,
+                               std::string& error);
+    // Builds the rows (key, value) on spec.threads threads, sorted like read()'s
+    static void generate(const Populate& spec, Load& load);
+
+    // For tools that write load files: the bytes a file starts with, and one
+    // row appended in the given format (false if CSV cannot hold the row, or
+    // a BINARY length does not fit in 32 bits)
+    static std::string header(Format format);
+    static bool encode(Format format, const std::string& key, const std::string& value, std::string& out);
+};
+
+#endif
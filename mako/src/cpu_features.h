@@ -0,0 +1,40 @@
+#ifndef _CPU_FEATURES_H_
+#define _CPU_FEATURES_H_
+
+#include <cstdlib>
+
+// Runtime CPU feature checks used to pick SIMD kernels. The engine is built
+// without -march flags; SIMD kernels are compiled per function with
+// __attribute__((target(...))) and only called when these return true.
+// Setting MAKO_DISABLE_SIMD=1 in the environment forces the scalar kernels.
+
+inline bool simd_disabled_by_env() {
+    const char* v = std::getenv("MAKO_DISABLE_SIMD");
+    return v != nullptr && v[0] != '\0' && v[0] != '0';
+}
+
+inline bool cpu_has_popcnt() {
+#if defined(__x86_64__) || defined(__i386__)
+    return !simd_disabled_by_env() && __builtin_cpu_supports("popcnt");
+#else
+    return false;
+#endif
+}
+
+inline bool cpu_has_avx2() {
+#if defined(__x86_64__) || defined(__i386__)
+    return !simd_disabled_by_env() && __builtin_cpu_supports("avx2");
+#else
+    return false;
+#endif
+}
+
+inline bool cpu_has_fma() {
+#if defined(__x86_64__) || defined(__i386__)
+    return !simd_disabled_by_env() && __builtin_cpu_supports("fma");
+#else
+    return false;
+#endif
+}
+
+#endif
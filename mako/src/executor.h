@@ -0,0 +1,33 @@
+#ifndef _EXECUTOR_H_
+#define _EXECUTOR_H_
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed pool of background threads running submitted tasks in FIFO order.
+// The destructor runs whatever is still queued, then joins the threads.
+class Executor {
+public:
+    explicit Executor(size_t threads);
+    ~Executor();
+
+    void submit(std::function<void()> task);
+    size_t pending() const;
+    size_t threads() const { return threads_.size(); }
+
+private:
+    void run();
+
+    mutable std::mutex mutex_;
+    std::condition_variable ready_;
+    std::deque<std::function<void()>> tasks_;
+    bool stopping_;
+    std::vector<std::thread> threads_;
+};
+
+#endif
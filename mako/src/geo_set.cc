@@ -0,0 +1,333 @@
+#include "geo_set.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+const double kPi = 3.14159265358979323846;
+
+double rad(double deg) { return deg * kPi / 180.0; }
+double deg(double rad) { return rad * 180.0 / kPi; }
+
+// Spreads the low 32 bits of v to the even bit positions
+uint64_t spread(uint64_t v) {
+    v &= 0xFFFFFFFFULL;
+    v = (v | (v << 16)) & 0x0000FFFF0000FFFFULL;
+    v = (v | (v << 8)) & 0x00FF00FF00FF00FFULL;
+    v = (v | (v << 4)) & 0x0F0F0F0F0F0F0F0FULL;
+    v = (v | (v << 2)) & 0x3333333333333333ULL;
+    v = (v | (v << 1)) & 0x5555555555555555ULL;
+    return v;
+}
+
+uint64_t squash(uint64_t v) {
+    v &= 0x5555555555555555ULL;
+    v = (v | (v >> 1)) & 0x3333333333333333ULL;
+    v = (v | (v >> 2)) & 0x0F0F0F0F0F0F0F0FULL;
+    v = (v | (v >> 4)) & 0x00FF00FF00FF00FFULL;
+    v = (v | (v >> 8)) & 0x0000FFFF0000FFFFULL;
+    v = (v | (v >> 16)) & 0x00000000FFFFFFFFULL;
+    return v;
+}
+
+// Latitude in the even bits, longitude in the odd bits
+uint64_t interleave(uint64_t lat_cell, uint64_t lon_cell) { return spread(lat_cell) | (spread(lon_cell) << 1); }
+
+uint64_t cell(double v, double min, double span, int step) {
+    uint64_t cells = 1ULL << step;
+    double offset = (v - min) / span * static_cast<double>(cells);
+    if (offset < 0) return 0;
+    if (offset >= static_cast<double>(cells)) return cells - 1;
+    return static_cast<uint64_t>(offset);
+}
+
+} // namespace
+
+bool GeoSet::valid(Point p) {
+    return p.lon >= -180 && p.lon <= 180 && p.lat >= -kLatMax && p.lat <= kLatMax;
+}
+
+uint64_t GeoSet::encode(Point p) {
+    return interleave(cell(p.lat, -kLatMax, 2 * kLatMax, kStepBits), cell(p.lon, -180, 360, kStepBits));
+}
+
+GeoSet::Point GeoSet::decode(uint64_t hash) {
+    // Center of the cell
+    double cells = static_cast<double>(1ULL << kStepBits);
+    double lat = -kLatMax + (static_cast<double>(squash(hash)) + 0.5) * (2 * kLatMax) / cells;
+    double lon = -180 + (static_cast<double>(squash(hash >> 1)) + 0.5) * 360 / cells;
+    return {lon, lat};
+}
+
+double GeoSet::distance(Point a, Point b) {
+    double lat1 = rad(a.lat), lat2 = rad(b.lat);
+    double u = std::sin((lat2 - lat1) / 2);
+    double v = std::sin(rad(b.lon - a.lon) / 2);
+    double h = u * u + std::cos(lat1) * std::cos(lat2) * v * v;
+    return 2.0 * kEarthRadiusM * std::asin(std::sqrt(std::min(1.0, h)));
+}
+
+size_t GeoSet::memory_bytes() const {
+    size_t bytes = leaves_.size() * (4 * sizeof(void*) + sizeof(Entry) + sizeof(std::vector<Entry>));
+    for (const auto& leaf : leaves_) {
+        bytes += leaf.second.capacity() * sizeof(Entry);
+    }
+    for (const auto& m : members_) {
+        bytes += sizeof(m) + (m.capacity() > 15 ? m.capacity() : 0);
+    }
+    bytes += hashes_.capacity() * sizeof(uint64_t) + free_labels_.capacity() * sizeof(uint32_t);
+    // Hash node: next pointer, key copy and label, plus the bucket array
+    bytes += labels_.size() * (sizeof(void*) + sizeof(std::string) + sizeof(uint64_t));
+    return bytes + labels_.bucket_count() * sizeof(void*);
+}
+
+void GeoSet::insert(Entry e) {
+    auto it = leaves_.upper_bound(e);
+    if (it == leaves_.begin()) {
+        if (it == leaves_.end() || it->second.size() >= kLeafEntries) {
+            leaves_.emplace(e, std::vector<Entry>{e});
+            return;
+        }
+        // Smaller than everything: the first leaf takes it under a new key
+        auto node = leaves_.extract(it);
+        node.key() = e;
+        node.mapped().insert(node.mapped().begin(), e);
+        leaves_.insert(std::move(node));
+        return;
+    }
+    --it;
+    std::vector<Entry>& leaf = it->second;
+    leaf.insert(std::upper_bound(leaf.begin(), leaf.end(), e), e);
+    if (leaf.size() > kLeafEntries) {
+        size_t half = leaf.size() / 2;
+        std::vector<Entry> upper(leaf.begin() + half, leaf.end());
+        leaf.resize(half);
+        leaves_.emplace(upper.front(), std::move(upper));
+    }
+}
+
+void GeoSet::erase(Entry e) {
+    auto it = leaves_.upper_bound(e);
+    if (it == leaves_.begin()) {
+        return;
+    }
+    --it;
+    std::vector<Entry>& leaf = it->second;
+    auto pos = std::lower_bound(leaf.begin(), leaf.end(), e);
+    if (pos != leaf.end() && *pos == e) {
+        leaf.erase(pos);
+        if (leaf.empty()) {
+            leaves_.erase(it);
+        }
+    }
+}
+
+bool GeoSet::add(const std::string& member, Point p) {
+    if (!valid(p)) {
+        return false;
+    }
+    uint64_t hash = encode(p);
+    auto it = labels_.find(member);
+    if (it != labels_.end()) {
+        uint32_t label = it->second;
+        if (hashes_[label] != hash) {
+            erase({hashes_[label], label});
+            insert({hash, label});
+            hashes_[label] = hash;
+        }
+        return false;
+    }
+    uint32_t label;
+    if (!free_labels_.empty()) {
+        label = free_labels_.back();
+        free_labels_.pop_back();
+        members_[label] = member;
+        hashes_[label] = hash;
+    } else {
+        label = static_cast<uint32_t>(members_.size());
+        members_.push_back(member);
+        hashes_.push_back(hash);
+    }
+    labels_.emplace(member, label);
+    insert({hash, label});
+    return true;
+}
+
+bool GeoSet::remove(const std::string& member) {
+    auto it = labels_.find(member);
+    if (it == labels_.end()) {
+        return false;
+    }
+    uint32_t label = it->second;
+    erase({hashes_[label], label});
+    members_[label].clear();
+    members_[label].shrink_to_fit();
+    free_labels_.push_back(label);
+    labels_.erase(it);
+    return true;
+}
+
+bool GeoSet::position(const std::string& member, Point& out) const {
+    auto it = labels_.find(member);
+    if (it == labels_.end()) {
+        return false;
+    }
+    out = decode(hashes_[it->second]);
+    return true;
+}
+
+GeoSet::Bounds GeoSet::bounds(const Query& q) {
+    double half_lat_m = q.by_radius ? q.radius_m : q.height_m / 2;
+    double half_lon_m = q.by_radius ? q.radius_m : q.width_m / 2;
+
+    Bounds b;
+    double dlat = deg(half_lat_m / kEarthRadiusM);
+    b.lat_min = std::max(-kLatMax, q.center.lat - dlat);
+    b.lat_max = std::min(kLatMax, q.center.lat + dlat);
+    // Scaling the distance by the cosine of the latitude underestimates the
+    // span near the poles, so use the spherical extents: a circle reaches
+    // asin(sin r / cos lat) either side of its center, or every longitude once
+    // it covers a pole; a box edge is a great-circle offset at the point's
+    // latitude, widest at the box edge farthest from the equator.
+    double dlon = 360;
+    if (q.by_radius) {
+        double r = half_lon_m / kEarthRadiusM;
+        double s = std::sin(r) / std::cos(rad(q.center.lat));
+        if (rad(std::fabs(q.center.lat)) + r < kPi / 2 && s < 1) {
+            dlon = deg(std::asin(s));
+        }
+    } else {
+        double half = half_lon_m / (2 * kEarthRadiusM);
+        double s = std::sin(half) / std::cos(rad(std::max(std::fabs(b.lat_min), std::fabs(b.lat_max))));
+        if (half < kPi / 2 && s < 1) {
+            dlon = 2 * deg(std::asin(s));
+        }
+    }
+
+    if (dlon >= 180) {
+        b.lons.emplace_back(-180, 180);
+    } else if (q.center.lon - dlon < -180) {
+        b.lons.emplace_back(q.center.lon - dlon + 360, 180);
+        b.lons.emplace_back(-180, q.center.lon + dlon);
+    } else if (q.center.lon + dlon > 180) {
+        b.lons.emplace_back(q.center.lon - dlon, 180);
+        b.lons.emplace_back(-180, q.center.lon + dlon - 360);
+    } else {
+        b.lons.emplace_back(q.center.lon - dlon, q.center.lon + dlon);
+    }
+    return b;
+}
+
+bool GeoSet::Bounds::contains(Point p) const {
+    if (p.lat < lat_min || p.lat > lat_max) {
+        return false;
+    }
+    for (const auto& l : lons) {
+        if (p.lon >= l.first && p.lon <= l.second) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void GeoSet::cover(const Query& q, std::vector<std::pair<uint64_t, uint64_t>>& ranges) {
+    Bounds b = bounds(q);
+    double lat_min = b.lat_min, lat_max = b.lat_max;
+    const auto& lons = b.lons;
+
+    // Finest precision whose cells cover the box with at most kMaxCells of them
+    int step = kStepBits;
+    for (; step > 1; step--) {
+        uint64_t ys = cell(lat_max, -kLatMax, 2 * kLatMax, step) - cell(lat_min, -kLatMax, 2 * kLatMax, step) + 1;
+        uint64_t xs = 0;
+        for (const auto& l : lons) {
+            xs += cell(l.second, -180, 360, step) - cell(l.first, -180, 360, step) + 1;
+        }
+        if (xs * ys <= kMaxCells) {
+            break;
+        }
+    }
+
+    ranges.clear();
+    int shift = 2 * (kStepBits - step);
+    uint64_t y0 = cell(lat_min, -kLatMax, 2 * kLatMax, step), y1 = cell(lat_max, -kLatMax, 2 * kLatMax, step);
+    for (const auto& l : lons) {
+        uint64_t x0 = cell(l.first, -180, 360, step), x1 = cell(l.second, -180, 360, step);
+        for (uint64_t y = y0; y <= y1; y++) {
+            for (uint64_t x = x0; x <= x1; x++) {
+                uint64_t code = interleave(y, x);
+                ranges.emplace_back(code << shift, (code + 1) << shift);
+            }
+        }
+    }
+    std::sort(ranges.begin(), ranges.end());
+    size_t merged = 0;
+    for (size_t i = 1; i < ranges.size(); i++) {
+        if (ranges[i].first <= ranges[merged].second) {
+            ranges[merged].second = std::max(ranges[merged].second, ranges[i].second);
+        } else {
+            ranges[++merged] = ranges[i];
+        }
+    }
+    ranges.resize(ranges.empty() ? 0 : merged + 1);
+}
+
+size_t GeoSet::search(const Query& q, std::vector<Match>& out) const {
+    std::vector<std::pair<uint64_t, uint64_t>> ranges;
+    cover(q, ranges);
+    Bounds box = bounds(q);
+
+    auto visit = [&](const Entry& e) {
+        Point p = decode(e.first);
+        // Cells overhang the bounding box; skip those points before the trigonometry
+        if (!box.contains(p)) {
+            return;
+        }
+        double d = distance(q.center, p);
+        if (q.by_radius) {
+            if (d > q.radius_m) {
+                return;
+            }
+        } else {
+            // North-south offset along the meridian, east-west offset at the point's latitude
+            double lat_m = kEarthRadiusM * rad(std::fabs(p.lat - q.center.lat));
+            double lon_m = distance({q.center.lon, p.lat}, p);
+            if (lat_m > q.height_m / 2 || lon_m > q.width_m / 2) {
+                return;
+            }
+        }
+        out.push_back({members_[e.second], d, p});
+    };
+
+    size_t examined = 0;
+    for (const auto& r : ranges) {
+        Entry lo(r.first, 0);
+        auto leaf = leaves_.upper_bound(lo);
+        if (leaf != leaves_.begin()) {
+            --leaf;
+        }
+        bool done = false;
+        for (; leaf != leaves_.end() && !done; ++leaf) {
+            const std::vector<Entry>& entries = leaf->second;
+            for (auto e = std::lower_bound(entries.begin(), entries.end(), lo); e != entries.end(); ++e) {
+                if (e->first >= r.second) {
+                    done = true;
+                    break;
+                }
+                examined++;
+                visit(*e);
+            }
+        }
+    }
+
+    auto closer = [&](const Match& a, const Match& b) {
+        return q.descending ? a.distance_m > b.distance_m : a.distance_m < b.distance_m;
+    };
+    if (q.count && q.count < out.size()) {
+        std::partial_sort(out.begin(), out.begin() + q.count, out.end(), closer);
+        out.resize(q.count);
+    } else {
+        std::sort(out.begin(), out.end(), closer);
+    }
+    return examined;
+}
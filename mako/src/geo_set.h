@@ -0,0 +1,96 @@
+#ifndef _GEO_SET_H_
+#define _GEO_SET_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Set of named points kept in 52-bit geohash order.
+//
+// Longitude and latitude are quantized to 26 bits each and interleaved, so
+// every geohash cell at precision s (2s bits) is one contiguous hash range.
+// A radius or box search covers its bounding box with the smallest cells
+// that still need at most kMaxCells of them, merges cells whose ranges touch,
+// and walks only those ranges before the exact distance filter.
+//
+// The ordered structure is a map of sorted leaves of up to kLeafEntries
+// (hash, label) pairs, so a range walk reads contiguous memory instead of
+// chasing one tree node per point. Points are stored as their geohash, like
+// Redis (about 0.6m error).
+class GeoSet {
+public:
+    static const int kStepBits = 26;
+    static const size_t kMaxCells = 9;
+    static const size_t kLeafEntries = 128;
+    static constexpr double kLatMax = 85.05112878;
+    static constexpr double kEarthRadiusM = 6372797.560856;
+
+    struct Point {
+        double lon;
+        double lat;
+    };
+
+    struct Query {
+        Point center;
+        bool by_radius = true;
+        double radius_m = 0;
+        double width_m = 0;    // BYBOX
+        double height_m = 0;
+        size_t count = 0;      // 0 = all
+        bool descending = false;
+    };
+
+    struct Match {
+        std::string member;
+        double distance_m;
+        Point point;
+    };
+
+    size_t size() const { return labels_.size(); }
+    size_t memory_bytes() const;
+
+    // Returns true if the member is new; false for out-of-range coordinates too
+    bool add(const std::string& member, Point p);
+    bool remove(const std::string& member);
+    bool position(const std::string& member, Point& out) const;
+
+    // Matches sorted by distance; returns the number of candidates examined
+    size_t search(const Query& q, std::vector<Match>& out) const;
+
+    static bool valid(Point p);
+    static uint64_t encode(Point p);
+    static Point decode(uint64_t hash);
+    static double distance(Point a, Point b);
+
+    // Hash ranges [first, second) a search of q would scan
+    static void cover(const Query& q, std::vector<std::pair<uint64_t, uint64_t>>& ranges);
+
+private:
+    // Bounding box of q: latitude range and one or two longitude ranges (split at the antimeridian)
+    struct Bounds {
+        double lat_min, lat_max;
+        std::vector<std::pair<double, double>> lons;
+        bool contains(Point p) const;
+    };
+    static Bounds bounds(const Query& q);
+
+    // (hash, label); leaves are keyed by their smallest entry at creation,
+    // which stays a lower bound for everything in the leaf
+    typedef std::pair<uint64_t, uint32_t> Entry;
+    typedef std::map<Entry, std::vector<Entry>> Leaves;
+
+    void insert(Entry e);
+    void erase(Entry e);
+
+    Leaves leaves_;
+    std::vector<std::string> members_;      // by label
+    std::vector<uint64_t> hashes_;          // by label
+    std::vector<uint32_t> free_labels_;
+    std::unordered_map<std::string, uint32_t> labels_;
+};
+
+#endif
@@ -0,0 +1,46 @@
+#ifndef _HASH_H_
+#define _HASH_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+// MurmurHash64A (Austin Appleby). HyperLogLog uses Redis' seed so register
+// placement matches Redis; the Bloom filter reuses it for block/bit selection
+// and the hot key sketch for its counter columns.
+inline uint64_t murmur64a(const void* key, size_t len, uint64_t seed) {
+    const uint64_t m = 0xc6a4a7935bd1e995ULL;
+    const int r = 47;
+    uint64_t h = seed ^ (len * m);
+    const uint8_t* data = static_cast<const uint8_t*>(key);
+    const uint8_t* end = data + (len - (len & 7));
+
+    while (data != end) {
+        uint64_t k;
+        std::memcpy(&k, data, sizeof(k));
+        k *= m;
+        k ^= k >> r;
+        k *= m;
+        h ^= k;
+        h *= m;
+        data += 8;
+    }
+
+    switch (len & 7) {
+    case 7: h ^= uint64_t(data[6]) << 48; // fall through
+    case 6: h ^= uint64_t(data[5]) << 40; // fall through
+    case 5: h ^= uint64_t(data[4]) << 32; // fall through
+    case 4: h ^= uint64_t(data[3]) << 24; // fall through
+    case 3: h ^= uint64_t(data[2]) << 16; // fall through
+    case 2: h ^= uint64_t(data[1]) << 8;  // fall through
+    case 1: h ^= uint64_t(data[0]);
+            h *= m;
+    }
+
+    h ^= h >> r;
+    h *= m;
+    h ^= h >> r;
+    return h;
+}
+
+#endif
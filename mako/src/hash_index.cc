@@ -0,0 +1,124 @@
+#include "hash_index.h"
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cmath>
+#include <cstdlib>
+
+namespace {
+
+bool parse_number(const std::string& s, double& out) {
+    if (s.empty() || std::isspace(static_cast<unsigned char>(s[0]))) {
+        return false;
+    }
+    char* end = nullptr;
+    errno = 0;
+    out = std::strtod(s.c_str(), &end);
+    return errno == 0 && *end == '\0' && !std::isnan(out);
+}
+
+} // namespace
+
+bool HashIndex::parse_kind(const std::string& name, Kind& out) {
+    std::string upper = name;
+    std::transform(upper.begin(), upper.end(), upper.begin(), ::toupper);
+    if (upper == "NUMERIC") out = Kind::Numeric;
+    else if (upper == "TAG") out = Kind::Tag;
+    else return false;
+    return true;
+}
+
+void HashIndex::remove(const std::string& key) {
+    if (kind_ == Kind::Numeric) {
+        auto it = numeric_keys_.find(key);
+        if (it != numeric_keys_.end()) {
+            numeric_.erase({it->second, key});
+            numeric_keys_.erase(it);
+        }
+        return;
+    }
+    auto it = tag_keys_.find(key);
+    if (it != tag_keys_.end()) {
+        auto tag_it = tags_.find(it->second);
+        tag_it->second.erase(key);
+        if (tag_it->second.empty()) {
+            tags_.erase(tag_it);
+        }
+        tag_keys_.erase(it);
+    }
+}
+
+void HashIndex::update(const std::string& key, const std::string* value) {
+    if (kind_ == Kind::Numeric) {
+        double v;
+        if (!value || !parse_number(*value, v)) {
+            remove(key);
+            return;
+        }
+        auto it = numeric_keys_.find(key);
+        if (it != numeric_keys_.end()) {
+            if (it->second == v) {
+                return;
+            }
+            numeric_.erase({it->second, key});
+            it->second = v;
+        } else {
+            numeric_keys_.emplace(key, v);
+        }
+        numeric_.emplace(v, key);
+        return;
+    }
+
+    if (!value) {
+        remove(key);
+        return;
+    }
+    auto it = tag_keys_.find(key);
+    if (it != tag_keys_.end()) {
+        if (it->second == *value) {
+            return;
+        }
+        remove(key);
+    }
+    tag_keys_.emplace(key, *value);
+    tags_[*value].insert(key);
+}
+
+void HashIndex::clear() {
+    numeric_.clear();
+    numeric_keys_.clear();
+    tags_.clear();
+    tag_keys_.clear();
+}
+
+void HashIndex::range(double min, bool min_exclusive, double max, bool max_exclusive, size_t limit,
+                      std::vector<std::string>& out) const {
+    // (value, "") sorts before every key with that value
+    auto it = numeric_.lower_bound({min, std::string()});
+    for (; it != numeric_.end(); ++it) {
+        double v = it->first;
+        if (v > max || (max_exclusive && v == max)) {
+            break;
+        }
+        if (min_exclusive && v == min) {
+            continue;
+        }
+        out.push_back(it->second);
+        if (limit && out.size() >= limit) {
+            break;
+        }
+    }
+}
+
+void HashIndex::match(const std::string& tag, size_t limit, std::vector<std::string>& out) const {
+    auto it = tags_.find(tag);
+    if (it == tags_.end()) {
+        return;
+    }
+    for (const auto& key : it->second) {
+        out.push_back(key);
+        if (limit && out.size() >= limit) {
+            break;
+        }
+    }
+}
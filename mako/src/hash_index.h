@@ -0,0 +1,61 @@
+#ifndef _HASH_INDEX_H_
+#define _HASH_INDEX_H_
+
+#include <cstddef>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+// Secondary index over one field of every hash whose key starts with a prefix.
+//
+// NUMERIC indexes keep (value, key) pairs in an ordered set, so a range query
+// is a seek plus an in-order walk. TAG indexes map each exact field value to
+// the keys holding it. Both also remember the value indexed for every key so
+// an update or delete removes the stale entry without scanning. KVStore calls
+// update() from every hash mutation; the index never looks at the keyspace.
+class HashIndex {
+public:
+    enum class Kind { Numeric, Tag };
+
+    HashIndex(const std::string& prefix, const std::string& field, Kind kind)
+        : prefix_(prefix), field_(field), kind_(kind) {}
+
+    const std::string& prefix() const { return prefix_; }
+    const std::string& field() const { return field_; }
+    Kind kind() const { return kind_; }
+    size_t size() const { return kind_ == Kind::Numeric ? numeric_keys_.size() : tag_keys_.size(); }
+
+    bool covers(const std::string& key) const { return key.compare(0, prefix_.size(), prefix_) == 0; }
+
+    // New value of the indexed field for key; nullptr when the field or key is gone.
+    // Values that are not numbers are left out of a NUMERIC index.
+    void update(const std::string& key, const std::string* value);
+    void clear();
+
+    // Keys with min <= value <= max (bounds exclusive when the flag is set),
+    // in value order, at most limit of them (0 = unlimited)
+    void range(double min, bool min_exclusive, double max, bool max_exclusive, size_t limit,
+               std::vector<std::string>& out) const;
+    // Keys whose field equals tag exactly
+    void match(const std::string& tag, size_t limit, std::vector<std::string>& out) const;
+
+    static bool parse_kind(const std::string& name, Kind& out);
+
+private:
+    void remove(const std::string& key);
+
+    std::string prefix_;
+    std::string field_;
+    Kind kind_;
+
+    std::set<std::pair<double, std::string>> numeric_;
+    std::unordered_map<std::string, double> numeric_keys_;
+
+    std::unordered_map<std::string, std::unordered_set<std::string>> tags_;
+    std::unordered_map<std::string, std::string> tag_keys_;
+};
+
+#endif
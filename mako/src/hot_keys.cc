@@ -0,0 +1,154 @@
+#include "hot_keys.h"
+#include "hash.h"
+#include <algorithm>
+#include <unordered_map>
+
+namespace {
+
+uint64_t xorshift(uint64_t& s) {
+    s ^= s << 13;
+    s ^= s >> 7;
+    s ^= s << 17;
+    return s;
+}
+
+inline size_t column(uint64_t hash, size_t row) {
+    uint32_t h1 = static_cast<uint32_t>(hash);
+    uint32_t h2 = static_cast<uint32_t>(hash >> 32);
+    return (h1 + row * h2) & (HotKeys::kWidth - 1);
+}
+
+} // namespace
+
+HotKeys::HotKeys(uint32_t sample_every) : sample_every_(sample_every) {}
+
+HotKeys::~HotKeys() {}
+
+uint32_t HotKeys::Tracker::estimate(uint64_t hash) const {
+    uint32_t est = UINT32_MAX;
+    for (size_t r = 0; r < kDepth; r++) {
+        est = std::min(est, counters[r * kWidth + column(hash, r)]);
+    }
+    return est;
+}
+
+HotKeys::Tracker* HotKeys::local() {
+    return trackers_.get(registry_mutex_, [this](Tracker& t) {
+        Tracker* self = &t;
+        t.rng = murmur64a(&self, sizeof(self), trackers_.id()) | 1;
+        t.counters.assign(kDepth * kWidth, 0);
+        t.slots.reserve(kTopK);
+    });
+}
+
+void HotKeys::record(const std::string& key) {
+    uint32_t every = sample_every_.load(std::memory_order_relaxed);
+    if (every == 0) {
+        return;
+    }
+    Tracker* t = local();
+    if (--t->skip > 0) {
+        return;
+    }
+    // Uniform skip in [1, 2 * every - 1]: one sample per `every` accesses on average
+    t->skip = every == 1 ? 1 : 1 + static_cast<int64_t>(xorshift(t->rng) % (2 * every - 1));
+    sample(*t, key);
+}
+
+void HotKeys::sample(Tracker& t, const std::string& key) {
+    uint64_t hash = murmur64a(key.data(), key.size(), 0x9747b28c);
+    std::lock_guard<std::mutex> lock(t.mutex);
+
+    // Conservative update: raise only the counters that are at the minimum
+    uint32_t est = t.estimate(hash);
+    uint32_t next = est == UINT32_MAX ? est : est + 1;
+    for (size_t r = 0; r < kDepth; r++) {
+        uint32_t& c = t.counters[r * kWidth + column(hash, r)];
+        c = std::max(c, next);
+    }
+
+    size_t min_slot = 0;
+    for (size_t i = 0; i < t.slots.size(); i++) {
+        Slot& s = t.slots[i];
+        if (s.hash == hash && s.key == key) {
+            s.count = next;
+            return;
+        }
+        if (s.count < t.slots[min_slot].count) {
+            min_slot = i;
+        }
+    }
+    if (t.slots.size() < kTopK) {
+        t.slots.push_back({hash, key, next});
+    } else if (next > t.slots[min_slot].count) {
+        t.slots[min_slot] = {hash, key, next};
+    }
+}
+
+void HotKeys::top(size_t n, std::vector<Entry>& out) const {
+    std::lock_guard<std::mutex> lock(registry_mutex_);
+    std::unordered_map<std::string, uint64_t> candidates;
+    for (const auto& t : trackers_.all()) {
+        std::lock_guard<std::mutex> tlock(t->mutex);
+        for (const auto& s : t->slots) {
+            candidates.emplace(s.key, s.hash);
+        }
+    }
+    uint64_t scale = sample_every();
+    out.clear();
+    for (const auto& c : candidates) {
+        uint64_t total = 0;
+        for (const auto& t : trackers_.all()) {
+            std::lock_guard<std::mutex> tlock(t->mutex);
+            total += t->estimate(c.second);
+        }
+        out.push_back({c.first, total * scale});
+    }
+    std::sort(out.begin(), out.end(), [](const Entry& a, const Entry& b) {
+        return a.count != b.count ? a.count > b.count : a.key < b.key;
+    });
+    if (out.size() > n) {
+        out.resize(n);
+    }
+}
+
+uint64_t HotKeys::estimate(const std::string& key) const {
+    uint64_t hash = murmur64a(key.data(), key.size(), 0x9747b28c);
+    std::lock_guard<std::mutex> lock(registry_mutex_);
+    uint64_t total = 0;
+    for (const auto& t : trackers_.all()) {
+        std::lock_guard<std::mutex> tlock(t->mutex);
+        total += t->estimate(hash);
+    }
+    return total * sample_every();
+}
+
+void HotKeys::decay() {
+    std::lock_guard<std::mutex> lock(registry_mutex_);
+    for (auto& t : trackers_.all()) {
+        std::lock_guard<std::mutex> tlock(t->mutex);
+        for (auto& c : t->counters) {
+            c >>= 1;
+        }
+        for (auto& s : t->slots) {
+            s.count >>= 1;
+        }
+        t->slots.erase(std::remove_if(t->slots.begin(), t->slots.end(), [](const Slot& s) { return s.count == 0; }),
+                       t->slots.end());
+    }
+}
+
+void HotKeys::reset() {
+    std::lock_guard<std::mutex> lock(registry_mutex_);
+    for (auto& t : trackers_.all()) {
+        std::lock_guard<std::mutex> tlock(t->mutex);
+        std::fill(t->counters.begin(), t->counters.end(), 0);
+        t->slots.clear();
+    }
+}
+
+void HotKeys::set_sample_every(uint32_t n) {
+    if (sample_every_.exchange(n) != n) {
+        reset();
+    }
+}
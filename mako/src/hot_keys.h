@@ -0,0 +1,78 @@
+#ifndef _HOT_KEYS_H_
+#define _HOT_KEYS_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "per_thread.h"
+
+// Heavy-hitter tracking for the GET/SET path.
+//
+// Every worker thread records into its own tracker: a count-min sketch
+// (kDepth rows of kWidth counters, conservative update) plus the kTopK keys
+// with the highest estimates it has seen. Only about one access in
+// sample_every is recorded, picked with a random geometric skip so periodic
+// access patterns cannot alias with the sampler; the unsampled path is one
+// thread-local decrement. top() merges the workers' candidates and sums their
+// sketch estimates. decay() halves every counter so old heat fades.
+class HotKeys {
+public:
+    static const size_t kDepth = 4;
+    static const size_t kWidth = 4096;   // power of two
+    static const size_t kTopK = 32;
+    static const uint32_t kDefaultSampleEvery = 16;
+
+    struct Entry {
+        std::string key;
+        uint64_t count;   // estimated accesses, scaled back up by the sample rate
+    };
+
+    explicit HotKeys(uint32_t sample_every = kDefaultSampleEvery);
+    ~HotKeys();
+
+    // Thread-safe; cheap unless this access is sampled
+    void record(const std::string& key);
+
+    // Hottest n keys across all workers, hottest first
+    void top(size_t n, std::vector<Entry>& out) const;
+    // Estimated accesses of one key across all workers
+    uint64_t estimate(const std::string& key) const;
+
+    void decay();
+    void reset();
+
+    // 0 turns tracking off; changing the rate resets the counts
+    void set_sample_every(uint32_t n);
+    uint32_t sample_every() const { return sample_every_.load(std::memory_order_relaxed); }
+
+private:
+    struct Slot {
+        uint64_t hash;
+        std::string key;
+        uint32_t count;
+    };
+
+    struct alignas(64) Tracker {
+        int64_t skip = 0;       // accesses left before the next sample; owner thread only
+        uint64_t rng;
+        std::mutex mutex;       // guards the counts against top()/decay() from other threads
+        std::vector<uint32_t> counters;
+        std::vector<Slot> slots;
+
+        uint32_t estimate(uint64_t hash) const;
+    };
+
+    Tracker* local();
+    void sample(Tracker& t, const std::string& key);
+
+    std::atomic<uint32_t> sample_every_;
+    mutable std::mutex registry_mutex_;
+    PerThread<Tracker> trackers_;
+};
+
+#endif
@@ -0,0 +1,222 @@
+#include "hyperloglog.h"
+#include "cpu_features.h"
+#include "hash.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define MAKO_X86 1
+#endif
+
+namespace {
+
+// Helpers of Ertl's improved raw estimator ("New cardinality estimation
+// algorithms for HyperLogLog sketches"), as used by Redis
+double hll_sigma(double x) {
+    if (x == 1.0) return INFINITY;
+    double y = 1.0;
+    double z = x;
+    double z_prev;
+    do {
+        x *= x;
+        z_prev = z;
+        z += x * y;
+        y += y;
+    } while (z_prev != z);
+    return z;
+}
+
+double hll_tau(double x) {
+    if (x == 0.0 || x == 1.0) return 0.0;
+    double y = 1.0;
+    double z = 1.0 - x;
+    double z_prev;
+    do {
+        x = std::sqrt(x);
+        z_prev = z;
+        y *= 0.5;
+        z -= std::pow(1.0 - x, 2) * y;
+    } while (z_prev != z);
+    return z / 3.0;
+}
+
+void max_registers_scalar(uint8_t* registers, const uint8_t* other) {
+    for (size_t i = 0; i < HyperLogLog::kRegisters; i++) {
+        registers[i] = std::max(registers[i], other[i]);
+    }
+}
+
+#ifdef MAKO_X86
+__attribute__((target("avx2")))
+void max_registers_avx2(uint8_t* registers, const uint8_t* other) {
+    for (size_t i = 0; i < HyperLogLog::kRegisters; i += 32) {
+        __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(registers + i));
+        __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(other + i));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(registers + i), _mm256_max_epu8(a, b));
+    }
+}
+#endif
+
+} // namespace
+
+HyperLogLog::HyperLogLog() : cached_count_(0), cache_valid_(true) {
+}
+
+uint64_t HyperLogLog::hash(const std::string& element) {
+    // Same seed as Redis so register placement matches
+    return murmur64a(element.data(), element.size(), 0xadc83b19ULL);
+}
+
+size_t HyperLogLog::memory_bytes() const {
+    return is_sparse() ? sparse_.capacity() * sizeof(uint32_t) : dense_.size();
+}
+
+uint8_t HyperLogLog::dense_get(size_t index) const {
+    size_t byte = index * 6 / 8;
+    unsigned fb = (index * 6) & 7;
+    unsigned fb8 = 8 - fb;
+    unsigned b0 = dense_[byte];
+    unsigned b1 = dense_[byte + 1];
+    return static_cast<uint8_t>(((b0 >> fb) | (b1 << fb8)) & 63);
+}
+
+void HyperLogLog::dense_set(size_t index, uint8_t value) {
+    size_t byte = index * 6 / 8;
+    unsigned fb = (index * 6) & 7;
+    unsigned fb8 = 8 - fb;
+    unsigned v = value;
+    dense_[byte] &= static_cast<uint8_t>(~(63u << fb));
+    dense_[byte] |= static_cast<uint8_t>(v << fb);
+    dense_[byte + 1] &= static_cast<uint8_t>(~(63u >> fb8));
+    dense_[byte + 1] |= static_cast<uint8_t>(v >> fb8);
+}
+
+void HyperLogLog::promote_to_dense() {
+    dense_.assign(kDenseBytes + 1, 0);
+    for (uint32_t entry : sparse_) {
+        dense_set(entry >> 8, static_cast<uint8_t>(entry & 0xff));
+    }
+    std::vector<uint32_t>().swap(sparse_);
+}
+
+bool HyperLogLog::set_register(size_t index, uint8_t rank) {
+    if (!is_sparse()) {
+        if (dense_get(index) >= rank) {
+            return false;
+        }
+        dense_set(index, rank);
+        return true;
+    }
+
+    uint32_t key = static_cast<uint32_t>(index) << 8;
+    auto it = std::lower_bound(sparse_.begin(), sparse_.end(), key);
+    if (it != sparse_.end() && (*it >> 8) == index) {
+        if ((*it & 0xff) >= rank) {
+            return false;
+        }
+        *it = key | rank;
+        return true;
+    }
+    sparse_.insert(it, key | rank);
+    if (sparse_.size() * sizeof(uint32_t) > kSparseMaxBytes) {
+        promote_to_dense();
+    }
+    return true;
+}
+
+bool HyperLogLog::add(const std::string& element) {
+    uint64_t h = hash(element);
+    size_t index = h & (kRegisters - 1);
+    // Rank = position of the first 1 bit in the remaining hash bits; the
+    // sentinel bit caps it at kMaxRank
+    h >>= kPrecision;
+    h |= uint64_t(1) << (64 - kPrecision);
+    uint8_t rank = static_cast<uint8_t>(__builtin_ctzll(h) + 1);
+
+    if (!set_register(index, rank)) {
+        return false;
+    }
+    cache_valid_ = false;
+    return true;
+}
+
+uint64_t HyperLogLog::estimate_from_histogram(const int* histogram) {
+    const double m = static_cast<double>(kRegisters);
+    const int q = 64 - kPrecision;
+    double z = m * hll_tau((m - histogram[q + 1]) / m);
+    for (int j = q; j >= 1; --j) {
+        z += histogram[j];
+        z *= 0.5;
+    }
+    z += m * hll_sigma(histogram[0] / m);
+    const double alpha_inf = 0.721347520444481703680;
+    return static_cast<uint64_t>(std::llround(alpha_inf * m * m / z));
+}
+
+uint64_t HyperLogLog::count() const {
+    if (cache_valid_) {
+        return cached_count_;
+    }
+    int histogram[kMaxRank + 2] = {0};
+    if (is_sparse()) {
+        histogram[0] = static_cast<int>(kRegisters - sparse_.size());
+        for (uint32_t entry : sparse_) {
+            histogram[entry & 0xff]++;
+        }
+    } else {
+        for (size_t i = 0; i < kRegisters; i++) {
+            histogram[dense_get(i)]++;
+        }
+    }
+    cached_count_ = estimate_from_histogram(histogram);
+    cache_valid_ = true;
+    return cached_count_;
+}
+
+uint64_t HyperLogLog::estimate(const uint8_t* registers) {
+    int histogram[kMaxRank + 2] = {0};
+    for (size_t i = 0; i < kRegisters; i++) {
+        histogram[registers[i]]++;
+    }
+    return estimate_from_histogram(histogram);
+}
+
+void HyperLogLog::max_registers(uint8_t* registers, const uint8_t* other) {
+#ifdef MAKO_X86
+    static const bool use_avx2 = cpu_has_avx2();
+    if (use_avx2) {
+        max_registers_avx2(registers, other);
+        return;
+    }
+#endif
+    max_registers_scalar(registers, other);
+}
+
+void HyperLogLog::merge_into(uint8_t* registers) const {
+    if (is_sparse()) {
+        for (uint32_t entry : sparse_) {
+            uint8_t& r = registers[entry >> 8];
+            r = std::max(r, static_cast<uint8_t>(entry & 0xff));
+        }
+        return;
+    }
+    // Unpack the 6-bit registers, then fold them in with a vectorized max
+    uint8_t unpacked[kRegisters];
+    for (size_t i = 0; i < kRegisters; i++) {
+        unpacked[i] = dense_get(i);
+    }
+    max_registers(registers, unpacked);
+}
+
+void HyperLogLog::assign_registers(const uint8_t* registers) {
+    std::vector<uint32_t>().swap(sparse_);
+    dense_.assign(kDenseBytes + 1, 0);
+    for (size_t i = 0; i < kRegisters; i++) {
+        if (registers[i]) {
+            dense_set(i, registers[i]);
+        }
+    }
+    cache_valid_ = false;
+}
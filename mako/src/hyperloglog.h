@@ -0,0 +1,63 @@
+#ifndef _HYPERLOGLOG_H_
+#define _HYPERLOGLOG_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// HyperLogLog cardinality estimator with 2^14 registers (0.81% standard error).
+//
+// Small sets use a sparse encoding: a sorted vector of (register, value)
+// pairs packed in 32 bits. Once that passes kSparseMaxBytes the sketch is
+// converted to the dense encoding, 16384 6-bit registers packed into 12KB as
+// in Redis. The estimate is cached and invalidated whenever a register grows.
+class HyperLogLog {
+public:
+    static const int kPrecision = 14;
+    static const size_t kRegisters = size_t(1) << kPrecision;
+    static const int kMaxRank = 64 - kPrecision + 1;
+    static const size_t kDenseBytes = kRegisters * 6 / 8;
+    static const size_t kSparseMaxBytes = 3000;
+
+    HyperLogLog();
+
+    // Returns true if a register changed (the estimate may have moved)
+    bool add(const std::string& element);
+
+    uint64_t count() const;
+
+    bool is_sparse() const { return dense_.empty(); }
+    size_t memory_bytes() const;
+
+    // Folds this sketch into an unpacked byte-per-register array with max()
+    void merge_into(uint8_t* registers) const;
+
+    // Replaces this sketch with the given unpacked registers (dense encoding)
+    void assign_registers(const uint8_t* registers);
+
+    // Estimate from an unpacked byte-per-register array
+    static uint64_t estimate(const uint8_t* registers);
+
+    // registers[i] = max(registers[i], other[i]) for kRegisters entries (SIMD when available)
+    static void max_registers(uint8_t* registers, const uint8_t* other);
+
+private:
+    static uint64_t hash(const std::string& element);
+    static uint64_t estimate_from_histogram(const int* histogram);
+
+    uint8_t dense_get(size_t index) const;
+    void dense_set(size_t index, uint8_t value);
+    void promote_to_dense();
+    bool set_register(size_t index, uint8_t rank);
+
+    // Sparse entries: (register index << 8) | rank, sorted by index
+    std::vector<uint32_t> sparse_;
+    // Dense registers, 6 bits each (+1 guard byte); empty while sparse
+    std::vector<uint8_t> dense_;
+
+    mutable uint64_t cached_count_;
+    mutable bool cache_valid_;
+};
+
+#endif
@@ -0,0 +1,786 @@
+#include "json_doc.h"
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <utility>
+
+namespace {
+
+const size_t kMaxDepth = 128;
+const size_t kContainerHeader = 9;   // tag, count, size
+
+// Parse tree for incoming text; encoded once and then dropped
+struct Value {
+    JsonDoc::Tag tag = JsonDoc::Null;
+    int64_t i = 0;
+    double d = 0;
+    std::string s;
+    std::vector<Value> items;
+    std::vector<std::pair<std::string, Value>> members;
+};
+
+class Parser {
+public:
+    explicit Parser(const std::string& text) : p_(text.data()), end_(text.data() + text.size()) {}
+
+    bool parse(Value& out, std::string& error) {
+        skip_ws();
+        if (!value(out, 0)) {
+            error = error_;
+            return false;
+        }
+        skip_ws();
+        if (p_ != end_) {
+            error = "trailing characters";
+            return false;
+        }
+        return true;
+    }
+
+private:
+    bool fail(const char* msg) {
+        error_ = msg;
+        return false;
+    }
+
+    void skip_ws() {
+        while (p_ < end_ && (*p_ == ' ' || *p_ == '\t' || *p_ == '\n' || *p_ == '\r')) {
+            ++p_;
+        }
+    }
+
+    bool literal(const char* word) {
+        size_t n = std::strlen(word);
+        if (static_cast<size_t>(end_ - p_) < n || std::memcmp(p_, word, n) != 0) {
+            return fail("invalid literal");
+        }
+        p_ += n;
+        return true;
+    }
+
+    bool value(Value& out, size_t depth) {
+        if (depth > kMaxDepth) {
+            return fail("nesting too deep");
+        }
+        if (p_ == end_) {
+            return fail("unexpected end of input");
+        }
+        switch (*p_) {
+            case 'n': out.tag = JsonDoc::Null; return literal("null");
+            case 't': out.tag = JsonDoc::True; return literal("true");
+            case 'f': out.tag = JsonDoc::False; return literal("false");
+            case '"': out.tag = JsonDoc::String; return string(out.s);
+            case '[': return array(out, depth);
+            case '{': return object(out, depth);
+            default: return number(out);
+        }
+    }
+
+    bool array(Value& out, size_t depth) {
+        out.tag = JsonDoc::Array;
+        ++p_;
+        skip_ws();
+        if (p_ < end_ && *p_ == ']') {
+            ++p_;
+            return true;
+        }
+        while (true) {
+            out.items.emplace_back();
+            skip_ws();
+            if (!value(out.items.back(), depth + 1)) {
+                return false;
+            }
+            skip_ws();
+            if (p_ < end_ && *p_ == ',') {
+                ++p_;
+            } else if (p_ < end_ && *p_ == ']') {
+                ++p_;
+                return true;
+            } else {
+                return fail("expected ',' or ']'");
+            }
+        }
+    }
+
+    bool object(Value& out, size_t depth) {
+        out.tag = JsonDoc::Object;
+        ++p_;
+        skip_ws();
+        if (p_ < end_ && *p_ == '}') {
+            ++p_;
+            return true;
+        }
+        while (true) {
+            skip_ws();
+            if (p_ == end_ || *p_ != '"') {
+                return fail("expected object key");
+            }
+            std::string key;
+            if (!string(key)) {
+                return false;
+            }
+            skip_ws();
+            if (p_ == end_ || *p_ != ':') {
+                return fail("expected ':'");
+            }
+            ++p_;
+            skip_ws();
+            out.members.emplace_back(std::move(key), Value());
+            if (!value(out.members.back().second, depth + 1)) {
+                return false;
+            }
+            skip_ws();
+            if (p_ < end_ && *p_ == ',') {
+                ++p_;
+            } else if (p_ < end_ && *p_ == '}') {
+                ++p_;
+                return true;
+            } else {
+                return fail("expected ',' or '}'");
+            }
+        }
+    }
+
+    bool hex4(uint32_t& out) {
+        if (end_ - p_ < 4) {
+            return fail("bad \\u escape");
+        }
+        out = 0;
+        for (int i = 0; i < 4; i++) {
+            char c = *p_++;
+            out <<= 4;
+            if (c >= '0' && c <= '9') out |= c - '0';
+            else if (c >= 'a' && c <= 'f') out |= c - 'a' + 10;
+            else if (c >= 'A' && c <= 'F') out |= c - 'A' + 10;
+            else return fail("bad \\u escape");
+        }
+        return true;
+    }
+
+    static void utf8(uint32_t cp, std::string& out) {
+        if (cp < 0x80) {
+            out += static_cast<char>(cp);
+        } else if (cp < 0x800) {
+            out += static_cast<char>(0xC0 | (cp >> 6));
+            out += static_cast<char>(0x80 | (cp & 0x3F));
+        } else if (cp < 0x10000) {
+            out += static_cast<char>(0xE0 | (cp >> 12));
+            out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+            out += static_cast<char>(0x80 | (cp & 0x3F));
+        } else {
+            out += static_cast<char>(0xF0 | (cp >> 18));
+            out += static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
+            out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+            out += static_cast<char>(0x80 | (cp & 0x3F));
+        }
+    }
+
+    bool string(std::string& out) {
+        ++p_;
+        while (p_ < end_) {
+            char c = *p_++;
+            if (c == '"') {
+                return true;
+            }
+            if (static_cast<unsigned char>(c) < 0x20) {
+                return fail("control character in string");
+            }
+            if (c != '\\') {
+                out += c;
+                continue;
+            }
+            if (p_ == end_) {
+                break;
+            }
+            switch (*p_++) {
+                case '"': out += '"'; break;
+                case '\\': out += '\\'; break;
+                case '/': out += '/'; break;
+                case 'b': out += '\b'; break;
+                case 'f': out += '\f'; break;
+                case 'n': out += '\n'; break;
+                case 'r': out += '\r'; break;
+                case 't': out += '\t'; break;
+                case 'u': {
+                    uint32_t cp;
+                    if (!hex4(cp)) {
+                        return false;
+                    }
+                    if (cp >= 0xD800 && cp < 0xDC00) {
+                        uint32_t low;
+                        if (end_ - p_ < 2 || p_[0] != '\\' || p_[1] != 'u') {
+                            return fail("unpaired surrogate");
+                        }
+                        p_ += 2;
+                        if (!hex4(low) || low < 0xDC00 || low > 0xDFFF) {
+                            return fail("unpaired surrogate");
+                        }
+                        cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+                    } else if (cp >= 0xDC00 && cp <= 0xDFFF) {
+                        return fail("unpaired surrogate");
+                    }
+                    utf8(cp, out);
+                    break;
+                }
+                default:
+                    return fail("bad escape");
+            }
+        }
+        return fail("unterminated string");
+    }
+
+    bool number(Value& out) {
+        const char* start = p_;
+        bool integral = true;
+        if (p_ < end_ && *p_ == '-') ++p_;
+        if (p_ == end_ || !(*p_ >= '0' && *p_ <= '9')) {
+            return fail("invalid value");
+        }
+        if (*p_ == '0') {
+            ++p_;
+        } else {
+            while (p_ < end_ && *p_ >= '0' && *p_ <= '9') ++p_;
+        }
+        if (p_ < end_ && *p_ == '.') {
+            integral = false;
+            ++p_;
+            if (p_ == end_ || !(*p_ >= '0' && *p_ <= '9')) {
+                return fail("invalid number");
+            }
+            while (p_ < end_ && *p_ >= '0' && *p_ <= '9') ++p_;
+        }
+        if (p_ < end_ && (*p_ == 'e' || *p_ == 'E')) {
+            integral = false;
+            ++p_;
+            if (p_ < end_ && (*p_ == '+' || *p_ == '-')) ++p_;
+            if (p_ == end_ || !(*p_ >= '0' && *p_ <= '9')) {
+                return fail("invalid number");
+            }
+            while (p_ < end_ && *p_ >= '0' && *p_ <= '9') ++p_;
+        }
+        std::string text(start, p_);
+        if (integral) {
+            errno = 0;
+            long long v = std::strtoll(text.c_str(), nullptr, 10);
+            if (errno == 0) {
+                out.tag = JsonDoc::Int;
+                out.i = v;
+                return true;
+            }
+        }
+        out.tag = JsonDoc::Double;
+        out.d = std::strtod(text.c_str(), nullptr);
+        if (!std::isfinite(out.d)) {
+            return fail("number out of range");
+        }
+        return true;
+    }
+
+    const char* p_;
+    const char* end_;
+    std::string error_;
+};
+
+void put_u32(std::string& out, uint32_t v) {
+    out.append(reinterpret_cast<const char*>(&v), sizeof(v));
+}
+
+void put_u64(std::string& out, uint64_t v) {
+    out.append(reinterpret_cast<const char*>(&v), sizeof(v));
+}
+
+void set_u32(std::string& buf, size_t off, uint32_t v) {
+    std::memcpy(&buf[off], &v, sizeof(v));
+}
+
+// Builds a container node from already encoded children
+std::string assemble_array(const std::vector<std::string>& items) {
+    size_t header = kContainerHeader + 4 * items.size();
+    std::string out;
+    out += static_cast<char>(JsonDoc::Array);
+    put_u32(out, static_cast<uint32_t>(items.size()));
+    put_u32(out, 0);
+    size_t off = header;
+    for (const auto& item : items) {
+        put_u32(out, static_cast<uint32_t>(off));
+        off += item.size();
+    }
+    for (const auto& item : items) {
+        out += item;
+    }
+    set_u32(out, 5, static_cast<uint32_t>(out.size()));
+    return out;
+}
+
+// Entries must be sorted by key without duplicates
+std::string assemble_object(const std::vector<std::pair<std::string, std::string>>& entries) {
+    size_t header = kContainerHeader + 8 * entries.size();
+    std::string out;
+    out += static_cast<char>(JsonDoc::Object);
+    put_u32(out, static_cast<uint32_t>(entries.size()));
+    put_u32(out, 0);
+    size_t off = header;
+    for (const auto& e : entries) {
+        put_u32(out, static_cast<uint32_t>(off));
+        put_u32(out, static_cast<uint32_t>(off + 4 + e.first.size()));
+        off += 4 + e.first.size() + e.second.size();
+    }
+    for (const auto& e : entries) {
+        put_u32(out, static_cast<uint32_t>(e.first.size()));
+        out += e.first;
+        out += e.second;
+    }
+    set_u32(out, 5, static_cast<uint32_t>(out.size()));
+    return out;
+}
+
+void encode(const Value& v, std::string& out) {
+    out += static_cast<char>(v.tag);
+    switch (v.tag) {
+        case JsonDoc::Int:
+            put_u64(out, static_cast<uint64_t>(v.i));
+            break;
+        case JsonDoc::Double: {
+            uint64_t bits;
+            std::memcpy(&bits, &v.d, sizeof(bits));
+            put_u64(out, bits);
+            break;
+        }
+        case JsonDoc::String:
+            put_u32(out, static_cast<uint32_t>(v.s.size()));
+            out += v.s;
+            break;
+        case JsonDoc::Array: {
+            out.pop_back();
+            std::vector<std::string> items(v.items.size());
+            for (size_t i = 0; i < v.items.size(); i++) {
+                encode(v.items[i], items[i]);
+            }
+            out += assemble_array(items);
+            break;
+        }
+        case JsonDoc::Object: {
+            out.pop_back();
+            // Sort by key; for duplicate keys the last one wins
+            std::vector<size_t> order(v.members.size());
+            for (size_t i = 0; i < order.size(); i++) order[i] = i;
+            std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+                return v.members[a].first < v.members[b].first;
+            });
+            std::vector<std::pair<std::string, std::string>> entries;
+            for (size_t i = 0; i < order.size(); i++) {
+                const auto& m = v.members[order[i]];
+                if (i + 1 < order.size() && v.members[order[i + 1]].first == m.first) {
+                    continue;
+                }
+                entries.emplace_back(m.first, std::string());
+                encode(m.second, entries.back().second);
+            }
+            out += assemble_object(entries);
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+bool encode_text(const std::string& text, std::string& out, std::string& error) {
+    Value root;
+    if (!Parser(text).parse(root, error)) {
+        return false;
+    }
+    out.clear();
+    encode(root, out);
+    if (out.size() > std::numeric_limits<uint32_t>::max()) {
+        error = "document too large";
+        return false;
+    }
+    return true;
+}
+
+void format_number(double v, std::string& out) {
+    char buf[32];
+    snprintf(buf, sizeof(buf), "%.15g", v);
+    if (std::strtod(buf, nullptr) != v) {
+        snprintf(buf, sizeof(buf), "%.17g", v);
+    }
+    out += buf;
+}
+
+void print_string(const char* s, size_t len, std::string& out) {
+    out += '"';
+    for (size_t i = 0; i < len; i++) {
+        unsigned char c = static_cast<unsigned char>(s[i]);
+        switch (c) {
+            case '"': out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\n': out += "\\n"; break;
+            case '\r': out += "\\r"; break;
+            case '\t': out += "\\t"; break;
+            case '\b': out += "\\b"; break;
+            case '\f': out += "\\f"; break;
+            default:
+                if (c < 0x20) {
+                    char esc[8];
+                    snprintf(esc, sizeof(esc), "\\u%04x", c);
+                    out += esc;
+                } else {
+                    out += static_cast<char>(c);
+                }
+        }
+    }
+    out += '"';
+}
+
+} // namespace
+
+uint32_t JsonDoc::read_u32(size_t off) const {
+    uint32_t v;
+    std::memcpy(&v, buf_.data() + off, sizeof(v));
+    return v;
+}
+
+void JsonDoc::write_u32(size_t off, uint32_t v) {
+    std::memcpy(&buf_[off], &v, sizeof(v));
+}
+
+bool JsonDoc::parse(const std::string& text, std::string& error) {
+    std::string bytes;
+    if (!encode_text(text, bytes, error)) {
+        return false;
+    }
+    buf_.swap(bytes);
+    return true;
+}
+
+size_t JsonDoc::node_size(size_t node) const {
+    switch (static_cast<Tag>(buf_[node])) {
+        case Int:
+        case Double:
+            return 9;
+        case String:
+            return 5 + read_u32(node + 1);
+        case Array:
+        case Object:
+            return read_u32(node + 5);
+        default:
+            return 1;
+    }
+}
+
+bool JsonDoc::parse_path(const std::string& path, std::vector<Step>& steps) {
+    size_t i = 0;
+    if (path.empty() || path == ".") {
+        return true;
+    }
+    if (path[0] == '$') {
+        ++i;
+    } else if (path[0] != '.' && path[0] != '[') {
+        // Legacy form without the leading dot: "a.b"
+        return parse_path("." + path, steps);
+    }
+    while (i < path.size()) {
+        Step step{false, 0, std::string()};
+        if (path[i] == '.') {
+            size_t start = ++i;
+            while (i < path.size() && path[i] != '.' && path[i] != '[') ++i;
+            if (i == start) {
+                return false;
+            }
+            step.key = path.substr(start, i - start);
+        } else if (path[i] == '[') {
+            ++i;
+            if (i < path.size() && (path[i] == '"' || path[i] == '\'')) {
+                char quote = path[i++];
+                size_t close = path.find(quote, i);
+                if (close == std::string::npos || close + 1 >= path.size() || path[close + 1] != ']') {
+                    return false;
+                }
+                step.key = path.substr(i, close - i);
+                i = close + 2;
+            } else {
+                size_t close = path.find(']', i);
+                if (close == std::string::npos || close == i) {
+                    return false;
+                }
+                std::string digits = path.substr(i, close - i);
+                char* end = nullptr;
+                errno = 0;
+                long long idx = std::strtoll(digits.c_str(), &end, 10);
+                if (errno != 0 || *end != '\0') {
+                    return false;
+                }
+                step.is_index = true;
+                step.index = idx;
+                i = close + 1;
+            }
+        } else {
+            return false;
+        }
+        steps.push_back(std::move(step));
+    }
+    return true;
+}
+
+bool JsonDoc::child(size_t node, const Step& step, size_t& out) const {
+    Tag tag = static_cast<Tag>(buf_[node]);
+    uint32_t count = (tag == Array || tag == Object) ? read_u32(node + 1) : 0;
+    if (step.is_index) {
+        if (tag != Array) {
+            return false;
+        }
+        int64_t idx = step.index < 0 ? step.index + count : step.index;
+        if (idx < 0 || idx >= static_cast<int64_t>(count)) {
+            return false;
+        }
+        out = node + read_u32(node + kContainerHeader + 4 * idx);
+        return true;
+    }
+    if (tag != Object) {
+        return false;
+    }
+    // Binary search over the sorted (key, value) offset table
+    size_t lo = 0, hi = count;
+    while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        size_t key = node + read_u32(node + kContainerHeader + 8 * mid);
+        uint32_t len = read_u32(key);
+        int cmp = buf_.compare(key + 4, len, step.key);
+        if (cmp == 0) {
+            out = node + read_u32(node + kContainerHeader + 8 * mid + 4);
+            return true;
+        }
+        if (cmp < 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return false;
+}
+
+bool JsonDoc::resolve(const std::vector<Step>& steps, size_t count, size_t& node,
+                      std::vector<Frame>* frames) const {
+    node = 0;
+    for (size_t i = 0; i < count; i++) {
+        size_t next;
+        if (!child(node, steps[i], next)) {
+            return false;
+        }
+        if (frames) {
+            frames->push_back({node, next});
+        }
+        node = next;
+    }
+    return true;
+}
+
+void JsonDoc::print(size_t node, std::string& out) const {
+    switch (static_cast<Tag>(buf_[node])) {
+        case Null: out += "null"; break;
+        case False: out += "false"; break;
+        case True: out += "true"; break;
+        case Int: {
+            int64_t v;
+            std::memcpy(&v, buf_.data() + node + 1, sizeof(v));
+            out += std::to_string(v);
+            break;
+        }
+        case Double: {
+            double v;
+            std::memcpy(&v, buf_.data() + node + 1, sizeof(v));
+            format_number(v, out);
+            break;
+        }
+        case String:
+            print_string(buf_.data() + node + 5, read_u32(node + 1), out);
+            break;
+        case Array: {
+            uint32_t count = read_u32(node + 1);
+            out += '[';
+            for (uint32_t i = 0; i < count; i++) {
+                if (i) out += ',';
+                print(node + read_u32(node + kContainerHeader + 4 * i), out);
+            }
+            out += ']';
+            break;
+        }
+        case Object: {
+            uint32_t count = read_u32(node + 1);
+            out += '{';
+            for (uint32_t i = 0; i < count; i++) {
+                if (i) out += ',';
+                size_t key = node + read_u32(node + kContainerHeader + 8 * i);
+                print_string(buf_.data() + key + 4, read_u32(key), out);
+                out += ':';
+                print(node + read_u32(node + kContainerHeader + 8 * i + 4), out);
+            }
+            out += '}';
+            break;
+        }
+    }
+}
+
+bool JsonDoc::get(const std::string& path, std::string& out) const {
+    std::vector<Step> steps;
+    size_t node;
+    if (buf_.empty() || !parse_path(path, steps) || !resolve(steps, steps.size(), node, nullptr)) {
+        return false;
+    }
+    print(node, out);
+    return true;
+}
+
+bool JsonDoc::type(const std::string& path, std::string& out) const {
+    std::vector<Step> steps;
+    size_t node;
+    if (buf_.empty() || !parse_path(path, steps) || !resolve(steps, steps.size(), node, nullptr)) {
+        return false;
+    }
+    static const char* const kNames[] = {"null", "boolean", "boolean", "integer", "number", "string", "array", "object"};
+    out = kNames[static_cast<uint8_t>(buf_[node])];
+    return true;
+}
+
+void JsonDoc::splice(const std::vector<Frame>& frames, size_t node, size_t old_size, const std::string& bytes) {
+    int64_t delta = static_cast<int64_t>(bytes.size()) - static_cast<int64_t>(old_size);
+    buf_.replace(node, old_size, bytes);
+    if (delta == 0) {
+        return;
+    }
+    // Ancestors start before node, so their headers did not move. Each one
+    // grows by delta, and entries laid out after the changed child shift.
+    for (auto it = frames.rbegin(); it != frames.rend(); ++it) {
+        size_t parent = it->node;
+        write_u32(parent + 5, static_cast<uint32_t>(read_u32(parent + 5) + delta));
+        uint32_t count = read_u32(parent + 1);
+        size_t slots = buf_[parent] == Object ? 2 * count : count;
+        uint32_t child_off = static_cast<uint32_t>(it->child - parent);
+        for (size_t i = 0; i < slots; i++) {
+            size_t slot = parent + kContainerHeader + 4 * i;
+            uint32_t off = read_u32(slot);
+            if (off > child_off) {
+                write_u32(slot, static_cast<uint32_t>(off + delta));
+            }
+        }
+    }
+}
+
+std::string JsonDoc::object_with(size_t node, const std::string& key, const std::string& value) const {
+    uint32_t count = read_u32(node + 1);
+    std::vector<std::pair<std::string, std::string>> entries;
+    entries.reserve(count + 1);
+    bool placed = false;
+    for (uint32_t i = 0; i < count; i++) {
+        size_t k = node + read_u32(node + kContainerHeader + 8 * i);
+        size_t v = node + read_u32(node + kContainerHeader + 8 * i + 4);
+        std::string name = buf_.substr(k + 4, read_u32(k));
+        if (!placed && key < name) {
+            entries.emplace_back(key, value);
+            placed = true;
+        }
+        // Children are copied as raw bytes; offsets inside them are relative
+        entries.emplace_back(std::move(name), buf_.substr(v, node_size(v)));
+    }
+    if (!placed) {
+        entries.emplace_back(key, value);
+    }
+    return assemble_object(entries);
+}
+
+JsonDoc::SetResult JsonDoc::set(const std::string& path, const std::string& json, std::string& error) {
+    std::vector<Step> steps;
+    if (!parse_path(path, steps)) {
+        return SetResult::BadPath;
+    }
+    std::string bytes;
+    if (!encode_text(json, bytes, error)) {
+        return SetResult::BadJson;
+    }
+    if (steps.empty() || buf_.empty()) {
+        if (!steps.empty()) {
+            return SetResult::NotFound;
+        }
+        buf_.swap(bytes);
+        return SetResult::Spliced;
+    }
+
+    std::vector<Frame> frames;
+    size_t node;
+    if (resolve(steps, steps.size(), node, &frames)) {
+        size_t old_size = node_size(node);
+        if (old_size == bytes.size()) {
+            std::memcpy(&buf_[node], bytes.data(), bytes.size());
+            return SetResult::InPlace;
+        }
+        if (buf_.size() - old_size + bytes.size() > std::numeric_limits<uint32_t>::max()) {
+            error = "document too large";
+            return SetResult::BadJson;
+        }
+        splice(frames, node, old_size, bytes);
+        return SetResult::Spliced;
+    }
+
+    // A missing last member of an existing object is added
+    const Step& last = steps.back();
+    frames.clear();
+    if (last.is_index || !resolve(steps, steps.size() - 1, node, &frames) || buf_[node] != Object) {
+        return SetResult::NotFound;
+    }
+    std::string replaced = object_with(node, last.key, bytes);
+    size_t old_size = node_size(node);
+    if (buf_.size() - old_size + replaced.size() > std::numeric_limits<uint32_t>::max()) {
+        error = "document too large";
+        return SetResult::BadJson;
+    }
+    splice(frames, node, old_size, replaced);
+    return SetResult::Spliced;
+}
+
+JsonDoc::IncrResult JsonDoc::numincrby(const std::string& path, double by, bool by_is_int, int64_t by_int,
+                                       std::string& out) {
+    std::vector<Step> steps;
+    if (!parse_path(path, steps)) {
+        return IncrResult::BadPath;
+    }
+    size_t node;
+    if (buf_.empty() || !resolve(steps, steps.size(), node, nullptr)) {
+        return IncrResult::NotFound;
+    }
+    Tag tag = static_cast<Tag>(buf_[node]);
+    if (tag != Int && tag != Double) {
+        return IncrResult::NotNumber;
+    }
+
+    // Both number encodings are 9 bytes, so the result always fits in place
+    if (tag == Int && by_is_int) {
+        int64_t v, sum;
+        std::memcpy(&v, buf_.data() + node + 1, sizeof(v));
+        if (!__builtin_add_overflow(v, by_int, &sum)) {
+            std::memcpy(&buf_[node + 1], &sum, sizeof(sum));
+            out = std::to_string(sum);
+            return IncrResult::Ok;
+        }
+    }
+    double current;
+    if (tag == Int) {
+        int64_t v;
+        std::memcpy(&v, buf_.data() + node + 1, sizeof(v));
+        current = static_cast<double>(v);
+    } else {
+        std::memcpy(&current, buf_.data() + node + 1, sizeof(current));
+    }
+    double result = current + by;
+    if (!std::isfinite(result)) {
+        return IncrResult::Overflow;
+    }
+    buf_[node] = static_cast<char>(Double);
+    std::memcpy(&buf_[node + 1], &result, sizeof(result));
+    out.clear();
+    format_number(result, out);
+    return IncrResult::Ok;
+}
@@ -0,0 +1,79 @@
+#ifndef _JSON_DOC_H_
+#define _JSON_DOC_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// JSON document held in a compact binary tree encoding.
+//
+// Every node starts with a one byte tag. Scalars follow inline: numbers are
+// always 8 bytes (int64 or double), strings are a 4 byte length plus bytes.
+// Arrays and objects carry their element count, their total encoded size and
+// an offset table relative to the node start (objects: (key, value) offset
+// pairs sorted by key), so a path step is an index lookup or a binary search
+// and a subtree can be moved without touching its insides.
+//
+// Paths ($.a.b[2], $["k"], or the legacy .a.b) are evaluated directly on the
+// encoding. A JSON.SET whose new value encodes to the same size (numbers,
+// booleans, equal length strings) overwrites the bytes in place; otherwise
+// only the changed node is spliced and its ancestors' sizes and offset tables
+// are patched. JSON text is only parsed for new values and printed for reads.
+class JsonDoc {
+public:
+    enum Tag : uint8_t { Null = 0, False = 1, True = 2, Int = 3, Double = 4, String = 5, Array = 6, Object = 7 };
+
+    // Parses JSON text; on failure returns false and sets error
+    bool parse(const std::string& text, std::string& error);
+
+    // Serializes the node at path; false if the path does not resolve
+    bool get(const std::string& path, std::string& out) const;
+
+    enum class SetResult { InPlace, Spliced, NotFound, BadPath, BadJson };
+    // Sets the value at path. The last step may name a new object member;
+    // array indexes must exist. "$" replaces the whole document.
+    SetResult set(const std::string& path, const std::string& json, std::string& error);
+
+    enum class IncrResult { Ok, NotFound, NotNumber, BadPath, Overflow };
+    // Adds by to the number at path in place; out is the new value as text
+    IncrResult numincrby(const std::string& path, double by, bool by_is_int, int64_t by_int, std::string& out);
+
+    // Type name of the node at path (object, array, string, integer, number, boolean, null)
+    bool type(const std::string& path, std::string& out) const;
+
+    size_t memory_bytes() const { return buf_.capacity(); }
+    const std::string& encoding() const { return buf_; }
+
+private:
+    struct Step {
+        bool is_index;
+        int64_t index;
+        std::string key;
+    };
+    // One resolved ancestor on the way down: node offset and the child taken
+    struct Frame {
+        size_t node;
+        size_t child;   // offset of the chosen child (absolute)
+    };
+
+    static bool parse_path(const std::string& path, std::vector<Step>& steps);
+    // Walks steps from the root; fills frames for every container passed
+    bool resolve(const std::vector<Step>& steps, size_t count, size_t& node, std::vector<Frame>* frames) const;
+    bool child(size_t node, const Step& step, size_t& out) const;
+
+    size_t node_size(size_t node) const;
+    void print(size_t node, std::string& out) const;
+
+    // Replaces [node, node + old_size) with bytes and patches the ancestors in frames
+    void splice(const std::vector<Frame>& frames, size_t node, size_t old_size, const std::string& bytes);
+    // Re-encodes the object at node with key set to the encoded value (raw children are copied)
+    std::string object_with(size_t node, const std::string& key, const std::string& value) const;
+
+    uint32_t read_u32(size_t off) const;
+    void write_u32(size_t off, uint32_t v);
+
+    std::string buf_;
+};
+
+#endif
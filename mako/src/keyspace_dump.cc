@@ -0,0 +1,507 @@
+#include "keyspace_dump.h"
+#include "mapped_file.h"
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cerrno>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+const char KeyspaceDump::kMagic[9] = "MAKODMP1";
+const size_t KeyspaceDump::kMaxThreads;
+const size_t KeyspaceDump::kBufferSize;
+const size_t KeyspaceDump::kMinPartKeys;
+
+namespace {
+
+typedef KeyspaceDump::Item Item;
+
+const size_t kHeaderSize = 16;   // magic, part, parts
+
+size_t default_threads() {
+    return std::min<size_t>(std::max(1u, std::thread::hardware_concurrency()), KeyspaceDump::kMaxThreads);
+}
+
+void put_le(char* out, uint64_t v, size_t bytes) {
+    for (size_t i = 0; i < bytes; i++) {
+        out[i] = static_cast<char>(v >> (8 * i));
+    }
+}
+
+uint64_t get_le(const char* in, size_t bytes) {
+    uint64_t v = 0;
+    for (size_t i = 0; i < bytes; i++) {
+        v |= static_cast<uint64_t>(static_cast<unsigned char>(in[i])) << (8 * i);
+    }
+    return v;
+}
+
+// Reads from a mapped part; every read fails once the part runs out
+class PartReader {
+public:
+    PartReader(const char* p, const char* end) : p_(p), end_(end) {}
+
+    bool done() const { return p_ == end_; }
+
+    bool u8(uint8_t& v) {
+        if (end_ - p_ < 1) {
+            return false;
+        }
+        v = static_cast<uint8_t>(*p_++);
+        return true;
+    }
+    bool u32(uint32_t& v) {
+        if (end_ - p_ < 4) {
+            return false;
+        }
+        v = static_cast<uint32_t>(get_le(p_, 4));
+        p_ += 4;
+        return true;
+    }
+    bool u64(uint64_t& v) {
+        if (end_ - p_ < 8) {
+            return false;
+        }
+        v = get_le(p_, 8);
+        p_ += 8;
+        return true;
+    }
+    bool string(std::string& s) {
+        uint32_t size;
+        if (!u32(size) || static_cast<size_t>(end_ - p_) < size) {
+            return false;
+        }
+        s.assign(p_, size);
+        p_ += size;
+        return true;
+    }
+
+private:
+    const char* p_;
+    const char* end_;
+};
+
+// The part number and part count in the header of a mapped part
+bool read_header(const MappedFile& file, const std::string& path, uint32_t& part, uint32_t& parts,
+                 std::string& error) {
+    if (file.size() < kHeaderSize || std::memcmp(file.begin(), KeyspaceDump::kMagic, 8) != 0) {
+        error = "ERROR: " + path + " is not a dump part";
+        return false;
+    }
+    part = static_cast<uint32_t>(get_le(file.begin() + 8, 4));
+    parts = static_cast<uint32_t>(get_le(file.begin() + 12, 4));
+    return true;
+}
+
+bool parse_part(const std::string& dir, size_t part, size_t parts, std::vector<Item>& items, size_t& bytes,
+                std::string& error) {
+    std::string path = KeyspaceDump::part_path(dir, part);
+    MappedFile file;
+    uint32_t number, count;
+    if (!file.open(path, error) || !read_header(file, path, number, count, error)) {
+        return false;
+    }
+    if (number != part || count != parts) {
+        error = "ERROR: " + path + " belongs to another export";
+        return false;
+    }
+    bytes = file.size();
+
+    PartReader in(file.begin() + kHeaderSize, file.end());
+    for (;;) {
+        uint8_t type;
+        if (!in.u8(type)) {
+            break;
+        }
+        if (type == KeyspaceDump::kEnd) {
+            uint64_t keys;
+            if (!in.u64(keys)) {
+                break;
+            }
+            if (keys != items.size() || !in.done()) {
+                error = "ERROR: " + path + " is corrupt";
+                return false;
+            }
+            return true;
+        }
+        if (type < KeyspaceDump::kString || type > KeyspaceDump::kSet) {
+            error = "ERROR: " + path + " is corrupt";
+            return false;
+        }
+        items.emplace_back();
+        Item& item = items.back();
+        item.type = static_cast<KeyspaceDump::Type>(type);
+        uint64_t expire_ms;
+        if (!in.u64(expire_ms) || !in.string(item.key)) {
+            break;
+        }
+        item.expire_ms = static_cast<int64_t>(expire_ms);
+        if (item.type == KeyspaceDump::kString) {
+            if (!in.string(item.value)) {
+                break;
+            }
+            continue;
+        }
+        uint32_t n;
+        if (!in.u32(n)) {
+            break;
+        }
+        uint64_t strings = item.type == KeyspaceDump::kHash ? 2ull * n : n;
+        item.elements.reserve(std::min<uint64_t>(strings, file.size() / 4));   // each takes at least 4 bytes
+        bool whole = true;
+        for (uint64_t i = 0; i < strings && whole; i++) {
+            item.elements.emplace_back();
+            whole = in.string(item.elements.back());
+        }
+        if (!whole) {
+            break;
+        }
+    }
+    error = "ERROR: " + path + " is cut short";
+    return false;
+}
+
+}  // namespace
+
+bool KeyspaceDump::parse_threads(const std::string& usage, const std::string& args, size_t& threads,
+                                 std::string& error) {
+    threads = default_threads();
+    if (args.empty()) {
+        return true;
+    }
+    size_t comma = args.find(',');
+    std::string word = args.substr(0, comma);
+    std::transform(word.begin(), word.end(), word.begin(), ::toupper);
+    if (word != "THREADS" || comma == std::string::npos) {
+        error = "ERROR: " + usage;
+        return false;
+    }
+    std::string n = args.substr(comma + 1);
+    char* stop = nullptr;
+    errno = 0;
+    unsigned long long v = 0;
+    if (!n.empty() && isdigit(static_cast<unsigned char>(n[0]))) {
+        v = std::strtoull(n.c_str(), &stop, 10);
+    }
+    if (v == 0 || *stop != '\0' || errno == ERANGE) {
+        error = "ERROR: THREADS must be a positive integer";
+        return false;
+    }
+    threads = static_cast<size_t>(std::min<unsigned long long>(v, kMaxThreads));
+    return true;
+}
+
+bool KeyspaceDump::parse_export(const std::string& args, size_t& threads, bool& partial, std::string& error) {
+    partial = false;
+    std::string rest;
+    size_t pos = 0;
+    while (pos <= args.size() && !args.empty()) {
+        size_t comma = std::min(args.find(',', pos), args.size());
+        std::string word = args.substr(pos, comma - pos);
+        std::transform(word.begin(), word.end(), word.begin(), ::toupper);
+        if (word == "PARTIAL") {
+            partial = true;
+        } else {
+            rest += (rest.empty() ? "" : ",") + args.substr(pos, comma - pos);
+        }
+        pos = comma + 1;
+    }
+    return parse_threads("EXPORT takes dir [THREADS n] [PARTIAL]", rest, threads, error);
+}
+
+std::string KeyspaceDump::part_path(const std::string& dir, size_t part) {
+    char name[32];
+    snprintf(name, sizeof(name), "part-%04zu.dump", part);
+    return dir + "/" + name;
+}
+
+void KeyspaceDump::remove_parts(const std::string& dir, size_t from) {
+    for (size_t part = from; unlink(part_path(dir, part).c_str()) == 0; part++) {
+    }
+}
+
+// Writer
+
+KeyspaceDump::Writer::Writer() : fd_(-1), used_(0), keys_(0), bytes_(0) {}
+
+KeyspaceDump::Writer::~Writer() {
+    if (fd_ >= 0) {
+        ::close(fd_);
+        unlink(temp_path_.c_str());
+    }
+}
+
+bool KeyspaceDump::Writer::open(const std::string& dir, size_t part, size_t parts, std::string& error) {
+    if (mkdir(dir.c_str(), 0755) != 0 && errno != EEXIST) {
+        error = "ERROR: cannot create " + dir + ": " + std::strerror(errno);
+        return false;
+    }
+    path_ = part_path(dir, part);
+    temp_path_ = path_ + ".tmp";
+    fd_ = ::open(temp_path_.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd_ < 0) {
+        error = "ERROR: cannot create " + temp_path_ + ": " + std::strerror(errno);
+        return false;
+    }
+    buffer_.resize(kBufferSize);
+    used_ = 0;
+    keys_ = 0;
+    bytes_ = 0;
+    error_.clear();
+
+    char header[kHeaderSize];
+    std::memcpy(header, kMagic, 8);
+    put_le(header + 8, part, 4);
+    put_le(header + 12, parts, 4);
+    put(header, sizeof(header));
+    return true;
+}
+
+void KeyspaceDump::Writer::key(Type type, const std::string& key, int64_t expire_ms) {
+    char head[9];
+    head[0] = static_cast<char>(type);
+    put_le(head + 1, static_cast<uint64_t>(expire_ms), 8);
+    put(head, sizeof(head));
+    string(key.data(), key.size());
+    keys_++;
+}
+
+void KeyspaceDump::Writer::count(size_t n) {
+    put_u32(n);
+}
+
+void KeyspaceDump::Writer::string(const char* data, size_t size) {
+    put_u32(size);
+    put(data, size);
+}
+
+void KeyspaceDump::Writer::string(const std::vector<std::string_view>& pieces) {
+    size_t size = 0;
+    for (const auto& piece : pieces) {
+        size += piece.size();
+    }
+    put_u32(size);
+    for (const auto& piece : pieces) {
+        put(piece.data(), piece.size());
+    }
+}
+
+bool KeyspaceDump::Writer::close(std::string& error) {
+    char tail[9];
+    tail[0] = static_cast<char>(kEnd);
+    put_le(tail + 1, keys_, 8);
+    put(tail, sizeof(tail));
+    flush();
+    if (error_.empty() && fsync(fd_) != 0) {
+        error_ = "ERROR: cannot sync " + temp_path_ + ": " + std::strerror(errno);
+    }
+    ::close(fd_);
+    fd_ = -1;
+    if (error_.empty() && rename(temp_path_.c_str(), path_.c_str()) != 0) {
+        error_ = "ERROR: cannot rename " + temp_path_ + ": " + std::strerror(errno);
+    }
+    if (!error_.empty()) {
+        unlink(temp_path_.c_str());
+        error = error_;
+        return false;
+    }
+    return true;
+}
+
+void KeyspaceDump::Writer::put(const void* data, size_t size) {
+    bytes_ += size;
+    if (!error_.empty()) {
+        return;
+    }
+    const char* p = static_cast<const char*>(data);
+    while (size > 0) {
+        size_t n = std::min(size, buffer_.size() - used_);
+        std::memcpy(buffer_.data() + used_, p, n);
+        used_ += n;
+        p += n;
+        size -= n;
+        if (used_ == buffer_.size()) {
+            flush();
+        }
+    }
+}
+
+void KeyspaceDump::Writer::put_u32(size_t n) {
+    if (n > UINT32_MAX) {
+        if (error_.empty()) {
+            error_ = "ERROR: a value of " + std::to_string(n) + " bytes or elements does not fit in a dump";
+        }
+        n = 0;
+    }
+    char v[4];
+    put_le(v, n, 4);
+    put(v, sizeof(v));
+}
+
+void KeyspaceDump::Writer::flush() {
+    const char* p = buffer_.data();
+    size_t left = error_.empty() ? used_ : 0;
+    while (left > 0) {
+        ssize_t n = ::write(fd_, p, left);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            error_ = "ERROR: cannot write " + temp_path_ + ": " + std::strerror(errno);
+            break;
+        }
+        p += n;
+        left -= static_cast<size_t>(n);
+    }
+    used_ = 0;
+}
+
+// Reading
+
+bool KeyspaceDump::read(const std::string& dir, const std::string& args, Image& image, std::string& error) {
+    auto start = std::chrono::steady_clock::now();
+    size_t threads;
+    if (!parse_threads("IMPORT takes dir [THREADS n]", args, threads, error)) {
+        return false;
+    }
+
+    // Part 0 says how many parts there are
+    std::string first = part_path(dir, 0);
+    if (access(first.c_str(), F_OK) != 0) {
+        error = "ERROR: no export in " + dir;
+        return false;
+    }
+    uint32_t part, parts;
+    {
+        MappedFile file;
+        if (!file.open(first, error) || !read_header(file, first, part, parts, error)) {
+            return false;
+        }
+    }
+    if (part != 0 || parts == 0) {
+        error = "ERROR: " + first + " is corrupt";
+        return false;
+    }
+
+    image.parts.assign(parts, std::vector<Item>());
+    std::vector<size_t> bytes(parts, 0);
+    std::vector<std::string> errors(parts);
+    std::atomic<size_t> next(0);
+    auto work = [&]() {
+        for (size_t i; (i = next.fetch_add(1)) < parts;) {
+            if (!parse_part(dir, i, parts, image.parts[i], bytes[i], errors[i])) {
+                std::vector<Item>().swap(image.parts[i]);
+            }
+        }
+    };
+    threads = std::min<size_t>(threads, parts);
+    std::vector<std::thread> workers;
+    for (size_t i = 1; i < threads; i++) {
+        workers.emplace_back(work);
+    }
+    work();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+
+    for (size_t i = 0; i < parts; i++) {
+        if (!errors[i].empty()) {
+            error = errors[i];
+            image.parts.clear();
+            return false;
+        }
+        image.keys += image.parts[i].size();
+        image.bytes += bytes[i];
+    }
+    image.threads = threads;
+    image.parse_us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start)
+                         .count();
+    return true;
+}
+
+// The child
+
+bool KeyspaceDump::spawn(const std::function<bool(std::string&)>& work, Child& child, std::string& error) {
+    int fds[2];
+    if (pipe2(fds, O_CLOEXEC) != 0) {
+        error = std::string("ERROR: cannot create a pipe: ") + std::strerror(errno);
+        return false;
+    }
+    auto start = std::chrono::steady_clock::now();
+    pid_t pid = fork();
+    if (pid < 0) {
+        error = std::string("ERROR: cannot fork: ") + std::strerror(errno);
+        ::close(fds[0]);
+        ::close(fds[1]);
+        return false;
+    }
+    if (pid == 0) {
+        ::close(fds[0]);
+        std::string reply;
+        bool ok = work(reply);
+        reply.insert(reply.begin(), ok ? '+' : '-');
+        const char* p = reply.data();
+        size_t left = reply.size();
+        while (left > 0) {
+            ssize_t n = ::write(fds[1], p, left);
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n <= 0) {
+                break;
+            }
+            p += n;
+            left -= static_cast<size_t>(n);
+        }
+        _exit(ok ? 0 : 1);
+    }
+    ::close(fds[1]);
+    child.pid = pid;
+    child.report_fd = fds[0];
+    child.fork_us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start)
+                        .count();
+    return true;
+}
+
+bool KeyspaceDump::wait(Child& child, std::string& reply) {
+    reply.clear();
+    char buf[4096];
+    for (;;) {
+        ssize_t n = ::read(child.report_fd, buf, sizeof(buf));
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            break;
+        }
+        reply.append(buf, static_cast<size_t>(n));
+    }
+    ::close(child.report_fd);
+    child.report_fd = -1;
+
+    int status = 0;
+    while (waitpid(child.pid, &status, 0) < 0 && errno == EINTR) {
+    }
+    child.pid = -1;
+    if (reply.empty()) {
+        reply = WIFSIGNALED(status) ? "ERROR: export child killed by signal " + std::to_string(WTERMSIG(status))
+                                    : "ERROR: export child exited without a reply";
+        return false;
+    }
+    bool ok = reply[0] == '+';
+    reply.erase(0, 1);
+    return ok;
+}
+
+int64_t KeyspaceDump::unix_ms(std::chrono::steady_clock::time_point t) {
+    auto at = std::chrono::system_clock::now() + std::chrono::duration_cast<std::chrono::system_clock::duration>(
+                                                     t - std::chrono::steady_clock::now());
+    return std::chrono::duration_cast<std::chrono::milliseconds>(at.time_since_epoch()).count();
+}
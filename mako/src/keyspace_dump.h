@@ -0,0 +1,134 @@
+#ifndef _KEYSPACE_DUMP_H_
+#define _KEYSPACE_DUMP_H_
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <sys/types.h>
+
+// Point-in-time dumps of the keyspace for EXPORT, read back by IMPORT.
+//
+// EXPORT forks. The child has a copy-on-write image of the process as of the
+// fork, so it sees every key as it was at that instant while the parent goes
+// on serving, and only the pages the parent writes meanwhile get copied. The
+// child cuts the ordered keyspace into key ranges, writes each range to its
+// own part file on its own thread through a fixed kBufferSize buffer, reports
+// back on a pipe and exits. Memory is the buffers and the copied pages, not
+// the size of the dump.
+//
+// A part file is the 8 byte magic kMagic, a uint32 part number and a uint32
+// part count, then per key a uint8 type, an int64 expiry (unix ms, 0 for
+// none) and the key, followed by
+//   kString  the value
+//   kHash    a uint32 field count, then each field and its value
+//   kList    a uint32 item count, then each item
+//   kSet     a uint32 member count, then each member
+// where every key, value, field, item and member is a uint32 length and the
+// bytes. A kEnd byte and the uint64 number of keys close the file; a part
+// without it was cut short. Integers are little-endian. Keys of one type are
+// in order within a part, and part i holds smaller keys than part i + 1.
+class KeyspaceDump {
+public:
+    enum Type : uint8_t { kString = 1, kHash = 2, kList = 3, kSet = 4, kEnd = 0xff };
+
+    static const char kMagic[9];
+    static const size_t kMaxThreads = 64;
+    static const size_t kBufferSize = 1 << 20;
+    static const size_t kMinPartKeys = 65536;   // smaller parts are not worth a thread
+
+    // args is "[THREADS,n]"; usage is the error when it is neither
+    static bool parse_threads(const std::string& usage, const std::string& args, size_t& threads,
+                              std::string& error);
+    // EXPORT's args, "[THREADS,n][,PARTIAL]" in any order: PARTIAL lets an
+    // export go ahead without the keys of types it cannot dump
+    static bool parse_export(const std::string& args, size_t& threads, bool& partial, std::string& error);
+    // dir/part-0000.dump and so on
+    static std::string part_path(const std::string& dir, size_t part);
+    // Removes part from and those after it, left in dir by an export with more parts
+    static void remove_parts(const std::string& dir, size_t from);
+
+    // One part file. Written to a temporary name and renamed over the part by
+    // close(), so a failed export leaves the previous one readable. Errors
+    // are kept until close(), which then returns false.
+    class Writer {
+    public:
+        Writer();
+        ~Writer();
+        Writer(const Writer&) = delete;
+        Writer& operator=(const Writer&) = delete;
+
+        bool open(const std::string& dir, size_t part, size_t parts, std::string& error);
+        void key(Type type, const std::string& key, int64_t expire_ms);
+        void count(size_t n);
+        void string(const char* data, size_t size);
+        void string(const std::vector<std::string_view>& pieces);   // a value kept in pieces
+        bool close(std::string& error);
+
+        uint64_t keys() const { return keys_; }
+        uint64_t bytes() const { return bytes_; }
+
+    private:
+        void put(const void* data, size_t size);
+        void put_u32(size_t n);
+        void flush();
+
+        int fd_;
+        std::string path_;
+        std::string temp_path_;
+        std::vector<char> buffer_;
+        size_t used_;
+        uint64_t keys_;
+        uint64_t bytes_;
+        std::string error_;
+    };
+
+    // A key read back from a part
+    struct Item {
+        Type type;
+        int64_t expire_ms;
+        std::string key;
+        std::string value;                   // kString
+        std::vector<std::string> elements;   // fields and values in turn, items or members
+    };
+
+    struct Image {
+        std::vector<std::vector<Item>> parts;
+        size_t keys;
+        size_t bytes;
+        size_t threads;
+        int64_t parse_us;
+
+        Image() : keys(0), bytes(0), threads(0), parse_us(0) {}
+    };
+
+    // Parses every part of the dump in dir on up to THREADS threads; false
+    // with error set if a part is missing, cut short or not a dump part.
+    // Nothing here touches the engine.
+    static bool read(const std::string& dir, const std::string& args, Image& image, std::string& error);
+
+    // A forked child writing an export
+    struct Child {
+        pid_t pid;
+        int report_fd;
+        int64_t fork_us;   // how long the fork held up the caller
+
+        Child() : pid(-1), report_fd(-1), fork_us(0) {}
+    };
+
+    // Forks a child that runs work and sends back the reply it returns
+    // (work returns false with an error reply), then exits without running
+    // destructors. work must not take locks: any lock another thread held at the
+    // fork stays held in the child.
+    static bool spawn(const std::function<bool(std::string&)>& work, Child& child, std::string& error);
+    // Waits for the child; false with reply holding the error if it failed
+    static bool wait(Child& child, std::string& reply);
+
+    // A steady_clock deadline as unix ms, the form expiries are dumped in
+    static int64_t unix_ms(std::chrono::steady_clock::time_point t);
+};
+
+#endif
@@ -1,31 +1,322 @@
 #include "kv_store.h"
+#include "sha1.h"
+#include "bitops.h"
 #include <sstream>
 #include <stdexcept>
+#include <algorithm>
+#include <climits>
+#include <tuple>
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <cerrno>
+#include <thread>
 
-KVStore::KVStore() {
+namespace {
+
+const char* const kStringTooLong = "ERROR: string exceeds maximum allowed size (proto-max-bulk-len)";
+
+// Splits a comma-separated argument list
+std::vector<std::string> split_args(const std::string& value) {
+    std::vector<std::string> args;
+    std::istringstream iss(value);
+    std::string arg;
+    while (std::getline(iss, arg, ',')) {
+        args.push_back(arg);
+    }
+    return args;
+}
+
+std::string format_entries(const std::vector<Stream::Entry>& entries) {
+    std::string out;
+    for (const auto& e : entries) {
+        if (!out.empty()) out += ";";
+        out += e.id.to_string();
+        for (const auto& f : e.fields) {
+            out += "," + f.first + ":" + f.second;
+        }
+    }
+    return out;
+}
+
+// Parses the optional trailing count of xrange/xrevrange/xread
+bool parse_count(const std::vector<std::string>& args, size_t index, size_t& count) {
+    count = 0;
+    if (args.size() <= index) {
+        return true;
+    }
+    try {
+        long long n = std::stoll(args[index]);
+        if (n < 0) {
+            return false;
+        }
+        count = static_cast<size_t>(n);
+        return true;
+    } catch (const std::exception&) {
+        return false;
+    }
+}
+
+// Shortest decimal form that parses back to the same double
+std::string format_double(double v) {
+    char buf[32];
+    snprintf(buf, sizeof(buf), "%.15g", v);
+    if (std::strtod(buf, nullptr) != v) {
+        snprintf(buf, sizeof(buf), "%.17g", v);
+    }
+    return buf;
+}
+
+std::string format_samples(const std::vector<TimeSeries::Sample>& samples) {
+    std::string out;
+    for (const auto& s : samples) {
+        if (!out.empty()) out += ",";
+        out += std::to_string(s.ts) + ":" + format_double(s.value);
+    }
+    return out;
+}
+
+// Parses comma-separated name=value pairs
+bool parse_labels(const std::string& value, std::map<std::string, std::string>& labels) {
+    for (const auto& pair : split_args(value)) {
+        size_t eq = pair.find('=');
+        if (eq == std::string::npos || eq == 0) {
+            return false;
+        }
+        labels[pair.substr(0, eq)] = pair.substr(eq + 1);
+    }
+    return true;
+}
+
+// Parses a TS.RANGE bound: an integer timestamp, or - / + for the ends
+bool parse_ts_bound(const std::string& s, int64_t& out) {
+    if (s == "-") {
+        out = 0;
+        return true;
+    }
+    if (s == "+") {
+        out = INT64_MAX;
+        return true;
+    }
+    try {
+        size_t idx;
+        long long v = std::stoll(s, &idx);
+        if (idx != s.size()) {
+            return false;
+        }
+        out = v;
+        return true;
+    } catch (const std::exception&) {
+        return false;
+    }
+}
+
+// Splits from,to[,aggregation,bucket_ms] for ts.range/ts.mrange
+bool parse_ts_range_args(const std::string& value, std::vector<std::string>& args, int64_t& bucket_ms) {
+    args = split_args(value);
+    bucket_ms = 0;
+    if (args.size() == 2) {
+        args.push_back("");
+        return true;
+    }
+    if (args.size() != 4) {
+        return false;
+    }
+    try {
+        bucket_ms = std::stoll(args[3]);
+    } catch (const std::exception&) {
+        return false;
+    }
+    return bucket_ms > 0;
+}
+
+// Parses args[first..] as floats
+bool parse_floats(const std::vector<std::string>& args, size_t first, size_t count, std::vector<float>& out) {
+    out.clear();
+    try {
+        for (size_t i = first; i < first + count; i++) {
+            size_t idx;
+            out.push_back(std::stof(args[i], &idx));
+            if (idx != args[i].size() || !std::isfinite(out.back())) {
+                return false;
+            }
+        }
+    } catch (const std::exception&) {
+        return false;
+    }
+    return true;
+}
+
+// Meters per unit for geo distances
+bool parse_geo_unit(const std::string& unit, double& meters) {
+    std::string lower = unit;
+    std::transform(lower.begin(), lower.end(), lower.begin(), ::tolower);
+    if (lower == "m") meters = 1;
+    else if (lower == "km") meters = 1000;
+    else if (lower == "mi") meters = 1609.34;
+    else if (lower == "ft") meters = 0.3048;
+    else return false;
+    return true;
+}
+
+bool parse_geo_number(const std::string& s, double& out) {
+    try {
+        size_t idx;
+        out = std::stod(s, &idx);
+        return idx == s.size() && std::isfinite(out);
+    } catch (const std::exception&) {
+        return false;
+    }
+}
+
+// Operations that never modify their key; everything else bumps the key's version
+bool is_read_only(const std::string& operation) {
+    static const std::unordered_set<std::string> kReadOnly = {
+        "get", "llen", "lrange", "hget", "hgetall", "hmget", "hexists", "idx.query", "ping", "exists", "ttl",
+        "keys", "smembers", "sismember", "sinter", "sdiff", "scard", "getrange", "strlen", "getbit", "bitcount",
+        "bitpos", "publish", "pfcount", "bf.exists", "bf.mexists", "xrange", "xrevrange", "xread", "xlen",
+        "ts.get", "ts.range", "ts.mrange", "vec.knn", "vec.card", "json.get", "json.type", "geodist", "geopos",
+        "geosearch", "hotkeys", "counters", "admission", "chunking", "resultcache", "export", "script.exists", "multi", "exec", "discard", "watch", "unwatch"};
+    return kReadOnly.count(operation) != 0;
+}
+
+// Read-only operations that look at their key alone; multi-key reads such as
+// SINTER are left out because only the named key's version is checked
+bool is_single_key_read(const std::string& operation) {
+    static const std::unordered_set<std::string> kReads = {
+        "get", "strlen", "getrange", "getbit", "bitcount", "bitpos", "exists", "ttl", "llen", "lrange", "hget",
+        "hgetall", "hmget", "hexists", "smembers", "sismember", "scard", "bf.exists", "bf.mexists", "xrange",
+        "xrevrange", "xlen", "ts.get", "ts.range", "vec.knn", "vec.card", "json.get", "json.type", "geodist",
+        "geopos", "geosearch"};
+    return kReads.count(operation) != 0;
+}
+
+std::string format_geo(double v) {
+    char buf[32];
+    snprintf(buf, sizeof(buf), "%.4f", v);
+    return buf;
+}
+
+// KEYS glob matching over a list of key names
+KVStore::Result match_keys(const std::string& pattern, const std::vector<std::string>& names) {
+    // Convert Redis pattern to regex
+    std::string regex_pattern = pattern;
+    // Replace * with .*
+    size_t pos = 0;
+    while ((pos = regex_pattern.find('*', pos)) != std::string::npos) {
+        regex_pattern.replace(pos, 1, ".*");
+        pos += 2;
+    }
+    // Replace ? with .
+    pos = 0;
+    while ((pos = regex_pattern.find('?', pos)) != std::string::npos) {
+        regex_pattern.replace(pos, 1, ".");
+        pos += 1;
+    }
+    
+    std::regex pattern_regex(regex_pattern);
+    
+    // Join matching keys with comma
+    std::ostringstream result;
+    bool first = true;
+    for (const auto& name : names) {
+        if (std::regex_match(name, pattern_regex)) {
+            if (!first) result << ",";
+            result << name;
+            first = false;
+        }
+    }
+    
+    return KVStore::Result(result.str(), true);
+}
+
+// The entries of an ordered map with keys in [lo, hi); nullptr for no bound
+template <class Map>
+std::pair<typename Map::const_iterator, typename Map::const_iterator> key_range(const Map& map, const std::string* lo,
+                                                                                 const std::string* hi) {
+    return {lo != nullptr ? map.lower_bound(*lo) : map.begin(), hi != nullptr ? map.lower_bound(*hi) : map.end()};
+}
+
+// Keys that cut an ordered map into parts of about equal size
+template <class Map>
+std::vector<std::string> split_points(const Map& map, size_t parts) {
+    std::vector<std::string> cuts;
+    auto it = map.begin();
+    size_t at = 0;
+    for (size_t i = 1; i < parts && at < map.size(); i++) {
+        size_t next = map.size() * i / parts;
+        std::advance(it, next - at);
+        at = next;
+        cuts.push_back(it->first);
+    }
+    return cuts;
+}
+
+std::string format_rate(double rate) {
+    char buf[32];
+    snprintf(buf, sizeof(buf), "%.1f", rate);
+    return buf;
+}
+
+} // namespace
+
+KVStore::KVStore()
+    : throttle_sweep_at_(1024), hotkeys_decay_ms_(10000), hotkeys_timer_(0), replicas_(versions_),
+      results_(versions_), replica_min_accesses_(1000), counters_(INT_MIN, INT_MAX), counter_auto_threshold_(64), chunk_budget_us_(100), chunked_commands_(0),
+      chunk_slices_(0), chunk_detached_(0), next_block_id_(1) {
+    schedule_hotkeys_decay();
+    schedule_replica_refresh();
+    schedule_contention_window();
 }
 
 KVStore::~KVStore() {
 }
 
 KVStore::Result KVStore::get(const std::string& key) const {
+    int64_t total;
+    if (!counters_.empty() && counters_.value(key, total)) {
+        return Result(std::to_string(total), true);
+    }
     auto it = store_.find(key);
     if (it != store_.end()) {
         return Result(it->second, true);
-    } else {
-        return Result(false);
     }
+    auto rope_it = ropes_.find(key);
+    if (rope_it != ropes_.end()) {
+        return Result(rope_it->second.flatten(), true);
+    }
+    return Result(false);
 }
 
 KVStore::Result KVStore::set(const std::string& key, const std::string& value) {
     store_[key] = value;
+    if (!ropes_.empty()) {
+        ropes_.erase(key);
+    }
     return Result("OK", true);
 }
 
 KVStore::Result KVStore::execute_operation(const std::string& operation, const std::string& key, const std::string& value) {
+    if (!is_read_only(operation)) {
+        versions_.bump(key);
+        if (!cursors_.empty()) {
+            detach_cursors(key);
+        }
+    }
+    if (!counters_.empty() && operation.compare(0, 8, "counter.") != 0 && counters_.contains(key)) {
+        std::string total;
+        if (sharded_counter(operation, key, value, total)) {
+            return Result(total, true);
+        }
+        if (operation != "exists" && operation != "ttl") {
+            fold_counter(key);
+        }
+    }
     if (operation == "get") {
+        hotkeys_.record(key);
         return get(key);
     } else if (operation == "set") {
+        hotkeys_.record(key);
         return set(key, value);
     } else if (operation == "incr") {
         return incr(key);
@@ -45,26 +336,12 @@ KVStore::Result KVStore::execute_operation(const std::string& operation, const s
         } catch (const std::exception&) {
             return Result("ERROR: Invalid decrement value", false);
         }
+    } else if (operation == "throttle") {
+        return throttle(key, value); // max_burst,count,period[,quantity]
     } else if (operation == "lpush") {
-        // Handle multiple values separated by comma
-        std::istringstream iss(value);
-        std::string single_value;
-        int count = 0;
-        while (std::getline(iss, single_value, ',')) {
-            lpush(key, single_value);
-            count++;
-        }
-        return Result(std::to_string(lists_[key].size()), true);
+        return push_values(key, split_args(value), true); // value contains comma-separated values
     } else if (operation == "rpush") {
-        // Handle multiple values separated by comma
-        std::istringstream iss(value);
-        std::string single_value;
-        int count = 0;
-        while (std::getline(iss, single_value, ',')) {
-            rpush(key, single_value);
-            count++;
-        }
-        return Result(std::to_string(lists_[key].size()), true);
+        return push_values(key, split_args(value), false); // value contains comma-separated values
     } else if (operation == "lpop") {
         return lpop(key);
     } else if (operation == "rpop") {
@@ -101,6 +378,17 @@ KVStore::Result KVStore::execute_operation(const std::string& operation, const s
         return hmget(key, value); // value contains comma-separated fields
     } else if (operation == "hdel") {
         return hdel(key, value); // value is field
+    } else if (operation == "idx.create") {
+        // key is the index name, value is prefix,field,NUMERIC|TAG
+        std::vector<std::string> args = split_args(value);
+        if (args.size() != 3) {
+            return Result("ERROR: Invalid idx.create format", false);
+        }
+        return idx_create(key, args[0], args[1], args[2]);
+    } else if (operation == "idx.drop") {
+        return idx_drop(key);
+    } else if (operation == "idx.query") {
+        return idx_query(key, value); // min,max[,limit] or tag[,limit]
     } else if (operation == "hexists") {
         return hexists(key, value); // value is field
     } else if (operation == "ping") {
@@ -132,6 +420,279 @@ KVStore::Result KVStore::execute_operation(const std::string& operation, const s
         return sdiff(key, value); // value is the second key
     } else if (operation == "scard") {
         return scard(key);
+    } else if (operation == "append") {
+        return append(key, value);
+    } else if (operation == "setrange") {
+        // Parse offset,value from value (only the first comma separates)
+        size_t comma_pos = value.find(',');
+        if (comma_pos == std::string::npos) {
+            return Result("ERROR: Invalid setrange format", false);
+        }
+        try {
+            int64_t offset = std::stoll(value.substr(0, comma_pos));
+            return setrange(key, offset, value.substr(comma_pos + 1));
+        } catch (const std::exception&) {
+            return Result("ERROR: Invalid offset value", false);
+        }
+    } else if (operation == "getrange") {
+        // Parse start,end from value
+        size_t comma_pos = value.find(',');
+        if (comma_pos == std::string::npos) {
+            return Result("ERROR: Invalid range format", false);
+        }
+        try {
+            int64_t start = std::stoll(value.substr(0, comma_pos));
+            int64_t end = std::stoll(value.substr(comma_pos + 1));
+            return getrange(key, start, end);
+        } catch (const std::exception&) {
+            return Result("ERROR: Invalid range values", false);
+        }
+    } else if (operation == "strlen") {
+        return strlen(key);
+    } else if (operation == "setbit") {
+        // Parse offset,bit from value
+        std::vector<std::string> args = split_args(value);
+        if (args.size() != 2) {
+            return Result("ERROR: Invalid setbit format", false);
+        }
+        try {
+            return setbit(key, std::stoull(args[0]), std::stoi(args[1]));
+        } catch (const std::exception&) {
+            return Result("ERROR: bit offset is not an integer or out of range", false);
+        }
+    } else if (operation == "getbit") {
+        try {
+            return getbit(key, std::stoull(value));
+        } catch (const std::exception&) {
+            return Result("ERROR: bit offset is not an integer or out of range", false);
+        }
+    } else if (operation == "bitcount") {
+        // Optional start,end byte range in value
+        std::vector<std::string> args = split_args(value);
+        try {
+            if (args.empty()) {
+                return bitcount(key);
+            } else if (args.size() == 2) {
+                return bitcount(key, std::stoll(args[0]), std::stoll(args[1]));
+            }
+        } catch (const std::exception&) {
+        }
+        return Result("ERROR: Invalid bitcount range", false);
+    } else if (operation == "bitpos") {
+        // bit[,start[,end]] in value
+        std::vector<std::string> args = split_args(value);
+        try {
+            if (args.size() == 1) {
+                return bitpos(key, std::stoi(args[0]));
+            } else if (args.size() == 2) {
+                return bitpos(key, std::stoi(args[0]), std::stoll(args[1]));
+            } else if (args.size() == 3) {
+                return bitpos(key, std::stoi(args[0]), std::stoll(args[1]), std::stoll(args[2]));
+            }
+        } catch (const std::exception&) {
+        }
+        return Result("ERROR: Invalid bitpos arguments", false);
+    } else if (operation == "bitop") {
+        // key is the destination, value is op,src1[,src2...]
+        size_t comma_pos = value.find(',');
+        if (comma_pos == std::string::npos) {
+            return Result("ERROR: Invalid bitop format", false);
+        }
+        if (!counters_.empty()) {
+            for (const auto& src : split_args(value.substr(comma_pos + 1))) {
+                fold_counter(src);
+            }
+        }
+        return bitop(value.substr(0, comma_pos), key, value.substr(comma_pos + 1));
+    } else if (operation == "publish") {
+        return publish(key, value); // key is the channel, value is the message
+    } else if (operation == "pfadd") {
+        return pfadd(key, value);
+    } else if (operation == "pfcount") {
+        // key plus optional comma-separated extra keys in value
+        return pfcount(value.empty() ? key : key + "," + value);
+    } else if (operation == "pfmerge") {
+        return pfmerge(key, value); // key is the destination, value the sources
+    } else if (operation == "bf.reserve") {
+        // value is error_rate,capacity
+        size_t comma_pos = value.find(',');
+        if (comma_pos == std::string::npos) {
+            return Result("ERROR: Invalid bf.reserve format", false);
+        }
+        try {
+            return bf_reserve(key, std::stod(value.substr(0, comma_pos)),
+                              std::stoull(value.substr(comma_pos + 1)));
+        } catch (const std::exception&) {
+            return Result("ERROR: Invalid bf.reserve arguments", false);
+        }
+    } else if (operation == "bf.add") {
+        return bf_add(key, value);
+    } else if (operation == "bf.madd") {
+        return bf_madd(key, value);
+    } else if (operation == "bf.exists") {
+        return bf_exists(key, value);
+    } else if (operation == "bf.mexists") {
+        return bf_mexists(key, value);
+    } else if (operation == "xadd") {
+        // value is id,field:value[,field:value...] (id may be * or ms-*)
+        size_t comma_pos = value.find(',');
+        if (comma_pos == std::string::npos) {
+            return Result("ERROR: Invalid xadd format", false);
+        }
+        return xadd(key, value.substr(0, comma_pos), value.substr(comma_pos + 1));
+    } else if (operation == "xrange" || operation == "xrevrange") {
+        // value is start,end[,count] (end,start[,count] for xrevrange)
+        std::vector<std::string> args = split_args(value);
+        size_t count;
+        if (args.size() < 2 || !parse_count(args, 2, count)) {
+            return Result("ERROR: Invalid " + operation + " format", false);
+        }
+        return operation == "xrange" ? xrange(key, args[0], args[1], count)
+                                     : xrevrange(key, args[0], args[1], count);
+    } else if (operation == "xread") {
+        // value is last_id[,count]; returns entries after last_id
+        std::vector<std::string> args = split_args(value);
+        size_t count;
+        if (args.empty() || !parse_count(args, 1, count)) {
+            return Result("ERROR: Invalid xread format", false);
+        }
+        return xread(key, args[0], count);
+    } else if (operation == "xtrim") {
+        // value is MAXLEN,n or MINID,id
+        size_t comma_pos = value.find(',');
+        if (comma_pos == std::string::npos) {
+            return Result("ERROR: Invalid xtrim format", false);
+        }
+        return xtrim(key, value.substr(0, comma_pos), value.substr(comma_pos + 1));
+    } else if (operation == "xlen") {
+        return xlen(key);
+    } else if (operation == "ts.create") {
+        return ts_create(key, value); // value is name=value[,name=value...] labels
+    } else if (operation == "ts.add") {
+        // value is timestamp,value (timestamp may be *)
+        size_t comma_pos = value.find(',');
+        if (comma_pos == std::string::npos) {
+            return Result("ERROR: Invalid ts.add format", false);
+        }
+        return ts_add(key, value.substr(0, comma_pos), value.substr(comma_pos + 1));
+    } else if (operation == "ts.get") {
+        return ts_get(key);
+    } else if (operation == "ts.range" || operation == "ts.mrange") {
+        // value is from,to[,aggregation,bucket_ms]; for ts.mrange key is the label filter
+        std::vector<std::string> args;
+        int64_t bucket_ms;
+        if (!parse_ts_range_args(value, args, bucket_ms)) {
+            return Result("ERROR: Invalid " + operation + " format", false);
+        }
+        return operation == "ts.range" ? ts_range(key, args[0], args[1], args[2], bucket_ms)
+                                       : ts_mrange(key, args[0], args[1], args[2], bucket_ms);
+    } else if (operation == "vec.create") {
+        // value is dim[,L2|IP|COSINE]
+        std::vector<std::string> args = split_args(value);
+        try {
+            if (args.empty() || args.size() > 2) {
+                return Result("ERROR: Invalid vec.create format", false);
+            }
+            return vec_create(key, std::stoul(args[0]), args.size() == 2 ? args[1] : "L2");
+        } catch (const std::exception&) {
+            return Result("ERROR: Invalid vector dimension", false);
+        }
+    } else if (operation == "vec.add") {
+        // value is id,f1,...,fdim
+        std::vector<std::string> args = split_args(value);
+        std::vector<float> vec;
+        if (args.size() < 2 || !parse_floats(args, 1, args.size() - 1, vec)) {
+            return Result("ERROR: Invalid vec.add format", false);
+        }
+        return vec_add(key, args[0], vec);
+    } else if (operation == "vec.del") {
+        return vec_del(key, value); // value is the id
+    } else if (operation == "vec.knn") {
+        // value is k,f1,...,fdim[,nprobe]
+        const VectorSet* set = vector_set(key);
+        if (!set) {
+            return Result("", true);
+        }
+        std::vector<std::string> args = split_args(value);
+        std::vector<float> query;
+        size_t dim = set->dim();
+        if ((args.size() != dim + 1 && args.size() != dim + 2) || !parse_floats(args, 1, dim, query)) {
+            return Result("ERROR: vec.knn expects k, " + std::to_string(dim) + " floats and an optional nprobe", false);
+        }
+        try {
+            size_t k = std::stoul(args[0]);
+            size_t nprobe = args.size() == dim + 2 ? std::stoul(args[dim + 1]) : VectorSet::kDefaultNprobe;
+            return vec_knn(key, k, query, nprobe);
+        } catch (const std::exception&) {
+            return Result("ERROR: Invalid vec.knn count", false);
+        }
+    } else if (operation == "vec.ivf") {
+        try {
+            return vec_build_ivf(key, std::stoul(value)); // value is the number of lists
+        } catch (const std::exception&) {
+            return Result("ERROR: Invalid vec.ivf list count", false);
+        }
+    } else if (operation == "vec.card") {
+        return vec_card(key);
+    } else if (operation == "json.set") {
+        // value is path,json (split at the first comma; the JSON may contain more)
+        size_t comma = value.find(',');
+        if (comma == std::string::npos) {
+            return Result("ERROR: Invalid json.set format", false);
+        }
+        return json_set(key, value.substr(0, comma), value.substr(comma + 1));
+    } else if (operation == "json.get") {
+        return json_get(key, value.empty() ? "$" : value); // value is the path
+    } else if (operation == "json.numincrby") {
+        size_t comma = value.find(',');
+        if (comma == std::string::npos) {
+            return Result("ERROR: Invalid json.numincrby format", false);
+        }
+        return json_numincrby(key, value.substr(0, comma), value.substr(comma + 1));
+    } else if (operation == "json.type") {
+        return json_type(key, value.empty() ? "$" : value);
+    } else if (operation == "geoadd") {
+        return geoadd(key, value); // value is lon,lat,member[,lon,lat,member...]
+    } else if (operation == "geodist") {
+        std::vector<std::string> args = split_args(value);
+        if (args.size() != 2 && args.size() != 3) {
+            return Result("ERROR: Invalid geodist format", false);
+        }
+        return geodist(key, args[0], args[1], args.size() == 3 ? args[2] : "m");
+    } else if (operation == "geopos") {
+        return geopos(key, value); // value contains comma-separated members
+    } else if (operation == "geosearch") {
+        return geosearch(key, value); // FROMLONLAT,lon,lat|FROMMEMBER,m,BYRADIUS,r,unit|BYBOX,w,h,unit[,ASC|DESC][,COUNT,n]
+    } else if (operation == "hotkeys") {
+        return hotkeys(value);
+    } else if (operation == "counter.shard") {
+        return shard_counter(key);
+    } else if (operation == "counter.unshard") {
+        return unshard_counter(key);
+    } else if (operation == "counters") {
+        return counters(value);
+    } else if (operation == "admission") {
+        return admission(value);
+    } else if (operation == "chunking") {
+        return chunking(value);
+    } else if (operation == "resultcache") {
+        return resultcache(value);
+    } else if (operation == "script.load") {
+        return script_load(value);
+    } else if (operation == "script.exists") {
+        return script_exists(value); // value contains comma-separated SHA1s
+    } else if (operation == "script.flush") {
+        return script_flush();
+    } else if (operation == "evalsha") {
+        return evalsha(key, value); // key is the SHA1, value numkeys,keys...,args...
+    } else if (operation == "bulkload") {
+        return bulkload(key, value); // key is the file path, value [RESP|CSV|BINARY][,THREADS,n]
+    } else if (operation == "export") {
+        return keyspace_export(key, value); // key is the directory, value [THREADS,n][,PARTIAL]
+    } else if (operation == "import") {
+        return keyspace_import(key, value);
+    } else if (operation == "debug.populate") {
+        return debug_populate(key, value); // key is the count, value [prefix[,size]][,TYPE,weight]...[,TTL,s,pct]
     } else if (operation == "multi") {
         return Result("OK", true); // Just acknowledge, no state change needed
     } else if (operation == "exec") {
@@ -148,18 +709,36 @@ KVStore::Result KVStore::execute_operation(const std::string& operation, const s
 }
 
 size_t KVStore::size() const {
-    return store_.size();
+    return store_.size() + ropes_.size();
 }
 
 bool KVStore::empty() const {
-    return store_.empty();
+    return store_.empty() && ropes_.empty();
 }
 
 void KVStore::clear() {
+    detach_all_cursors();
     store_.clear();
+    ropes_.clear();
     lists_.clear();
     hashes_.clear();
     sets_.clear();
+    hlls_.clear();
+    blooms_.clear();
+    streams_.clear();
+    timeseries_.clear();
+    vectors_.clear();
+    jsons_.clear();
+    geos_.clear();
+    throttles_.clear();
+    hotkeys_.reset();
+    counters_.clear();
+    results_.clear();
+    incr_contention_.clear();
+    versions_.bump_all();
+    for (auto& pair : indexes_) {
+        pair.second.clear();
+    }
 }
 
 // Numeric operations
@@ -172,6 +751,9 @@ KVStore::Result KVStore::decr(const std::string& key) {
 }
 
 KVStore::Result KVStore::incrby(const std::string& key, int increment) {
+    if (ropes_.find(key) != ropes_.end()) {
+        return Result("ERROR: value is not an integer", false);
+    }
     auto it = store_.find(key);
     int current_value = 0;
     
@@ -194,13 +776,35 @@ KVStore::Result KVStore::decrby(const std::string& key, int decrement) {
 
 // List operations
 KVStore::Result KVStore::lpush(const std::string& key, const std::string& value) {
-    lists_[key].push_front(value);
-    return Result(std::to_string(lists_[key].size()), true);
+    return push_values(key, {value}, true);
 }
 
 KVStore::Result KVStore::rpush(const std::string& key, const std::string& value) {
-    lists_[key].push_back(value);
-    return Result(std::to_string(lists_[key].size()), true);
+    return push_values(key, {value}, false);
+}
+
+KVStore::Result KVStore::push_values(const std::string& key, const std::vector<std::string>& values,
+                                     bool to_left) {
+    // A value a blocked client takes never reaches the list, so llen() afterwards would miss it
+    auto it = lists_.find(key);
+    size_t length = (it == lists_.end() ? 0 : it->second.size()) + values.size();
+    for (const auto& value : values) {
+        push_to_list(key, value, to_left);
+    }
+    return Result(std::to_string(length), true);
+}
+
+void KVStore::push_to_list(const std::string& key, const std::string& value, bool to_left) {
+    versions_.bump(key);
+    // A blocked client takes the value directly; the list itself is never touched
+    if (serve_list_waiter(key, value)) {
+        return;
+    }
+    if (to_left) {
+        lists_[key].push_front(value);
+    } else {
+        lists_[key].push_back(value);
+    }
 }
 
 KVStore::Result KVStore::lpop(const std::string& key) {
@@ -280,6 +884,7 @@ KVStore::Result KVStore::lrange(const std::string& key, int start, int stop) {
 KVStore::Result KVStore::hset(const std::string& key, const std::string& field, const std::string& value) {
     bool is_new = hashes_[key].find(field) == hashes_[key].end();
     hashes_[key][field] = value;
+    index_hash_field(key, field, &value);
     return Result(is_new ? "1" : "0", true);
 }
 
@@ -360,6 +965,9 @@ KVStore::Result KVStore::hdel(const std::string& key, const std::string& field)
     if (hash_it->second.empty()) {
         hashes_.erase(hash_it);
     }
+    if (removed) {
+        index_hash_field(key, field, nullptr);
+    }
     
     return Result(std::to_string(removed), true);
 }
@@ -374,128 +982,2330 @@ KVStore::Result KVStore::hexists(const std::string& key, const std::string& fiel
     return Result(exists ? "1" : "0", true);
 }
 
-// Key management operations
-bool KVStore::is_expired(const std::string& key) const {
-    auto it = expiry_times_.find(key);
-    if (it == expiry_times_.end()) {
-        return false; // No expiry set
+// Secondary index operations
+void KVStore::index_hash_field(const std::string& key, const std::string& field, const std::string* value) {
+    for (auto& pair : indexes_) {
+        HashIndex& index = pair.second;
+        if (index.field() == field && index.covers(key)) {
+            index.update(key, value);
+        }
     }
-    return std::chrono::steady_clock::now() >= it->second;
 }
 
-KVStore::Result KVStore::exists(const std::string& key) const {
-    if (is_expired(key)) {
-        return Result("0", true);
+void KVStore::unindex_hash(const std::string& key) {
+    for (auto& pair : indexes_) {
+        if (pair.second.covers(key)) {
+            pair.second.update(key, nullptr);
+        }
     }
-    
-    int count = 0;
-    if (store_.find(key) != store_.end()) count++;
-    if (lists_.find(key) != lists_.end()) count++;
-    if (hashes_.find(key) != hashes_.end()) count++;
-    if (sets_.find(key) != sets_.end()) count++;
-    
-    return Result(std::to_string(count), true);
 }
 
-KVStore::Result KVStore::expire(const std::string& key, int seconds) {
-    // Check if key exists in any store
-    bool key_exists = (store_.find(key) != store_.end()) ||
-                      (lists_.find(key) != lists_.end()) ||
-                      (hashes_.find(key) != hashes_.end()) ||
-                      (sets_.find(key) != sets_.end());
-    
-    if (!key_exists) {
-        return Result("0", true); // Key doesn't exist
+KVStore::Result KVStore::idx_create(const std::string& name, const std::string& prefix, const std::string& field,
+                                    const std::string& kind) {
+    HashIndex::Kind k;
+    if (!HashIndex::parse_kind(kind, k)) {
+        return Result("ERROR: index type must be NUMERIC or TAG", false);
     }
-    
-    auto expiry_time = std::chrono::steady_clock::now() + std::chrono::seconds(seconds);
-    expiry_times_[key] = expiry_time;
-    return Result("1", true); // Expiry set
-}
-
-KVStore::Result KVStore::ttl(const std::string& key) const {
-    // Check if key exists
-    bool key_exists = (store_.find(key) != store_.end()) ||
-                      (lists_.find(key) != lists_.end()) ||
-                      (hashes_.find(key) != hashes_.end()) ||
-                      (sets_.find(key) != sets_.end());
-    
-    if (!key_exists) {
-        return Result("-2", true); // Key doesn't exist
+    if (field.empty()) {
+        return Result("ERROR: index field must not be empty", false);
     }
-    
-    auto it = expiry_times_.find(key);
-    if (it == expiry_times_.end()) {
-        return Result("-1", true); // No expiry set
+    if (indexes_.find(name) != indexes_.end()) {
+        return Result("ERROR: Index already exists", false);
     }
-    
-    auto now = std::chrono::steady_clock::now();
-    if (now >= it->second) {
-        return Result("-2", true); // Key expired
+    HashIndex& index = indexes_.emplace(name, HashIndex(prefix, field, k)).first->second;
+
+    // Backfill from existing hashes; keys are ordered, so the prefix is one contiguous range
+    for (auto it = hashes_.lower_bound(prefix); it != hashes_.end() && index.covers(it->first); ++it) {
+        auto field_it = it->second.find(field);
+        if (field_it != it->second.end()) {
+            index.update(it->first, &field_it->second);
+        }
     }
-    
-    auto remaining = std::chrono::duration_cast<std::chrono::seconds>(it->second - now);
-    return Result(std::to_string(remaining.count()), true);
+    return Result("OK", true);
 }
 
-KVStore::Result KVStore::keys(const std::string& pattern) const {
-    std::vector<std::string> matching_keys;
-    
-    // Convert Redis pattern to regex
-    std::string regex_pattern = pattern;
-    // Replace * with .*
-    size_t pos = 0;
-    while ((pos = regex_pattern.find('*', pos)) != std::string::npos) {
-        regex_pattern.replace(pos, 1, ".*");
-        pos += 2;
+KVStore::Result KVStore::idx_drop(const std::string& name) {
+    if (!indexes_.erase(name)) {
+        return Result("ERROR: Unknown index name", false);
     }
-    // Replace ? with .
-    pos = 0;
-    while ((pos = regex_pattern.find('?', pos)) != std::string::npos) {
-        regex_pattern.replace(pos, 1, ".");
-        pos += 1;
+    return Result("OK", true);
+}
+
+KVStore::Result KVStore::idx_query(const std::string& name, const std::string& query) const {
+    auto it = indexes_.find(name);
+    if (it == indexes_.end()) {
+        return Result("ERROR: Unknown index name", false);
     }
-    
-    std::regex pattern_regex(regex_pattern);
-    
-    // Check all stores
-    for (const auto& pair : store_) {
-        if (!is_expired(pair.first) && std::regex_match(pair.first, pattern_regex)) {
-            matching_keys.push_back(pair.first);
+    const HashIndex& index = it->second;
+    std::vector<std::string> args = split_args(query);
+    std::vector<std::string> keys;
+    size_t limit = 0;
+
+    if (index.kind() == HashIndex::Kind::Numeric) {
+        // min,max[,limit]; -inf/+inf allowed, a leading ( makes a bound exclusive
+        if (args.size() < 2 || !parse_count(args, 2, limit)) {
+            return Result("ERROR: Invalid numeric query, expected min,max[,limit]", false);
         }
-    }
-    for (const auto& pair : lists_) {
-        if (!is_expired(pair.first) && std::regex_match(pair.first, pattern_regex)) {
-            matching_keys.push_back(pair.first);
+        double bounds[2];
+        bool exclusive[2];
+        for (int i = 0; i < 2; i++) {
+            std::string b = args[i];
+            exclusive[i] = !b.empty() && b[0] == '(';
+            if (exclusive[i]) b.erase(0, 1);
+            try {
+                size_t idx;
+                bounds[i] = std::stod(b, &idx);
+                if (idx != b.size()) throw std::invalid_argument(b);
+            } catch (const std::exception&) {
+                return Result("ERROR: Invalid numeric bound " + args[i], false);
+            }
         }
-    }
-    for (const auto& pair : hashes_) {
-        if (!is_expired(pair.first) && std::regex_match(pair.first, pattern_regex)) {
-            matching_keys.push_back(pair.first);
+        index.range(bounds[0], exclusive[0], bounds[1], exclusive[1], limit, keys);
+    } else {
+        if (args.empty() || !parse_count(args, 1, limit)) {
+            return Result("ERROR: Invalid tag query, expected tag[,limit]", false);
         }
+        index.match(args[0], limit, keys);
     }
-    for (const auto& pair : sets_) {
-        if (!is_expired(pair.first) && std::regex_match(pair.first, pattern_regex)) {
-            matching_keys.push_back(pair.first);
-        }
+
+    std::string out;
+    for (const auto& key : keys) {
+        if (is_expired(key)) continue;
+        if (!out.empty()) out += ",";
+        out += key;
     }
-    
-    // Join keys with comma
-    std::ostringstream result;
-    for (size_t i = 0; i < matching_keys.size(); ++i) {
-        if (i > 0) result << ",";
-        result << matching_keys[i];
+    return Result(out, true);
+}
+
+// String range operations
+bool KVStore::has_string(const std::string& key) const {
+    return store_.find(key) != store_.end() || ropes_.find(key) != ropes_.end();
+}
+
+Rope* KVStore::promote_to_rope(const std::string& key) {
+    auto it = store_.find(key);
+    Rope& rope = ropes_[key];
+    rope.append(it->second.data(), it->second.size());
+    store_.erase(it);
+    return &rope;
+}
+
+KVStore::Result KVStore::append(const std::string& key, const std::string& value) {
+    auto rope_it = ropes_.find(key);
+    if (rope_it != ropes_.end()) {
+        if (value.size() > kMaxStringSize - rope_it->second.size()) {
+            return Result(kStringTooLong, false);
+        }
+        rope_it->second.append(value.data(), value.size());
+        return Result(std::to_string(rope_it->second.size()), true);
+    }
+
+    auto it = store_.find(key);
+    if (value.size() > kMaxStringSize - (it == store_.end() ? 0 : it->second.size())) {
+        return Result(kStringTooLong, false);
+    }
+    std::string& flat = it != store_.end() ? it->second : store_[key];
+    if (flat.size() + value.size() <= kRopeThreshold) {
+        flat += value;
+        return Result(std::to_string(flat.size()), true);
+    }
+    Rope* rope = promote_to_rope(key);
+    rope->append(value.data(), value.size());
+    return Result(std::to_string(rope->size()), true);
+}
+
+KVStore::Result KVStore::setrange(const std::string& key, int64_t offset, const std::string& value) {
+    if (offset < 0) {
+        return Result("ERROR: offset is out of range", false);
+    }
+    size_t off = static_cast<size_t>(offset);
+    // Refused before anything is allocated; like Redis, an empty write never is
+    if (!value.empty() && (value.size() > kMaxStringSize || off > kMaxStringSize - value.size())) {
+        return Result(kStringTooLong, false);
+    }
+
+    auto rope_it = ropes_.find(key);
+    if (rope_it != ropes_.end()) {
+        rope_it->second.set_range(off, value.data(), value.size());
+        return Result(std::to_string(rope_it->second.size()), true);
+    }
+
+    auto it = store_.find(key);
+    if (value.empty()) {
+        // Redis does not create the key for an empty write
+        return Result(std::to_string(it == store_.end() ? 0 : it->second.size()), true);
+    }
+    std::string& flat = it != store_.end() ? it->second : store_[key];
+    if (off + value.size() <= kRopeThreshold) {
+        if (flat.size() < off + value.size()) {
+            flat.resize(off + value.size(), '\0');
+        }
+        flat.replace(off, value.size(), value);
+        return Result(std::to_string(flat.size()), true);
+    }
+    Rope* rope = promote_to_rope(key);
+    rope->set_range(off, value.data(), value.size());
+    return Result(std::to_string(rope->size()), true);
+}
+
+std::vector<std::string_view> KVStore::getrange_view(const std::string& key, int64_t start, int64_t end) const {
+    std::vector<std::string_view> views;
+    auto it = store_.find(key);
+    auto rope_it = ropes_.find(key);
+    if (it == store_.end() && rope_it == ropes_.end()) {
+        return views;
+    }
+    int64_t size = it != store_.end() ? static_cast<int64_t>(it->second.size())
+                                      : static_cast<int64_t>(rope_it->second.size());
+
+    // Same index rules as Redis GETRANGE: negative from the end, inclusive, clamped
+    if (start < 0) start = std::max<int64_t>(0, start + size);
+    if (end < 0) end += size;
+    end = std::min(end, size - 1);
+    if (size == 0 || start > end) {
+        return views;
+    }
+
+    size_t len = static_cast<size_t>(end - start + 1);
+    if (it != store_.end()) {
+        views.emplace_back(it->second.data() + start, len);
+    } else {
+        rope_it->second.range(static_cast<size_t>(start), len, views);
+    }
+    return views;
+}
+
+KVStore::Result KVStore::getrange(const std::string& key, int64_t start, int64_t end) const {
+    std::vector<std::string_view> views = getrange_view(key, start, end);
+    size_t total = 0;
+    for (const auto& v : views) total += v.size();
+
+    std::string result;
+    result.reserve(total);
+    for (const auto& v : views) result.append(v.data(), v.size());
+    return Result(result, true);
+}
+
+KVStore::Result KVStore::strlen(const std::string& key) const {
+    auto it = store_.find(key);
+    if (it != store_.end()) {
+        return Result(std::to_string(it->second.size()), true);
+    }
+    auto rope_it = ropes_.find(key);
+    if (rope_it != ropes_.end()) {
+        return Result(std::to_string(rope_it->second.size()), true);
+    }
+    return Result("0", true);
+}
+
+// Bitmap operations
+KVStore::Result KVStore::setbit(const std::string& key, uint64_t offset, int bit) {
+    if (bit != 0 && bit != 1) {
+        return Result("ERROR: bit is not an integer or out of range", false);
+    }
+    if (offset >= (1ULL << 32)) {
+        return Result("ERROR: bit offset is not an integer or out of range", false);
+    }
+    size_t byte = static_cast<size_t>(offset >> 3);
+    uint8_t mask = static_cast<uint8_t>(0x80 >> (offset & 7));
+
+    auto rope_it = ropes_.find(key);
+    if (rope_it != ropes_.end()) {
+        Rope& rope = rope_it->second;
+        char current = '\0';
+        std::vector<std::string_view> views;
+        rope.range(byte, 1, views);
+        if (!views.empty()) current = views[0][0];
+        char updated = static_cast<char>(bit ? (current | mask) : (current & ~mask));
+        rope.set_range(byte, &updated, 1);
+        return Result((current & mask) ? "1" : "0", true);
+    }
+
+    // Bitmaps stay flat so BITCOUNT/BITOP can run the SIMD kernels over one buffer
+    std::string& value = store_[key];
+    if (value.size() <= byte) {
+        value.resize(byte + 1, '\0');
+    }
+    uint8_t current = static_cast<uint8_t>(value[byte]);
+    value[byte] = static_cast<char>(bit ? (current | mask) : (current & ~mask));
+    return Result((current & mask) ? "1" : "0", true);
+}
+
+KVStore::Result KVStore::getbit(const std::string& key, uint64_t offset) const {
+    int64_t byte = static_cast<int64_t>(offset >> 3);
+    std::vector<std::string_view> views = getrange_view(key, byte, byte);
+    if (views.empty()) {
+        return Result("0", true);
+    }
+    uint8_t mask = static_cast<uint8_t>(0x80 >> (offset & 7));
+    return Result((static_cast<uint8_t>(views[0][0]) & mask) ? "1" : "0", true);
+}
+
+KVStore::Result KVStore::bitcount(const std::string& key, int64_t start, int64_t end) const {
+    const bitops::Kernels& k = bitops::kernels();
+    uint64_t total = 0;
+    for (const auto& v : getrange_view(key, start, end)) {
+        total += k.popcount(reinterpret_cast<const uint8_t*>(v.data()), v.size());
+    }
+    return Result(std::to_string(total), true);
+}
+
+KVStore::Result KVStore::bitpos(const std::string& key, int bit, int64_t start, int64_t end) const {
+    if (bit != 0 && bit != 1) {
+        return Result("ERROR: The bit argument must be 1 or 0.", false);
+    }
+    if (!has_string(key)) {
+        return Result(bit ? "-1" : "0", true);
+    }
+
+    std::vector<std::string_view> views = getrange_view(key, start, end);
+    if (views.empty()) {
+        return Result("-1", true);
+    }
+    int64_t first_byte = start;
+    if (first_byte < 0) {
+        auto len = std::stoll(strlen(key).value);
+        first_byte = std::max<int64_t>(0, first_byte + len);
+    }
+
+    int64_t scanned = 0;
+    for (const auto& v : views) {
+        int64_t pos = bitops::bitpos(reinterpret_cast<const uint8_t*>(v.data()), v.size(), bit == 1);
+        if (pos >= 0) {
+            return Result(std::to_string((first_byte + scanned) * 8 + pos), true);
+        }
+        scanned += static_cast<int64_t>(v.size());
+    }
+
+    // Looking for a clear bit without an explicit end: the string is treated as
+    // padded with zeros, so the answer is the first bit past the end
+    if (bit == 0 && end == INT64_MAX) {
+        return Result(std::to_string((first_byte + scanned) * 8), true);
+    }
+    return Result("-1", true);
+}
+
+KVStore::Result KVStore::bitop(const std::string& op, const std::string& destination, const std::string& sources) {
+    std::string op_upper = op;
+    std::transform(op_upper.begin(), op_upper.end(), op_upper.begin(), ::toupper);
+    bitops::Op bit_op;
+    if (op_upper == "AND") bit_op = bitops::Op::And;
+    else if (op_upper == "OR") bit_op = bitops::Op::Or;
+    else if (op_upper == "XOR") bit_op = bitops::Op::Xor;
+    else if (op_upper == "NOT") bit_op = bitops::Op::Not;
+    else return Result("ERROR: syntax error", false);
+
+    std::vector<std::string> keys = split_args(sources);
+    if (keys.empty() || (bit_op == bitops::Op::Not && keys.size() != 1)) {
+        return Result("ERROR: BITOP NOT must be called with a single source key.", false);
+    }
+
+    // Rope sources are flattened once; flat sources are used in place
+    std::vector<std::string> flattened;
+    flattened.reserve(keys.size());
+    std::vector<bitops::Source> inputs;
+    for (const auto& k : keys) {
+        auto it = store_.find(k);
+        if (it != store_.end()) {
+            inputs.push_back({reinterpret_cast<const uint8_t*>(it->second.data()), it->second.size()});
+            continue;
+        }
+        auto rope_it = ropes_.find(k);
+        if (rope_it != ropes_.end()) {
+            flattened.push_back(rope_it->second.flatten());
+            inputs.push_back({reinterpret_cast<const uint8_t*>(flattened.back().data()), flattened.back().size()});
+        } else {
+            inputs.push_back({nullptr, 0});
+        }
+    }
+
+    // Build into a temporary: the destination may also be a source
+    std::string result;
+    bitops::bitop(bitops::kernels(), bit_op, inputs, result);
+    size_t len = result.size();
+    ropes_.erase(destination);
+    if (len == 0) {
+        store_.erase(destination);
+    } else {
+        store_[destination] = std::move(result);
+    }
+    return Result(std::to_string(len), true);
+}
+
+// HyperLogLog operations
+KVStore::Result KVStore::pfadd(const std::string& key, const std::string& elements) {
+    auto it = hlls_.find(key);
+    bool changed = false;
+    if (it == hlls_.end()) {
+        it = hlls_.emplace(key, HyperLogLog()).first;
+        changed = true;
+    }
+
+    std::istringstream iss(elements);
+    std::string element;
+    while (std::getline(iss, element, ',')) {
+        if (it->second.add(element)) {
+            changed = true;
+        }
+    }
+    return Result(changed ? "1" : "0", true);
+}
+
+KVStore::Result KVStore::pfcount(const std::string& keys) const {
+    std::vector<std::string> key_list = split_args(keys);
+    if (key_list.size() == 1) {
+        // Single key: served from the sketch's cached estimate
+        auto it = hlls_.find(key_list[0]);
+        return Result(std::to_string(it == hlls_.end() ? 0 : it->second.count()), true);
+    }
+
+    // Several keys: estimate the union without modifying any of them
+    std::vector<uint8_t> registers(HyperLogLog::kRegisters, 0);
+    for (const auto& k : key_list) {
+        auto it = hlls_.find(k);
+        if (it != hlls_.end()) {
+            it->second.merge_into(registers.data());
+        }
+    }
+    return Result(std::to_string(HyperLogLog::estimate(registers.data())), true);
+}
+
+KVStore::Result KVStore::pfmerge(const std::string& destination, const std::string& sources) {
+    std::vector<uint8_t> registers(HyperLogLog::kRegisters, 0);
+    auto dest_it = hlls_.find(destination);
+    if (dest_it != hlls_.end()) {
+        dest_it->second.merge_into(registers.data());
+    }
+    for (const auto& k : split_args(sources)) {
+        auto it = hlls_.find(k);
+        if (it != hlls_.end()) {
+            it->second.merge_into(registers.data());
+        }
+    }
+    hlls_[destination].assign_registers(registers.data());
+    return Result("OK", true);
+}
+
+// Bloom filter operations
+KVStore::Result KVStore::bf_reserve(const std::string& key, double error_rate, uint64_t capacity) {
+    if (!(error_rate > 0.0 && error_rate < 1.0) || capacity == 0) {
+        return Result("ERROR: error rate must be in (0,1) and capacity positive", false);
+    }
+    if (blooms_.find(key) != blooms_.end()) {
+        return Result("ERROR: item exists", false);
+    }
+    blooms_.emplace(std::piecewise_construct, std::forward_as_tuple(key),
+                    std::forward_as_tuple(capacity, error_rate));
+    return Result("OK", true);
+}
+
+KVStore::Result KVStore::bf_add(const std::string& key, const std::string& item) {
+    // Filters created implicitly use the default capacity and error rate
+    return Result(blooms_[key].add(item) ? "1" : "0", true);
+}
+
+KVStore::Result KVStore::bf_madd(const std::string& key, const std::string& items) {
+    ScalableBloomFilter& filter = blooms_[key];
+    std::string result;
+    for (const auto& item : split_args(items)) {
+        if (!result.empty()) result += ",";
+        result += filter.add(item) ? "1" : "0";
+    }
+    return Result(result, true);
+}
+
+KVStore::Result KVStore::bf_exists(const std::string& key, const std::string& item) const {
+    auto it = blooms_.find(key);
+    return Result(it != blooms_.end() && it->second.contains(item) ? "1" : "0", true);
+}
+
+KVStore::Result KVStore::bf_mexists(const std::string& key, const std::string& items) const {
+    auto it = blooms_.find(key);
+    std::string result;
+    for (const auto& item : split_args(items)) {
+        if (!result.empty()) result += ",";
+        result += it != blooms_.end() && it->second.contains(item) ? "1" : "0";
+    }
+    return Result(result, true);
+}
+
+// Stream operations
+KVStore::Result KVStore::xadd(const std::string& key, const std::string& id, const std::string& fields) {
+    std::vector<Stream::Field> field_list;
+    for (const auto& pair : split_args(fields)) {
+        size_t colon_pos = pair.find(':');
+        if (colon_pos == std::string::npos) {
+            return Result("ERROR: Invalid xadd field format", false);
+        }
+        field_list.emplace_back(pair.substr(0, colon_pos), pair.substr(colon_pos + 1));
+    }
+    if (field_list.empty()) {
+        return Result("ERROR: xadd needs at least one field", false);
+    }
+
+    // Resolve the ID before creating the key so a rejected XADD leaves nothing behind
+    auto it = streams_.find(key);
+    const Stream empty_stream;
+    const Stream& current = it == streams_.end() ? empty_stream : it->second;
+    StreamID new_id;
+    if (id == "*") {
+        uint64_t now_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+                              std::chrono::system_clock::now().time_since_epoch()).count();
+        if (!current.next_auto_id(now_ms, new_id)) {
+            return Result("ERROR: The stream has exhausted the last possible ID", false);
+        }
+    } else if (id.size() > 2 && id.compare(id.size() - 2, 2, "-*") == 0) {
+        // Explicit milliseconds, next free sequence number
+        if (!StreamID::parse(id.substr(0, id.size() - 2), 0, new_id)) {
+            return Result("ERROR: Invalid stream ID specified as stream command argument", false);
+        }
+        if (new_id.ms == current.last_id().ms && !current.last_id().next(new_id)) {
+            return Result("ERROR: The stream has exhausted the last possible ID", false);
+        }
+    } else if (!StreamID::parse(id, 0, new_id)) {
+        return Result("ERROR: Invalid stream ID specified as stream command argument", false);
+    }
+    if (!(current.last_id() < new_id)) {
+        return Result("ERROR: The ID specified in XADD is equal or smaller than the target stream top item", false);
+    }
+
+    streams_[key].add(new_id, field_list);
+    return Result(new_id.to_string(), true);
+}
+
+KVStore::Result KVStore::xrange(const std::string& key, const std::string& start, const std::string& end,
+                                size_t count) const {
+    StreamID from, to;
+    if (!StreamID::parse(start, 0, from) || !StreamID::parse(end, UINT64_MAX, to)) {
+        return Result("ERROR: Invalid stream ID specified as stream command argument", false);
+    }
+    auto it = streams_.find(key);
+    if (it == streams_.end()) {
+        return Result("", true);
+    }
+    std::vector<Stream::Entry> entries;
+    it->second.range(from, to, count, false, entries);
+    return Result(format_entries(entries), true);
+}
+
+KVStore::Result KVStore::xrevrange(const std::string& key, const std::string& end, const std::string& start,
+                                   size_t count) const {
+    StreamID from, to;
+    if (!StreamID::parse(start, 0, from) || !StreamID::parse(end, UINT64_MAX, to)) {
+        return Result("ERROR: Invalid stream ID specified as stream command argument", false);
+    }
+    auto it = streams_.find(key);
+    if (it == streams_.end()) {
+        return Result("", true);
+    }
+    std::vector<Stream::Entry> entries;
+    it->second.range(from, to, count, true, entries);
+    return Result(format_entries(entries), true);
+}
+
+KVStore::Result KVStore::xread(const std::string& key, const std::string& last_id, size_t count) const {
+    auto it = streams_.find(key);
+    if (last_id == "$" || it == streams_.end()) {
+        // Only entries added after this call would match
+        return Result("", true);
+    }
+    StreamID after, from;
+    if (!StreamID::parse(last_id, 0, after)) {
+        return Result("ERROR: Invalid stream ID specified as stream command argument", false);
+    }
+    if (!after.next(from)) {
+        return Result("", true);
+    }
+    std::vector<Stream::Entry> entries;
+    it->second.range(from, StreamID::max(), count, false, entries);
+    return Result(format_entries(entries), true);
+}
+
+KVStore::Result KVStore::xtrim(const std::string& key, const std::string& strategy, const std::string& threshold) {
+    auto it = streams_.find(key);
+    std::string upper = strategy;
+    std::transform(upper.begin(), upper.end(), upper.begin(), ::toupper);
+    if (upper == "MAXLEN") {
+        long long maxlen;
+        try {
+            maxlen = std::stoll(threshold);
+        } catch (const std::exception&) {
+            return Result("ERROR: value is not an integer or out of range", false);
+        }
+        if (maxlen < 0) {
+            return Result("ERROR: The MAXLEN argument must be >= 0", false);
+        }
+        size_t removed = it == streams_.end() ? 0 : it->second.trim_maxlen(static_cast<size_t>(maxlen));
+        return Result(std::to_string(removed), true);
+    }
+    if (upper == "MINID") {
+        StreamID minid;
+        if (!StreamID::parse(threshold, 0, minid)) {
+            return Result("ERROR: Invalid stream ID specified as stream command argument", false);
+        }
+        size_t removed = it == streams_.end() ? 0 : it->second.trim_minid(minid);
+        return Result(std::to_string(removed), true);
+    }
+    return Result("ERROR: xtrim strategy must be MAXLEN or MINID", false);
+}
+
+KVStore::Result KVStore::xlen(const std::string& key) const {
+    auto it = streams_.find(key);
+    return Result(std::to_string(it == streams_.end() ? 0 : it->second.length()), true);
+}
+
+// Time series operations
+KVStore::Result KVStore::ts_create(const std::string& key, const std::string& labels) {
+    std::map<std::string, std::string> label_map;
+    if (!parse_labels(labels, label_map)) {
+        return Result("ERROR: Invalid labels, expected name=value pairs", false);
+    }
+    if (timeseries_.find(key) != timeseries_.end()) {
+        return Result("ERROR: key already exists", false);
+    }
+    timeseries_[key].set_labels(label_map);
+    return Result("OK", true);
+}
+
+KVStore::Result KVStore::ts_add(const std::string& key, const std::string& timestamp, const std::string& value) {
+    int64_t ts;
+    if (timestamp == "*") {
+        ts = std::chrono::duration_cast<std::chrono::milliseconds>(
+                 std::chrono::system_clock::now().time_since_epoch()).count();
+    } else if (!parse_ts_bound(timestamp, ts) || timestamp == "-" || timestamp == "+" || ts < 0) {
+        return Result("ERROR: invalid timestamp", false);
+    }
+    double v;
+    try {
+        size_t idx;
+        v = std::stod(value, &idx);
+        if (idx != value.size()) {
+            return Result("ERROR: invalid value", false);
+        }
+    } catch (const std::exception&) {
+        return Result("ERROR: invalid value", false);
+    }
+    timeseries_[key].add(ts, v);
+    return Result(std::to_string(ts), true);
+}
+
+KVStore::Result KVStore::ts_get(const std::string& key) const {
+    auto it = timeseries_.find(key);
+    TimeSeries::Sample sample;
+    if (it == timeseries_.end() || !it->second.last(sample)) {
+        return Result("", true);
+    }
+    return Result(format_samples({sample}), true);
+}
+
+KVStore::Result KVStore::ts_range(const std::string& key, const std::string& from, const std::string& to,
+                                  const std::string& aggregation, int64_t bucket_ms) const {
+    int64_t from_ts, to_ts;
+    TimeSeries::Aggregation agg = TimeSeries::Aggregation::None;
+    if (!parse_ts_bound(from, from_ts) || !parse_ts_bound(to, to_ts)) {
+        return Result("ERROR: invalid timestamp", false);
+    }
+    if (!aggregation.empty() && !TimeSeries::parse_aggregation(aggregation, agg)) {
+        return Result("ERROR: unknown aggregation type", false);
+    }
+    auto it = timeseries_.find(key);
+    if (it == timeseries_.end()) {
+        return Result("", true);
+    }
+    std::vector<TimeSeries::Sample> samples;
+    it->second.range(from_ts, to_ts, agg, bucket_ms, samples);
+    return Result(format_samples(samples), true);
+}
+
+KVStore::Result KVStore::ts_mrange(const std::string& filter, const std::string& from, const std::string& to,
+                                   const std::string& aggregation, int64_t bucket_ms) const {
+    int64_t from_ts, to_ts;
+    TimeSeries::Aggregation agg = TimeSeries::Aggregation::None;
+    std::map<std::string, std::string> wanted;
+    if (!parse_ts_bound(from, from_ts) || !parse_ts_bound(to, to_ts)) {
+        return Result("ERROR: invalid timestamp", false);
+    }
+    if (!aggregation.empty() && !TimeSeries::parse_aggregation(aggregation, agg)) {
+        return Result("ERROR: unknown aggregation type", false);
+    }
+    if (!parse_labels(filter, wanted) || wanted.empty()) {
+        return Result("ERROR: Invalid filter, expected name=value pairs", false);
+    }
+
+    // One key=samples group per matching series, joined with ';'
+    std::string out;
+    std::vector<TimeSeries::Sample> samples;
+    for (const auto& pair : timeseries_) {
+        const auto& labels = pair.second.labels();
+        bool match = true;
+        for (const auto& w : wanted) {
+            auto l = labels.find(w.first);
+            if (l == labels.end() || l->second != w.second) {
+                match = false;
+                break;
+            }
+        }
+        if (!match || is_expired(pair.first)) {
+            continue;
+        }
+        samples.clear();
+        pair.second.range(from_ts, to_ts, agg, bucket_ms, samples);
+        if (!out.empty()) out += ";";
+        out += pair.first + "=" + format_samples(samples);
+    }
+    return Result(out, true);
+}
+
+// Vector set operations
+KVStore::Result KVStore::vec_create(const std::string& key, size_t dim, const std::string& metric) {
+    VectorSet::Metric m;
+    if (dim == 0 || dim > 32768) {
+        return Result("ERROR: vector dimension must be between 1 and 32768", false);
+    }
+    if (!VectorSet::parse_metric(metric, m)) {
+        return Result("ERROR: metric must be L2, IP or COSINE", false);
+    }
+    if (vectors_.find(key) != vectors_.end()) {
+        return Result("ERROR: key already exists", false);
+    }
+    vectors_.emplace(std::piecewise_construct, std::forward_as_tuple(key), std::forward_as_tuple(dim, m));
+    return Result("OK", true);
+}
+
+KVStore::Result KVStore::vec_add(const std::string& key, const std::string& id, const std::vector<float>& vec) {
+    auto it = vectors_.find(key);
+    if (it == vectors_.end()) {
+        // Created on first add with the dimension of that vector
+        if (vec.empty() || vec.size() > 32768) {
+            return Result("ERROR: vector dimension must be between 1 and 32768", false);
+        }
+        it = vectors_.emplace(std::piecewise_construct, std::forward_as_tuple(key),
+                              std::forward_as_tuple(vec.size(), VectorSet::Metric::L2)).first;
+    }
+    if (vec.size() != it->second.dim()) {
+        return Result("ERROR: vector dimension mismatch, expected " + std::to_string(it->second.dim()), false);
+    }
+    return Result(it->second.add(id, vec.data()) ? "1" : "0", true);
+}
+
+KVStore::Result KVStore::vec_del(const std::string& key, const std::string& id) {
+    auto it = vectors_.find(key);
+    if (it == vectors_.end() || !it->second.remove(id)) {
+        return Result("0", true);
+    }
+    if (it->second.size() == 0) {
+        vectors_.erase(it);
+    }
+    return Result("1", true);
+}
+
+KVStore::Result KVStore::vec_knn(const std::string& key, size_t k, const std::vector<float>& query,
+                                 size_t nprobe) const {
+    const VectorSet* set = vector_set(key);
+    if (!set) {
+        return Result("", true);
+    }
+    if (query.size() != set->dim()) {
+        return Result("ERROR: vector dimension mismatch, expected " + std::to_string(set->dim()), false);
+    }
+    std::vector<VectorSet::Match> matches;
+    set->knn(query.data(), k, nprobe, matches);
+    std::string out;
+    for (const auto& m : matches) {
+        if (!out.empty()) out += ",";
+        out += m.id + ":" + format_double(m.distance);
+    }
+    return Result(out, true);
+}
+
+KVStore::Result KVStore::vec_build_ivf(const std::string& key, size_t nlist) {
+    auto it = vectors_.find(key);
+    if (it == vectors_.end()) {
+        return Result("ERROR: no such key", false);
+    }
+    if (nlist == 0) {
+        return Result("ERROR: list count must be positive", false);
+    }
+    it->second.build_ivf(nlist);
+    return Result("OK", true);
+}
+
+KVStore::Result KVStore::vec_card(const std::string& key) const {
+    const VectorSet* set = vector_set(key);
+    return Result(std::to_string(set ? set->size() : 0), true);
+}
+
+const VectorSet* KVStore::vector_set(const std::string& key) const {
+    auto it = vectors_.find(key);
+    return it == vectors_.end() || is_expired(key) ? nullptr : &it->second;
+}
+
+// JSON document operations
+KVStore::Result KVStore::json_set(const std::string& key, const std::string& path, const std::string& json) {
+    auto it = jsons_.find(key);
+    if (it == jsons_.end()) {
+        // A new key can only be created at the root
+        JsonDoc doc;
+        std::string error;
+        if (path != "$" && path != ".") {
+            return Result("ERROR: new objects must be created at the root", false);
+        }
+        if (!doc.parse(json, error)) {
+            return Result("ERROR: invalid JSON: " + error, false);
+        }
+        jsons_.emplace(key, std::move(doc));
+        return Result("OK", true);
+    }
+    std::string error;
+    switch (it->second.set(path, json, error)) {
+        case JsonDoc::SetResult::InPlace:
+        case JsonDoc::SetResult::Spliced:
+            return Result("OK", true);
+        case JsonDoc::SetResult::NotFound:
+            return Result("", true);
+        case JsonDoc::SetResult::BadPath:
+            return Result("ERROR: invalid path", false);
+        case JsonDoc::SetResult::BadJson:
+        default:
+            return Result("ERROR: invalid JSON: " + error, false);
+    }
+}
+
+KVStore::Result KVStore::json_get(const std::string& key, const std::string& path) const {
+    auto it = jsons_.find(key);
+    std::string out;
+    if (it == jsons_.end() || is_expired(key) || !it->second.get(path, out)) {
+        return Result("", true);
+    }
+    return Result(out, true);
+}
+
+KVStore::Result KVStore::json_numincrby(const std::string& key, const std::string& path, const std::string& by) {
+    double delta;
+    try {
+        size_t idx;
+        delta = std::stod(by, &idx);
+        if (idx != by.size() || !std::isfinite(delta)) {
+            return Result("ERROR: increment is not a number", false);
+        }
+    } catch (const std::exception&) {
+        return Result("ERROR: increment is not a number", false);
+    }
+    // Integer increments keep integer fields exact; anything else goes through double
+    int64_t delta_int = 0;
+    bool is_int = false;
+    if (by.find_first_of(".eE") == std::string::npos) {
+        errno = 0;
+        delta_int = std::strtoll(by.c_str(), nullptr, 10);
+        is_int = errno == 0;
+    }
+    auto it = jsons_.find(key);
+    if (it == jsons_.end()) {
+        return Result("ERROR: no such key", false);
+    }
+    std::string out;
+    switch (it->second.numincrby(path, delta, is_int, delta_int, out)) {
+        case JsonDoc::IncrResult::Ok:
+            return Result(out, true);
+        case JsonDoc::IncrResult::NotNumber:
+            return Result("ERROR: value at path is not a number", false);
+        case JsonDoc::IncrResult::Overflow:
+            return Result("ERROR: result is not a finite number", false);
+        case JsonDoc::IncrResult::BadPath:
+            return Result("ERROR: invalid path", false);
+        case JsonDoc::IncrResult::NotFound:
+        default:
+            return Result("ERROR: path does not exist", false);
+    }
+}
+
+KVStore::Result KVStore::json_type(const std::string& key, const std::string& path) const {
+    auto it = jsons_.find(key);
+    std::string out;
+    if (it == jsons_.end() || is_expired(key) || !it->second.type(path, out)) {
+        return Result("", true);
+    }
+    return Result(out, true);
+}
+
+// Geo operations
+KVStore::Result KVStore::geoadd(const std::string& key, const std::string& points) {
+    std::vector<std::string> args = split_args(points);
+    if (args.empty() || args.size() % 3 != 0) {
+        return Result("ERROR: geoadd expects lon,lat,member triples", false);
+    }
+    // Validate every triple before touching the set
+    std::vector<GeoSet::Point> parsed;
+    for (size_t i = 0; i < args.size(); i += 3) {
+        GeoSet::Point p;
+        if (!parse_geo_number(args[i], p.lon) || !parse_geo_number(args[i + 1], p.lat) || !GeoSet::valid(p)) {
+            return Result("ERROR: invalid longitude,latitude pair " + args[i] + "," + args[i + 1], false);
+        }
+        parsed.push_back(p);
+    }
+    GeoSet& set = geos_[key];
+    int added = 0;
+    for (size_t i = 0; i < parsed.size(); i++) {
+        if (set.add(args[3 * i + 2], parsed[i])) {
+            added++;
+        }
+    }
+    return Result(std::to_string(added), true);
+}
+
+KVStore::Result KVStore::geodist(const std::string& key, const std::string& member1, const std::string& member2,
+                                 const std::string& unit) const {
+    double meters;
+    if (!parse_geo_unit(unit, meters)) {
+        return Result("ERROR: unit must be m, km, mi or ft", false);
+    }
+    auto it = geos_.find(key);
+    GeoSet::Point a, b;
+    if (it == geos_.end() || is_expired(key) || !it->second.position(member1, a) ||
+        !it->second.position(member2, b)) {
+        return Result("", true);
+    }
+    return Result(format_geo(GeoSet::distance(a, b) / meters), true);
+}
+
+KVStore::Result KVStore::geopos(const std::string& key, const std::string& members) const {
+    auto it = geos_.find(key);
+    bool live = it != geos_.end() && !is_expired(key);
+    std::string out;
+    bool first = true;
+    for (const auto& member : split_args(members)) {
+        if (!first) out += ";";
+        first = false;
+        GeoSet::Point p;
+        if (live && it->second.position(member, p)) {
+            out += format_double(p.lon) + "," + format_double(p.lat);
+        }
+    }
+    return Result(out, true);
+}
+
+KVStore::Result KVStore::geosearch(const std::string& key, const std::string& query) const {
+    std::vector<std::string> args = split_args(query);
+    GeoSet::Query q;
+    bool has_center = false, has_shape = false;
+    std::string from_member;
+    double unit = 1;
+    for (size_t i = 0; i < args.size(); i++) {
+        std::string opt = args[i];
+        std::transform(opt.begin(), opt.end(), opt.begin(), ::toupper);
+        size_t left = args.size() - i - 1;
+        if (opt == "FROMLONLAT" && left >= 2) {
+            if (!parse_geo_number(args[i + 1], q.center.lon) || !parse_geo_number(args[i + 2], q.center.lat) ||
+                !GeoSet::valid(q.center)) {
+                return Result("ERROR: invalid longitude,latitude pair", false);
+            }
+            has_center = true;
+            i += 2;
+        } else if (opt == "FROMMEMBER" && left >= 1) {
+            from_member = args[++i];
+            has_center = true;
+        } else if (opt == "BYRADIUS" && left >= 2) {
+            if (!parse_geo_number(args[i + 1], q.radius_m) || q.radius_m < 0 || !parse_geo_unit(args[i + 2], unit)) {
+                return Result("ERROR: invalid radius or unit", false);
+            }
+            q.by_radius = true;
+            q.radius_m *= unit;
+            has_shape = true;
+            i += 2;
+        } else if (opt == "BYBOX" && left >= 3) {
+            if (!parse_geo_number(args[i + 1], q.width_m) || !parse_geo_number(args[i + 2], q.height_m) ||
+                q.width_m < 0 || q.height_m < 0 || !parse_geo_unit(args[i + 3], unit)) {
+                return Result("ERROR: invalid box size or unit", false);
+            }
+            q.by_radius = false;
+            q.width_m *= unit;
+            q.height_m *= unit;
+            has_shape = true;
+            i += 3;
+        } else if (opt == "ASC") {
+            q.descending = false;
+        } else if (opt == "DESC") {
+            q.descending = true;
+        } else if (opt == "COUNT" && left >= 1) {
+            try {
+                q.count = std::stoul(args[++i]);
+            } catch (const std::exception&) {
+                return Result("ERROR: invalid COUNT", false);
+            }
+        } else {
+            return Result("ERROR: syntax error near " + args[i], false);
+        }
+    }
+    if (!has_center || !has_shape) {
+        return Result("ERROR: geosearch needs FROMLONLAT or FROMMEMBER and BYRADIUS or BYBOX", false);
+    }
+
+    auto it = geos_.find(key);
+    if (it == geos_.end() || is_expired(key)) {
+        return Result("", true);
+    }
+    if (!from_member.empty() && !it->second.position(from_member, q.center)) {
+        return Result("ERROR: member does not exist", false);
+    }
+    std::vector<GeoSet::Match> matches;
+    it->second.search(q, matches);
+    std::string out;
+    for (const auto& m : matches) {
+        if (!out.empty()) out += ",";
+        out += m.member + ":" + format_geo(m.distance_m / unit);
+    }
+    return Result(out, true);
+}
+
+// GCRA rate limiting
+bool KVStore::has_throttle(const std::string& key) const {
+    auto it = throttles_.find(key);
+    if (it == throttles_.end()) {
+        return false;
+    }
+    int64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                      std::chrono::steady_clock::now().time_since_epoch()).count();
+    return it->second > now;
+}
+
+KVStore::Result KVStore::throttle(const std::string& key, const std::string& args) {
+    const int64_t kSecond = 1000000000;
+    // Parsed in place; a decision allocates nothing but its reply
+    int64_t fields[5] = {0, 0, 0, 1, 0};
+    size_t n = 0;
+    const char* p = args.c_str();
+    while (n < 5) {
+        char* stop;
+        errno = 0;
+        fields[n++] = std::strtoll(p, &stop, 10);
+        if (stop == p || errno == ERANGE || (*stop != ',' && *stop != '\0')) {
+            return Result("ERROR: value is not an integer", false);
+        }
+        if (*stop == '\0') {
+            break;
+        }
+        p = stop + 1;
+    }
+    if (n != 3 && n != 4) {
+        return Result("ERROR: THROTTLE needs max_burst,count,period[,quantity]", false);
+    }
+    int64_t max_burst = fields[0], count = fields[1], period = fields[2], quantity = fields[3];
+    if (max_burst < 0 || count <= 0 || period <= 0 || quantity < 0) {
+        return Result("ERROR: max_burst and quantity must be >= 0, count and period > 0", false);
+    }
+
+    // One cell costs `interval`; a key may run up to `tolerance` ahead of now
+    int64_t period_ns, interval, tolerance, increment;
+    if (__builtin_mul_overflow(period, kSecond, &period_ns) || (interval = period_ns / count) == 0 ||
+        __builtin_mul_overflow(interval, max_burst + 1, &tolerance) ||
+        __builtin_mul_overflow(interval, quantity, &increment)) {
+        return Result("ERROR: rate out of range", false);
+    }
+
+    int64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                      std::chrono::steady_clock::now().time_since_epoch()).count();
+    if (throttles_.size() >= throttle_sweep_at_) {
+        for (auto it = throttles_.begin(); it != throttles_.end();) {
+            it = it->second <= now ? throttles_.erase(it) : std::next(it);
+        }
+        throttle_sweep_at_ = std::max<size_t>(1024, throttles_.size() * 2);
+    }
+
+    // The one lookup; a new or lapsed key starts at now
+    auto slot = throttles_.try_emplace(key, now).first;
+    int64_t tat = std::max(slot->second, now);
+    int64_t new_tat = tat + increment;
+    int64_t allow_at = new_tat - tolerance;
+    bool limited = now < allow_at;
+    int64_t retry_after = -1;
+    int64_t ttl;
+    if (limited) {
+        if (increment <= tolerance) {
+            retry_after = allow_at - now;
+        }
+        ttl = tat - now;
+    } else {
+        slot->second = new_tat;   // the one write
+        ttl = new_tat - now;
+    }
+    if (ttl <= 0) {
+        throttles_.erase(slot);
+    }
+    int64_t next = tolerance - ttl;
+    int64_t remaining = next > -interval ? next / interval : 0;
+
+    auto seconds = [&](int64_t ns) { return static_cast<long long>((ns + kSecond - 1) / kSecond); };
+    char reply[112];
+    int len = std::snprintf(reply, sizeof(reply), "%d,%lld,%lld,%lld,%lld", limited ? 1 : 0,
+                            static_cast<long long>(max_burst + 1), static_cast<long long>(remaining),
+                            retry_after < 0 ? -1LL : seconds(retry_after), seconds(ttl));
+    return Result(std::string(reply, len), true);
+}
+
+// Hot key tracking
+KVStore::Result KVStore::hotkeys(const std::string& args) {
+    std::vector<std::string> parts = split_args(args);
+    std::string sub = parts.empty() ? "" : parts[0];
+    std::transform(sub.begin(), sub.end(), sub.begin(), ::toupper);
+    try {
+        if (sub == "DECAY" && parts.size() == 2) {
+            long long ms = std::stoll(parts[1]);
+            if (ms < 0) {
+                return Result("ERROR: decay period must be >= 0 (0 disables decay)", false);
+            }
+            hotkeys_decay_ms_ = ms;
+            schedule_hotkeys_decay();
+            return Result("OK", true);
+        }
+        if (sub == "SAMPLE" && parts.size() == 2) {
+            long long n = std::stoll(parts[1]);
+            if (n < 0 || n > UINT32_MAX) {
+                return Result("ERROR: sample rate must be 1 in n with n >= 0 (0 disables tracking)", false);
+            }
+            hotkeys_.set_sample_every(static_cast<uint32_t>(n));
+            return Result("OK", true);
+        }
+        if (sub == "RESET" && parts.size() == 1) {
+            hotkeys_.reset();
+            return Result("OK", true);
+        }
+        if (sub == "REPLICATE" && parts.size() == 2) {
+            long long n = std::stoll(parts[1]);
+            if (n < 0) {
+                return Result("ERROR: replication threshold must be >= 0 (0 disables replicas)", false);
+            }
+            replica_min_accesses_ = static_cast<uint64_t>(n);
+            refresh_replicas();
+            return Result("OK", true);
+        }
+        if (sub == "REPLICAS" && parts.size() == 1) {
+            std::vector<std::string> keys;
+            replicas_.hot_keys(keys);
+            std::string out;
+            for (const auto& k : keys) {
+                if (!out.empty()) out += ",";
+                out += k;
+            }
+            return Result(out, true);
+        }
+        if (parts.size() > 1) {
+            return Result("ERROR: Invalid hotkeys format", false);
+        }
+        size_t n = parts.empty() ? 10 : std::stoul(parts[0]);
+        std::vector<HotKeys::Entry> top;
+        hotkeys_.top(n, top);
+        std::string out;
+        for (const auto& e : top) {
+            if (!out.empty()) out += ",";
+            out += e.key + ":" + std::to_string(e.count);
+        }
+        return Result(out, true);
+    } catch (const std::exception&) {
+        return Result("ERROR: Invalid hotkeys argument", false);
+    }
+}
+
+void KVStore::schedule_hotkeys_decay() {
+    if (hotkeys_timer_) {
+        timers_.cancel(hotkeys_timer_);
+        hotkeys_timer_ = 0;
+    }
+    if (hotkeys_decay_ms_ <= 0) {
+        return;
+    }
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(hotkeys_decay_ms_);
+    hotkeys_timer_ = timers_.schedule(deadline, [this]() {
+        hotkeys_timer_ = 0;
+        hotkeys_.decay();
+        schedule_hotkeys_decay();
+    });
+}
+
+bool KVStore::coalescable(const std::string& operation) {
+    return is_single_key_read(operation);
+}
+
+KVStore::ReplyType KVStore::reply_type(const std::string& operation) {
+    static const std::unordered_set<std::string> kStatus = {
+        "set", "ping", "pfmerge", "bf.reserve", "ts.create", "vec.create", "json.set", "idx.create", "idx.drop",
+        "counter.shard", "counter.unshard", "script.flush", "multi", "discard", "watch", "unwatch"};
+    static const std::unordered_set<std::string> kInteger = {
+        "incr", "decr", "incrby", "decrby", "lpush", "rpush", "llen", "hset", "hdel", "hexists", "del", "exists",
+        "expire", "ttl", "sadd", "sismember", "scard", "append", "setrange", "strlen", "setbit", "getbit",
+        "bitcount", "bitpos", "bitop", "publish", "pfadd", "pfcount", "bf.add", "bf.exists", "xtrim", "xlen",
+        "ts.add", "vec.add", "vec.del", "vec.card", "geoadd"};
+    if (kStatus.count(operation)) {
+        return kStatusReply;
+    }
+    return kInteger.count(operation) ? kIntegerReply : kBulkReply;
+}
+
+bool KVStore::slow_read_candidate(const std::string& operation) {
+    return operation == "keys";
+}
+
+size_t KVStore::read_cost(const std::string& operation) const {
+    if (operation == "keys") {
+        return store_.size() + ropes_.size() + lists_.size() + hashes_.size() + sets_.size() + hlls_.size() +
+               blooms_.size() + streams_.size() + timeseries_.size() + vectors_.size() + jsons_.size() +
+               geos_.size() + throttles_.size();
+    }
+    return 0;
+}
+
+KVStore::ReadJob KVStore::prepare_read(const std::string& operation, const std::string& key) const {
+    if (operation != "keys") {
+        return []() { return Result("ERROR: Invalid operation", false); };
+    }
+    std::string pattern = key;
+    return [pattern, names = live_keys()]() { return match_keys(pattern, names); };
+}
+
+// Chunked SMEMBERS/HGETALL/DEL
+class KVStore::Cursor {
+public:
+    std::string key;
+    bool registered = false;   // in cursors_, reading the live container
+    // A read cursor walks the key's live set or hash
+    const std::unordered_set<std::string>* members = nullptr;
+    std::unordered_set<std::string>::const_iterator member_it;
+    const std::unordered_map<std::string, std::string>* fields = nullptr;
+    std::unordered_map<std::string, std::string>::const_iterator field_it;
+    // A DEL cursor owns the containers it frees
+    std::unordered_set<std::string> doomed_members;
+    std::unordered_map<std::string, std::string> doomed_fields;
+    // The reply so far, one chunk per slice, so it is never copied to grow
+    std::vector<std::string> chunks;
+    size_t emitted = 0;
+
+    // Works until finished (true) or past the deadline; the clock is read every 32 elements
+    bool run(std::chrono::steady_clock::time_point deadline) {
+        size_t n = 0;
+        auto out_of_time = [&]() { return ++n % 32 == 0 && std::chrono::steady_clock::now() >= deadline; };
+        if (members || fields) {
+            chunks.emplace_back();
+        }
+        for (; members && member_it != members->end(); ++member_it) {
+            if (out_of_time()) return false;
+            if (emitted++ > 0) chunks.back() += ',';
+            chunks.back() += *member_it;
+        }
+        members = nullptr;
+        for (; fields && field_it != fields->end(); ++field_it) {
+            if (out_of_time()) return false;
+            if (emitted++ > 0) chunks.back() += ',';
+            chunks.back().append(field_it->first).append(1, ':').append(field_it->second);
+        }
+        fields = nullptr;
+        while (!doomed_members.empty()) {
+            if (out_of_time()) return false;
+            doomed_members.erase(doomed_members.begin());
+        }
+        while (!doomed_fields.empty()) {
+            if (out_of_time()) return false;
+            doomed_fields.erase(doomed_fields.begin());
+        }
+        return true;
+    }
+};
+
+std::shared_ptr<KVStore::Cursor> KVStore::begin_chunked(const std::string& operation, const std::string& key) {
+    bool deleting = operation == "del";
+    if ((!deleting && operation != "smembers" && operation != "hgetall") ||
+        (!counters_.empty() && counters_.contains(key))) {
+        return nullptr;
+    }
+    auto set_it = operation == "hgetall" ? sets_.end() : sets_.find(key);
+    auto hash_it = operation == "smembers" ? hashes_.end() : hashes_.find(key);
+    size_t elements = (set_it == sets_.end() ? 0 : set_it->second.size()) +
+                      (hash_it == hashes_.end() ? 0 : hash_it->second.size());
+    if (elements < kSlowReadElements) {
+        return nullptr;
+    }
+
+    auto cursor = std::make_shared<Cursor>();
+    cursor->key = key;
+    chunked_commands_++;
+    if (deleting) {
+        // The key goes now; its elements are freed slice by slice
+        versions_.bump(key);
+        detach_cursors(key);
+        if (set_it != sets_.end()) {
+            cursor->doomed_members = std::move(set_it->second);
+        }
+        if (hash_it != hashes_.end()) {
+            cursor->doomed_fields = std::move(hash_it->second);
+        }
+        cursor->chunks.push_back(del(key).value);
+        return cursor;
+    }
+    if (set_it != sets_.end()) {
+        cursor->members = &set_it->second;
+        cursor->member_it = set_it->second.begin();
+    } else {
+        cursor->fields = &hash_it->second;
+        cursor->field_it = hash_it->second.begin();
+    }
+    cursor->registered = true;
+    cursors_[key].push_back(cursor);
+    return cursor;
+}
+
+bool KVStore::step_chunked(Cursor& cursor) {
+    chunk_slices_++;
+    if (!cursor.run(std::chrono::steady_clock::now() + std::chrono::microseconds(chunk_budget_us_))) {
+        return false;
+    }
+    if (cursor.registered) {
+        auto it = cursors_.find(cursor.key);
+        auto& list = it->second;
+        for (size_t i = 0; i < list.size(); i++) {
+            if (list[i].get() == &cursor) {
+                list.erase(list.begin() + i);
+                break;
+            }
+        }
+        if (list.empty()) {
+            cursors_.erase(it);
+        }
+        cursor.registered = false;
+    }
+    return true;
+}
+
+KVStore::Result KVStore::chunked_reply(Cursor& cursor) {
+    size_t size = 0;
+    for (const auto& chunk : cursor.chunks) {
+        size += chunk.size();
+    }
+    std::string reply;
+    reply.reserve(size);
+    for (const auto& chunk : cursor.chunks) {
+        reply += chunk;
+    }
+    cursor.chunks.clear();
+    return Result(std::move(reply), true);
+}
+
+void KVStore::detach_cursors(const std::string& key) {
+    auto it = cursors_.find(key);
+    if (it == cursors_.end()) {
+        return;
+    }
+    // Finish their reads of the key before it changes
+    for (const auto& cursor : it->second) {
+        cursor->run(std::chrono::steady_clock::time_point::max());
+        cursor->registered = false;
+        chunk_detached_++;
+    }
+    cursors_.erase(it);
+}
+
+void KVStore::detach_all_cursors() {
+    while (!cursors_.empty()) {
+        detach_cursors(cursors_.begin()->first);
+    }
+}
+
+KVStore::Result KVStore::chunking(const std::string& args) {
+    std::vector<std::string> parts = split_args(args);
+    if (parts.empty()) {
+        size_t active = 0;
+        for (const auto& pair : cursors_) {
+            active += pair.second.size();
+        }
+        return Result("active:" + std::to_string(active) + ",budget_us:" + std::to_string(chunk_budget_us_) +
+                          ",commands:" + std::to_string(chunked_commands_) +
+                          ",slices:" + std::to_string(chunk_slices_) +
+                          ",detached:" + std::to_string(chunk_detached_),
+                      true);
+    }
+    std::string sub = parts[0];
+    std::transform(sub.begin(), sub.end(), sub.begin(), ::toupper);
+    if (parts.size() == 2 && sub == "BUDGET") {
+        try {
+            long long us = std::stoll(parts[1]);
+            if (us <= 0) {
+                return Result("ERROR: budget must be > 0", false);
+            }
+            chunk_budget_us_ = us;
+            return Result("OK", true);
+        } catch (const std::exception&) {
+        }
+    }
+    return Result("ERROR: Invalid chunking argument", false);
+}
+
+// Result cache
+void KVStore::cache_read(const std::string& operation, const std::string& key, const std::string& value,
+                         const ResultCache::Stamp& stamp, const Result& result) {
+    if (result.success) {
+        results_.store(operation, key, value, stamp, result.value);
+    }
+}
+
+KVStore::Result KVStore::resultcache(const std::string& args) {
+    std::vector<std::string> parts = split_args(args);
+    if (parts.empty()) {
+        return Result(results_.stats(), true);
+    }
+    std::string sub = parts[0];
+    std::transform(sub.begin(), sub.end(), sub.begin(), ::toupper);
+    if (parts.size() == 1 && (sub == "ON" || sub == "OFF")) {
+        results_.set_enabled(sub == "ON");
+        return Result("OK", true);
+    }
+    if (parts.size() == 2 && sub == "BUDGET") {
+        try {
+            long long bytes = std::stoll(parts[1]);
+            if (bytes < 0) {
+                return Result("ERROR: budget must be >= 0", false);
+            }
+            results_.set_budget(static_cast<size_t>(bytes));
+            return Result("OK", true);
+        } catch (const std::exception&) {
+        }
+    }
+    return Result("ERROR: Invalid resultcache argument", false);
+}
+
+// Scripts
+KVStore::Result KVStore::script_load(const std::string& source) {
+    std::string error;
+    std::shared_ptr<const Script> script = Script::compile(source, error);
+    if (!script) {
+        return Result(error, false);
+    }
+    std::string sha = sha1_hex(source);
+    scripts_[sha] = std::move(script);
+    return Result(sha, true);
+}
+
+KVStore::Result KVStore::script_exists(const std::string& shas) const {
+    std::ostringstream result;
+    bool first = true;
+    for (const auto& sha : split_args(shas)) {
+        if (!first) result << ",";
+        result << (scripts_.count(sha) ? "1" : "0");
+        first = false;
+    }
+    return Result(result.str(), true);
+}
+
+KVStore::Result KVStore::script_flush() {
+    scripts_.clear();
+    return Result("OK", true);
+}
+
+KVStore::Result KVStore::evalsha(const std::string& sha, const std::string& args) {
+    auto it = scripts_.find(sha);
+    if (it == scripts_.end()) {
+        return Result("ERROR: NOSCRIPT No matching script. Please use SCRIPT LOAD.", false);
+    }
+    std::vector<std::string> parts = split_args(args);
+    size_t numkeys = 0;
+    try {
+        long long n = parts.empty() ? 0 : std::stoll(parts[0]);
+        if (n < 0 || static_cast<size_t>(n) > (parts.empty() ? 0 : parts.size() - 1)) {
+            return Result("ERROR: Number of keys can't be greater than number of args", false);
+        }
+        numkeys = static_cast<size_t>(n);
+    } catch (const std::exception&) {
+        return Result("ERROR: value is not an integer", false);
+    }
+    std::vector<std::string> keys, argv;
+    for (size_t i = 1; i < parts.size(); i++) {
+        (i <= numkeys ? keys : argv).push_back(parts[i]);
+    }
+
+    // Keep the script alive while it runs
+    std::shared_ptr<const Script> script = it->second;
+    std::string reply, error;
+    bool found = false;
+    bool ok = script->run(
+        keys, argv,
+        [this](const std::string& operation, const std::string& key, const std::string& value, std::string& out) {
+            Result r = execute_operation(operation, key, value);
+            out = std::move(r.value);
+            return r.success;
+        },
+        reply, found, error);
+    if (!ok) {
+        return Result(error, false);
+    }
+    return found ? Result(reply, true) : Result(false);
+}
+
+// Read replicas of hot keys
+bool KVStore::read_replica(const std::string& key, std::string& value) {
+    if (!replicas_.lookup(key, value)) {
+        return false;
+    }
+    // Keep the key's heat up even though the engine never sees this read
+    hotkeys_.record(key);
+    return true;
+}
+
+void KVStore::fill_replica(const std::string& key, const std::string& value) {
+    // Copies cannot expire on their own, so keys with a TTL are always read from the engine
+    if (expiry_times_.find(key) == expiry_times_.end() && (counters_.empty() || !counters_.contains(key))) {
+        replicas_.fill(key, value);
+    }
+}
+
+void KVStore::refresh_replicas() {
+    std::vector<std::string> keys;
+    if (replica_min_accesses_ > 0 && hotkeys_.sample_every() > 0) {
+        std::vector<HotKeys::Entry> top;
+        hotkeys_.top(ReadReplicas::kMaxHot, top);
+        for (const auto& e : top) {
+            if (e.count >= replica_min_accesses_) {
+                keys.push_back(e.key);
+            }
+        }
+    }
+    // Rank changes alone should not make every worker refresh its copy of the set
+    std::sort(keys.begin(), keys.end());
+    replicas_.publish(keys);
+}
+
+void KVStore::schedule_replica_refresh() {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(250);
+    timers_.schedule(deadline, [this]() {
+        refresh_replicas();
+        schedule_replica_refresh();
+    });
+}
+
+// Sharded counters
+bool KVStore::sharded_counter(const std::string& operation, const std::string& key, const std::string& value,
+                              std::string& result) {
+    if (counters_.empty()) {
+        return false;
+    }
+    int64_t total;
+    if (operation == "get") {
+        if (!counters_.read(key, total)) {
+            return false;
+        }
+        result = std::to_string(total);
+        return true;
+    }
+    int64_t delta;
+    if (operation == "incr") {
+        delta = 1;
+    } else if (operation == "decr") {
+        delta = -1;
+    } else if (operation == "incrby" || operation == "decrby") {
+        try {
+            delta = std::stoi(value);
+        } catch (const std::exception&) {
+            return false;   // the engine reports the bad argument
+        }
+        if (operation == "decrby") {
+            delta = -delta;
+        }
+    } else {
+        return false;
+    }
+    if (!counters_.add(key, delta, total)) {
+        return false;
+    }
+    result = std::to_string(total);
+    return true;
+}
+
+void KVStore::note_incr_contention(const std::string& operation, const std::string& key) {
+    if (counter_auto_threshold_ == 0 ||
+        (operation != "incr" && operation != "decr" && operation != "incrby" && operation != "decrby")) {
+        return;
+    }
+    if (++incr_contention_[key] >= counter_auto_threshold_) {
+        incr_contention_.erase(key);
+        shard_counter(key);
+    }
+}
+
+KVStore::Result KVStore::shard_counter(const std::string& key) {
+    if (counters_.contains(key)) {
+        return Result("OK", true);
+    }
+    // Slots cannot expire, and a rope is never an integer
+    if (expiry_times_.count(key) || ropes_.count(key)) {
+        return Result("ERROR: only integer keys without a TTL can be sharded", false);
+    }
+    int64_t base = 0;
+    auto it = store_.find(key);
+    if (it != store_.end()) {
+        try {
+            size_t idx;
+            long long v = std::stoll(it->second, &idx);
+            if (idx != it->second.size() || v < INT_MIN || v > INT_MAX) {
+                return Result("ERROR: value is not an integer", false);
+            }
+            base = v;
+        } catch (const std::exception&) {
+            return Result("ERROR: value is not an integer", false);
+        }
+    } else {
+        store_[key] = "0";
+    }
+    versions_.bump(key);
+    counters_.shard(key, base);
+    return Result("OK", true);
+}
+
+KVStore::Result KVStore::unshard_counter(const std::string& key) {
+    if (!counters_.contains(key)) {
+        return Result("ERROR: key is not a sharded counter", false);
+    }
+    fold_counter(key);
+    return Result("OK", true);
+}
+
+void KVStore::fold_counter(const std::string& key) {
+    int64_t total;
+    if (counters_.unshard(key, total)) {
+        store_[key] = std::to_string(total);
+        versions_.bump(key);
+    }
+}
+
+KVStore::Result KVStore::counters(const std::string& args) {
+    std::vector<std::string> parts = split_args(args);
+    if (parts.empty()) {
+        std::vector<std::string> keys;
+        counters_.keys(keys);
+        std::string out;
+        for (const auto& k : keys) {
+            if (!out.empty()) out += ",";
+            out += k;
+        }
+        return Result(out, true);
+    }
+    std::string sub = parts[0];
+    std::transform(sub.begin(), sub.end(), sub.begin(), ::toupper);
+    if (sub == "AUTO" && parts.size() == 2) {
+        try {
+            long long n = std::stoll(parts[1]);
+            if (n < 0 || n > UINT32_MAX) {
+                return Result("ERROR: threshold must be >= 0 (0 disables conversion)", false);
+            }
+            counter_auto_threshold_ = static_cast<uint32_t>(n);
+            incr_contention_.clear();
+            return Result("OK", true);
+        } catch (const std::exception&) {
+        }
+    }
+    return Result("ERROR: Invalid counters argument", false);
+}
+
+void KVStore::schedule_contention_window() {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+    timers_.schedule(deadline, [this]() {
+        incr_contention_.clear();
+        schedule_contention_window();
+    });
+}
+
+// Admission control
+KVStore::Result KVStore::admission(const std::string& args) {
+    std::vector<std::string> parts = split_args(args);
+    if (parts.empty()) {
+        return Result("queued:" + std::to_string(admission_.queued()) +
+                          ",max_queue:" + std::to_string(admission_.max_queue()) +
+                          ",deadline_us:" + std::to_string(admission_.deadline_us()) +
+                          ",shed_full:" + std::to_string(admission_.shed_full()) +
+                          ",shed_late:" + std::to_string(admission_.shed_late()),
+                      true);
+    }
+    std::string sub = parts[0];
+    std::transform(sub.begin(), sub.end(), sub.begin(), ::toupper);
+    if (parts.size() == 2 && (sub == "MAXQUEUE" || sub == "DEADLINE")) {
+        try {
+            long long n = std::stoll(parts[1]);
+            if (n < 0) {
+                return Result("ERROR: limit must be >= 0 (0 disables it)", false);
+            }
+            if (sub == "MAXQUEUE") {
+                admission_.set_max_queue(static_cast<size_t>(n));
+            } else {
+                admission_.set_deadline_us(n);
+            }
+            return Result("OK", true);
+        } catch (const std::exception&) {
+        }
+    }
+    return Result("ERROR: Invalid admission argument", false);
+}
+
+// Bulk loading
+KVStore::Result KVStore::bulkload(const std::string& path, const std::string& args) {
+    BulkLoader::Load load;
+    std::string error;
+    if (!BulkLoader::read(path, args, load, error)) {
+        return Result(error, false);
     }
+    return bulk_insert(load);
+}
+
+KVStore::Result KVStore::bulk_insert(BulkLoader::Load& load) {
+    auto start = std::chrono::steady_clock::now();
+    detach_all_cursors();
     
-    return Result(result.str(), true);
+    // The rows are sorted, so each lands just after the previous one and the
+    // hint saves the tree search. Of equal keys the last row is kept.
+    size_t rows = load.rows.size();
+    auto hint = store_.end();
+    for (auto& row : load.rows) {
+        if (!ropes_.empty()) {
+            ropes_.erase(row.first);
+        }
+        int64_t folded;
+        if (!counters_.empty() && counters_.contains(row.first)) {
+            counters_.unshard(row.first, folded);   // the loaded value replaces the count
+        }
+        hint = std::next(store_.insert_or_assign(hint, std::move(row.first), std::move(row.second)));
+    }
+    BulkLoader::Run().swap(load.rows);
+    versions_.bump_all();
+    
+    int64_t insert_us = std::chrono::duration_cast<std::chrono::microseconds>(
+                            std::chrono::steady_clock::now() - start).count();
+    int64_t total_us = std::max<int64_t>(1, load.parse_us + insert_us);
+    return Result("rows:" + std::to_string(rows) + ",bytes:" + std::to_string(load.bytes) +
+                      ",threads:" + std::to_string(load.threads) + ",parse_ms:" + std::to_string(load.parse_us / 1000) +
+                      ",insert_ms:" + std::to_string(insert_us / 1000) +
+                      ",rows_per_sec:" + std::to_string(static_cast<uint64_t>(rows * 1000000.0 / total_us)),
+                  true);
+}
+
+KVStore::Result KVStore::debug_populate(const std::string& count, const std::string& args) {
+    BulkLoader::Populate spec;
+    std::string error;
+    if (!BulkLoader::parse_populate(count, args, spec, error)) {
+        return Result(error, false);
+    }
+    BulkLoader::Load load;
+    BulkLoader::generate(spec, load);
+    return populate_insert(load, spec);
+}
+
+KVStore::Result KVStore::populate_insert(BulkLoader::Load& load, const BulkLoader::Populate& spec) {
+    typedef BulkLoader::Populate Populate;
+    auto start = std::chrono::steady_clock::now();
+    detach_all_cursors();
+    
+    // Sorted rows again, with no key repeated; each type's map gets its keys
+    // in order too, so every map keeps its own hint. Into an empty keyspace
+    // nothing can collide and the existence check is skipped.
+    bool fresh = read_cost("keys") == 0;
+    auto expires_at = std::chrono::steady_clock::now() + std::chrono::seconds(spec.ttl_seconds);
+    auto strings = store_.end();
+    auto hashes = hashes_.end();
+    auto lists = lists_.end();
+    auto sets = sets_.end();
+    auto expiries = expiry_times_.end();
+    size_t added[Populate::kTypes] = {0, 0, 0, 0};
+    size_t expiring = 0;
+    for (auto& row : load.rows) {
+        if (!fresh) {
+            if (exists(row.first).value != "0") {
+                continue;
+            }
+            // exists() does not see an expired key the maps still hold; it goes
+            if (clear_key(row.first)) {
+                strings = store_.end();
+                hashes = hashes_.end();
+                lists = lists_.end();
+                sets = sets_.end();
+                expiries = expiry_times_.end();
+            }
+        }
+        bool expires;
+        Populate::Type type = spec.pick(row.first, expires);
+        if (expires) {
+            expiries = std::next(expiry_times_.emplace_hint(expiries, row.first, expires_at));
+            expiring++;
+        }
+        added[type]++;
+        if (type == Populate::kString) {
+            strings = std::next(store_.emplace_hint(strings, std::move(row.first), std::move(row.second)));
+        } else if (type == Populate::kHash) {
+            hashes = hashes_.emplace_hint(hashes, std::move(row.first), std::unordered_map<std::string, std::string>());
+            for (size_t i = 0; i < spec.elements; i++) {
+                std::string field = "field:" + std::to_string(i);
+                if (!indexes_.empty()) {
+                    index_hash_field(hashes->first, field, &row.second);
+                }
+                hashes->second.emplace(std::move(field), row.second);
+            }
+            ++hashes;
+        } else if (type == Populate::kList) {
+            lists = lists_.emplace_hint(lists, std::move(row.first), std::list<std::string>(spec.elements, row.second));
+            ++lists;
+        } else {
+            sets = sets_.emplace_hint(sets, std::move(row.first), std::unordered_set<std::string>());
+            sets->second.reserve(spec.elements);
+            for (size_t i = 0; i < spec.elements; i++) {
+                sets->second.insert(std::to_string(i) + ":" + row.second);
+            }
+            ++sets;
+        }
+    }
+    BulkLoader::Run().swap(load.rows);
+    versions_.bump_all();
+    
+    int64_t insert_us = std::chrono::duration_cast<std::chrono::microseconds>(
+                            std::chrono::steady_clock::now() - start).count();
+    size_t total = added[Populate::kString] + added[Populate::kHash] + added[Populate::kList] + added[Populate::kSet];
+    int64_t total_us = std::max<int64_t>(1, load.parse_us + insert_us);
+    return Result("keys:" + std::to_string(total) + ",strings:" + std::to_string(added[Populate::kString]) +
+                      ",hashes:" + std::to_string(added[Populate::kHash]) + ",lists:" +
+                      std::to_string(added[Populate::kList]) + ",sets:" + std::to_string(added[Populate::kSet]) +
+                      ",expiring:" + std::to_string(expiring) + ",threads:" + std::to_string(load.threads) +
+                      ",generate_ms:" + std::to_string(load.parse_us / 1000) + ",insert_ms:" +
+                      std::to_string(insert_us / 1000) +
+                      ",keys_per_sec:" + std::to_string(static_cast<uint64_t>(total * 1000000.0 / total_us)),
+                  true);
+}
+
+// Keyspace export and import
+KVStore::Result KVStore::keyspace_export(const std::string& dir, const std::string& args) {
+    KeyspaceDump::Child child;
+    Result started = export_begin(dir, args, child);
+    if (!started.success) {
+        return started;
+    }
+    return export_finish(child);
+}
+
+KVStore::Result KVStore::export_begin(const std::string& dir, const std::string& args, KeyspaceDump::Child& child) {
+    size_t threads;
+    bool partial;
+    std::string error;
+    if (!KeyspaceDump::parse_export(args, threads, partial, error)) {
+        return Result(error, false);
+    }
+    if (dir.empty()) {
+        return Result("ERROR: EXPORT takes dir [THREADS n] [PARTIAL]", false);
+    }
+    // A dump that leaves keys out is only written when asked for
+    size_t skipped = hlls_.size() + blooms_.size() + streams_.size() + timeseries_.size() + vectors_.size() +
+                     jsons_.size() + geos_.size();
+    if (skipped > 0 && !partial) {
+        return Result("ERROR: " + std::to_string(skipped) +
+                          " keys are of types EXPORT cannot dump (only strings, hashes, lists and sets); "
+                          "use PARTIAL to export without them",
+                      false);
+    }
+    
+    // Sharded counters are summed here; their registry lock may be held by
+    // another thread when the child is forked
+    std::unordered_map<std::string, int64_t> counters;
+    if (!counters_.empty()) {
+        std::vector<std::string> keys;
+        counters_.keys(keys);
+        for (const auto& key : keys) {
+            int64_t total;
+            if (counters_.value(key, total)) {
+                counters[key] = total;
+            }
+        }
+    }
+    auto work = [&](std::string& reply) { return export_child(dir, threads, skipped, counters, reply); };
+    if (!KeyspaceDump::spawn(work, child, error)) {
+        return Result(error, false);
+    }
+    return Result(true);
+}
+
+KVStore::Result KVStore::export_finish(KeyspaceDump::Child& child) {
+    std::string reply;
+    if (!KeyspaceDump::wait(child, reply)) {
+        return Result(reply, false);
+    }
+    return Result(reply + ",fork_us:" + std::to_string(child.fork_us), true);
+}
+
+bool KVStore::export_child(const std::string& dir, size_t threads, size_t skipped,
+                           const std::unordered_map<std::string, int64_t>& counters, std::string& reply) const {
+    auto start = std::chrono::steady_clock::now();
+    
+    // The keyspace is cut into key ranges at keys of the biggest type's map,
+    // so the parts come out about the same size when one type dominates
+    size_t total = store_.size() + ropes_.size() + hashes_.size() + lists_.size() + sets_.size();
+    size_t parts = std::max<size_t>(1, std::min(threads, total / KeyspaceDump::kMinPartKeys));
+    std::vector<std::string> cuts;
+    if (parts > 1) {
+        size_t biggest = std::max({store_.size(), hashes_.size(), lists_.size(), sets_.size()});
+        if (biggest == store_.size()) {
+            cuts = split_points(store_, parts);
+        } else if (biggest == hashes_.size()) {
+            cuts = split_points(hashes_, parts);
+        } else if (biggest == lists_.size()) {
+            cuts = split_points(lists_, parts);
+        } else {
+            cuts = split_points(sets_, parts);
+        }
+        parts = cuts.size() + 1;
+    }
+    
+    std::vector<ExportStats> stats(parts);
+    std::vector<std::thread> workers;
+    for (size_t i = 1; i < parts; i++) {
+        workers.emplace_back(&KVStore::export_part, this, std::cref(dir), i, parts, &cuts[i - 1],
+                             i + 1 < parts ? &cuts[i] : nullptr, std::cref(counters), std::ref(stats[i]));
+    }
+    export_part(dir, 0, parts, nullptr, parts > 1 ? &cuts[0] : nullptr, counters, stats[0]);
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    
+    ExportStats sum = ExportStats();
+    for (const auto& part : stats) {
+        if (!part.error.empty()) {
+            reply = part.error;
+            return false;
+        }
+        for (int type = KeyspaceDump::kString; type <= KeyspaceDump::kSet; type++) {
+            sum.added[type] += part.added[type];
+        }
+        sum.expiring += part.expiring;
+        sum.keys += part.keys;
+        sum.bytes += part.bytes;
+    }
+    KeyspaceDump::remove_parts(dir, parts);
+    
+    int64_t write_us = std::max<int64_t>(1, std::chrono::duration_cast<std::chrono::microseconds>(
+                                                std::chrono::steady_clock::now() - start).count());
+    reply = "keys:" + std::to_string(sum.keys) + ",strings:" + std::to_string(sum.added[KeyspaceDump::kString]) +
+            ",hashes:" + std::to_string(sum.added[KeyspaceDump::kHash]) +
+            ",lists:" + std::to_string(sum.added[KeyspaceDump::kList]) +
+            ",sets:" + std::to_string(sum.added[KeyspaceDump::kSet]) + ",expiring:" + std::to_string(sum.expiring) +
+            ",skipped:" + std::to_string(skipped) + ",files:" + std::to_string(parts) +
+            ",bytes:" + std::to_string(sum.bytes) + ",threads:" + std::to_string(parts) +
+            ",write_ms:" + std::to_string(write_us / 1000) +
+            ",mb_per_sec:" + format_rate(static_cast<double>(sum.bytes) / write_us);
+    return true;
+}
+
+void KVStore::export_part(const std::string& dir, size_t part, size_t parts, const std::string* lo,
+                          const std::string* hi, const std::unordered_map<std::string, int64_t>& counters,
+                          ExportStats& stats) const {
+    KeyspaceDump::Writer out;
+    if (!out.open(dir, part, parts, stats.error)) {
+        return;
+    }
+    
+    // Keys that expired before the fork are left out. Each walk below is in
+    // key order, so its expiries are found by a cursor over expiry_times_
+    // that only moves forward; rewind() starts it over for the next walk.
+    auto now = std::chrono::steady_clock::now();
+    int64_t now_ms = KeyspaceDump::unix_ms(now);
+    auto expiries = key_range(expiry_times_, lo, hi);
+    auto expiry = expiries.first;
+    auto rewind = [&]() { expiry = expiries.first; };
+    auto live = [&](const std::string& key, int64_t& expire_ms) {
+        expire_ms = 0;
+        while (expiry != expiries.second && expiry->first < key) {
+            ++expiry;
+        }
+        if (expiry == expiries.second || expiry->first != key) {
+            return true;
+        }
+        if (expiry->second <= now) {
+            return false;
+        }
+        expire_ms = std::max<int64_t>(1, now_ms + std::chrono::duration_cast<std::chrono::milliseconds>(
+                                                      expiry->second - now).count());
+        stats.expiring++;
+        return true;
+    };
+    int64_t expire_ms;
+    
+    // Flat strings and ropes, merged into one run in key order
+    auto flat = key_range(store_, lo, hi);
+    auto ropes = key_range(ropes_, lo, hi);
+    std::vector<std::string_view> pieces;
+    while (flat.first != flat.second || ropes.first != ropes.second) {
+        bool rope = flat.first == flat.second ||
+                    (ropes.first != ropes.second && ropes.first->first < flat.first->first);
+        const std::string& key = rope ? ropes.first->first : flat.first->first;
+        if (live(key, expire_ms)) {
+            out.key(KeyspaceDump::kString, key, expire_ms);
+            auto counter = counters.empty() ? counters.end() : counters.find(key);
+            if (rope) {
+                pieces.clear();
+                ropes.first->second.range(0, ropes.first->second.size(), pieces);
+                out.string(pieces);
+            } else if (counter != counters.end()) {
+                std::string total = std::to_string(counter->second);
+                out.string(total.data(), total.size());
+            } else {
+                out.string(flat.first->second.data(), flat.first->second.size());
+            }
+            stats.added[KeyspaceDump::kString]++;
+        }
+        if (rope) {
+            ++ropes.first;
+        } else {
+            ++flat.first;
+        }
+    }
+    
+    rewind();
+    for (auto range = key_range(hashes_, lo, hi); range.first != range.second; ++range.first) {
+        if (live(range.first->first, expire_ms)) {
+            out.key(KeyspaceDump::kHash, range.first->first, expire_ms);
+            out.count(range.first->second.size());
+            for (const auto& field : range.first->second) {
+                out.string(field.first.data(), field.first.size());
+                out.string(field.second.data(), field.second.size());
+            }
+            stats.added[KeyspaceDump::kHash]++;
+        }
+    }
+    rewind();
+    for (auto range = key_range(lists_, lo, hi); range.first != range.second; ++range.first) {
+        if (live(range.first->first, expire_ms)) {
+            out.key(KeyspaceDump::kList, range.first->first, expire_ms);
+            out.count(range.first->second.size());
+            for (const auto& item : range.first->second) {
+                out.string(item.data(), item.size());
+            }
+            stats.added[KeyspaceDump::kList]++;
+        }
+    }
+    rewind();
+    for (auto range = key_range(sets_, lo, hi); range.first != range.second; ++range.first) {
+        if (live(range.first->first, expire_ms)) {
+            out.key(KeyspaceDump::kSet, range.first->first, expire_ms);
+            out.count(range.first->second.size());
+            for (const auto& member : range.first->second) {
+                out.string(member.data(), member.size());
+            }
+            stats.added[KeyspaceDump::kSet]++;
+        }
+    }
+    
+    out.close(stats.error);
+    stats.keys = out.keys();
+    stats.bytes = out.bytes();
+}
+
+bool KVStore::clear_key(const std::string& key) {
+    int64_t folded;
+    if (!counters_.empty() && counters_.contains(key)) {
+        counters_.unshard(key, folded);
+    }
+    size_t expiries = expiry_times_.size();
+    return del(key).value != "0" || expiry_times_.size() != expiries;
+}
+
+KVStore::Result KVStore::keyspace_import(const std::string& dir, const std::string& args) {
+    KeyspaceDump::Image image;
+    std::string error;
+    if (!KeyspaceDump::read(dir, args, image, error)) {
+        return Result(error, false);
+    }
+    return import_insert(image);
+}
+
+KVStore::Result KVStore::import_insert(KeyspaceDump::Image& image) {
+    auto start = std::chrono::steady_clock::now();
+    detach_all_cursors();
+    
+    // Each part has every type's keys in order and the parts follow one
+    // another, so each map keeps a hint as in populate_insert(). A key that
+    // is already there is deleted first, and since that may take the node a
+    // hint points at, the hints then start over.
+    bool fresh = read_cost("keys") == 0;
+    int64_t now_ms = KeyspaceDump::unix_ms(start);
+    auto strings = store_.end();
+    auto hashes = hashes_.end();
+    auto lists = lists_.end();
+    auto sets = sets_.end();
+    auto expiries = expiry_times_.end();
+    size_t added[KeyspaceDump::kSet + 1] = {0, 0, 0, 0, 0};
+    size_t expiring = 0;
+    size_t expired = 0;
+    for (auto& part : image.parts) {
+        for (auto& item : part) {
+            if (item.expire_ms != 0 && item.expire_ms <= now_ms) {
+                expired++;
+                continue;
+            }
+            // Not exists(): an expired key the maps still hold has to go as well
+            if (!fresh && clear_key(item.key)) {
+                strings = store_.end();
+                hashes = hashes_.end();
+                lists = lists_.end();
+                sets = sets_.end();
+                expiries = expiry_times_.end();
+            }
+            // A key the dump repeats keeps its first copy
+            const std::string* name = nullptr;
+            if (item.type == KeyspaceDump::kString) {
+                size_t before = store_.size();
+                auto it = store_.emplace_hint(strings, std::move(item.key), std::move(item.value));
+                if (store_.size() != before) {
+                    name = &it->first;
+                }
+                strings = std::next(it);
+            } else if (item.type == KeyspaceDump::kHash) {
+                size_t before = hashes_.size();
+                hashes = hashes_.emplace_hint(hashes, std::move(item.key), std::unordered_map<std::string, std::string>());
+                if (hashes_.size() != before) {
+                    name = &hashes->first;
+                    hashes->second.reserve(item.elements.size() / 2);
+                    for (size_t i = 0; i + 1 < item.elements.size(); i += 2) {
+                        if (!indexes_.empty()) {
+                            index_hash_field(hashes->first, item.elements[i], &item.elements[i + 1]);
+                        }
+                        hashes->second.insert_or_assign(std::move(item.elements[i]), std::move(item.elements[i + 1]));
+                    }
+                }
+                ++hashes;
+            } else if (item.type == KeyspaceDump::kList) {
+                size_t before = lists_.size();
+                lists = lists_.emplace_hint(lists, std::move(item.key), std::list<std::string>(
+                                                std::make_move_iterator(item.elements.begin()),
+                                                std::make_move_iterator(item.elements.end())));
+                if (lists_.size() != before) {
+                    name = &lists->first;
+                }
+                ++lists;
+            } else {
+                size_t before = sets_.size();
+                sets = sets_.emplace_hint(sets, std::move(item.key), std::unordered_set<std::string>(
+                                              std::make_move_iterator(item.elements.begin()),
+                                              std::make_move_iterator(item.elements.end())));
+                if (sets_.size() != before) {
+                    name = &sets->first;
+                }
+                ++sets;
+            }
+            if (name == nullptr) {
+                continue;
+            }
+            added[item.type]++;
+            if (item.expire_ms != 0) {
+                expiries = std::next(expiry_times_.emplace_hint(
+                    expiries, *name, start + std::chrono::milliseconds(item.expire_ms - now_ms)));
+                expiring++;
+            }
+        }
+        std::vector<KeyspaceDump::Item>().swap(part);
+    }
+    versions_.bump_all();
+    
+    int64_t insert_us = std::chrono::duration_cast<std::chrono::microseconds>(
+                            std::chrono::steady_clock::now() - start).count();
+    size_t total = added[KeyspaceDump::kString] + added[KeyspaceDump::kHash] + added[KeyspaceDump::kList] +
+                   added[KeyspaceDump::kSet];
+    int64_t total_us = std::max<int64_t>(1, image.parse_us + insert_us);
+    return Result("keys:" + std::to_string(total) + ",strings:" + std::to_string(added[KeyspaceDump::kString]) +
+                      ",hashes:" + std::to_string(added[KeyspaceDump::kHash]) +
+                      ",lists:" + std::to_string(added[KeyspaceDump::kList]) +
+                      ",sets:" + std::to_string(added[KeyspaceDump::kSet]) + ",expiring:" + std::to_string(expiring) +
+                      ",expired:" + std::to_string(expired) + ",files:" + std::to_string(image.parts.size()) +
+                      ",bytes:" + std::to_string(image.bytes) + ",threads:" + std::to_string(image.threads) +
+                      ",parse_ms:" + std::to_string(image.parse_us / 1000) +
+                      ",insert_ms:" + std::to_string(insert_us / 1000) +
+                      ",mb_per_sec:" + format_rate(static_cast<double>(image.bytes) / total_us),
+                  true);
+}
+
+// Key management operations
+bool KVStore::is_expired(const std::string& key) const {
+    auto it = expiry_times_.find(key);
+    if (it == expiry_times_.end()) {
+        return false; // No expiry set
+    }
+    return std::chrono::steady_clock::now() >= it->second;
+}
+
+KVStore::Result KVStore::exists(const std::string& key) const {
+    if (is_expired(key)) {
+        return Result("0", true);
+    }
+    
+    int count = 0;
+    if (has_string(key)) count++;
+    if (lists_.find(key) != lists_.end()) count++;
+    if (hashes_.find(key) != hashes_.end()) count++;
+    if (sets_.find(key) != sets_.end()) count++;
+    if (hlls_.find(key) != hlls_.end()) count++;
+    if (blooms_.find(key) != blooms_.end()) count++;
+    if (streams_.find(key) != streams_.end()) count++;
+    if (timeseries_.find(key) != timeseries_.end()) count++;
+    if (vectors_.find(key) != vectors_.end()) count++;
+    if (jsons_.find(key) != jsons_.end()) count++;
+    if (geos_.find(key) != geos_.end()) count++;
+    if (has_throttle(key)) count++;
+    
+    return Result(std::to_string(count), true);
+}
+
+KVStore::Result KVStore::expire(const std::string& key, int seconds) {
+    // Check if key exists in any store
+    bool key_exists = has_string(key) ||
+                      (lists_.find(key) != lists_.end()) ||
+                      (hashes_.find(key) != hashes_.end()) ||
+                      (sets_.find(key) != sets_.end()) ||
+                      (hlls_.find(key) != hlls_.end()) ||
+                      (blooms_.find(key) != blooms_.end()) ||
+                      (streams_.find(key) != streams_.end()) ||
+                      (timeseries_.find(key) != timeseries_.end()) ||
+                      (vectors_.find(key) != vectors_.end()) ||
+                      (jsons_.find(key) != jsons_.end()) ||
+                      (geos_.find(key) != geos_.end());
+    
+    if (!key_exists) {
+        return Result("0", true); // Key doesn't exist
+    }
+    
+    auto expiry_time = std::chrono::steady_clock::now() + std::chrono::seconds(seconds);
+    expiry_times_[key] = expiry_time;
+    return Result("1", true); // Expiry set
+}
+
+KVStore::Result KVStore::ttl(const std::string& key) const {
+    // Check if key exists
+    bool key_exists = has_string(key) ||
+                      (lists_.find(key) != lists_.end()) ||
+                      (hashes_.find(key) != hashes_.end()) ||
+                      (sets_.find(key) != sets_.end()) ||
+                      (hlls_.find(key) != hlls_.end()) ||
+                      (blooms_.find(key) != blooms_.end()) ||
+                      (streams_.find(key) != streams_.end()) ||
+                      (timeseries_.find(key) != timeseries_.end()) ||
+                      (vectors_.find(key) != vectors_.end()) ||
+                      (jsons_.find(key) != jsons_.end()) ||
+                      (geos_.find(key) != geos_.end());
+    
+    if (!key_exists && has_throttle(key)) {
+        // A throttle key lives until its theoretical arrival time
+        int64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                          std::chrono::steady_clock::now().time_since_epoch()).count();
+        return Result(std::to_string((throttles_.find(key)->second - now + 999999999) / 1000000000), true);
+    }
+    if (!key_exists) {
+        return Result("-2", true); // Key doesn't exist
+    }
+    
+    auto it = expiry_times_.find(key);
+    if (it == expiry_times_.end()) {
+        return Result("-1", true); // No expiry set
+    }
+    
+    auto now = std::chrono::steady_clock::now();
+    if (now >= it->second) {
+        return Result("-2", true); // Key expired
+    }
+    
+    auto remaining = std::chrono::duration_cast<std::chrono::seconds>(it->second - now);
+    return Result(std::to_string(remaining.count()), true);
+}
+
+KVStore::Result KVStore::keys(const std::string& pattern) const {
+    return match_keys(pattern, live_keys());
+}
+
+std::vector<std::string> KVStore::live_keys() const {
+    std::vector<std::string> names;
+    
+    // Check all stores
+    for (const auto& pair : store_) {
+        if (!is_expired(pair.first)) {
+            names.push_back(pair.first);
+        }
+    }
+    for (const auto& pair : ropes_) {
+        if (!is_expired(pair.first)) {
+            names.push_back(pair.first);
+        }
+    }
+    for (const auto& pair : lists_) {
+        if (!is_expired(pair.first)) {
+            names.push_back(pair.first);
+        }
+    }
+    for (const auto& pair : hashes_) {
+        if (!is_expired(pair.first)) {
+            names.push_back(pair.first);
+        }
+    }
+    for (const auto& pair : sets_) {
+        if (!is_expired(pair.first)) {
+            names.push_back(pair.first);
+        }
+    }
+    for (const auto& pair : hlls_) {
+        if (!is_expired(pair.first)) {
+            names.push_back(pair.first);
+        }
+    }
+    for (const auto& pair : blooms_) {
+        if (!is_expired(pair.first)) {
+            names.push_back(pair.first);
+        }
+    }
+    for (const auto& pair : streams_) {
+        if (!is_expired(pair.first)) {
+            names.push_back(pair.first);
+        }
+    }
+    for (const auto& pair : timeseries_) {
+        if (!is_expired(pair.first)) {
+            names.push_back(pair.first);
+        }
+    }
+    for (const auto& pair : vectors_) {
+        if (!is_expired(pair.first)) {
+            names.push_back(pair.first);
+        }
+    }
+    for (const auto& pair : jsons_) {
+        if (!is_expired(pair.first)) {
+            names.push_back(pair.first);
+        }
+    }
+    for (const auto& pair : geos_) {
+        if (!is_expired(pair.first)) {
+            names.push_back(pair.first);
+        }
+    }
+    int64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                      std::chrono::steady_clock::now().time_since_epoch()).count();
+    for (const auto& pair : throttles_) {
+        if (pair.second > now) {
+            names.push_back(pair.first);
+        }
+    }
+    return names;
 }
 
 KVStore::Result KVStore::del(const std::string& key) {
     int deleted = 0;
     if (store_.erase(key)) deleted++;
+    if (ropes_.erase(key)) deleted++;
     if (lists_.erase(key)) deleted++;
-    if (hashes_.erase(key)) deleted++;
+    if (hashes_.erase(key)) {
+        unindex_hash(key);
+        deleted++;
+    }
     if (sets_.erase(key)) deleted++;
+    if (hlls_.erase(key)) deleted++;
+    if (blooms_.erase(key)) deleted++;
+    if (streams_.erase(key)) deleted++;
+    if (timeseries_.erase(key)) deleted++;
+    if (vectors_.erase(key)) deleted++;
+    if (jsons_.erase(key)) deleted++;
+    if (geos_.erase(key)) deleted++;
+    if (has_throttle(key)) deleted++;
+    throttles_.erase(key);
     expiry_times_.erase(key); // Also remove expiry
     return Result(std::to_string(deleted), true);
 }
@@ -593,4 +3403,188 @@ KVStore::Result KVStore::scard(const std::string& key) {
     }
     
     return Result(std::to_string(it->second.size()), true);
+}
+
+// Pub/Sub operations
+KVStore::Result KVStore::publish(const std::string& channel, const std::string& message) {
+    return Result(std::to_string(pubsub_.publish(channel, message)), true);
+}
+
+KVStore::Result KVStore::subscribe(uint64_t client_id, const std::string& channels) {
+    std::istringstream iss(channels);
+    std::string channel;
+    size_t count = 0;
+    while (std::getline(iss, channel, ',')) {
+        count = pubsub_.subscribe(client_id, channel);
+    }
+    return Result(std::to_string(count), true);
+}
+
+KVStore::Result KVStore::unsubscribe(uint64_t client_id, const std::string& channels) {
+    if (channels.empty()) {
+        return Result(std::to_string(pubsub_.unsubscribe_all(client_id)), true);   // no arguments: all of them
+    }
+    std::istringstream iss(channels);
+    std::string channel;
+    size_t count = 0;
+    while (std::getline(iss, channel, ',')) {
+        count = pubsub_.unsubscribe(client_id, channel);
+    }
+    return Result(std::to_string(count), true);
+}
+
+KVStore::Result KVStore::psubscribe(uint64_t client_id, const std::string& patterns) {
+    std::istringstream iss(patterns);
+    std::string pattern;
+    size_t count = 0;
+    while (std::getline(iss, pattern, ',')) {
+        count = pubsub_.psubscribe(client_id, pattern);
+    }
+    return Result(std::to_string(count), true);
+}
+
+KVStore::Result KVStore::punsubscribe(uint64_t client_id, const std::string& patterns) {
+    if (patterns.empty()) {
+        return Result(std::to_string(pubsub_.punsubscribe_all(client_id)), true);   // no arguments: all of them
+    }
+    std::istringstream iss(patterns);
+    std::string pattern;
+    size_t count = 0;
+    while (std::getline(iss, pattern, ',')) {
+        count = pubsub_.punsubscribe(client_id, pattern);
+    }
+    return Result(std::to_string(count), true);
+}
+
+// Blocking list operations
+KVStore::BlockId KVStore::blpop(const std::vector<std::string>& keys, int64_t timeout_ms, BlockCallback cb) {
+    for (const auto& key : keys) {
+        Result popped = lpop(key);
+        if (popped.success) {
+            versions_.bump(key);
+            cb(true, key, popped.value);
+            return 0;
+        }
+    }
+    auto waiter = std::make_shared<ListWaiter>();
+    waiter->keys = keys;
+    waiter->from_left = true;
+    waiter->is_move = false;
+    waiter->to_left = false;
+    waiter->cb = std::move(cb);
+    return block_on_lists(waiter, timeout_ms);
+}
+
+KVStore::BlockId KVStore::brpop(const std::vector<std::string>& keys, int64_t timeout_ms, BlockCallback cb) {
+    for (const auto& key : keys) {
+        Result popped = rpop(key);
+        if (popped.success) {
+            versions_.bump(key);
+            cb(true, key, popped.value);
+            return 0;
+        }
+    }
+    auto waiter = std::make_shared<ListWaiter>();
+    waiter->keys = keys;
+    waiter->from_left = false;
+    waiter->is_move = false;
+    waiter->to_left = false;
+    waiter->cb = std::move(cb);
+    return block_on_lists(waiter, timeout_ms);
+}
+
+KVStore::BlockId KVStore::blmove(const std::string& source, const std::string& destination,
+                                 bool from_left, bool to_left, int64_t timeout_ms, BlockCallback cb) {
+    Result popped = from_left ? lpop(source) : rpop(source);
+    if (popped.success) {
+        versions_.bump(source);
+        push_to_list(destination, popped.value, to_left);
+        cb(true, source, popped.value);
+        return 0;
+    }
+    auto waiter = std::make_shared<ListWaiter>();
+    waiter->keys.push_back(source);
+    waiter->from_left = from_left;
+    waiter->is_move = true;
+    waiter->destination = destination;
+    waiter->to_left = to_left;
+    waiter->cb = std::move(cb);
+    return block_on_lists(waiter, timeout_ms);
+}
+
+KVStore::BlockId KVStore::block_on_lists(std::shared_ptr<ListWaiter> waiter, int64_t timeout_ms) {
+    if (timeout_ms < 0) {
+        waiter->cb(false, "", "");
+        return 0;
+    }
+    for (const auto& key : waiter->keys) {
+        list_waiters_[key].push_back(waiter);
+    }
+    waiter->id = next_block_id_++;
+    blocked_[waiter->id] = waiter;
+
+    waiter->timer = 0;
+    if (timeout_ms > 0) {
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+        std::weak_ptr<ListWaiter> weak = waiter;
+        waiter->timer = timers_.schedule(deadline, [this, weak]() {
+            auto w = weak.lock();
+            if (!w) {
+                return;
+            }
+            w->timer = 0;
+            unblock_waiter(w);
+            w->cb(false, "", "");
+        });
+    }
+    return waiter->id;
+}
+
+bool KVStore::cancel_block(BlockId id) {
+    auto it = blocked_.find(id);
+    if (it == blocked_.end()) {
+        return false;
+    }
+    std::shared_ptr<ListWaiter> waiter = it->second;
+    unblock_waiter(waiter);
+    waiter->cb(false, "", "");
+    return true;
+}
+
+void KVStore::unblock_waiter(const std::shared_ptr<ListWaiter>& waiter) {
+    for (const auto& key : waiter->keys) {
+        auto it = list_waiters_.find(key);
+        if (it == list_waiters_.end()) {
+            continue;
+        }
+        auto& queue = it->second;
+        queue.erase(std::remove(queue.begin(), queue.end(), waiter), queue.end());
+        if (queue.empty()) {
+            list_waiters_.erase(it);
+        }
+    }
+    if (waiter->timer) {
+        timers_.cancel(waiter->timer);
+        waiter->timer = 0;
+    }
+    blocked_.erase(waiter->id);
+}
+
+bool KVStore::serve_list_waiter(const std::string& key, const std::string& value) {
+    auto it = list_waiters_.find(key);
+    if (it == list_waiters_.end() || it->second.empty()) {
+        return false;
+    }
+    // Oldest waiter first, like Redis
+    std::shared_ptr<ListWaiter> waiter = it->second.front();
+    unblock_waiter(waiter);
+    if (waiter->is_move) {
+        push_to_list(waiter->destination, value, waiter->to_left);
+    }
+    waiter->cb(true, key, value);
+    return true;
+}
+
+size_t KVStore::process_timers() {
+    return timers_.run_expired(std::chrono::steady_clock::now());
 }
\ No newline at end of file
@@ -10,6 +10,30 @@
 #include <unordered_set>
 #include <chrono>
 #include <regex>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <string_view>
+#include "pubsub.h"
+#include "rope.h"
+#include "hyperloglog.h"
+#include "bloom_filter.h"
+#include "stream.h"
+#include "timeseries.h"
+#include "vector_set.h"
+#include "hash_index.h"
+#include "json_doc.h"
+#include "geo_set.h"
+#include "hot_keys.h"
+#include "read_replicas.h"
+#include "result_cache.h"
+#include "bulk_load.h"
+#include "keyspace_dump.h"
+#include "script.h"
+#include "sharded_counter.h"
+#include "admission.h"
+#include "timer_queue.h"
 
 class KVStore {
 public:
@@ -28,6 +52,26 @@ public:
     Result set(const std::string& key, const std::string& value);
     Result execute_operation(const std::string& operation, const std::string& key, const std::string& value);
     
+    // String range operations (values past kRopeThreshold are kept as a Rope)
+    static const size_t kRopeThreshold = 64 * 1024;
+    // Redis's proto-max-bulk-len: APPEND and SETRANGE may not grow a value past it
+    static const size_t kMaxStringSize = 512 * 1024 * 1024;
+    Result append(const std::string& key, const std::string& value);
+    Result setrange(const std::string& key, int64_t offset, const std::string& value);
+    Result getrange(const std::string& key, int64_t start, int64_t end) const;
+    Result strlen(const std::string& key) const;
+    // Views into the stored value for [start, end]; valid until the key is next modified
+    std::vector<std::string_view> getrange_view(const std::string& key, int64_t start, int64_t end) const;
+    
+    // Bitmap operations over string values (bit 0 is the MSB of byte 0;
+    // start/end are byte offsets like Redis, INT64_MAX end means "to the end")
+    Result setbit(const std::string& key, uint64_t offset, int bit);
+    Result getbit(const std::string& key, uint64_t offset) const;
+    Result bitcount(const std::string& key, int64_t start = 0, int64_t end = INT64_MAX) const;
+    Result bitpos(const std::string& key, int bit, int64_t start = 0, int64_t end = INT64_MAX) const;
+    // op is AND, OR, XOR or NOT; sources are comma-separated keys
+    Result bitop(const std::string& op, const std::string& destination, const std::string& sources);
+    
     // Numeric operations
     Result incr(const std::string& key);
     Result decr(const std::string& key);
@@ -42,6 +86,26 @@ public:
     Result llen(const std::string& key);
     Result lrange(const std::string& key, int start, int stop);
     
+    // Blocking list operations. The callback runs exactly once: right away if
+    // one of the lists has data, later when a push hands a value to this
+    // waiter, or with found == false when the timeout fires or the wait is
+    // cancelled. timeout_ms == 0 blocks forever and kNoWait not at all. The
+    // id of the wait is returned, 0 if the callback already ran.
+    using BlockCallback = std::function<void(bool found, const std::string& key, const std::string& value)>;
+    using BlockId = uint64_t;
+    static const int64_t kNoWait = -1;
+    BlockId blpop(const std::vector<std::string>& keys, int64_t timeout_ms, BlockCallback cb);
+    BlockId brpop(const std::vector<std::string>& keys, int64_t timeout_ms, BlockCallback cb);
+    BlockId blmove(const std::string& source, const std::string& destination,
+                   bool from_left, bool to_left, int64_t timeout_ms, BlockCallback cb);
+    // Ends a wait whose client went away; false if it already ended
+    bool cancel_block(BlockId id);
+    size_t blocked_clients() const { return blocked_.size(); }
+    
+    // Timer subsystem (drives blocking timeouts); returns the number of timers fired
+    size_t process_timers();
+    TimerQueue& timers() { return timers_; }
+    
     // Hash operations
     Result hset(const std::string& key, const std::string& field, const std::string& value);
     Result hget(const std::string& key, const std::string& field);
@@ -50,6 +114,13 @@ public:
     Result hdel(const std::string& key, const std::string& field);
     Result hexists(const std::string& key, const std::string& field);
     
+    // Secondary indexes over a hash field for keys with a given prefix,
+    // maintained by hset/hdel/del. Queries return matching keys joined with ','.
+    Result idx_create(const std::string& name, const std::string& prefix, const std::string& field,
+                      const std::string& kind);
+    Result idx_drop(const std::string& name);
+    Result idx_query(const std::string& name, const std::string& query) const;
+    
     // Set operations
     Result sadd(const std::string& key, const std::string& members);
     Result smembers(const std::string& key);
@@ -58,6 +129,191 @@ public:
     Result sdiff(const std::string& key1, const std::string& key2);
     Result scard(const std::string& key);
     
+    // HyperLogLog operations (elements/keys are comma-separated)
+    Result pfadd(const std::string& key, const std::string& elements);
+    Result pfcount(const std::string& keys) const;
+    Result pfmerge(const std::string& destination, const std::string& sources);
+    
+    // Bloom filter operations (items are comma-separated for the multi variants)
+    Result bf_reserve(const std::string& key, double error_rate, uint64_t capacity);
+    Result bf_add(const std::string& key, const std::string& item);
+    Result bf_madd(const std::string& key, const std::string& items);
+    Result bf_exists(const std::string& key, const std::string& item) const;
+    Result bf_mexists(const std::string& key, const std::string& items) const;
+    
+    // Stream operations (fields are comma-separated field:value pairs; entries
+    // are returned as id,field:value,... joined with ';')
+    Result xadd(const std::string& key, const std::string& id, const std::string& fields);
+    Result xrange(const std::string& key, const std::string& start, const std::string& end, size_t count = 0) const;
+    Result xrevrange(const std::string& key, const std::string& end, const std::string& start, size_t count = 0) const;
+    Result xread(const std::string& key, const std::string& last_id, size_t count = 0) const;
+    Result xtrim(const std::string& key, const std::string& strategy, const std::string& threshold);
+    Result xlen(const std::string& key) const;
+    
+    // Time series operations (labels and filters are comma-separated name=value
+    // pairs; samples are returned as ts:value joined with ',')
+    Result ts_create(const std::string& key, const std::string& labels);
+    Result ts_add(const std::string& key, const std::string& timestamp, const std::string& value);
+    Result ts_get(const std::string& key) const;
+    Result ts_range(const std::string& key, const std::string& from, const std::string& to,
+                    const std::string& aggregation = "", int64_t bucket_ms = 0) const;
+    Result ts_mrange(const std::string& filter, const std::string& from, const std::string& to,
+                     const std::string& aggregation = "", int64_t bucket_ms = 0) const;
+    
+    // Vector set operations (vectors are comma-separated floats; KNN results
+    // are returned as id:distance joined with ',')
+    Result vec_create(const std::string& key, size_t dim, const std::string& metric);
+    Result vec_add(const std::string& key, const std::string& id, const std::vector<float>& vec);
+    Result vec_del(const std::string& key, const std::string& id);
+    Result vec_knn(const std::string& key, size_t k, const std::vector<float>& query,
+                   size_t nprobe = VectorSet::kDefaultNprobe) const;
+    Result vec_build_ivf(const std::string& key, size_t nlist);
+    Result vec_card(const std::string& key) const;
+    const VectorSet* vector_set(const std::string& key) const;
+    
+    // JSON document operations (paths are $.a.b[0] style; values are JSON text)
+    Result json_set(const std::string& key, const std::string& path, const std::string& json);
+    Result json_get(const std::string& key, const std::string& path) const;
+    Result json_numincrby(const std::string& key, const std::string& path, const std::string& by);
+    Result json_type(const std::string& key, const std::string& path) const;
+    
+    // Geo operations (points are lon,lat,member triples; search results are
+    // member:distance joined with ',', distances in the query's unit)
+    Result geoadd(const std::string& key, const std::string& points);
+    Result geodist(const std::string& key, const std::string& member1, const std::string& member2,
+                   const std::string& unit = "m") const;
+    Result geopos(const std::string& key, const std::string& members) const;
+    Result geosearch(const std::string& key, const std::string& query) const;
+    
+    // GCRA rate limiting. args: max_burst,count,period_seconds[,quantity]; the
+    // reply is limited,limit,remaining,retry_after,reset_after (seconds,
+    // retry_after -1 when allowed), as redis-cell's CL.THROTTLE
+    Result throttle(const std::string& key, const std::string& args);
+    
+    // Hot key tracking, sampled on GET/SET. args: "" or a count for the
+    // hottest keys (key:estimate joined with ','), DECAY,ms, SAMPLE,n, RESET,
+    // REPLICATE,min_accesses (0 disables read replicas) or REPLICAS
+    Result hotkeys(const std::string& args);
+    HotKeys& hot_keys() { return hotkeys_; }
+    
+    // Single-key reads whose reply depends only on the key, so identical
+    // requests in flight at once can share one execution (see SingleFlight)
+    static bool coalescable(const std::string& operation);
+
+    // How a successful reply to operation goes out over RESP: a status such
+    // as OK, an integer, or a bulk string for everything else
+    enum ReplyType { kStatusReply, kIntegerReply, kBulkReply };
+    static ReplyType reply_type(const std::string& operation);
+    uint64_t key_version(const std::string& key) const { return versions_.get(key); }
+    
+    // Reads whose reply is built off the engine lock: KEYS, where matching the
+    // pattern against every name is the cost and copying the names is cheap
+    // next to it. read_cost() is the number of keys it would walk.
+    // prepare_read() copies the names under the engine lock; the job it
+    // returns matches and formats the reply from the copy and may run on any
+    // thread after the lock is released. Other large reads do O(n) work under
+    // the lock whatever part of it moves, so they are left to chunking
+    // (SMEMBERS, HGETALL) or run in place.
+    typedef std::function<Result()> ReadJob;
+    static const size_t kSlowReadElements = 1000;
+    static bool slow_read_candidate(const std::string& operation);
+    size_t read_cost(const std::string& operation) const;
+    ReadJob prepare_read(const std::string& operation, const std::string& key) const;
+    
+    // Read replicas of hot string keys. read_replica() may be called without
+    // the engine lock; fill_replica() is called under it after a successful GET.
+    bool read_replica(const std::string& key, std::string& value);
+    void fill_replica(const std::string& key, const std::string& value);
+    // Re-derives the replicated set from the hot key estimates (also run by a timer)
+    void refresh_replicas();
+    ReadReplicas& replicas() { return replicas_; }
+    
+    // Opt-in cache of SMEMBERS/HGETALL/LRANGE/SINTER/SDIFF replies. cached_read()
+    // may be called without the engine lock; read_stamp() is taken under it
+    // before the read runs, and cache_read() stores the reply afterwards.
+    bool cached_read(const std::string& operation, const std::string& key, const std::string& value,
+                     std::string& reply) {
+        return results_.lookup(operation, key, value, reply);
+    }
+    ResultCache::Stamp read_stamp(const std::string& operation, const std::string& key,
+                                  const std::string& value) const {
+        return results_.stamp(operation, key, value);
+    }
+    void cache_read(const std::string& operation, const std::string& key, const std::string& value,
+                    const ResultCache::Stamp& stamp, const Result& result);
+    // args: "" for stats, ON, OFF or BUDGET,bytes
+    Result resultcache(const std::string& args);
+    
+    // Server-side scripts (src/script.h), cached by the SHA1 of their source.
+    // evalsha() runs one under the engine lock, so its engine calls are atomic;
+    // args: numkeys,key...,arg...
+    Result script_load(const std::string& source);
+    Result script_exists(const std::string& shas) const;
+    Result script_flush();
+    Result evalsha(const std::string& sha, const std::string& args);
+    
+    // Sharded counters for INCR-heavy keys. sharded_counter() may be called
+    // without the engine lock; it serves get/incr/decr/incrby/decrby on a
+    // sharded key and returns false when the engine has to run the command.
+    bool sharded_counter(const std::string& operation, const std::string& key, const std::string& value,
+                         std::string& result);
+    // Called under the engine lock when an INCR-family command had to wait for
+    // it; a key that keeps contending is converted to a sharded counter
+    void note_incr_contention(const std::string& operation, const std::string& key);
+    Result shard_counter(const std::string& key);
+    Result unshard_counter(const std::string& key);
+    // args: "" for the sharded keys, AUTO,threshold (0 disables conversion)
+    Result counters(const std::string& args);
+    ShardedCounters& sharded_counters() { return counters_; }
+    
+    // Load shedding for requests waiting on the engine lock. args: "" for the
+    // queue state, MAXQUEUE,n (0 = unbounded) or DEADLINE,us (0 = none)
+    Result admission(const std::string& args);
+    AdmissionControl& admission_control() { return admission_; }
+    
+    // SMEMBERS, HGETALL and DEL of a large set or hash run as resumable cursors.
+    // begin_chunked() returns null when the work is small enough to run in one
+    // go; otherwise the caller drives step_chunked() under the engine lock, each
+    // call bounded by the slice budget, and may release the lock between calls.
+    // A write to the key in between first finishes the cursor's read of it, so
+    // the reply is the key as it was at begin_chunked(). Each slice adds a chunk
+    // to the reply; chunked_reply() joins them once finished and does not need
+    // the lock.
+    class Cursor;
+    std::shared_ptr<Cursor> begin_chunked(const std::string& operation, const std::string& key);
+    bool step_chunked(Cursor& cursor);   // true once finished
+    static Result chunked_reply(Cursor& cursor);
+    // args: "" for cursor stats, BUDGET,us (slice budget, default 100)
+    Result chunking(const std::string& args);
+    
+    // Bulk loading of a local file (src/bulk_load.h); every row is a SET, a
+    // later row for the same key winning. args: [RESP|CSV|BINARY][,THREADS,n].
+    // bulk_insert() is the part that needs the engine lock, for callers that
+    // ran BulkLoader::read() without it; it consumes load.rows.
+    Result bulkload(const std::string& path, const std::string& args);
+    Result bulk_insert(BulkLoader::Load& load);
+    
+    // DEBUG POPULATE: generates count keys inside the engine (see
+    // BulkLoader::Populate for args); keys that already exist are left alone.
+    // populate_insert() is the part that needs the engine lock.
+    Result debug_populate(const std::string& count, const std::string& args);
+    Result populate_insert(BulkLoader::Load& load, const BulkLoader::Populate& spec);
+    
+    // EXPORT and IMPORT of a point-in-time dump to the part files in a
+    // directory (src/keyspace_dump.h); args: [THREADS,n] for both, and
+    // [PARTIAL] for EXPORT. Strings, hashes, lists and sets go out with their
+    // TTLs; EXPORT fails if there are keys of other types, unless PARTIAL
+    // says to leave them out and count them as skipped. export_begin() is
+    // the part of EXPORT that needs the engine lock: it forks the writer, and
+    // export_finish() waits for its reply.
+    // import_insert() is the part of IMPORT that needs the lock; an imported
+    // key replaces any key of the same name.
+    Result keyspace_export(const std::string& dir, const std::string& args);
+    Result export_begin(const std::string& dir, const std::string& args, KeyspaceDump::Child& child);
+    static Result export_finish(KeyspaceDump::Child& child);
+    Result keyspace_import(const std::string& dir, const std::string& args);
+    Result import_insert(KeyspaceDump::Image& image);
+    
     // Key management operations
     Result exists(const std::string& key) const;
     Result expire(const std::string& key, int seconds);
@@ -65,19 +321,131 @@ public:
     Result keys(const std::string& pattern) const;
     Result del(const std::string& key);
     
+    // Pub/Sub operations (channels/patterns are comma-separated; none to
+    // unsubscribe from every one)
+    Result publish(const std::string& channel, const std::string& message);
+    Result subscribe(uint64_t client_id, const std::string& channels);
+    Result unsubscribe(uint64_t client_id, const std::string& channels);
+    Result psubscribe(uint64_t client_id, const std::string& patterns);
+    Result punsubscribe(uint64_t client_id, const std::string& patterns);
+    PubSub& pubsub() { return pubsub_; }
+    
     size_t size() const;
     bool empty() const;
     void clear();
     
 private:
     std::map<std::string, std::string> store_;
+    std::map<std::string, Rope> ropes_;  // large string values; a key is in store_ or ropes_, never both
     std::map<std::string, std::list<std::string>> lists_;
     std::map<std::string, std::unordered_map<std::string, std::string>> hashes_;
     std::map<std::string, std::unordered_set<std::string>> sets_;
+    std::map<std::string, HyperLogLog> hlls_;
+    std::map<std::string, ScalableBloomFilter> blooms_;
+    std::map<std::string, Stream> streams_;
+    std::map<std::string, TimeSeries> timeseries_;
+    std::map<std::string, VectorSet> vectors_;
+    std::map<std::string, JsonDoc> jsons_;
+    std::map<std::string, GeoSet> geos_;
+    // Theoretical arrival time (steady clock ns) per THROTTLE key; an entry
+    // whose time has passed is the same as no entry and is swept lazily
+    std::unordered_map<std::string, int64_t> throttles_;
+    size_t throttle_sweep_at_;
+    bool has_throttle(const std::string& key) const;
+    std::map<std::string, HashIndex> indexes_;   // by index name, separate from the keyspace
     std::map<std::string, std::chrono::steady_clock::time_point> expiry_times_;
+    PubSub pubsub_;
+    TimerQueue timers_;
+    
+    HotKeys hotkeys_;
+    int64_t hotkeys_decay_ms_;
+    TimerQueue::TimerId hotkeys_timer_;
+    void schedule_hotkeys_decay();
+    
+    // Every execute_operation() that may write bumps its key's version, as do
+    // the blocking list commands for the lists they pop and push
+    KeyVersions versions_;
+    ReadReplicas replicas_;
+    ResultCache results_;
+    uint64_t replica_min_accesses_;
+    void schedule_replica_refresh();
+    
+    // store_ keeps a sharded key's value from before sharding so the key still
+    // exists; any command other than the counter ones folds the slots back first
+    ShardedCounters counters_;
+    std::unordered_map<std::string, uint32_t> incr_contention_;   // contended INCRs this window
+    uint32_t counter_auto_threshold_;
+    void fold_counter(const std::string& key);
+    void schedule_contention_window();
+    
+    AdmissionControl admission_;
+    
+    std::unordered_map<std::string, std::shared_ptr<const Script>> scripts_;
+    
+    // Read cursors by key, so a write can detach them first
+    std::unordered_map<std::string, std::vector<std::shared_ptr<Cursor>>> cursors_;
+    int64_t chunk_budget_us_;
+    uint64_t chunked_commands_;
+    uint64_t chunk_slices_;
+    uint64_t chunk_detached_;
+    void detach_cursors(const std::string& key);
+    void detach_all_cursors();
+    
+    // Clients blocked on an empty list, in arrival order per key
+    struct ListWaiter {
+        std::vector<std::string> keys;
+        bool from_left;
+        bool is_move;
+        std::string destination;
+        bool to_left;
+        BlockCallback cb;
+        TimerQueue::TimerId timer;
+        BlockId id;
+    };
+    std::map<std::string, std::deque<std::shared_ptr<ListWaiter>>> list_waiters_;
+    std::unordered_map<BlockId, std::shared_ptr<ListWaiter>> blocked_;
+    BlockId next_block_id_;
+    
+    BlockId block_on_lists(std::shared_ptr<ListWaiter> waiter, int64_t timeout_ms);
+    void unblock_waiter(const std::shared_ptr<ListWaiter>& waiter);
+    bool serve_list_waiter(const std::string& key, const std::string& value);
+    // LPUSH / RPUSH. Like Redis, the reply is the length the list reached,
+    // counting values blocked clients took straight away
+    Result push_values(const std::string& key, const std::vector<std::string>& values, bool to_left);
+    void push_to_list(const std::string& key, const std::string& value, bool to_left);
     
     // Helper method to check if a key has expired
     bool is_expired(const std::string& key) const;
+    
+    // Names of all unexpired keys, in KEYS order
+    std::vector<std::string> live_keys() const;
+    
+    // True if the key holds a string value (flat or rope)
+    bool has_string(const std::string& key) const;
+    // Keep secondary indexes in step with a hash field change (value nullptr = removed)
+    void index_hash_field(const std::string& key, const std::string& field, const std::string* value);
+    void unindex_hash(const std::string& key);
+    // Moves a flat value that outgrew kRopeThreshold into ropes_
+    Rope* promote_to_rope(const std::string& key);
+    
+    // Removes whatever the maps hold under key, an expired leftover or a
+    // sharded counter included; true if anything went, which may have taken
+    // a node the caller's insert hints point at
+    bool clear_key(const std::string& key);
+    
+    // Run in the EXPORT child: writes the keys in [lo, hi) (nullptr for no
+    // bound) to one part, sharded counters at the totals taken before the fork
+    struct ExportStats {
+        size_t added[KeyspaceDump::kSet + 1];
+        size_t expiring;
+        uint64_t keys;
+        uint64_t bytes;
+        std::string error;
+    };
+    bool export_child(const std::string& dir, size_t threads, size_t skipped,
+                      const std::unordered_map<std::string, int64_t>& counters, std::string& reply) const;
+    void export_part(const std::string& dir, size_t part, size_t parts, const std::string* lo, const std::string* hi,
+                     const std::unordered_map<std::string, int64_t>& counters, ExportStats& stats) const;
 };
 
 #endif
\ No newline at end of file
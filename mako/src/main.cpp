@@ -1,5 +1,6 @@
 #include "rust_wrapper.h"
 #include <iostream>
+#include <cstring>
 #include <signal.h>
 
 RustWrapper* g_kv_store = nullptr;
@@ -13,7 +14,31 @@ void signal_handler(int signal) {
     exit(0);
 }
 
-int main() {
+static void usage(const char* prog) {
+    std::cerr << "usage: " << prog << " [--dir DIR] [--load FILE [--load-format RESP|CSV|BINARY] [--load-threads N]]" << std::endl;
+}
+
+int main(int argc, char** argv) {
+    // Optional bulk load of a local file before the server accepts connections
+    std::string load_path;
+    std::string load_args;
+    // Where clients' BULKLOAD, EXPORT and IMPORT paths point; without it they are refused
+    std::string data_dir;
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "--dir") == 0 && i + 1 < argc) {
+            data_dir = argv[++i];
+        } else if (std::strcmp(argv[i], "--load") == 0 && i + 1 < argc) {
+            load_path = argv[++i];
+        } else if (std::strcmp(argv[i], "--load-format") == 0 && i + 1 < argc) {
+            load_args += std::string(load_args.empty() ? "" : ",") + argv[++i];
+        } else if (std::strcmp(argv[i], "--load-threads") == 0 && i + 1 < argc) {
+            load_args += std::string(load_args.empty() ? "" : ",") + "THREADS," + argv[++i];
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    
     // Set up signal handler for graceful shutdown
     signal(SIGINT, signal_handler);
     signal(SIGTERM, signal_handler);
@@ -23,6 +48,24 @@ int main() {
     // Create and initialize KV store
     g_kv_store = new RustWrapper();
     
+    std::string dir_error;
+    if (!data_dir.empty() && !g_kv_store->set_data_dir(data_dir, dir_error)) {
+        std::cerr << dir_error << std::endl;
+        delete g_kv_store;
+        return 1;
+    }
+    
+    if (!load_path.empty()) {
+        std::cout << "Loading " << load_path << "..." << std::endl;
+        KVStore::Result loaded = g_kv_store->bulk_load(load_path, load_args);
+        if (!loaded.success) {
+            std::cerr << "Failed to load " << load_path << ": " << loaded.value << std::endl;
+            delete g_kv_store;
+            return 1;
+        }
+        std::cout << "Loaded " << load_path << ": " << loaded.value << std::endl;
+    }
+    
     if (!g_kv_store->init()) {
         std::cerr << "Failed to initialize KV store" << std::endl;
         delete g_kv_store;
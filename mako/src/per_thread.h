@@ -0,0 +1,84 @@
+#ifndef _PER_THREAD_H_
+#define _PER_THREAD_H_
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// One T per thread for state that several worker threads update, as in
+// HotKeys, ShardedCounters and ReadReplicas: a worker writes only its own T,
+// and the owner walks all of them to sum, copy or reset.
+//
+// get() remembers in a thread-local the last PerThread<T> the thread used, so
+// with one engine-wide instance it returns without a lock after the first
+// call. Otherwise it searches the registry under the owner's mutex and adds a
+// T for a thread it has not seen. Ts are only freed with the PerThread, so a
+// thread that exits leaves its T behind.
+template <class T>
+class PerThread {
+public:
+    PerThread() : id_(next_id().fetch_add(1, std::memory_order_relaxed)) {}
+    PerThread(const PerThread&) = delete;
+    PerThread& operator=(const PerThread&) = delete;
+
+    // Unique among the PerThread<T> of a process
+    uint64_t id() const { return id_; }
+
+    // The calling thread's T. mutex is the owner's lock over the registry;
+    // init(T&) runs under it on a T just added.
+    template <class Init>
+    T* get(std::mutex& mutex, Init init) {
+        Cache& cache = t_cache();
+        if (cache.owner == id_) {
+            return cache.item;
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        std::thread::id self = std::this_thread::get_id();
+        T* found = nullptr;
+        for (size_t i = 0; i < owners_.size(); i++) {
+            if (owners_[i] == self) {
+                found = items_[i].get();
+                break;
+            }
+        }
+        if (!found) {
+            items_.emplace_back(new T());
+            owners_.push_back(self);
+            found = items_.back().get();
+            init(*found);
+        }
+        cache.owner = id_;
+        cache.item = found;
+        return found;
+    }
+    T* get(std::mutex& mutex) {
+        return get(mutex, [](T&) {});
+    }
+
+    // Every thread's T; hold the owner's mutex
+    const std::vector<std::unique_ptr<T>>& all() const { return items_; }
+
+private:
+    struct Cache {
+        uint64_t owner = 0;
+        T* item = nullptr;
+    };
+
+    static Cache& t_cache() {
+        static thread_local Cache cache;
+        return cache;
+    }
+    static std::atomic<uint64_t>& next_id() {
+        static std::atomic<uint64_t> next{1};
+        return next;
+    }
+
+    const uint64_t id_;
+    std::vector<std::unique_ptr<T>> items_;
+    std::vector<std::thread::id> owners_;
+};
+
+#endif
@@ -0,0 +1,403 @@
+#include "pubsub.h"
+#include <algorithm>
+
+namespace {
+
+void append_bulk(std::string& out, const std::string& data) {
+    out += '$';
+    out += std::to_string(data.size());
+    out += "\r\n";
+    out += data;
+    out += "\r\n";
+}
+
+void erase_id(std::vector<uint64_t>& ids, uint64_t client_id) {
+    auto it = std::find(ids.begin(), ids.end(), client_id);
+    if (it != ids.end()) {
+        *it = ids.back();
+        ids.pop_back();
+    }
+}
+
+} // namespace
+
+PubSub::PubSub() : num_patterns_(0) {
+}
+
+PubSub::~PubSub() {
+}
+
+size_t PubSub::subscription_count(const Subscriber& sub) const {
+    return sub.channels.size() + sub.patterns.size();
+}
+
+size_t PubSub::subscribe(uint64_t client_id, const std::string& channel) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Subscriber& sub = subscribers_[client_id];
+    if (sub.channels.insert(channel).second) {
+        channels_[channel].push_back(client_id);
+    }
+    return subscription_count(sub);
+}
+
+void PubSub::remove_channel_locked(uint64_t client_id, const std::string& channel) {
+    auto it = channels_.find(channel);
+    if (it == channels_.end()) {
+        return;
+    }
+    erase_id(it->second, client_id);
+    if (it->second.empty()) {
+        channels_.erase(it);
+    }
+}
+
+size_t PubSub::unsubscribe(uint64_t client_id, const std::string& channel) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto sub_it = subscribers_.find(client_id);
+    if (sub_it == subscribers_.end()) {
+        return 0;
+    }
+    if (sub_it->second.channels.erase(channel)) {
+        remove_channel_locked(client_id, channel);
+    }
+    return subscription_count(sub_it->second);
+}
+
+size_t PubSub::unsubscribe_all(uint64_t client_id) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto sub_it = subscribers_.find(client_id);
+    if (sub_it == subscribers_.end()) {
+        return 0;
+    }
+    for (const auto& channel : sub_it->second.channels) {
+        remove_channel_locked(client_id, channel);
+    }
+    sub_it->second.channels.clear();
+    return subscription_count(sub_it->second);
+}
+
+std::string PubSub::literal_prefix(const std::string& pattern) {
+    size_t end = pattern.find_first_of("*?[\\");
+    return pattern.substr(0, end);
+}
+
+size_t PubSub::psubscribe(uint64_t client_id, const std::string& pattern) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Subscriber& sub = subscribers_[client_id];
+    if (sub.patterns.insert(pattern).second) {
+        TrieNode* node = &pattern_root_;
+        for (char c : literal_prefix(pattern)) {
+            auto& child = node->children[c];
+            if (!child) {
+                child.reset(new TrieNode());
+            }
+            node = child.get();
+        }
+        auto& ids = node->patterns[pattern];
+        if (ids.empty()) {
+            num_patterns_++;
+        }
+        ids.push_back(client_id);
+    }
+    return subscription_count(sub);
+}
+
+void PubSub::remove_pattern_locked(uint64_t client_id, const std::string& pattern) {
+    // Remember the path so empty nodes can be pruned on the way back up
+    std::vector<std::pair<TrieNode*, char>> path;
+    TrieNode* node = &pattern_root_;
+    for (char c : literal_prefix(pattern)) {
+        auto child = node->children.find(c);
+        if (child == node->children.end()) {
+            return;
+        }
+        path.emplace_back(node, c);
+        node = child->second.get();
+    }
+
+    auto it = node->patterns.find(pattern);
+    if (it == node->patterns.end()) {
+        return;
+    }
+    erase_id(it->second, client_id);
+    if (!it->second.empty()) {
+        return;
+    }
+    node->patterns.erase(it);
+    num_patterns_--;
+
+    while (!path.empty() && node->patterns.empty() && node->children.empty()) {
+        TrieNode* parent = path.back().first;
+        parent->children.erase(path.back().second);
+        node = parent;
+        path.pop_back();
+    }
+}
+
+size_t PubSub::punsubscribe(uint64_t client_id, const std::string& pattern) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto sub_it = subscribers_.find(client_id);
+    if (sub_it == subscribers_.end()) {
+        return 0;
+    }
+    if (sub_it->second.patterns.erase(pattern)) {
+        remove_pattern_locked(client_id, pattern);
+    }
+    return subscription_count(sub_it->second);
+}
+
+size_t PubSub::punsubscribe_all(uint64_t client_id) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto sub_it = subscribers_.find(client_id);
+    if (sub_it == subscribers_.end()) {
+        return 0;
+    }
+    for (const auto& pattern : sub_it->second.patterns) {
+        remove_pattern_locked(client_id, pattern);
+    }
+    sub_it->second.patterns.clear();
+    return subscription_count(sub_it->second);
+}
+
+void PubSub::remove_client(uint64_t client_id) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto sub_it = subscribers_.find(client_id);
+    if (sub_it == subscribers_.end()) {
+        return;
+    }
+    for (const auto& channel : sub_it->second.channels) {
+        remove_channel_locked(client_id, channel);
+    }
+    for (const auto& pattern : sub_it->second.patterns) {
+        remove_pattern_locked(client_id, pattern);
+    }
+    subscribers_.erase(sub_it);
+}
+
+void PubSub::set_notify(Notify notify) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    notify_ = std::move(notify);
+}
+
+PubSub::Message PubSub::encode_message(const std::string& channel, const std::string& message) {
+    auto frame = std::make_shared<std::string>();
+    frame->reserve(32 + channel.size() + message.size());
+    *frame += "*3\r\n";
+    append_bulk(*frame, "message");
+    append_bulk(*frame, channel);
+    append_bulk(*frame, message);
+    return frame;
+}
+
+PubSub::Message PubSub::encode_pmessage(const std::string& pattern, const std::string& channel,
+                                        const std::string& message) {
+    auto frame = std::make_shared<std::string>();
+    frame->reserve(48 + pattern.size() + channel.size() + message.size());
+    *frame += "*4\r\n";
+    append_bulk(*frame, "pmessage");
+    append_bulk(*frame, pattern);
+    append_bulk(*frame, channel);
+    append_bulk(*frame, message);
+    return frame;
+}
+
+bool PubSub::deliver_locked(uint64_t client_id, const Message& frame) {
+    Subscriber& sub = subscribers_[client_id];
+    if (sub.overflowed) {
+        return false;
+    }
+    if (sub.queued_bytes + frame->size() > kMaxQueuedBytes) {
+        std::deque<Message>().swap(sub.queue);
+        sub.queued_bytes = 0;
+        sub.overflowed = true;
+        if (notify_) {
+            notify_(client_id);
+        }
+        return false;
+    }
+    bool was_empty = sub.queue.empty();
+    sub.queue.push_back(frame);
+    sub.queued_bytes += frame->size();
+    if (was_empty && notify_) {
+        notify_(client_id);
+    }
+    return true;
+}
+
+size_t PubSub::publish(const std::string& channel, const std::string& message) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    size_t receivers = 0;
+
+    auto it = channels_.find(channel);
+    if (it != channels_.end() && !it->second.empty()) {
+        Message frame = encode_message(channel, message);
+        for (uint64_t id : it->second) {
+            receivers += deliver_locked(id, frame);
+        }
+    }
+
+    if (num_patterns_ == 0) {
+        return receivers;
+    }
+
+    // Walk the trie along the channel; every node on the path holds patterns
+    // whose literal prefix matches, the rest is checked with the glob matcher.
+    const TrieNode* node = &pattern_root_;
+    size_t depth = 0;
+    while (node) {
+        for (const auto& entry : node->patterns) {
+            const std::string& pattern = entry.first;
+            if (!glob_match(pattern.data() + depth, pattern.size() - depth,
+                            channel.data() + depth, channel.size() - depth)) {
+                continue;
+            }
+            Message frame = encode_pmessage(pattern, channel, message);
+            for (uint64_t id : entry.second) {
+                receivers += deliver_locked(id, frame);
+            }
+        }
+        if (depth == channel.size()) {
+            break;
+        }
+        auto child = node->children.find(channel[depth]);
+        node = child == node->children.end() ? nullptr : child->second.get();
+        depth++;
+    }
+
+    return receivers;
+}
+
+bool PubSub::pop_message(uint64_t client_id, Message& out) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = subscribers_.find(client_id);
+    if (it == subscribers_.end() || it->second.queue.empty()) {
+        return false;
+    }
+    out = std::move(it->second.queue.front());
+    it->second.queue.pop_front();
+    it->second.queued_bytes -= out->size();
+    return true;
+}
+
+size_t PubSub::drain(uint64_t client_id, std::vector<Message>& out) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = subscribers_.find(client_id);
+    if (it == subscribers_.end()) {
+        return 0;
+    }
+    auto& queue = it->second.queue;
+    size_t n = queue.size();
+    out.insert(out.end(), std::make_move_iterator(queue.begin()), std::make_move_iterator(queue.end()));
+    queue.clear();
+    it->second.queued_bytes = 0;
+    return n;
+}
+
+size_t PubSub::pending(uint64_t client_id) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = subscribers_.find(client_id);
+    return it == subscribers_.end() ? 0 : it->second.queue.size();
+}
+
+bool PubSub::overflowed(uint64_t client_id) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = subscribers_.find(client_id);
+    return it != subscribers_.end() && it->second.overflowed;
+}
+
+size_t PubSub::numsub(const std::string& channel) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = channels_.find(channel);
+    return it == channels_.end() ? 0 : it->second.size();
+}
+
+size_t PubSub::numpat() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return num_patterns_;
+}
+
+bool PubSub::glob_match(const char* pattern, size_t plen, const char* str, size_t slen) {
+    while (plen > 0) {
+        switch (pattern[0]) {
+        case '*':
+            while (plen > 1 && pattern[1] == '*') {
+                pattern++;
+                plen--;
+            }
+            if (plen == 1) {
+                return true;
+            }
+            for (size_t skip = 0; skip <= slen; skip++) {
+                if (glob_match(pattern + 1, plen - 1, str + skip, slen - skip)) {
+                    return true;
+                }
+            }
+            return false;
+        case '?':
+            if (slen == 0) {
+                return false;
+            }
+            str++;
+            slen--;
+            break;
+        case '[': {
+            if (slen == 0) {
+                return false;
+            }
+            pattern++;
+            plen--;
+            bool negate = plen > 0 && pattern[0] == '^';
+            if (negate) {
+                pattern++;
+                plen--;
+            }
+            bool matched = false;
+            while (plen > 0 && pattern[0] != ']') {
+                if (pattern[0] == '\\' && plen >= 2) {
+                    pattern++;
+                    plen--;
+                    if (pattern[0] == str[0]) matched = true;
+                } else if (plen >= 3 && pattern[1] == '-') {
+                    char lo = std::min(pattern[0], pattern[2]);
+                    char hi = std::max(pattern[0], pattern[2]);
+                    if (str[0] >= lo && str[0] <= hi) matched = true;
+                    pattern += 2;
+                    plen -= 2;
+                } else if (pattern[0] == str[0]) {
+                    matched = true;
+                }
+                pattern++;
+                plen--;
+            }
+            if (negate) {
+                matched = !matched;
+            }
+            if (!matched) {
+                return false;
+            }
+            str++;
+            slen--;
+            if (plen == 0) {
+                return slen == 0;
+            }
+            break;
+        }
+        case '\\':
+            if (plen >= 2) {
+                pattern++;
+                plen--;
+            }
+            // fall through
+        default:
+            if (slen == 0 || pattern[0] != str[0]) {
+                return false;
+            }
+            str++;
+            slen--;
+            break;
+        }
+        pattern++;
+        plen--;
+    }
+    return slen == 0;
+}
@@ -0,0 +1,112 @@
+#ifndef _PUBSUB_H_
+#define _PUBSUB_H_
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// Publish/subscribe registry.
+//
+// Exact channels live in a channel -> subscriber index. Glob patterns are kept
+// in a trie keyed by their literal prefix (the characters before the first
+// wildcard), so PUBLISH only glob-matches the patterns whose prefix is a
+// prefix of the channel instead of every pattern in the server.
+//
+// A published message is encoded into its RESP frame once per matching
+// channel/pattern and the same refcounted buffer is pushed onto every
+// subscriber's output queue.
+//
+// A subscriber that does not drain its queue cannot hold more than
+// kMaxQueuedBytes of frames. Past that, as with Redis's pubsub output buffer
+// limit, its backlog is dropped, it gets no further messages and overflowed()
+// tells the connection layer to close it.
+//
+// The connection layer is told when a subscriber needs attention rather than
+// polling every queue: the notify hook runs when a frame lands in an empty
+// queue and when a queue overflows.
+class PubSub {
+public:
+    using Message = std::shared_ptr<const std::string>;
+
+    static const size_t kMaxQueuedBytes = 32 << 20;
+
+    PubSub();
+    ~PubSub();
+
+    // Each returns the number of channels + patterns the client is subscribed to afterwards
+    size_t subscribe(uint64_t client_id, const std::string& channel);
+    size_t unsubscribe(uint64_t client_id, const std::string& channel);
+    size_t psubscribe(uint64_t client_id, const std::string& pattern);
+    size_t punsubscribe(uint64_t client_id, const std::string& pattern);
+    // UNSUBSCRIBE / PUNSUBSCRIBE without arguments: every channel (pattern) of the client
+    size_t unsubscribe_all(uint64_t client_id);
+    size_t punsubscribe_all(uint64_t client_id);
+
+    // Drop every subscription and pending message of a client (connection closed)
+    void remove_client(uint64_t client_id);
+
+    // Runs under the registry lock with the client to wake, so it must not
+    // call back into PubSub
+    using Notify = std::function<void(uint64_t client_id)>;
+    void set_notify(Notify notify);
+
+    // Returns the number of subscribers that received the message
+    size_t publish(const std::string& channel, const std::string& message);
+
+    // Output queue access for the connection layer
+    bool pop_message(uint64_t client_id, Message& out);
+    size_t drain(uint64_t client_id, std::vector<Message>& out);
+    size_t pending(uint64_t client_id) const;
+    // True once the client's queue went over kMaxQueuedBytes; it should be disconnected
+    bool overflowed(uint64_t client_id) const;
+
+    size_t numsub(const std::string& channel) const;
+    size_t numpat() const;
+
+    // Redis-style glob matching (*, ?, [...], \x)
+    static bool glob_match(const char* pattern, size_t plen, const char* str, size_t slen);
+
+private:
+    struct Subscriber {
+        std::deque<Message> queue;
+        size_t queued_bytes = 0;
+        bool overflowed = false;
+        std::unordered_set<std::string> channels;
+        std::unordered_set<std::string> patterns;
+    };
+
+    struct TrieNode {
+        std::map<char, std::unique_ptr<TrieNode>> children;
+        // Patterns whose literal prefix ends at this node -> subscriber ids
+        std::map<std::string, std::vector<uint64_t>> patterns;
+    };
+
+    static std::string literal_prefix(const std::string& pattern);
+    static Message encode_message(const std::string& channel, const std::string& message);
+    static Message encode_pmessage(const std::string& pattern, const std::string& channel,
+                                   const std::string& message);
+
+    size_t subscription_count(const Subscriber& sub) const;
+    // Queues frame for the client; false if the client is (now) over its limit
+    bool deliver_locked(uint64_t client_id, const Message& frame);
+    void remove_channel_locked(uint64_t client_id, const std::string& channel);
+    void remove_pattern_locked(uint64_t client_id, const std::string& pattern);
+
+    std::unordered_map<std::string, std::vector<uint64_t>> channels_;
+    std::unordered_map<uint64_t, Subscriber> subscribers_;
+    TrieNode pattern_root_;
+    size_t num_patterns_;
+    Notify notify_;
+
+    // Publishers run on the engine thread while connections drain their own queues
+    mutable std::mutex mutex_;
+};
+
+#endif
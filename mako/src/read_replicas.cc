@@ -0,0 +1,124 @@
+#include "read_replicas.h"
+#include "hash.h"
+#include <algorithm>
+
+namespace {
+
+// Only the owning thread writes its counters, so no read-modify-write is needed
+inline void bump(std::atomic<uint64_t>& counter) {
+    counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+}
+
+} // namespace
+
+KeyVersions::KeyVersions() : stripes_(new Stripe[kStripes]) {}
+
+size_t KeyVersions::stripe(const std::string& key) {
+    return murmur64a(key.data(), key.size(), 0x5eed) & (kStripes - 1);
+}
+
+void KeyVersions::bump_all() {
+    for (size_t i = 0; i < kStripes; i++) {
+        stripes_[i].value.fetch_add(1, std::memory_order_acq_rel);
+    }
+}
+
+const size_t ReadReplicas::kMaxHot;
+
+ReadReplicas::ReadReplicas(const KeyVersions& versions)
+    : versions_(versions), generation_(0) {}
+
+ReadReplicas::~ReadReplicas() {}
+
+ReadReplicas::Local* ReadReplicas::local() {
+    return locals_.get(mutex_);
+}
+
+void ReadReplicas::refresh(Local& l) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    l.generation = generation_.load(std::memory_order_acquire);
+    l.hot.clear();
+    l.hot.insert(hot_.begin(), hot_.end());
+    for (auto it = l.copies.begin(); it != l.copies.end();) {
+        if (l.hot.count(it->first)) {
+            ++it;
+        } else {
+            it = l.copies.erase(it);
+        }
+    }
+}
+
+bool ReadReplicas::lookup(const std::string& key, std::string& value) {
+    Local* l = local();
+    if (l->generation != generation_.load(std::memory_order_acquire)) {
+        refresh(*l);
+    }
+    if (l->hot.empty()) {
+        return false;
+    }
+    auto it = l->copies.find(key);
+    if (it == l->copies.end()) {
+        if (l->hot.count(key)) {
+            bump(l->misses);
+        }
+        return false;
+    }
+    if (it->second.version != versions_.get(key)) {
+        l->copies.erase(it);
+        bump(l->misses);
+        return false;
+    }
+    value = it->second.value;
+    bump(l->hits);
+    return true;
+}
+
+void ReadReplicas::fill(const std::string& key, const std::string& value) {
+    if (value.size() > kMaxValueBytes) {
+        return;
+    }
+    Local* l = local();
+    if (l->generation != generation_.load(std::memory_order_acquire)) {
+        refresh(*l);
+    }
+    if (!l->hot.count(key)) {
+        return;
+    }
+    // The engine lock is held, so no write can move the version under us
+    Copy& copy = l->copies[key];
+    copy.value = value;
+    copy.version = versions_.get(key);
+}
+
+void ReadReplicas::publish(const std::vector<std::string>& keys) {
+    std::vector<std::string> next(keys.begin(), keys.begin() + std::min(keys.size(), kMaxHot));
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (next == hot_) {
+        return;
+    }
+    hot_.swap(next);
+    generation_.fetch_add(1, std::memory_order_acq_rel);
+}
+
+void ReadReplicas::hot_keys(std::vector<std::string>& out) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    out = hot_;
+}
+
+uint64_t ReadReplicas::hits() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    uint64_t total = 0;
+    for (const auto& l : locals_.all()) {
+        total += l->hits.load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+uint64_t ReadReplicas::misses() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    uint64_t total = 0;
+    for (const auto& l : locals_.all()) {
+        total += l->misses.load(std::memory_order_relaxed);
+    }
+    return total;
+}
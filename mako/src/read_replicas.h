@@ -0,0 +1,94 @@
+#ifndef _READ_REPLICAS_H_
+#define _READ_REPLICAS_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "per_thread.h"
+
+// Write versions for every key, striped by hash. Writers bump the stripe of
+// the key they touch while holding the engine lock; readers load it without
+// the lock to check whether a copy made earlier is still current. Two keys
+// sharing a stripe only cost a spurious invalidation.
+class KeyVersions {
+public:
+    static const size_t kStripes = 4096;   // power of two
+
+    KeyVersions();
+
+    uint64_t get(const std::string& key) const {
+        return stripes_[stripe(key)].value.load(std::memory_order_acquire);
+    }
+    void bump(const std::string& key) {
+        stripes_[stripe(key)].value.fetch_add(1, std::memory_order_acq_rel);
+    }
+    void bump_all();
+
+private:
+    struct alignas(64) Stripe {
+        std::atomic<uint64_t> value{0};
+    };
+    static size_t stripe(const std::string& key);
+
+    std::unique_ptr<Stripe[]> stripes_;
+};
+
+// Per-worker read-only copies of hot string values.
+//
+// The engine publishes the current hot key set (from HotKeys); each worker
+// thread keeps its own copy of that set and of the values it last read for
+// those keys, tagged with the key's version. A GET of a hot key whose version
+// has not moved is answered from the worker's copy without the engine lock,
+// so reads of one viral key spread over every worker instead of queueing on
+// the owner. Any write bumps the version and the next read refills the copy.
+class ReadReplicas {
+public:
+    static const size_t kMaxHot = 16;
+    static const size_t kMaxValueBytes = 64 * 1024;
+
+    explicit ReadReplicas(const KeyVersions& versions);
+    ~ReadReplicas();
+
+    // Lock-free path: true with the value if this worker holds a current copy
+    bool lookup(const std::string& key, std::string& value);
+    // Called with the engine lock held right after a GET returned value
+    void fill(const std::string& key, const std::string& value);
+
+    // Replaces the hot set; workers pick it up on their next lookup
+    void publish(const std::vector<std::string>& keys);
+    void hot_keys(std::vector<std::string>& out) const;
+
+    uint64_t hits() const;
+    uint64_t misses() const;
+
+private:
+    struct Copy {
+        std::string value;
+        uint64_t version;
+    };
+    struct Local {
+        uint64_t generation = 0;
+        std::unordered_set<std::string> hot;
+        std::unordered_map<std::string, Copy> copies;
+        std::atomic<uint64_t> hits{0};     // written by the owner, summed by hits()
+        std::atomic<uint64_t> misses{0};
+    };
+
+    Local* local();
+    void refresh(Local& l);
+
+    const KeyVersions& versions_;
+    std::atomic<uint64_t> generation_;
+    mutable std::mutex mutex_;   // guards hot_ and locals_
+    std::vector<std::string> hot_;
+    PerThread<Local> locals_;
+};
+
+#endif
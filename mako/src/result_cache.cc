@@ -0,0 +1,133 @@
+#include "result_cache.h"
+
+namespace {
+
+// Bookkeeping per entry beyond its strings: list node, index slot, stamp
+const size_t kEntryOverhead = 96;
+
+bool two_keys(const std::string& operation) {
+    return operation == "sinter" || operation == "sdiff";   // args is the second key
+}
+
+} // namespace
+
+const size_t ResultCache::kDefaultBudget;
+
+ResultCache::ResultCache(const KeyVersions& versions)
+    : versions_(versions), enabled_(false), bytes_(0), budget_(kDefaultBudget), hits_(0), misses_(0), stale_(0),
+      evictions_(0) {}
+
+bool ResultCache::cacheable(const std::string& operation) {
+    return operation == "smembers" || operation == "hgetall" || operation == "lrange" || two_keys(operation);
+}
+
+void ResultCache::set_enabled(bool on) {
+    enabled_.store(on, std::memory_order_relaxed);
+    if (!on) {
+        clear();
+    }
+}
+
+void ResultCache::set_budget(size_t bytes) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    budget_ = bytes;
+    evict_locked();
+}
+
+std::string ResultCache::make_id(const std::string& operation, const std::string& key, const std::string& args) {
+    std::string id;
+    id.reserve(operation.size() + key.size() + args.size() + 2);
+    id.append(operation).push_back('\0');
+    id.append(key).push_back('\0');
+    id.append(args);
+    return id;
+}
+
+ResultCache::Stamp ResultCache::stamp(const std::string& operation, const std::string& key,
+                                      const std::string& args) const {
+    Stamp s;
+    s.versions[0] = versions_.get(key);
+    if (two_keys(operation)) {
+        s.versions[1] = versions_.get(args);
+    }
+    return s;
+}
+
+bool ResultCache::current(const std::string& operation, const std::string& key, const std::string& args,
+                          const Stamp& s) const {
+    Stamp now = stamp(operation, key, args);
+    return now.versions[0] == s.versions[0] && now.versions[1] == s.versions[1];
+}
+
+bool ResultCache::lookup(const std::string& operation, const std::string& key, const std::string& args,
+                         std::string& reply) {
+    if (!enabled() || !cacheable(operation)) {
+        return false;
+    }
+    std::string id = make_id(operation, key, args);
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = index_.find(id);
+    if (it == index_.end()) {
+        misses_++;
+        return false;
+    }
+    if (!current(operation, key, args, it->second->stamp)) {
+        erase_locked(it->second);
+        stale_++;
+        misses_++;
+        return false;
+    }
+    lru_.splice(lru_.begin(), lru_, it->second);
+    reply = it->second->reply;
+    hits_++;
+    return true;
+}
+
+void ResultCache::store(const std::string& operation, const std::string& key, const std::string& args,
+                        const Stamp& s, const std::string& reply) {
+    if (!enabled() || !cacheable(operation) || !current(operation, key, args, s)) {
+        return;   // a write already overtook this reply
+    }
+    std::string id = make_id(operation, key, args);
+    size_t size = id.size() * 2 + reply.size() + kEntryOverhead;
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (size > budget_) {
+        return;
+    }
+    auto it = index_.find(id);
+    if (it != index_.end()) {
+        erase_locked(it->second);
+    }
+    lru_.push_front(Entry{id, reply, s});
+    index_.emplace(std::move(id), lru_.begin());
+    bytes_ += size;
+    evict_locked();
+}
+
+void ResultCache::erase_locked(Lru::iterator it) {
+    bytes_ -= it->id.size() * 2 + it->reply.size() + kEntryOverhead;
+    index_.erase(it->id);
+    lru_.erase(it);
+}
+
+void ResultCache::evict_locked() {
+    while (bytes_ > budget_ && !lru_.empty()) {
+        erase_locked(std::prev(lru_.end()));
+        evictions_++;
+    }
+}
+
+void ResultCache::clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    lru_.clear();
+    index_.clear();
+    bytes_ = 0;
+}
+
+std::string ResultCache::stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return "enabled:" + std::string(enabled() ? "1" : "0") + ",hits:" + std::to_string(hits_) +
+           ",misses:" + std::to_string(misses_) + ",stale:" + std::to_string(stale_) +
+           ",evictions:" + std::to_string(evictions_) + ",entries:" + std::to_string(index_.size()) +
+           ",bytes:" + std::to_string(bytes_) + ",budget:" + std::to_string(budget_);
+}
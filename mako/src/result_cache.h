@@ -0,0 +1,80 @@
+#ifndef _RESULT_CACHE_H_
+#define _RESULT_CACHE_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "read_replicas.h"
+
+// Opt-in cache of the replies of expensive collection reads.
+//
+// Entries are keyed by (command, key, args) and hold the reply together with
+// the write versions of the keys the command read, taken before it ran. A
+// lookup compares those against the current versions: any write since then
+// has bumped one of them, so a stale entry costs one version read per key to
+// detect and is dropped. Versions are striped, so a write to an unrelated key
+// in the same stripe can also drop an entry; it never serves a stale one.
+// Entries are evicted least recently used first to stay under the byte budget.
+class ResultCache {
+public:
+    static const size_t kDefaultBudget = 64 << 20;
+
+    // Versions of the keys one read depends on, taken before it runs
+    struct Stamp {
+        uint64_t versions[2] = {0, 0};
+    };
+
+    explicit ResultCache(const KeyVersions& versions);
+
+    // SMEMBERS, HGETALL, LRANGE, SINTER and SDIFF
+    static bool cacheable(const std::string& operation);
+
+    bool enabled() const { return enabled_.load(std::memory_order_relaxed); }
+    void set_enabled(bool on);          // turning it off drops every entry
+    void set_budget(size_t bytes);
+
+    // stamp() is taken under the engine lock before the read runs; lookup()
+    // and store() do not need the lock
+    Stamp stamp(const std::string& operation, const std::string& key, const std::string& args) const;
+    bool lookup(const std::string& operation, const std::string& key, const std::string& args, std::string& reply);
+    void store(const std::string& operation, const std::string& key, const std::string& args, const Stamp& stamp,
+               const std::string& reply);
+    void clear();
+
+    // enabled:..,hits:..,misses:..,stale:..,evictions:..,entries:..,bytes:..,budget:..
+    std::string stats() const;
+
+private:
+    struct Entry {
+        std::string id;
+        std::string reply;
+        Stamp stamp;
+    };
+    typedef std::list<Entry> Lru;   // most recently used first
+
+    static std::string make_id(const std::string& operation, const std::string& key, const std::string& args);
+    bool current(const std::string& operation, const std::string& key, const std::string& args,
+                 const Stamp& stamp) const;
+    void evict_locked();
+    void erase_locked(Lru::iterator it);
+
+    const KeyVersions& versions_;
+    std::atomic<bool> enabled_;
+
+    mutable std::mutex mutex_;
+    Lru lru_;
+    std::unordered_map<std::string, Lru::iterator> index_;
+    size_t bytes_;
+    size_t budget_;
+    uint64_t hits_;
+    uint64_t misses_;
+    uint64_t stale_;
+    uint64_t evictions_;
+};
+
+#endif
@@ -0,0 +1,82 @@
+#include "rope.h"
+#include <algorithm>
+
+Rope::Rope() : size_(0) {
+}
+
+Rope::Rope(const std::string& value) : size_(0) {
+    append(value.data(), value.size());
+}
+
+void Rope::append(const char* data, size_t len) {
+    while (len > 0) {
+        if (chunks_.empty() || chunks_.back().size() == kChunkSize) {
+            chunks_.emplace_back();
+            chunks_.back().reserve(kChunkSize);
+        }
+        std::string& tail = chunks_.back();
+        size_t n = std::min(len, kChunkSize - tail.size());
+        tail.append(data, n);
+        data += n;
+        len -= n;
+        size_ += n;
+    }
+}
+
+void Rope::append_fill(char c, size_t len) {
+    while (len > 0) {
+        if (chunks_.empty() || chunks_.back().size() == kChunkSize) {
+            chunks_.emplace_back();
+            chunks_.back().reserve(kChunkSize);
+        }
+        std::string& tail = chunks_.back();
+        size_t n = std::min(len, kChunkSize - tail.size());
+        tail.append(n, c);
+        len -= n;
+        size_ += n;
+    }
+}
+
+void Rope::set_range(size_t offset, const char* data, size_t len) {
+    if (offset > size_) {
+        append_fill('\0', offset - size_);
+    }
+    // Overwrite the part that already exists, then append the remainder
+    size_t overlap = offset < size_ ? std::min(len, size_ - offset) : 0;
+    size_t pos = offset;
+    size_t done = 0;
+    while (done < overlap) {
+        std::string& chunk = chunks_[pos / kChunkSize];
+        size_t in_chunk = pos % kChunkSize;
+        size_t n = std::min(overlap - done, chunk.size() - in_chunk);
+        std::copy(data + done, data + done + n, &chunk[in_chunk]);
+        pos += n;
+        done += n;
+    }
+    append(data + overlap, len - overlap);
+}
+
+void Rope::range(size_t start, size_t len, std::vector<std::string_view>& out) const {
+    if (start >= size_) {
+        return;
+    }
+    len = std::min(len, size_ - start);
+    size_t pos = start;
+    while (len > 0) {
+        const std::string& chunk = chunks_[pos / kChunkSize];
+        size_t in_chunk = pos % kChunkSize;
+        size_t n = std::min(len, chunk.size() - in_chunk);
+        out.emplace_back(chunk.data() + in_chunk, n);
+        pos += n;
+        len -= n;
+    }
+}
+
+std::string Rope::flatten() const {
+    std::string out;
+    out.reserve(size_);
+    for (const auto& chunk : chunks_) {
+        out += chunk;
+    }
+    return out;
+}
@@ -0,0 +1,41 @@
+#ifndef _ROPE_H_
+#define _ROPE_H_
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Chunked storage for large string values.
+//
+// Every chunk except the last is exactly kChunkSize bytes, so the chunk that
+// holds a byte offset is offset / kChunkSize. Chunks reserve their full size
+// up front, which means APPEND never moves bytes that are already stored and
+// SETRANGE/GETRANGE only touch the chunks covering the requested range.
+class Rope {
+public:
+    static const size_t kChunkSize = 64 * 1024;
+
+    Rope();
+    explicit Rope(const std::string& value);
+
+    size_t size() const { return size_; }
+
+    void append(const char* data, size_t len);
+
+    // Overwrites [offset, offset + len), zero-padding any gap past the end
+    void set_range(size_t offset, const char* data, size_t len);
+
+    // Appends views covering [start, start + len) to out; no bytes are copied
+    void range(size_t start, size_t len, std::vector<std::string_view>& out) const;
+
+    std::string flatten() const;
+
+private:
+    void append_fill(char c, size_t len);
+
+    std::vector<std::string> chunks_;
+    size_t size_;
+};
+
+#endif
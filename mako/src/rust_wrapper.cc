@@ -1,32 +1,236 @@
 #include "rust_wrapper.h"
 #include <sstream>
+#include <cstring>
+#include <strings.h>
+#include <future>
 #include <vector>
+#include <algorithm>
+#include <climits>
+#include <cstdlib>
+#include <cerrno>
 
 // Global instance pointer for Rust notification
 RustWrapper* g_rust_wrapper_instance = nullptr;
 
-RustWrapper::RustWrapper() : running_(false), initialized_(false) {
+namespace {
+
+// Error replies for shed requests; the Rust layer passes them on as -BUSY
+const char kBusyQueueFull[] = "BUSY too many requests queued for the engine";
+const char kBusyDeadline[] = "BUSY request deadline exceeded";
+
+// Runs a request that holds `lock`. Large SMEMBERS/HGETALL/DEL run in slices
+// with the lock released in between; KEYS over a large keyspace only copies
+// the names under the lock and has the pattern matched on the slow read pool
+// after it is released, so fast commands queued behind it are not held up.
+KVStore::Result run_locked(KVStore& kv, std::unique_lock<std::mutex>& lock, const std::string& op,
+                           const std::string& key, const std::string& value) {
+    std::shared_ptr<KVStore::Cursor> cursor = kv.begin_chunked(op, key);
+    if (cursor) {
+        while (!kv.step_chunked(*cursor)) {
+            lock.unlock();
+            std::this_thread::yield();
+            lock.lock();
+        }
+        lock.unlock();
+        return KVStore::chunked_reply(*cursor);
+    }
+    if (!KVStore::slow_read_candidate(op) || kv.read_cost(op) < KVStore::kSlowReadElements) {
+        return kv.execute_operation(op, key, value);
+    }
+    KVStore::ReadJob job = kv.prepare_read(op, key);
+    lock.unlock();
+    
+    std::promise<KVStore::Result> done;
+    std::future<KVStore::Result> reply = done.get_future();
+    g_rust_wrapper_instance->slow_reads_.submit([&]() {
+        try {
+            done.set_value(job());
+        } catch (...) {
+            done.set_exception(std::current_exception());
+        }
+    });
+    return reply.get();
+}
+
+// run_locked(), keeping the reply in the result cache if it is enabled
+KVStore::Result execute_locked(KVStore& kv, std::unique_lock<std::mutex>& lock, const std::string& op,
+                               const std::string& key, const std::string& value) {
+    ResultCache::Stamp stamp = kv.read_stamp(op, key, value);
+    KVStore::Result result = run_locked(kv, lock, op, key, value);
+    kv.cache_read(op, key, value, stamp, result);
+    return result;
+}
+
+// Copies a result out for the front end: a failure with text is an error and
+// one without is a nil, a success is typed by its operation
+bool fill_reply(EngineReply* reply, const std::string& op, const KVStore::Result& result) {
+    if (!result.success) {
+        reply->type = result.value.empty() ? ENGINE_REPLY_NIL : ENGINE_REPLY_ERROR;
+    } else {
+        switch (KVStore::reply_type(op)) {
+            case KVStore::kStatusReply: reply->type = ENGINE_REPLY_STATUS; break;
+            case KVStore::kIntegerReply: reply->type = ENGINE_REPLY_INTEGER; break;
+            default: reply->type = ENGINE_REPLY_BULK; break;
+        }
+    }
+    reply->len = result.value.size();
+    reply->data = nullptr;
+    if (reply->len) {
+        reply->data = static_cast<char*>(malloc(reply->len));
+        memcpy(reply->data, result.value.data(), reply->len);
+    }
+    return result.success;
+}
+
+} // namespace
+
+RustWrapper::RustWrapper() : slow_reads_(kSlowReadThreads), running_(false), initialized_(false) {
     g_rust_wrapper_instance = this;
 }
 
 RustWrapper::~RustWrapper() {
-    if (running_) running_ = false;
+    if (running_) {
+        {
+            std::lock_guard<std::mutex> lock(kv_mutex_);
+            running_ = false;
+        }
+        timer_cv_.notify_all();
+        if (timer_thread_.joinable()) {
+            timer_thread_.join();
+        }
+    }
     g_rust_wrapper_instance = nullptr;
 }
 
+void RustWrapper::notify_timers() {
+    timer_cv_.notify_one();
+}
+
+void RustWrapper::timer_loop() {
+    std::unique_lock<std::mutex> lock(kv_mutex_);
+    while (running_) {
+        kv_store_.process_timers();
+        
+        // Sleep until the next deadline; new timers wake us through notify_timers()
+        auto wake = std::chrono::steady_clock::now() + std::chrono::milliseconds(100);
+        TimerQueue::TimePoint next;
+        if (kv_store_.timers().next_deadline(next) && next < wake) {
+            wake = next;
+        }
+        timer_cv_.wait_until(lock, wake);
+    }
+}
+
+KVStore::Result RustWrapper::bulk_load(const std::string& path, const std::string& args) {
+    BulkLoader::Load load;
+    std::string error;
+    if (!BulkLoader::read(path, args, load, error)) {
+        return KVStore::Result(error, false);
+    }
+    std::lock_guard<std::mutex> lock(kv_mutex_);
+    return kv_store_.bulk_insert(load);
+}
+
+KVStore::Result RustWrapper::populate(const std::string& count, const std::string& args) {
+    BulkLoader::Populate spec;
+    std::string error;
+    if (!BulkLoader::parse_populate(count, args, spec, error)) {
+        return KVStore::Result(error, false);
+    }
+    BulkLoader::Load load;
+    BulkLoader::generate(spec, load);
+    std::lock_guard<std::mutex> lock(kv_mutex_);
+    return kv_store_.populate_insert(load, spec);
+}
+
+KVStore::Result RustWrapper::keyspace_export(const std::string& dir, const std::string& args) {
+    KeyspaceDump::Child child;
+    {
+        std::lock_guard<std::mutex> lock(kv_mutex_);
+        KVStore::Result started = kv_store_.export_begin(dir, args, child);
+        if (!started.success) {
+            return started;
+        }
+    }
+    return KVStore::export_finish(child);
+}
+
+KVStore::Result RustWrapper::keyspace_import(const std::string& dir, const std::string& args) {
+    KeyspaceDump::Image image;
+    std::string error;
+    if (!KeyspaceDump::read(dir, args, image, error)) {
+        return KVStore::Result(error, false);
+    }
+    std::lock_guard<std::mutex> lock(kv_mutex_);
+    return kv_store_.import_insert(image);
+}
+
+bool RustWrapper::set_data_dir(const std::string& dir, std::string& error) {
+    char resolved[PATH_MAX];
+    if (!realpath(dir.c_str(), resolved)) {
+        error = "ERROR: cannot use " + dir + ": " + std::strerror(errno);
+        return false;
+    }
+    data_dir_ = resolved;
+    return true;
+}
+
+bool RustWrapper::client_path(const std::string& name, std::string& path, std::string& error) const {
+    if (data_dir_.empty()) {
+        error = "ERROR: file access is disabled, start the server with --dir";
+        return false;
+    }
+    if (name.empty() || name[0] == '/') {
+        error = "ERROR: path must be relative to the data directory";
+        return false;
+    }
+    for (size_t start = 0; start <= name.size();) {
+        size_t end = name.find('/', start);
+        if (end == std::string::npos) {
+            end = name.size();
+        }
+        if (name.compare(start, end - start, "..") == 0) {
+            error = "ERROR: path must not contain ..";
+            return false;
+        }
+        start = end + 1;
+    }
+    path = data_dir_ + "/" + name;
+    
+    // Symlinks are followed as far as the path exists; a missing tail (a
+    // directory EXPORT is about to create) can hold no link
+    std::string existing = path;
+    char resolved[PATH_MAX];
+    while (!realpath(existing.c_str(), resolved)) {
+        size_t slash = existing.rfind('/');
+        if (errno != ENOENT || slash == std::string::npos || slash < data_dir_.size()) {
+            error = "ERROR: cannot resolve " + name + ": " + std::strerror(errno);
+            return false;
+        }
+        existing.resize(slash);
+    }
+    std::string real(resolved);
+    if (real != data_dir_ && real.compare(0, data_dir_.size() + 1, data_dir_ + "/") != 0) {
+        error = "ERROR: path leaves the data directory";
+        return false;
+    }
+    return true;
+}
+
 bool RustWrapper::init() {
     if (initialized_) {
         return false; // Already initialized
     }
     
     // Initialize Rust socket listener
-    if (!rust_init()) {
+    if (!rust_init(std::max(1u, std::thread::hardware_concurrency()))) {
         std::cerr << "Failed to initialize Rust socket listener" << std::endl;
         return false;
     }
     
     running_ = true;
     initialized_ = true;
+    timer_thread_ = std::thread(&RustWrapper::timer_loop, this);
     
     std::cout << "RustWrapper initialized successfully" << std::endl;
     return true;
@@ -34,29 +238,264 @@ bool RustWrapper::init() {
 
 
 extern "C" {
-    bool cpp_execute_request_sync(const char* operation, const char* key, const char* value, char** result) {
+    bool cpp_execute_request_sync(const char* operation, const char* key, size_t key_len, const char* value,
+                                  size_t value_len, int64_t waited_us, EngineReply* reply) {
         std::string op_str(operation);
-        std::string key_str(key);
-        std::string val_str(value ? value : "");
+        std::string key_str(key, key_len);
+        std::string val_str(value ? value : "", value ? value_len : 0);
         
-        KVStore::Result kv_result = g_rust_wrapper_instance->kv_store_.execute_operation(op_str, key_str, val_str);
+        KVStore& kv = g_rust_wrapper_instance->kv_store_;
         
-        if (kv_result.success && !kv_result.value.empty()) {
-            // Allocate C string for result
-            *result = strdup(kv_result.value.c_str());
-        } else {
-            *result = nullptr;
+        // A bulk load parses its file, DEBUG POPULATE builds its keys and
+        // IMPORT parses its dump before taking the engine lock; EXPORT writes
+        // from a forked child once the lock is released
+        if (op_str == "bulkload" || op_str == "debug.populate" || op_str == "export" || op_str == "import") {
+            KVStore::Result loaded(false);
+            std::string path;
+            std::string error;
+            if (op_str == "bulkload") {
+                loaded = g_rust_wrapper_instance->client_path(key_str, path, error)
+                    ? g_rust_wrapper_instance->bulk_load(path, val_str)
+                    : KVStore::Result(error, false);
+            } else if (op_str == "debug.populate") {
+                loaded = g_rust_wrapper_instance->populate(key_str, val_str);
+            } else if (!g_rust_wrapper_instance->client_path(key_str, path, error)) {
+                loaded = KVStore::Result(error, false);
+            } else if (op_str == "export") {
+                loaded = g_rust_wrapper_instance->keyspace_export(path, val_str);
+            } else {
+                loaded = g_rust_wrapper_instance->keyspace_import(path, val_str);
+            }
+            return fill_reply(reply, op_str, loaded);
+        }
+        
+        // Sharded counters and hot keys are served without the engine lock
+        std::string unlocked;
+        if (kv.sharded_counter(op_str, key_str, val_str, unlocked) ||
+            (op_str == "get" && kv.read_replica(key_str, unlocked))) {
+            return fill_reply(reply, op_str, KVStore::Result(unlocked, true));
+        }
+        // So are cached replies of large reads whose keys have not been written since
+        if (kv.cached_read(op_str, key_str, val_str, unlocked)) {
+            return fill_reply(reply, op_str, KVStore::Result(unlocked, true));
         }
         
-        std::cout << "Executed " << op_str << " for key '" << key_str << "' -> " << kv_result.value << std::endl;
+        // Bounded queue for the engine lock; work that waited past its deadline is dropped
+        AdmissionControl& admission = kv.admission_control();
+        AdmissionControl::Clock::time_point arrival = admission.arrival(waited_us);
+        if (!admission.enter()) {
+            return fill_reply(reply, op_str, KVStore::Result(kBusyQueueFull, false));
+        }
         
-        return kv_result.success;
+        std::unique_lock<std::mutex> lock(g_rust_wrapper_instance->kv_mutex_, std::try_to_lock);
+        bool contended = !lock.owns_lock();
+        KVStore::Result kv_result(false);
+        if (contended && KVStore::coalescable(op_str)) {
+            // A read stampede: identical reads queued behind the lock share one execution
+            SingleFlight::ReplyPtr reply = g_rust_wrapper_instance->reads_.run(
+                op_str, key_str, val_str, kv.key_version(key_str), [&]() {
+                    std::unique_lock<std::mutex> engine(g_rust_wrapper_instance->kv_mutex_);
+                    SingleFlight::Reply r;
+                    r.version = kv.key_version(key_str);
+                    if (admission.expired(arrival)) {
+                        r.value = kBusyDeadline;
+                        return r;
+                    }
+                    KVStore::Result executed = execute_locked(kv, engine, op_str, key_str, val_str);
+                    if (op_str == "get" && executed.success) {
+                        kv.fill_replica(key_str, executed.value);
+                    }
+                    r.value = std::move(executed.value);
+                    r.success = executed.success;
+                    return r;
+                });
+            admission.leave();
+            kv_result = KVStore::Result(reply->value, reply->success);
+        } else {
+            if (contended) {
+                lock.lock();
+            }
+            admission.leave();
+            if (admission.expired(arrival)) {
+                kv_result = KVStore::Result(kBusyDeadline, false);
+            } else {
+                kv_result = execute_locked(kv, lock, op_str, key_str, val_str);
+                if (op_str == "get" && kv_result.success) {
+                    kv.fill_replica(key_str, kv_result.value);
+                } else if (contended && kv_result.success) {
+                    kv.note_incr_contention(op_str, key_str);
+                }
+            }
+            if (lock.owns_lock()) {
+                lock.unlock();
+            }
+        }
+        
+        return fill_reply(reply, op_str, kv_result);
     }
     
-    void cpp_free_string(char* ptr) {
-        if (ptr) {
-            free(ptr);
+    void cpp_free_reply(EngineReply* reply) {
+        free(reply->data);
+        reply->data = nullptr;
+        reply->len = 0;
+    }
+
+    void cpp_worker_thread_init(size_t thread_id) {
+        // Nothing per thread yet: every worker shares the engine behind kv_mutex_
+        (void)thread_id;
+    }
+
+    bool cpp_execute_transaction(const TxnRequest* request, TxnResponse* response) {
+        response->transaction_success = false;
+        response->num_results = 0;
+        response->results = nullptr;
+        if (request->num_ops == 0) {
+            response->transaction_success = true;
+            return true;
+        }
+        auto* results = static_cast<TxnOpResult*>(calloc(request->num_ops, sizeof(TxnOpResult)));
+        if (!results) {
+            return false;
+        }
+        response->results = results;
+        response->num_results = request->num_ops;
+
+        KVStore& kv = g_rust_wrapper_instance->kv_store_;
+        std::lock_guard<std::mutex> lock(g_rust_wrapper_instance->kv_mutex_);
+        for (size_t i = 0; i < request->num_ops; i++) {
+            const TxnOperation& op = request->ops[i];
+            std::string key(reinterpret_cast<const char*>(op.key_ptr), op.key_len);
+            if (op.op == TXN_OP_GET) {
+                KVStore::Result got = kv.execute_operation("get", key, "");
+                results[i].success = true;   // a missing key is a nil reply, not an error
+                if (got.success && !got.value.empty()) {
+                    results[i].data_ptr = static_cast<uint8_t*>(malloc(got.value.size()));
+                    if (results[i].data_ptr) {
+                        memcpy(results[i].data_ptr, got.value.data(), got.value.size());
+                        results[i].data_len = got.value.size();
+                    } else {
+                        results[i].success = false;
+                    }
+                }
+            } else if (op.op == TXN_OP_SET) {
+                std::string value = op.val_ptr ? std::string(reinterpret_cast<const char*>(op.val_ptr), op.val_len)
+                                               : std::string();
+                results[i].success = kv.execute_operation("set", key, value).success;
+            }
+        }
+        response->transaction_success = true;
+        return true;
+    }
+
+    void cpp_free_transaction_response(TxnResponse* response) {
+        for (size_t i = 0; response->results && i < response->num_results; i++) {
+            free(response->results[i].data_ptr);
+        }
+        free(response->results);
+        response->results = nullptr;
+        response->num_results = 0;
+    }
+
+    bool cpp_pubsub_command(uint64_t client_id, const char* operation, const char* channels, uint64_t* count) {
+        std::string op_str(operation);
+        std::string channels_str(channels ? channels : "");
+        KVStore& kv = g_rust_wrapper_instance->kv_store_;
+
+        std::lock_guard<std::mutex> lock(g_rust_wrapper_instance->kv_mutex_);
+        KVStore::Result kv_result(false);
+        if (op_str == "subscribe") {
+            kv_result = kv.subscribe(client_id, channels_str);
+        } else if (op_str == "unsubscribe") {
+            kv_result = kv.unsubscribe(client_id, channels_str);
+        } else if (op_str == "psubscribe") {
+            kv_result = kv.psubscribe(client_id, channels_str);
+        } else if (op_str == "punsubscribe") {
+            kv_result = kv.punsubscribe(client_id, channels_str);
+        }
+
+        if (kv_result.success) {
+            *count = std::stoull(kv_result.value);
+        }
+        return kv_result.success;
+    }
+
+    bool cpp_pubsub_next_message(uint64_t client_id, const char** data, size_t* len, void** handle) {
+        PubSub::Message message;
+        if (!g_rust_wrapper_instance->kv_store_.pubsub().pop_message(client_id, message)) {
+            return false;
         }
+        // Hand out a reference to the shared frame instead of copying it per subscriber
+        auto* ref = new PubSub::Message(std::move(message));
+        *data = (*ref)->data();
+        *len = (*ref)->size();
+        *handle = ref;
+        return true;
+    }
+
+    void cpp_pubsub_release_message(void* handle) {
+        delete static_cast<PubSub::Message*>(handle);
+    }
+
+    bool cpp_pubsub_overflowed(uint64_t client_id) {
+        return g_rust_wrapper_instance->kv_store_.pubsub().overflowed(client_id);
+    }
+
+    void cpp_pubsub_client_closed(uint64_t client_id) {
+        g_rust_wrapper_instance->kv_store_.pubsub().remove_client(client_id);
+    }
+
+    void cpp_pubsub_set_ready_callback(cpp_pubsub_ready_callback cb) {
+        PubSub::Notify notify;
+        if (cb) {
+            notify = [cb](uint64_t client_id) { cb(client_id); };
+        }
+        g_rust_wrapper_instance->kv_store_.pubsub().set_notify(notify);
+    }
+
+    bool cpp_execute_blocking(const char* operation, const char* keys, const char* args, int64_t timeout_ms,
+                              cpp_block_callback cb, void* ctx, uint64_t* block_id) {
+        std::string op_str(operation);
+        std::vector<std::string> key_list;
+        std::istringstream iss(keys ? keys : "");
+        std::string key;
+        while (std::getline(iss, key, ',')) {
+            key_list.push_back(key);
+        }
+        if (key_list.empty() || (timeout_ms < 0 && timeout_ms != KVStore::kNoWait)) {
+            return false;
+        }
+
+        KVStore::BlockCallback done = [cb, ctx](bool found, const std::string& k, const std::string& v) {
+            cb(ctx, found, k.c_str(), v.data(), v.size());
+        };
+
+        KVStore& kv = g_rust_wrapper_instance->kv_store_;
+        {
+            std::lock_guard<std::mutex> lock(g_rust_wrapper_instance->kv_mutex_);
+            if (op_str == "blpop") {
+                *block_id = kv.blpop(key_list, timeout_ms, done);
+            } else if (op_str == "brpop") {
+                *block_id = kv.brpop(key_list, timeout_ms, done);
+            } else if (op_str == "blmove") {
+                std::string where(args ? args : "");
+                size_t comma = where.find(',');
+                if (key_list.size() != 2 || comma == std::string::npos) {
+                    return false;
+                }
+                bool from_left = strcasecmp(where.substr(0, comma).c_str(), "left") == 0;
+                bool to_left = strcasecmp(where.substr(comma + 1).c_str(), "left") == 0;
+                *block_id = kv.blmove(key_list[0], key_list[1], from_left, to_left, timeout_ms, done);
+            } else {
+                return false;
+            }
+        }
+        g_rust_wrapper_instance->notify_timers();
+        return true;
+    }
+
+    void cpp_cancel_blocking(uint64_t block_id) {
+        std::lock_guard<std::mutex> lock(g_rust_wrapper_instance->kv_mutex_);
+        g_rust_wrapper_instance->kv_store_.cancel_block(block_id);
     }
 }
 
@@ -9,12 +9,16 @@
 #include <mutex>
 #include <condition_variable>
 #include "kv_store.h"
+#include "single_flight.h"
+#include "executor.h"
+#include "transaction_ffi.h"
 
 using namespace std;
 
 // C interface for Rust functions
 extern "C" {
-    bool rust_init();
+    // Starts n_threads thread-per-core workers accepting on the server port
+    bool rust_init(size_t n_threads);
     void rust_free_string(char* ptr);
 }
 
@@ -24,6 +28,37 @@ public:
     ~RustWrapper();
     
     KVStore kv_store_;
+    
+    // Serializes access to kv_store_ between request threads and the timer thread
+    std::mutex kv_mutex_;
+    
+    // Identical reads that find kv_mutex_ taken share one execution
+    SingleFlight reads_;
+    
+    // Builds the replies of KEYS over large keyspaces outside the engine lock; the pool size caps the CPU they take at once
+    static const size_t kSlowReadThreads = 2;
+    Executor slow_reads_;
+    
+    // Wakes the timer thread when a new deadline may have been scheduled
+    void notify_timers();
+    
+    // BULKLOAD: parses the file on the loader's threads, then takes the engine
+    // lock only to merge the rows in (see KVStore::bulkload)
+    KVStore::Result bulk_load(const std::string& path, const std::string& args);
+    // DEBUG POPULATE, the same way: keys are generated before the lock is taken
+    KVStore::Result populate(const std::string& count, const std::string& args);
+    // EXPORT holds the engine lock only to fork its writer (see
+    // KeyspaceDump), and IMPORT only to add the keys it parsed without it
+    KVStore::Result keyspace_export(const std::string& dir, const std::string& args);
+    KVStore::Result keyspace_import(const std::string& dir, const std::string& args);
+
+    // The directory clients' BULKLOAD, EXPORT and IMPORT paths are taken
+    // relative to, like Redis' dir; set from --dir before init(). Without one
+    // those commands are refused over the network (--load is not affected)
+    bool set_data_dir(const std::string& dir, std::string& error);
+    // Resolves a client's path under the data directory: it must be relative,
+    // have no ".." and not leave the directory through a symlink
+    bool client_path(const std::string& name, std::string& path, std::string& error) const;
 
     bool init();
     
@@ -33,10 +68,18 @@ private:
     
     // Core storage
     
+    // Drives kv_store_.process_timers() (blocking command timeouts)
+    void timer_loop();
+    std::thread timer_thread_;
+    std::condition_variable timer_cv_;
+    
     // Control flags
     std::atomic<bool> running_;
     std::atomic<bool> initialized_;
     
+    // Canonical --dir, or empty
+    std::string data_dir_;
+    
 };
 
 // Global pointer for Rust to notify C++
@@ -44,8 +87,56 @@ extern RustWrapper* g_rust_wrapper_instance;
 
 // C function for Rust to call when new request is available
 extern "C" {
-    bool cpp_execute_request_sync(const char* operation, const char* key, const char* value, char** result);
-    void cpp_free_string(char* ptr);
+    // How the front end writes a reply: ENGINE_REPLY_ERROR carries "ERROR: ..."
+    // (or "BUSY ..." if the request was shed by admission control) and
+    // ENGINE_REPLY_NIL is a nil such as a GET of a missing key
+    enum EngineReplyType : uint32_t {
+        ENGINE_REPLY_NIL = 0,
+        ENGINE_REPLY_STATUS = 1,
+        ENGINE_REPLY_INTEGER = 2,
+        ENGINE_REPLY_BULK = 3,
+        ENGINE_REPLY_ERROR = 4
+    };
+    struct EngineReply {
+        uint32_t type;
+        char* data;
+        size_t len;
+    };
+    // key and value are binary-safe; waited_us is how long ago the front end
+    // read the request, which counts towards the admission deadline. The reply
+    // is released with cpp_free_reply
+    bool cpp_execute_request_sync(const char* operation, const char* key, size_t key_len, const char* value,
+                                  size_t value_len, int64_t waited_us, EngineReply* reply);
+    void cpp_free_reply(EngineReply* reply);
+
+    // Pub/Sub: operation is subscribe/unsubscribe/psubscribe/punsubscribe, channels are comma-separated
+    bool cpp_pubsub_command(uint64_t client_id, const char* operation, const char* channels, uint64_t* count);
+    // Pops the next encoded message for a subscriber; the buffer stays valid until released
+    bool cpp_pubsub_next_message(uint64_t client_id, const char** data, size_t* len, void** handle);
+    void cpp_pubsub_release_message(void* handle);
+    // True once the subscriber fell more than PubSub::kMaxQueuedBytes behind;
+    // its messages are dropped and the connection should be closed
+    bool cpp_pubsub_overflowed(uint64_t client_id);
+    void cpp_pubsub_client_closed(uint64_t client_id);
+    // cb(client_id) runs when a frame lands in the client's empty queue or the
+    // queue overflows, from the publishing thread under the engine lock, so it
+    // must not call back into C++
+    typedef void (*cpp_pubsub_ready_callback)(uint64_t client_id);
+    void cpp_pubsub_set_ready_callback(cpp_pubsub_ready_callback cb);
+
+    // Blocking list commands (blpop/brpop/blmove). keys are comma-separated; for
+    // blmove keys is "source,destination" and args is "LEFT|RIGHT,LEFT|RIGHT".
+    // The callback fires exactly once, possibly later from another thread (a
+    // pushing client or the timer thread), while the engine lock is held, so it
+    // must not call back into C++. timeout_ms is KVStore::kNoWait to fail at once
+    // rather than wait. *block_id is the wait for cpp_cancel_blocking, 0 if the
+    // callback already ran.
+    typedef void (*cpp_block_callback)(void* ctx, bool found, const char* key, const char* value, size_t value_len);
+    bool cpp_execute_blocking(const char* operation, const char* keys, const char* args, int64_t timeout_ms,
+                              cpp_block_callback cb, void* ctx, uint64_t* block_id);
+    // Ends a wait whose client disconnected; its callback fires with found == false
+    // unless it already fired
+    void cpp_cancel_blocking(uint64_t block_id);
 }
 
 #endif
\ No newline at end of file
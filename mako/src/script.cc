@@ -0,0 +1,424 @@
+#include "script.h"
+#include <algorithm>
+#include <cctype>
+#include <unordered_map>
+
+namespace {
+
+struct Value {
+    enum Type { kNil, kInt, kStr } type = kNil;
+    int64_t i = 0;
+    std::string s;
+
+    static Value nil() { return Value(); }
+    static Value integer(int64_t v) {
+        Value r;
+        r.type = kInt;
+        r.i = v;
+        return r;
+    }
+    static Value string(std::string v) {
+        Value r;
+        r.type = kStr;
+        r.s = std::move(v);
+        return r;
+    }
+};
+
+bool parse_int(const std::string& s, int64_t& out) {
+    if (s.empty() || s.size() > 20) {
+        return false;
+    }
+    size_t pos = 0;
+    bool negative = s[0] == '-';
+    if (negative && s.size() == 1) {
+        return false;
+    }
+    pos = negative ? 1 : 0;
+    uint64_t magnitude = 0;
+    for (; pos < s.size(); pos++) {
+        if (!isdigit(static_cast<unsigned char>(s[pos]))) {
+            return false;
+        }
+        uint64_t next = magnitude * 10 + (s[pos] - '0');
+        if (next / 10 != magnitude) {
+            return false;
+        }
+        magnitude = next;
+    }
+    if (magnitude > (negative ? uint64_t(INT64_MAX) + 1 : uint64_t(INT64_MAX))) {
+        return false;
+    }
+    out = negative ? static_cast<int64_t>(0 - magnitude) : static_cast<int64_t>(magnitude);
+    return true;
+}
+
+bool as_int(const Value& v, int64_t& out) {
+    if (v.type == Value::kInt) {
+        out = v.i;
+        return true;
+    }
+    return v.type == Value::kStr && parse_int(v.s, out);
+}
+
+std::string as_string(const Value& v) {
+    return v.type == Value::kInt ? std::to_string(v.i) : v.s;
+}
+
+bool truthy(const Value& v) {
+    switch (v.type) {
+    case Value::kNil: return false;
+    case Value::kInt: return v.i != 0;
+    default: return !v.s.empty() && v.s != "0";
+    }
+}
+
+// Engine commands a script may not run: scripts themselves, transactions,
+// server administration, and commands that reach keys by pattern, index or
+// label rather than by name, which KEYS cannot declare
+bool callable(const std::string& operation) {
+    static const char* const kDenied[] = {"evalsha", "script.load", "script.exists", "script.flush", "multi", "exec",
+                                          "discard", "watch", "unwatch", "hotkeys", "counters", "counter.shard",
+                                          "counter.unshard", "admission", "chunking", "resultcache", "bulkload",
+                                          "debug.populate", "export", "import", "keys", "idx.create", "idx.drop",
+                                          "idx.query", "ts.mrange"};
+    for (const char* denied : kDenied) {
+        if (operation == denied) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Keys an engine command names in its value rather than its key; they must be
+// declared in KEYS like the key
+std::vector<std::string> value_keys(const std::string& operation, const std::string& value) {
+    std::vector<std::string> names;
+    size_t start = 0;
+    if (operation == "sinter" || operation == "sdiff") {
+        names.push_back(value);   // the second key
+        return names;
+    } else if (operation == "bitop") {
+        start = value.find(',');   // op,src1[,src2...]
+        if (start == std::string::npos) {
+            return names;
+        }
+        start++;
+    } else if (operation != "pfcount" && operation != "pfmerge") {
+        return names;
+    }
+    while (start < value.size()) {
+        size_t comma = std::min(value.find(',', start), value.size());
+        names.push_back(value.substr(start, comma - start));
+        start = comma + 1;
+    }
+    return names;
+}
+
+} // namespace
+
+const size_t Script::kMaxStack;
+const size_t Script::kMaxString;
+
+std::shared_ptr<const Script> Script::compile(const std::string& source, std::string& error) {
+    static const std::unordered_map<std::string, Op> kWords = {
+        {"+", kAdd}, {"-", kSub}, {"*", kMul}, {"/", kDiv}, {"%", kMod},
+        {"=", kEq}, {"<>", kNe}, {"<", kLt}, {">", kGt}, {"<=", kLe}, {">=", kGe},
+        {"not", kNot}, {"and", kAnd}, {"or", kOr}, {"isnil", kIsNil}, {"nil", kPushNil},
+        {"dup", kDup}, {"drop", kDrop}, {"swap", kSwap}, {"over", kOver}, {"..", kConcat},
+        {"call1", kCall1}, {"call2", kCall2}};
+
+    std::shared_ptr<Script> script(new Script());
+    std::vector<size_t> open_ifs;   // kJumpIfFalse (then kJump after else) awaiting a target
+    std::vector<bool> has_else;
+    size_t pos = 0;
+    while (pos < source.size()) {
+        unsigned char c = source[pos];
+        if (isspace(c)) {
+            pos++;
+            continue;
+        }
+        bool comment = source.compare(pos, 2, "--") == 0 &&
+                       (pos + 2 == source.size() || isspace(static_cast<unsigned char>(source[pos + 2])));
+        if (comment) {
+            pos = source.find('\n', pos);
+            if (pos == std::string::npos) {
+                break;
+            }
+            continue;
+        }
+        if (c == '\'' || c == '"') {
+            std::string literal;
+            size_t end = pos + 1;
+            for (; end < source.size() && source[end] != static_cast<char>(c); end++) {
+                if (source[end] == '\\' && end + 1 < source.size()) {
+                    end++;
+                }
+                literal.push_back(source[end]);
+            }
+            if (end >= source.size()) {
+                error = "ERROR: unterminated string literal";
+                return nullptr;
+            }
+            script->code_.push_back({kPushStr, static_cast<int64_t>(script->strings_.size())});
+            script->strings_.push_back(std::move(literal));
+            pos = end + 1;
+            continue;
+        }
+
+        size_t end = pos;
+        while (end < source.size() && !isspace(static_cast<unsigned char>(source[end]))) {
+            end++;
+        }
+        std::string word = source.substr(pos, end - pos);
+        pos = end;
+
+        int64_t number;
+        auto it = kWords.find(word);
+        if (it != kWords.end()) {
+            script->code_.push_back({it->second, 0});
+        } else if (parse_int(word, number)) {
+            script->code_.push_back({kPushInt, number});
+        } else if ((word[0] == 'k' || word[0] == 'a') && word.size() > 1 && word.size() <= 4 && word[1] != '0' &&
+                   std::all_of(word.begin() + 1, word.end(),
+                               [](char d) { return isdigit(static_cast<unsigned char>(d)) != 0; })) {
+            int64_t index = std::stoll(word.substr(1));
+            bool is_key = word[0] == 'k';
+            size_t& used = is_key ? script->keys_used_ : script->args_used_;
+            used = std::max(used, static_cast<size_t>(index));
+            script->code_.push_back({is_key ? kKey : kArg, index - 1});
+        } else if (word == "if") {
+            open_ifs.push_back(script->code_.size());
+            has_else.push_back(false);
+            script->code_.push_back({kJumpIfFalse, 0});
+        } else if (word == "else") {
+            if (open_ifs.empty() || has_else.back()) {
+                error = "ERROR: else without if";
+                return nullptr;
+            }
+            // The if branch jumps over the else branch; a false condition lands after this jump
+            script->code_.push_back({kJump, 0});
+            script->code_[open_ifs.back()].operand = static_cast<int64_t>(script->code_.size());
+            open_ifs.back() = script->code_.size() - 1;
+            has_else.back() = true;
+        } else if (word == "then") {
+            if (open_ifs.empty()) {
+                error = "ERROR: then without if";
+                return nullptr;
+            }
+            script->code_[open_ifs.back()].operand = static_cast<int64_t>(script->code_.size());
+            open_ifs.pop_back();
+            has_else.pop_back();
+        } else {
+            error = "ERROR: unknown word '" + word + "'";
+            return nullptr;
+        }
+    }
+    if (!open_ifs.empty()) {
+        error = "ERROR: if without then";
+        return nullptr;
+    }
+    return script;
+}
+
+bool Script::run(const std::vector<std::string>& keys, const std::vector<std::string>& args, const Call& call,
+                 std::string& result, bool& found, std::string& error) const {
+    std::vector<Value> stack;
+    stack.reserve(16);
+
+    auto fail = [&](const std::string& message) {
+        error = "ERROR: " + message;
+        return false;
+    };
+
+    size_t pc = 0;
+    while (pc < code_.size()) {
+        const Instr& in = code_[pc++];
+
+        // Values each instruction needs on the stack, and whether it grows the stack
+        size_t needs = 0;
+        bool grows = false;
+        switch (in.op) {
+        case kPushInt: case kPushStr: case kPushNil: case kKey: case kArg:
+            grows = true;
+            break;
+        case kDup:
+            needs = 1;
+            grows = true;
+            break;
+        case kOver:
+            needs = 2;
+            grows = true;
+            break;
+        case kNot: case kIsNil: case kDrop: case kJumpIfFalse:
+            needs = 1;
+            break;
+        case kAdd: case kSub: case kMul: case kDiv: case kMod: case kEq: case kNe: case kLt: case kGt: case kLe:
+        case kGe: case kAnd: case kOr: case kSwap: case kConcat: case kCall1:
+            needs = 2;
+            break;
+        case kCall2:
+            needs = 3;
+            break;
+        default:
+            break;
+        }
+        if (stack.size() < needs) {
+            return fail("stack underflow");
+        }
+        if (grows && stack.size() >= kMaxStack) {
+            return fail("stack overflow");
+        }
+
+        switch (in.op) {
+        case kPushInt:
+            stack.push_back(Value::integer(in.operand));
+            break;
+        case kPushStr:
+            stack.push_back(Value::string(strings_[in.operand]));
+            break;
+        case kPushNil:
+            stack.push_back(Value::nil());
+            break;
+        case kKey:
+        case kArg: {
+            const std::vector<std::string>& from = in.op == kKey ? keys : args;
+            if (static_cast<size_t>(in.operand) >= from.size()) {
+                return fail(std::string(in.op == kKey ? "KEYS" : "ARGV") + "[" + std::to_string(in.operand + 1) +
+                            "] not given");
+            }
+            stack.push_back(Value::string(from[in.operand]));
+            break;
+        }
+        case kAdd: case kSub: case kMul: case kDiv: case kMod:
+        case kLt: case kGt: case kLe: case kGe: {
+            int64_t a, b, r = 0;
+            if (!as_int(stack[stack.size() - 2], a) || !as_int(stack.back(), b)) {
+                return fail("value is not an integer");
+            }
+            stack.pop_back();
+            bool overflow = false;
+            switch (in.op) {
+            case kAdd: overflow = __builtin_add_overflow(a, b, &r); break;
+            case kSub: overflow = __builtin_sub_overflow(a, b, &r); break;
+            case kMul: overflow = __builtin_mul_overflow(a, b, &r); break;
+            case kDiv:
+            case kMod:
+                if (b == 0) {
+                    return fail("division by zero");
+                }
+                if (a == INT64_MIN && b == -1) {
+                    overflow = true;
+                    break;
+                }
+                r = in.op == kDiv ? a / b : a % b;
+                break;
+            case kLt: r = a < b; break;
+            case kGt: r = a > b; break;
+            case kLe: r = a <= b; break;
+            default: r = a >= b; break;
+            }
+            if (overflow) {
+                return fail("integer overflow");
+            }
+            stack.back() = Value::integer(r);
+            break;
+        }
+        case kEq:
+        case kNe: {
+            const Value& a = stack[stack.size() - 2];
+            const Value& b = stack.back();
+            int64_t x, y;
+            bool equal;
+            if (a.type == Value::kNil || b.type == Value::kNil) {
+                equal = a.type == b.type;
+            } else if (as_int(a, x) && as_int(b, y)) {
+                equal = x == y;
+            } else {
+                equal = as_string(a) == as_string(b);
+            }
+            stack.pop_back();
+            stack.back() = Value::integer((in.op == kEq) == equal);
+            break;
+        }
+        case kNot:
+            stack.back() = Value::integer(!truthy(stack.back()));
+            break;
+        case kAnd:
+        case kOr: {
+            // a b and -> a if a is false, else b; a b or -> a if a is true, else b
+            bool keep_first = truthy(stack[stack.size() - 2]) == (in.op == kOr);
+            if (!keep_first) {
+                stack[stack.size() - 2] = std::move(stack.back());
+            }
+            stack.pop_back();
+            break;
+        }
+        case kIsNil:
+            stack.back() = Value::integer(stack.back().type == Value::kNil);
+            break;
+        case kDup:
+            stack.push_back(stack.back());
+            break;
+        case kDrop:
+            stack.pop_back();
+            break;
+        case kSwap:
+            std::swap(stack[stack.size() - 2], stack.back());
+            break;
+        case kOver:
+            stack.push_back(stack[stack.size() - 2]);
+            break;
+        case kConcat: {
+            std::string joined = as_string(stack[stack.size() - 2]) + as_string(stack.back());
+            if (joined.size() > kMaxString) {
+                return fail("string too long");
+            }
+            stack.pop_back();
+            stack.back() = Value::string(std::move(joined));
+            break;
+        }
+        case kCall1:
+        case kCall2: {
+            std::string operation = as_string(stack.back());
+            std::transform(operation.begin(), operation.end(), operation.begin(), ::tolower);
+            stack.pop_back();
+            std::string value;
+            if (in.op == kCall2) {
+                value = as_string(stack.back());
+                stack.pop_back();
+            }
+            std::string key = as_string(stack.back());
+            stack.pop_back();
+            if (!callable(operation)) {
+                return fail("'" + operation + "' may not be called from a script");
+            }
+            std::vector<std::string> named = value_keys(operation, value);
+            named.push_back(key);
+            for (const auto& name : named) {
+                if (std::find(keys.begin(), keys.end(), name) == keys.end()) {
+                    return fail("key '" + name + "' was not declared in KEYS");
+                }
+            }
+            std::string reply;
+            stack.push_back(call(operation, key, value, reply) ? Value::string(std::move(reply)) : Value::nil());
+            break;
+        }
+        case kJumpIfFalse: {
+            bool condition = truthy(stack.back());
+            stack.pop_back();
+            if (!condition) {
+                pc = static_cast<size_t>(in.operand);
+            }
+            break;
+        }
+        case kJump:
+            pc = static_cast<size_t>(in.operand);
+            break;
+        }
+    }
+
+    found = !stack.empty() && stack.back().type != Value::kNil;
+    result = found ? as_string(stack.back()) : std::string();
+    return true;
+}
@@ -0,0 +1,86 @@
+#ifndef _SCRIPT_H_
+#define _SCRIPT_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Server-side scripts: a small postfix (stack) language compiled to bytecode.
+//
+// A script is a sequence of whitespace separated words run left to right on a
+// value stack; whatever is on top at the end is the reply. Values are nil,
+// 64-bit integers or strings, and strings that hold an integer take part in
+// arithmetic and comparisons as numbers.
+//
+//   123 'text' "text"      push a literal
+//   k1 k2 ... a1 a2 ...    push KEYS[i] / ARGV[i]
+//   nil                    push nil
+//   + - * / %              integer arithmetic (errors on overflow, / or % by 0)
+//   = <> < > <= >=         comparisons; = and <> compare strings unless both are integers
+//   not and or             and/or return one of their operands, like Lua
+//   isnil                  1 if the top value is nil, else 0
+//   dup drop swap over     stack shuffling
+//   ..                     string concatenation
+//   call1 call2            key op call1 / key value op call2: run an engine
+//                          command, pushing its reply or nil when it fails
+//   if ... [else ...] then pop a condition (nil, 0 and '' are false)
+//   -- comment             to the end of the line
+//
+// There are no loops and no backward jumps, so a script runs at most one step
+// per word. Engine calls may only name keys passed in KEYS, including the
+// keys SINTER, SDIFF, BITOP, PFCOUNT and PFMERGE take in their value, so a
+// script touches nothing it did not declare. Together with the stack and string size
+// limits that keeps a script from running away with the engine lock.
+//
+// A fixed-window rate limiter (KEYS[1] counter, ARGV[1] limit, ARGV[2] window):
+//   k1 'incr' call1
+//   dup 1 = if k1 a2 'expire' call2 drop then
+//   a1 > if 0 else 1 then
+class Script {
+public:
+    static const size_t kMaxStack = 256;
+    static const size_t kMaxString = 1 << 20;
+
+    // Runs one engine command; false if it failed
+    typedef std::function<bool(const std::string& operation, const std::string& key, const std::string& value,
+                               std::string& reply)>
+        Call;
+
+    // Null with error set if the source does not compile
+    static std::shared_ptr<const Script> compile(const std::string& source, std::string& error);
+
+    // Highest KEYS / ARGV index the script uses
+    size_t keys_used() const { return keys_used_; }
+    size_t args_used() const { return args_used_; }
+
+    // False with error set if the script failed; a nil result leaves found false
+    bool run(const std::vector<std::string>& keys, const std::vector<std::string>& args, const Call& call,
+             std::string& result, bool& found, std::string& error) const;
+
+private:
+    enum Op : uint8_t {
+        kPushInt, kPushStr, kPushNil, kKey, kArg,
+        kAdd, kSub, kMul, kDiv, kMod,
+        kEq, kNe, kLt, kGt, kLe, kGe,
+        kNot, kAnd, kOr, kIsNil,
+        kDup, kDrop, kSwap, kOver, kConcat,
+        kCall1, kCall2,
+        kJumpIfFalse, kJump
+    };
+    struct Instr {
+        Op op;
+        int64_t operand;   // literal, KEYS/ARGV index, string pool index or jump target
+    };
+
+    Script() : keys_used_(0), args_used_(0) {}
+
+    std::vector<Instr> code_;
+    std::vector<std::string> strings_;
+    size_t keys_used_;
+    size_t args_used_;
+};
+
+#endif
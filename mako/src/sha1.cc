@@ -0,0 +1,83 @@
+#include "sha1.h"
+#include <cstdint>
+#include <cstring>
+
+namespace {
+
+inline uint32_t rotl(uint32_t x, int n) {
+    return (x << n) | (x >> (32 - n));
+}
+
+void compress(uint32_t h[5], const uint8_t block[64]) {
+    uint32_t w[80];
+    for (int i = 0; i < 16; i++) {
+        w[i] = uint32_t(block[i * 4]) << 24 | uint32_t(block[i * 4 + 1]) << 16 | uint32_t(block[i * 4 + 2]) << 8 |
+               uint32_t(block[i * 4 + 3]);
+    }
+    for (int i = 16; i < 80; i++) {
+        w[i] = rotl(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+    }
+    uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+    for (int i = 0; i < 80; i++) {
+        uint32_t f, k;
+        if (i < 20) {
+            f = (b & c) | (~b & d);
+            k = 0x5a827999;
+        } else if (i < 40) {
+            f = b ^ c ^ d;
+            k = 0x6ed9eba1;
+        } else if (i < 60) {
+            f = (b & c) | (b & d) | (c & d);
+            k = 0x8f1bbcdc;
+        } else {
+            f = b ^ c ^ d;
+            k = 0xca62c1d6;
+        }
+        uint32_t t = rotl(a, 5) + f + e + k + w[i];
+        e = d;
+        d = c;
+        c = rotl(b, 30);
+        b = a;
+        a = t;
+    }
+    h[0] += a;
+    h[1] += b;
+    h[2] += c;
+    h[3] += d;
+    h[4] += e;
+}
+
+} // namespace
+
+std::string sha1_hex(const void* data, size_t len) {
+    uint32_t h[5] = {0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476, 0xc3d2e1f0};
+    const uint8_t* p = static_cast<const uint8_t*>(data);
+    size_t full = len - len % 64;
+    for (size_t i = 0; i < full; i += 64) {
+        compress(h, p + i);
+    }
+
+    // Pad with 0x80, zeros and the bit length as a big-endian 64-bit integer
+    uint8_t tail[128] = {0};
+    size_t rest = len - full;
+    std::memcpy(tail, p + full, rest);
+    tail[rest] = 0x80;
+    size_t tail_len = rest < 56 ? 64 : 128;
+    uint64_t bits = uint64_t(len) * 8;
+    for (int i = 0; i < 8; i++) {
+        tail[tail_len - 1 - i] = uint8_t(bits >> (8 * i));
+    }
+    compress(h, tail);
+    if (tail_len == 128) {
+        compress(h, tail + 64);
+    }
+
+    static const char kHex[] = "0123456789abcdef";
+    std::string out(40, '0');
+    for (int i = 0; i < 5; i++) {
+        for (int j = 0; j < 8; j++) {
+            out[i * 8 + j] = kHex[(h[i] >> (28 - 4 * j)) & 0xf];
+        }
+    }
+    return out;
+}
@@ -0,0 +1,15 @@
+#ifndef _SHA1_H_
+#define _SHA1_H_
+
+#include <cstddef>
+#include <string>
+
+// SHA-1 of a byte string as 40 lowercase hex digits (FIPS 180-4). Used to
+// name cached scripts the way Redis' SCRIPT LOAD / EVALSHA do.
+std::string sha1_hex(const void* data, size_t len);
+
+inline std::string sha1_hex(const std::string& s) {
+    return sha1_hex(s.data(), s.size());
+}
+
+#endif
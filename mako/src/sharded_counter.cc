@@ -0,0 +1,154 @@
+#include "sharded_counter.h"
+#include <algorithm>
+
+namespace {
+
+std::atomic<uint32_t> g_next_slot{0};
+
+// Threads take slots round-robin; with more threads than slots some share one
+uint32_t thread_slot() {
+    thread_local uint32_t slot = g_next_slot.fetch_add(1, std::memory_order_relaxed);
+    return slot;
+}
+
+size_t slot_count() {
+    size_t cores = std::thread::hardware_concurrency();
+    return std::min(std::max<size_t>(cores, 1), ShardedCounters::kMaxSlots);
+}
+
+} // namespace
+
+const size_t ShardedCounters::kMaxSlots;
+
+ShardedCounters::ShardedCounters(int64_t min, int64_t max)
+    : min_(min), max_(max), slots_(slot_count()), generation_(0), count_(0) {}
+
+ShardedCounters::~ShardedCounters() {}
+
+ShardedCounters::Local* ShardedCounters::local() {
+    return locals_.get(mutex_);
+}
+
+ShardedCounters::Counter* ShardedCounters::find(const std::string& key) {
+    Local* l = local();
+    uint64_t generation = generation_.load(std::memory_order_acquire);
+    if (l->generation != generation) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        l->generation = generation_.load(std::memory_order_acquire);
+        l->counters = counters_;
+    }
+    auto it = l->counters.find(key);
+    return it == l->counters.end() ? nullptr : it->second.get();
+}
+
+bool ShardedCounters::sum(const Counter& c, int64_t& total) const {
+    // Slots may drift far apart in opposite directions; wrapping arithmetic
+    // still gives the exact total as long as the total itself fits
+    uint64_t acc = static_cast<uint64_t>(c.base);
+    for (size_t i = 0; i < slots_; i++) {
+        acc += static_cast<uint64_t>(c.slots[i].value.load(std::memory_order_relaxed));
+    }
+    total = static_cast<int64_t>(acc);
+    return total >= min_ && total <= max_;
+}
+
+void ShardedCounters::retire(Counter& c) const {
+    // Pairs with add(): either the add sees retired, or we see it busy and wait
+    c.retired.store(true, std::memory_order_seq_cst);
+    for (size_t i = 0; i < slots_; i++) {
+        while (c.slots[i].busy.load(std::memory_order_seq_cst) != 0) {
+            std::this_thread::yield();
+        }
+    }
+}
+
+bool ShardedCounters::add(const std::string& key, int64_t delta, int64_t& total) {
+    Counter* c = find(key);
+    if (!c) {
+        return false;
+    }
+    Slot& s = c->slots[thread_slot() % slots_];
+    s.busy.fetch_add(1, std::memory_order_seq_cst);
+    if (c->retired.load(std::memory_order_seq_cst)) {
+        s.busy.fetch_sub(1, std::memory_order_release);
+        return false;
+    }
+    s.value.fetch_add(delta, std::memory_order_relaxed);
+    bool ok = sum(*c, total);
+    if (!ok) {
+        s.value.fetch_sub(delta, std::memory_order_relaxed);
+    }
+    s.busy.fetch_sub(1, std::memory_order_release);
+    return ok;
+}
+
+bool ShardedCounters::read(const std::string& key, int64_t& total) {
+    Counter* c = find(key);
+    if (!c || c->retired.load(std::memory_order_acquire)) {
+        return false;
+    }
+    sum(*c, total);
+    return true;
+}
+
+bool ShardedCounters::contains(const std::string& key) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return counters_.count(key) != 0;
+}
+
+bool ShardedCounters::value(const std::string& key, int64_t& total) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = counters_.find(key);
+    if (it == counters_.end()) {
+        return false;
+    }
+    sum(*it->second, total);
+    return true;
+}
+
+void ShardedCounters::shard(const std::string& key, int64_t base) {
+    auto c = std::make_shared<Counter>();
+    c->base = base;
+    c->slots.reset(new Slot[slots_]);
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (counters_.emplace(key, std::move(c)).second) {
+        count_.fetch_add(1, std::memory_order_acq_rel);
+        generation_.fetch_add(1, std::memory_order_acq_rel);
+    }
+}
+
+bool ShardedCounters::unshard(const std::string& key, int64_t& total) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = counters_.find(key);
+    if (it == counters_.end()) {
+        return false;
+    }
+    retire(*it->second);
+    sum(*it->second, total);
+    counters_.erase(it);
+    count_.fetch_sub(1, std::memory_order_acq_rel);
+    generation_.fetch_add(1, std::memory_order_acq_rel);
+    return true;
+}
+
+void ShardedCounters::keys(std::vector<std::string>& out) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    out.clear();
+    for (const auto& c : counters_) {
+        out.push_back(c.first);
+    }
+    std::sort(out.begin(), out.end());
+}
+
+void ShardedCounters::clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (counters_.empty()) {
+        return;
+    }
+    for (auto& c : counters_) {
+        retire(*c.second);
+    }
+    counters_.clear();
+    count_.store(0, std::memory_order_release);
+    generation_.fetch_add(1, std::memory_order_acq_rel);
+}
@@ -0,0 +1,81 @@
+#ifndef _SHARDED_COUNTER_H_
+#define _SHARDED_COUNTER_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "per_thread.h"
+
+// Integer keys whose value is split over per-core slots.
+//
+// A sharded counter is a base value plus one cache-line-padded slot per core.
+// Each worker thread is assigned a slot; INCRBY adds to that slot only and
+// the value is the base plus the sum of the slots, so concurrent increments
+// from different workers never write the same cache line and never take the
+// engine lock. Workers find counters through their own snapshot of the
+// registry, refreshed when its generation moves.
+//
+// Turning a counter back into a plain value (unshard) marks it retired and
+// waits for increments in flight on its slots, so an increment either lands
+// in the folded total or sees the retirement and goes through the engine.
+class ShardedCounters {
+public:
+    static const size_t kMaxSlots = 64;
+
+    // Totals must stay within [min, max]; an add that would leave the range fails
+    ShardedCounters(int64_t min, int64_t max);
+    ~ShardedCounters();
+
+    // Lock-free path. False if the key is not sharded (or was just unsharded)
+    // or the total would leave the range; the caller then uses the engine.
+    bool add(const std::string& key, int64_t delta, int64_t& total);
+    bool read(const std::string& key, int64_t& total);
+    bool empty() const { return count_.load(std::memory_order_acquire) == 0; }
+
+    // Called with the engine lock held
+    bool contains(const std::string& key) const;
+    bool value(const std::string& key, int64_t& total) const;
+    void shard(const std::string& key, int64_t base);
+    bool unshard(const std::string& key, int64_t& total);
+    void keys(std::vector<std::string>& out) const;
+    void clear();
+
+    size_t slots() const { return slots_; }
+
+private:
+    struct alignas(64) Slot {
+        std::atomic<int64_t> value{0};
+        std::atomic<int32_t> busy{0};   // adds in flight; unshard waits for zero
+    };
+    struct Counter {
+        int64_t base = 0;
+        std::atomic<bool> retired{false};
+        std::unique_ptr<Slot[]> slots;
+    };
+    struct Local {
+        uint64_t generation = 0;
+        std::unordered_map<std::string, std::shared_ptr<Counter>> counters;
+    };
+
+    Local* local();
+    Counter* find(const std::string& key);
+    bool sum(const Counter& c, int64_t& total) const;
+    void retire(Counter& c) const;
+
+    const int64_t min_;
+    const int64_t max_;
+    const size_t slots_;
+    std::atomic<uint64_t> generation_;
+    std::atomic<size_t> count_;
+    mutable std::mutex mutex_;   // guards counters_ and locals_
+    std::unordered_map<std::string, std::shared_ptr<Counter>> counters_;
+    PerThread<Local> locals_;
+};
+
+#endif
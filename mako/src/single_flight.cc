@@ -0,0 +1,89 @@
+#include "single_flight.h"
+#include "hash.h"
+
+SingleFlight::SingleFlight() : stripes_(new Stripe[kStripes]) {}
+
+SingleFlight::~SingleFlight() {}
+
+SingleFlight::ReplyPtr SingleFlight::execute_counted(Stripe& s, const std::function<Reply()>& execute) {
+    ReplyPtr reply = std::make_shared<const Reply>(execute());
+    std::lock_guard<std::mutex> lock(s.mutex);
+    s.executed++;
+    return reply;
+}
+
+SingleFlight::ReplyPtr SingleFlight::run(const std::string& operation, const std::string& key,
+                                         const std::string& args, uint64_t version,
+                                         const std::function<Reply()>& execute) {
+    Stripe& s = stripes_[murmur64a(key.data(), key.size(), 0x51f1) & (kStripes - 1)];
+    std::string id;
+    id.reserve(operation.size() + key.size() + args.size() + 2);
+    id.append(operation).push_back('\0');
+    id.append(key).push_back('\0');
+    id.append(args);
+
+    std::unique_lock<std::mutex> lock(s.mutex);
+    auto it = s.flights.find(id);
+    if (it != s.flights.end()) {
+        std::shared_ptr<Flight> flight = it->second;
+        s.done.wait(lock, [&]() { return flight->done; });
+        if (flight->reply && flight->reply->version >= version) {
+            s.coalesced++;
+            return flight->reply;
+        }
+        // The shared run read the key before a write this caller already saw
+        lock.unlock();
+        return execute_counted(s, execute);
+    }
+
+    auto flight = std::make_shared<Flight>();
+    s.flights.emplace(id, flight);
+    lock.unlock();
+
+    ReplyPtr reply;
+    try {
+        reply = std::make_shared<const Reply>(execute());
+    } catch (...) {
+        lock.lock();
+        flight->done = true;
+        s.flights.erase(id);
+        lock.unlock();
+        s.done.notify_all();
+        throw;
+    }
+
+    lock.lock();
+    s.executed++;
+    flight->reply = reply;
+    flight->done = true;
+    s.flights.erase(id);
+    lock.unlock();
+    s.done.notify_all();
+    return reply;
+}
+
+uint64_t SingleFlight::executed() const {
+    uint64_t total = 0;
+    for (size_t i = 0; i < kStripes; i++) {
+        std::lock_guard<std::mutex> lock(stripes_[i].mutex);
+        total += stripes_[i].executed;
+    }
+    return total;
+}
+
+uint64_t SingleFlight::coalesced() const {
+    uint64_t total = 0;
+    for (size_t i = 0; i < kStripes; i++) {
+        std::lock_guard<std::mutex> lock(stripes_[i].mutex);
+        total += stripes_[i].coalesced;
+    }
+    return total;
+}
+
+void SingleFlight::reset_stats() {
+    for (size_t i = 0; i < kStripes; i++) {
+        std::lock_guard<std::mutex> lock(stripes_[i].mutex);
+        stripes_[i].executed = 0;
+        stripes_[i].coalesced = 0;
+    }
+}
@@ -0,0 +1,61 @@
+#ifndef _SINGLE_FLIGHT_H_
+#define _SINGLE_FLIGHT_H_
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+// Coalesces identical read requests that are waiting on the engine at once.
+//
+// The first caller for an (operation, key, args) triple runs the request; any
+// identical caller that arrives before it finishes waits for that run and
+// shares its reply instead of queueing for the engine lock itself. Replies
+// carry the key's write version as seen by the run, and a waiter only takes a
+// reply produced at or after the version it saw on arrival, so a read never
+// returns a value older than a write that completed before it was issued.
+class SingleFlight {
+public:
+    static const size_t kStripes = 64;   // power of two
+
+    struct Reply {
+        std::string value;
+        bool success = false;
+        uint64_t version = 0;
+    };
+    typedef std::shared_ptr<const Reply> ReplyPtr;
+
+    SingleFlight();
+    ~SingleFlight();
+
+    // version is the key's write version when the caller arrived
+    ReplyPtr run(const std::string& operation, const std::string& key, const std::string& args, uint64_t version,
+                 const std::function<Reply()>& execute);
+
+    uint64_t executed() const;    // runs of execute()
+    uint64_t coalesced() const;   // callers served by another caller's run
+    void reset_stats();
+
+private:
+    struct Flight {
+        bool done = false;
+        ReplyPtr reply;   // null if the run threw
+    };
+    struct alignas(64) Stripe {
+        std::mutex mutex;
+        std::condition_variable done;
+        std::unordered_map<std::string, std::shared_ptr<Flight>> flights;
+        uint64_t executed = 0;
+        uint64_t coalesced = 0;
+    };
+
+    ReplyPtr execute_counted(Stripe& s, const std::function<Reply()>& execute);
+
+    std::unique_ptr<Stripe[]> stripes_;
+};
+
+#endif
@@ -0,0 +1,329 @@
+#include "stream.h"
+#include <cerrno>
+#include <cstdlib>
+#include <iterator>
+
+namespace {
+
+// LEB128 varints keep small ID deltas and lengths to a byte or two
+void put_varint(std::string& buf, uint64_t v) {
+    while (v >= 0x80) {
+        buf.push_back(static_cast<char>((v & 0x7f) | 0x80));
+        v >>= 7;
+    }
+    buf.push_back(static_cast<char>(v));
+}
+
+uint64_t get_varint(const std::string& buf, size_t& pos) {
+    uint64_t v = 0;
+    int shift = 0;
+    while (true) {
+        uint8_t b = static_cast<uint8_t>(buf[pos++]);
+        v |= static_cast<uint64_t>(b & 0x7f) << shift;
+        if (!(b & 0x80)) {
+            return v;
+        }
+        shift += 7;
+    }
+}
+
+void put_string(std::string& buf, const std::string& s) {
+    put_varint(buf, s.size());
+    buf.append(s);
+}
+
+std::string get_string(const std::string& buf, size_t& pos) {
+    size_t len = get_varint(buf, pos);
+    std::string s = buf.substr(pos, len);
+    pos += len;
+    return s;
+}
+
+bool parse_u64(const std::string& s, uint64_t& out) {
+    if (s.empty() || s[0] < '0' || s[0] > '9') {
+        return false;
+    }
+    char* end = nullptr;
+    errno = 0;
+    unsigned long long v = std::strtoull(s.c_str(), &end, 10);
+    if (errno != 0 || *end != '\0') {
+        return false;
+    }
+    out = v;
+    return true;
+}
+
+const uint64_t kSameFields = 1;
+
+} // namespace
+
+bool StreamID::next(StreamID& out) const {
+    if (seq != UINT64_MAX) {
+        out = StreamID(ms, seq + 1);
+        return true;
+    }
+    if (ms != UINT64_MAX) {
+        out = StreamID(ms + 1, 0);
+        return true;
+    }
+    return false;
+}
+
+std::string StreamID::to_string() const {
+    return std::to_string(ms) + "-" + std::to_string(seq);
+}
+
+bool StreamID::parse(const std::string& s, uint64_t missing_seq, StreamID& out) {
+    if (s == "-") {
+        out = min();
+        return true;
+    }
+    if (s == "+") {
+        out = max();
+        return true;
+    }
+    size_t dash = s.find('-');
+    if (dash == std::string::npos) {
+        out.seq = missing_seq;
+        return parse_u64(s, out.ms);
+    }
+    return parse_u64(s.substr(0, dash), out.ms) && parse_u64(s.substr(dash + 1), out.seq);
+}
+
+void Stream::encode_entry(Node& node, const StreamID& id, const std::vector<Field>& fields) {
+    uint64_t ms_delta = id.ms - node.master.ms;
+    put_varint(node.data, ms_delta);
+    put_varint(node.data, ms_delta == 0 ? id.seq - node.master.seq : id.seq);
+
+    bool same = fields.size() == node.master_fields.size();
+    for (size_t i = 0; same && i < fields.size(); i++) {
+        same = fields[i].first == node.master_fields[i];
+    }
+    put_varint(node.data, same ? kSameFields : 0);
+    if (!same) {
+        put_varint(node.data, fields.size());
+    }
+    for (const auto& f : fields) {
+        if (!same) {
+            put_string(node.data, f.first);
+        }
+        put_string(node.data, f.second);
+    }
+    node.count++;
+}
+
+StreamID Stream::decode_id(const Node& node, size_t& pos) {
+    uint64_t ms_delta = get_varint(node.data, pos);
+    uint64_t seq = get_varint(node.data, pos);
+    if (ms_delta == 0) {
+        return StreamID(node.master.ms, node.master.seq + seq);
+    }
+    return StreamID(node.master.ms + ms_delta, seq);
+}
+
+void Stream::decode_entry(const Node& node, size_t& pos, Entry& out) {
+    out.id = decode_id(node, pos);
+    bool same = get_varint(node.data, pos) & kSameFields;
+    size_t n = same ? node.master_fields.size() : get_varint(node.data, pos);
+    out.fields.clear();
+    out.fields.reserve(n);
+    for (size_t i = 0; i < n; i++) {
+        std::string name = same ? node.master_fields[i] : get_string(node.data, pos);
+        out.fields.emplace_back(std::move(name), get_string(node.data, pos));
+    }
+}
+
+void Stream::skip_entry(const Node& node, size_t& pos) {
+    // Called after decode_id; skips the field/value payload without copying
+    bool same = get_varint(node.data, pos) & kSameFields;
+    size_t n = same ? node.master_fields.size() : get_varint(node.data, pos);
+    for (size_t i = 0; i < n; i++) {
+        if (!same) {
+            pos += get_varint(node.data, pos);
+        }
+        pos += get_varint(node.data, pos);
+    }
+}
+
+bool Stream::next_auto_id(uint64_t now_ms, StreamID& out) const {
+    if (now_ms > last_id_.ms) {
+        out = StreamID(now_ms, 0);
+        return true;
+    }
+    return last_id_.next(out);
+}
+
+bool Stream::add(const StreamID& id, const std::vector<Field>& fields) {
+    if (!(last_id_ < id)) {
+        return false;
+    }
+    Node* node = nullptr;
+    if (!nodes_.empty()) {
+        Node& tail = nodes_.rbegin()->second;
+        if (tail.count < kNodeMaxEntries && tail.data.size() < kNodeMaxBytes) {
+            node = &tail;
+        }
+    }
+    if (!node) {
+        node = &nodes_[id];
+        node->master = id;
+        node->count = 0;
+        for (const auto& f : fields) {
+            node->master_fields.push_back(f.first);
+        }
+    }
+    encode_entry(*node, id, fields);
+    length_++;
+    last_id_ = id;
+    return true;
+}
+
+void Stream::range(const StreamID& start, const StreamID& end, size_t count, bool reverse,
+                   std::vector<Entry>& out) const {
+    if (end < start || nodes_.empty()) {
+        return;
+    }
+    Entry entry;
+
+    if (!reverse) {
+        // The first node to scan is the last one whose master ID is <= start
+        auto it = nodes_.upper_bound(start);
+        if (it != nodes_.begin()) {
+            --it;
+        }
+        for (; it != nodes_.end() && it->first <= end; ++it) {
+            const Node& node = it->second;
+            size_t pos = 0;
+            for (size_t i = 0; i < node.count; i++) {
+                size_t entry_pos = pos;
+                StreamID id = decode_id(node, pos);
+                if (end < id) {
+                    return;
+                }
+                if (id < start) {
+                    skip_entry(node, pos);
+                    continue;
+                }
+                pos = entry_pos;
+                decode_entry(node, pos, entry);
+                out.push_back(std::move(entry));
+                if (count && out.size() >= count) {
+                    return;
+                }
+            }
+        }
+        return;
+    }
+
+    // Reverse: entries are variable length, so collect a node's entry offsets
+    // first and then decode them back to front
+    auto it = nodes_.upper_bound(end);
+    std::vector<size_t> offsets;
+    while (it != nodes_.begin()) {
+        --it;
+        const Node& node = it->second;
+        offsets.clear();
+        size_t pos = 0;
+        for (size_t i = 0; i < node.count; i++) {
+            offsets.push_back(pos);
+            decode_id(node, pos);
+            skip_entry(node, pos);
+        }
+        for (auto off = offsets.rbegin(); off != offsets.rend(); ++off) {
+            size_t p = *off;
+            StreamID id = decode_id(node, p);
+            if (end < id) {
+                continue;
+            }
+            if (id < start) {
+                return;
+            }
+            p = *off;
+            decode_entry(node, p, entry);
+            out.push_back(std::move(entry));
+            if (count && out.size() >= count) {
+                return;
+            }
+        }
+    }
+}
+
+size_t Stream::drop_front(size_t n) {
+    auto it = nodes_.begin();
+    Node& old = it->second;
+    if (n >= old.count) {
+        size_t removed = old.count;
+        length_ -= removed;
+        nodes_.erase(it);
+        return removed;
+    }
+
+    // Re-encode the survivors under a new master ID (the first survivor)
+    std::vector<Entry> keep;
+    Entry entry;
+    size_t pos = 0;
+    for (size_t i = 0; i < old.count; i++) {
+        decode_entry(old, pos, entry);
+        if (i >= n) {
+            keep.push_back(std::move(entry));
+        }
+    }
+    nodes_.erase(it);
+
+    Node& node = nodes_[keep[0].id];
+    node.master = keep[0].id;
+    node.count = 0;
+    for (const auto& f : keep[0].fields) {
+        node.master_fields.push_back(f.first);
+    }
+    for (const auto& e : keep) {
+        encode_entry(node, e.id, e.fields);
+    }
+    length_ -= n;
+    return n;
+}
+
+size_t Stream::trim_maxlen(size_t maxlen) {
+    size_t removed = 0;
+    while (length_ > maxlen) {
+        removed += drop_front(length_ - maxlen);
+    }
+    return removed;
+}
+
+size_t Stream::trim_minid(const StreamID& minid) {
+    size_t removed = 0;
+    while (!nodes_.empty()) {
+        auto next = std::next(nodes_.begin());
+        if (next != nodes_.end() && next->first <= minid) {
+            // Every entry of the first node is below the next node's master ID
+            removed += drop_front(nodes_.begin()->second.count);
+            continue;
+        }
+        const Node& node = nodes_.begin()->second;
+        size_t below = 0;
+        size_t pos = 0;
+        for (; below < node.count; below++) {
+            if (!(decode_id(node, pos) < minid)) {
+                break;
+            }
+            skip_entry(node, pos);
+        }
+        if (below) {
+            removed += drop_front(below);
+        }
+        break;
+    }
+    return removed;
+}
+
+size_t Stream::memory_bytes() const {
+    size_t total = 0;
+    for (const auto& pair : nodes_) {
+        total += sizeof(Node) + pair.second.data.capacity();
+        for (const auto& f : pair.second.master_fields) {
+            total += sizeof(std::string) + f.capacity();
+        }
+    }
+    return total;
+}
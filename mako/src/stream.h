@@ -0,0 +1,99 @@
+#ifndef _STREAM_H_
+#define _STREAM_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Stream entry ID: <milliseconds>-<sequence>, ordered lexicographically
+struct StreamID {
+    uint64_t ms;
+    uint64_t seq;
+
+    StreamID() : ms(0), seq(0) {}
+    StreamID(uint64_t m, uint64_t s) : ms(m), seq(s) {}
+
+    bool operator<(const StreamID& o) const { return ms < o.ms || (ms == o.ms && seq < o.seq); }
+    bool operator==(const StreamID& o) const { return ms == o.ms && seq == o.seq; }
+    bool operator<=(const StreamID& o) const { return !(o < *this); }
+
+    static StreamID min() { return StreamID(0, 0); }
+    static StreamID max() { return StreamID(UINT64_MAX, UINT64_MAX); }
+
+    // Smallest ID greater than this one; returns false on overflow
+    bool next(StreamID& out) const;
+
+    std::string to_string() const;
+
+    // Parses "ms-seq", or "ms" alone with the sequence set to missing_seq
+    // (0 for range starts, UINT64_MAX for range ends)
+    static bool parse(const std::string& s, uint64_t missing_seq, StreamID& out);
+};
+
+// Append-only log of (ID, field/value pairs) entries.
+//
+// Entries are packed into nodes of up to kNodeMaxEntries / kNodeMaxBytes
+// as in Redis: each entry stores its ID as a varint delta from the node's
+// master ID, and entries with the same field names as the node's first entry
+// store only their values. Nodes are indexed by master ID in an ordered map,
+// so a range read is one O(log n) seek followed by a sequential scan of
+// contiguous node buffers.
+class Stream {
+public:
+    using Field = std::pair<std::string, std::string>;
+
+    struct Entry {
+        StreamID id;
+        std::vector<Field> fields;
+    };
+
+    static const size_t kNodeMaxEntries = 100;
+    static const size_t kNodeMaxBytes = 4096;
+
+    Stream() : length_(0) {}
+
+    // Appends an entry; id must be greater than last_id()
+    bool add(const StreamID& id, const std::vector<Field>& fields);
+
+    // ID for XADD '*': now_ms, or last_id() + 1 when the clock is behind
+    bool next_auto_id(uint64_t now_ms, StreamID& out) const;
+
+    // Entries with start <= id <= end, at most count (0 = unlimited), in
+    // ascending order or descending when reverse is set
+    void range(const StreamID& start, const StreamID& end, size_t count, bool reverse,
+               std::vector<Entry>& out) const;
+
+    // Drop the oldest entries; both return the number of entries removed
+    size_t trim_maxlen(size_t maxlen);
+    size_t trim_minid(const StreamID& minid);
+
+    size_t length() const { return length_; }
+    size_t nodes() const { return nodes_.size(); }
+    const StreamID& last_id() const { return last_id_; }
+    size_t memory_bytes() const;
+
+private:
+    struct Node {
+        StreamID master;
+        size_t count;
+        std::vector<std::string> master_fields;   // field names of the first entry
+        std::string data;                         // packed entries
+    };
+
+    static void encode_entry(Node& node, const StreamID& id, const std::vector<Field>& fields);
+    // Decodes the entry at pos and advances pos past it
+    static void decode_entry(const Node& node, size_t& pos, Entry& out);
+    static StreamID decode_id(const Node& node, size_t& pos);
+    static void skip_entry(const Node& node, size_t& pos);
+    // Removes the first n entries of the first node (all of it if n >= count)
+    size_t drop_front(size_t n);
+
+    std::map<StreamID, Node> nodes_;   // keyed by master ID
+    size_t length_;
+    StreamID last_id_;
+};
+
+#endif
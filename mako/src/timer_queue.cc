@@ -0,0 +1,47 @@
+#include "timer_queue.h"
+
+TimerQueue::TimerQueue() : next_id_(1) {
+}
+
+TimerQueue::~TimerQueue() {
+}
+
+TimerQueue::TimerId TimerQueue::schedule(TimePoint deadline, Callback cb) {
+    TimerId id = next_id_++;
+    callbacks_.emplace(id, std::move(cb));
+    heap_.push(Entry{deadline, id});
+    return id;
+}
+
+bool TimerQueue::cancel(TimerId id) {
+    return callbacks_.erase(id) > 0;
+}
+
+size_t TimerQueue::run_expired(TimePoint now) {
+    size_t fired = 0;
+    while (!heap_.empty() && heap_.top().deadline <= now) {
+        TimerId id = heap_.top().id;
+        heap_.pop();
+        auto it = callbacks_.find(id);
+        if (it == callbacks_.end()) {
+            continue; // cancelled
+        }
+        // Detach before running: the callback may schedule or cancel timers
+        Callback cb = std::move(it->second);
+        callbacks_.erase(it);
+        cb();
+        fired++;
+    }
+    return fired;
+}
+
+bool TimerQueue::next_deadline(TimePoint& out) {
+    while (!heap_.empty() && callbacks_.find(heap_.top().id) == callbacks_.end()) {
+        heap_.pop();
+    }
+    if (heap_.empty()) {
+        return false;
+    }
+    out = heap_.top().deadline;
+    return true;
+}
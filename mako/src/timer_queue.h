@@ -0,0 +1,46 @@
+#ifndef _TIMER_QUEUE_H_
+#define _TIMER_QUEUE_H_
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <queue>
+#include <unordered_map>
+#include <vector>
+
+// Engine timer subsystem: a min-heap of deadlines. Cancelled timers are
+// dropped from the callback table and their heap entries skipped lazily.
+// Not thread-safe; it is driven by whoever owns the KVStore.
+class TimerQueue {
+public:
+    using TimerId = uint64_t;
+    using TimePoint = std::chrono::steady_clock::time_point;
+    using Callback = std::function<void()>;
+
+    TimerQueue();
+    ~TimerQueue();
+
+    TimerId schedule(TimePoint deadline, Callback cb);
+    bool cancel(TimerId id);
+
+    // Runs every callback whose deadline is <= now, returns how many fired
+    size_t run_expired(TimePoint now);
+
+    // Earliest pending deadline, false if no timer is pending
+    bool next_deadline(TimePoint& out);
+
+    size_t size() const { return callbacks_.size(); }
+
+private:
+    struct Entry {
+        TimePoint deadline;
+        TimerId id;
+        bool operator>(const Entry& other) const { return deadline > other.deadline; }
+    };
+
+    std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> heap_;
+    std::unordered_map<TimerId, Callback> callbacks_;
+    TimerId next_id_;
+};
+
+#endif
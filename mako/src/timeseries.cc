@@ -0,0 +1,457 @@
+#include "timeseries.h"
+#include "cpu_features.h"
+#include <algorithm>
+#include <cctype>
+#include <climits>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define MAKO_X86 1
+#endif
+
+namespace {
+
+uint64_t double_bits(double v) {
+    uint64_t bits;
+    std::memcpy(&bits, &v, sizeof(bits));
+    return bits;
+}
+
+double bits_double(uint64_t bits) {
+    double v;
+    std::memcpy(&v, &bits, sizeof(v));
+    return v;
+}
+
+class BitReader {
+public:
+    explicit BitReader(const std::vector<uint64_t>& words) : words_(words), pos_(0) {}
+
+    uint64_t read(int nbits) {
+        uint64_t v = 0;
+        while (nbits > 0) {
+            int off = static_cast<int>(pos_ & 63);
+            int take = std::min(64 - off, nbits);
+            uint64_t part = (words_[pos_ >> 6] << off) >> (64 - take);
+            v = take == 64 ? part : (v << take) | part;
+            pos_ += take;
+            nbits -= take;
+        }
+        return v;
+    }
+
+    bool read_bit() {
+        bool bit = (words_[pos_ >> 6] >> (63 - (pos_ & 63))) & 1;
+        pos_++;
+        return bit;
+    }
+
+private:
+    const std::vector<uint64_t>& words_;
+    size_t pos_;
+};
+
+// Delta-of-delta buckets from the Gorilla paper: control bits, value bits, offset
+struct DodBucket {
+    uint64_t control;
+    int control_bits;
+    int value_bits;
+    int64_t offset;   // dod + offset is stored, so the bucket covers [-offset, 2^bits - 1 - offset]
+};
+
+const DodBucket kDodBuckets[] = {
+    {0x2, 2, 7, 63},      // '10'   [-63, 64]
+    {0x6, 3, 9, 255},     // '110'  [-255, 256]
+    {0xe, 4, 12, 2047},   // '1110' [-2047, 2048]
+};
+
+double sum_scalar(const double* v, size_t n) {
+    double s = 0.0;
+    for (size_t i = 0; i < n; i++) {
+        s += v[i];
+    }
+    return s;
+}
+
+double min_scalar(const double* v, size_t n) {
+    double m = v[0];
+    for (size_t i = 1; i < n; i++) {
+        m = v[i] < m ? v[i] : m;
+    }
+    return m;
+}
+
+double max_scalar(const double* v, size_t n) {
+    double m = v[0];
+    for (size_t i = 1; i < n; i++) {
+        m = v[i] > m ? v[i] : m;
+    }
+    return m;
+}
+
+#ifdef MAKO_X86
+__attribute__((target("avx2")))
+double hsum_avx2(__m256d v) {
+    __m128d lo = _mm256_castpd256_pd128(v);
+    __m128d hi = _mm256_extractf128_pd(v, 1);
+    lo = _mm_add_pd(lo, hi);
+    return _mm_cvtsd_f64(_mm_add_sd(lo, _mm_unpackhi_pd(lo, lo)));
+}
+
+__attribute__((target("avx2")))
+double sum_avx2(const double* v, size_t n) {
+    // Two accumulators hide the add latency
+    __m256d a0 = _mm256_setzero_pd();
+    __m256d a1 = _mm256_setzero_pd();
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        a0 = _mm256_add_pd(a0, _mm256_loadu_pd(v + i));
+        a1 = _mm256_add_pd(a1, _mm256_loadu_pd(v + i + 4));
+    }
+    double s = hsum_avx2(_mm256_add_pd(a0, a1));
+    for (; i < n; i++) {
+        s += v[i];
+    }
+    return s;
+}
+
+#define MAKO_TS_MINMAX_AVX2(NAME, VOP, CMP)                                        \
+    __attribute__((target("avx2")))                                                \
+    double NAME(const double* v, size_t n) {                                       \
+        if (n < 8) {                                                               \
+            double m = v[0];                                                       \
+            for (size_t i = 1; i < n; i++) m = v[i] CMP m ? v[i] : m;              \
+            return m;                                                              \
+        }                                                                          \
+        __m256d a0 = _mm256_loadu_pd(v);                                           \
+        __m256d a1 = _mm256_loadu_pd(v + 4);                                       \
+        size_t i = 8;                                                              \
+        for (; i + 8 <= n; i += 8) {                                               \
+            a0 = VOP(a0, _mm256_loadu_pd(v + i));                                  \
+            a1 = VOP(a1, _mm256_loadu_pd(v + i + 4));                              \
+        }                                                                          \
+        alignas(32) double lanes[4];                                               \
+        _mm256_store_pd(lanes, VOP(a0, a1));                                       \
+        double m = lanes[0];                                                       \
+        for (int l = 1; l < 4; l++) m = lanes[l] CMP m ? lanes[l] : m;             \
+        for (; i < n; i++) m = v[i] CMP m ? v[i] : m;                              \
+        return m;                                                                  \
+    }
+
+MAKO_TS_MINMAX_AVX2(min_avx2, _mm256_min_pd, <)
+MAKO_TS_MINMAX_AVX2(max_avx2, _mm256_max_pd, >)
+#undef MAKO_TS_MINMAX_AVX2
+#endif
+
+const TimeSeries::Kernels kScalar = {"scalar", sum_scalar, min_scalar, max_scalar};
+#ifdef MAKO_X86
+const TimeSeries::Kernels kAvx2 = {"avx2", sum_avx2, min_avx2, max_avx2};
+#endif
+
+// Running state of the bucket being aggregated
+struct Bucket {
+    int64_t start = 0;
+    size_t count = 0;
+    double sum = 0.0;
+    double min = 0.0;
+    double max = 0.0;
+    double first = 0.0;
+    double last = 0.0;
+};
+
+double bucket_value(const Bucket& b, TimeSeries::Aggregation agg) {
+    switch (agg) {
+        case TimeSeries::Aggregation::Avg: return b.sum / static_cast<double>(b.count);
+        case TimeSeries::Aggregation::Sum: return b.sum;
+        case TimeSeries::Aggregation::Min: return b.min;
+        case TimeSeries::Aggregation::Max: return b.max;
+        case TimeSeries::Aggregation::Count: return static_cast<double>(b.count);
+        case TimeSeries::Aggregation::First: return b.first;
+        case TimeSeries::Aggregation::Last: return b.last;
+        default: return 0.0;
+    }
+}
+
+} // namespace
+
+const TimeSeries::Kernels& TimeSeries::scalar_kernels() {
+    return kScalar;
+}
+
+const TimeSeries::Kernels& TimeSeries::kernels() {
+#ifdef MAKO_X86
+    static const Kernels& best = cpu_has_avx2() ? kAvx2 : kScalar;
+    return best;
+#else
+    return kScalar;
+#endif
+}
+
+bool TimeSeries::parse_aggregation(const std::string& name, Aggregation& out) {
+    std::string lower = name;
+    std::transform(lower.begin(), lower.end(), lower.begin(), ::tolower);
+    if (lower == "avg") out = Aggregation::Avg;
+    else if (lower == "sum") out = Aggregation::Sum;
+    else if (lower == "min") out = Aggregation::Min;
+    else if (lower == "max") out = Aggregation::Max;
+    else if (lower == "count") out = Aggregation::Count;
+    else if (lower == "first") out = Aggregation::First;
+    else if (lower == "last") out = Aggregation::Last;
+    else return false;
+    return true;
+}
+
+void TimeSeries::Chunk::write_bits(uint64_t value, int nbits) {
+    while (nbits > 0) {
+        size_t off = bits & 63;
+        if (off == 0) {
+            words.push_back(0);
+        }
+        int take = std::min(static_cast<int>(64 - off), nbits);
+        // Top `take` of the remaining nbits bits of value
+        uint64_t part = value >> (nbits - take);
+        if (take < 64) {
+            part &= (uint64_t(1) << take) - 1;
+        }
+        words.back() |= part << (64 - off - take);
+        bits += take;
+        nbits -= take;
+    }
+}
+
+void TimeSeries::Chunk::append(int64_t ts, double value) {
+    uint64_t vbits = double_bits(value);
+    if (count == 0) {
+        first_ts = ts;
+        write_bits(static_cast<uint64_t>(ts), 64);
+        write_bits(vbits, 64);
+    } else {
+        int64_t delta = ts - last_ts;
+        int64_t dod = delta - last_delta;
+        if (dod == 0) {
+            write_bits(0, 1);
+        } else {
+            bool written = false;
+            for (const auto& b : kDodBuckets) {
+                int64_t stored = dod + b.offset;
+                if (stored >= 0 && stored < (int64_t(1) << b.value_bits)) {
+                    write_bits(b.control, b.control_bits);
+                    write_bits(static_cast<uint64_t>(stored), b.value_bits);
+                    written = true;
+                    break;
+                }
+            }
+            if (!written) {
+                write_bits(0xf, 4);
+                write_bits(static_cast<uint64_t>(dod), 64);
+            }
+        }
+        last_delta = delta;
+
+        uint64_t x = vbits ^ last_value;
+        if (x == 0) {
+            write_bits(0, 1);
+        } else {
+            int lead = std::min(__builtin_clzll(x), 31);
+            int trail = __builtin_ctzll(x);
+            if (leading >= 0 && lead >= leading && trail >= trailing) {
+                // Meaningful bits fit in the previous window
+                write_bits(0x2, 2);
+                write_bits(x >> trailing, 64 - leading - trailing);
+            } else {
+                int len = 64 - lead - trail;
+                write_bits(0x3, 2);
+                write_bits(static_cast<uint64_t>(lead), 5);
+                write_bits(static_cast<uint64_t>(len - 1), 6);
+                write_bits(x >> trail, len);
+                leading = lead;
+                trailing = trail;
+            }
+        }
+    }
+    last_ts = ts;
+    last_value = vbits;
+    count++;
+}
+
+void TimeSeries::Chunk::decode(int64_t to, std::vector<int64_t>& ts_out, std::vector<double>& values_out) const {
+    if (count == 0) {
+        return;
+    }
+    BitReader r(words);
+    int64_t ts = static_cast<int64_t>(r.read(64));
+    uint64_t vbits = r.read(64);
+    int64_t delta = 0;
+    int lead = 0;
+    int trail = 0;
+    for (size_t i = 0;;) {
+        if (ts > to) {
+            return;
+        }
+        ts_out.push_back(ts);
+        values_out.push_back(bits_double(vbits));
+        if (++i == count) {
+            return;
+        }
+
+        // Timestamp: count leading 1 bits of the control prefix (at most 4)
+        int ones = 0;
+        while (ones < 4 && r.read_bit()) {
+            ones++;
+        }
+        if (ones == 4) {
+            delta += static_cast<int64_t>(r.read(64));
+        } else if (ones > 0) {
+            const DodBucket& b = kDodBuckets[ones - 1];
+            delta += static_cast<int64_t>(r.read(b.value_bits)) - b.offset;
+        }
+        ts += delta;
+
+        // Value
+        if (r.read_bit()) {
+            if (r.read_bit()) {
+                lead = static_cast<int>(r.read(5));
+                int len = static_cast<int>(r.read(6)) + 1;
+                trail = 64 - lead - len;
+            }
+            vbits ^= r.read(64 - lead - trail) << trail;
+        }
+    }
+}
+
+void TimeSeries::rewrite_chunk(std::map<int64_t, Chunk>::iterator it, int64_t ts, double value) {
+    std::vector<int64_t> times;
+    std::vector<double> values;
+    it->second.decode(INT64_MAX, times, values);
+    auto pos = std::lower_bound(times.begin(), times.end(), ts);
+    size_t idx = pos - times.begin();
+    if (pos != times.end() && *pos == ts) {
+        values[idx] = value;   // duplicate: last write wins
+    } else {
+        times.insert(pos, ts);
+        values.insert(values.begin() + idx, value);
+        size_++;
+    }
+    chunks_.erase(it);
+
+    // Re-encode, splitting if the extra sample overflows the chunk
+    Chunk* chunk = nullptr;
+    for (size_t i = 0; i < times.size(); i++) {
+        if (!chunk || chunk->full()) {
+            chunk = &chunks_[times[i]];
+        }
+        chunk->append(times[i], values[i]);
+    }
+}
+
+void TimeSeries::add(int64_t ts, double value) {
+    if (chunks_.empty()) {
+        chunks_[ts].append(ts, value);
+        size_++;
+        return;
+    }
+    auto last = std::prev(chunks_.end());
+    if (ts > last->second.last_ts) {
+        if (last->second.full()) {
+            // Sealed chunks only change on out-of-order writes; drop the growth slack
+            last->second.words.shrink_to_fit();
+            chunks_[ts].append(ts, value);
+        } else {
+            last->second.append(ts, value);
+        }
+        size_++;
+        return;
+    }
+    // Out of order: rewrite the chunk the timestamp falls in
+    auto it = chunks_.upper_bound(ts);
+    if (it != chunks_.begin()) {
+        --it;
+    }
+    rewrite_chunk(it, ts, value);
+}
+
+void TimeSeries::range(int64_t from, int64_t to, Aggregation agg, int64_t bucket_ms,
+                       std::vector<Sample>& out) const {
+    if (to < from || chunks_.empty()) {
+        return;
+    }
+    if (bucket_ms <= 0) {
+        agg = Aggregation::None;
+    }
+    const Kernels& k = kernels();
+    std::vector<int64_t> times;
+    std::vector<double> values;
+    Bucket bucket;
+
+    auto it = chunks_.upper_bound(from);
+    if (it != chunks_.begin()) {
+        --it;
+    }
+    for (; it != chunks_.end() && it->first <= to; ++it) {
+        if (it->second.last_ts < from) {
+            continue;
+        }
+        times.clear();
+        values.clear();
+        it->second.decode(to, times, values);
+        size_t i = std::lower_bound(times.begin(), times.end(), from) - times.begin();
+        size_t n = times.size();
+
+        if (agg == Aggregation::None) {
+            for (; i < n; i++) {
+                out.push_back({times[i], values[i]});
+            }
+            continue;
+        }
+
+        // Fold each run of samples that share a bucket with one kernel call
+        while (i < n) {
+            int64_t start = times[i] - ((times[i] % bucket_ms) + bucket_ms) % bucket_ms;
+            if (bucket.count && start != bucket.start) {
+                out.push_back({bucket.start, bucket_value(bucket, agg)});
+                bucket = Bucket();
+            }
+            int64_t bucket_last = start > INT64_MAX - (bucket_ms - 1) ? INT64_MAX : start + bucket_ms - 1;
+            size_t j = std::upper_bound(times.begin() + i, times.begin() + n, bucket_last) - times.begin();
+            const double* v = values.data() + i;
+            size_t len = j - i;
+            if (!bucket.count) {
+                bucket.start = start;
+                bucket.first = v[0];
+                bucket.min = v[0];
+                bucket.max = v[0];
+            }
+            switch (agg) {
+                case Aggregation::Avg:
+                case Aggregation::Sum: bucket.sum += k.sum(v, len); break;
+                case Aggregation::Min: bucket.min = std::min(bucket.min, k.min(v, len)); break;
+                case Aggregation::Max: bucket.max = std::max(bucket.max, k.max(v, len)); break;
+                default: break;
+            }
+            bucket.last = v[len - 1];
+            bucket.count += len;
+            i = j;
+        }
+    }
+    if (agg != Aggregation::None && bucket.count) {
+        out.push_back({bucket.start, bucket_value(bucket, agg)});
+    }
+}
+
+bool TimeSeries::last(Sample& out) const {
+    if (chunks_.empty()) {
+        return false;
+    }
+    const Chunk& c = chunks_.rbegin()->second;
+    out = {c.last_ts, bits_double(c.last_value)};
+    return true;
+}
+
+size_t TimeSeries::memory_bytes() const {
+    size_t total = 0;
+    for (const auto& pair : chunks_) {
+        total += pair.second.memory_bytes();
+    }
+    return total;
+}
@@ -0,0 +1,91 @@
+#ifndef _TIMESERIES_H_
+#define _TIMESERIES_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+// Time series of (timestamp ms, double) samples in Gorilla-compressed chunks
+// (Pelkonen et al., "Gorilla: A Fast, Scalable, In-Memory Time Series
+// Database"): timestamps are stored as delta-of-deltas in variable-width
+// buckets and values as the XOR with the previous value, so a regular series
+// costs a bit or two per timestamp and a few bits per value.
+//
+// Chunks are indexed by their first timestamp. Appends go to the last chunk;
+// an out-of-order or duplicate timestamp re-encodes the chunk it falls in
+// (the later write wins, like Redis' LAST duplicate policy).
+class TimeSeries {
+public:
+    enum class Aggregation { None, Avg, Sum, Min, Max, Count, First, Last };
+
+    struct Sample {
+        int64_t ts;
+        double value;
+    };
+
+    static const size_t kChunkBytes = 4096;
+
+    TimeSeries() : size_(0) {}
+
+    void add(int64_t ts, double value);
+
+    // Samples with from <= ts <= to. With an aggregation, one sample per
+    // non-empty bucket of bucket_ms (aligned to 0, stamped with the bucket
+    // start), computed while the chunks are decoded.
+    void range(int64_t from, int64_t to, Aggregation agg, int64_t bucket_ms,
+               std::vector<Sample>& out) const;
+
+    size_t size() const { return size_; }
+    size_t chunks() const { return chunks_.size(); }
+    size_t memory_bytes() const;
+    bool last(Sample& out) const;
+
+    // Labels (name=value) matched by TS.MRANGE filters
+    void set_labels(const std::map<std::string, std::string>& labels) { labels_ = labels; }
+    const std::map<std::string, std::string>& labels() const { return labels_; }
+
+    // Parses avg/sum/min/max/count/first/last (case-insensitive)
+    static bool parse_aggregation(const std::string& name, Aggregation& out);
+
+    // Sum/min/max over n doubles, AVX2 when available (exposed for engine_bench)
+    struct Kernels {
+        const char* name;
+        double (*sum)(const double*, size_t);
+        double (*min)(const double*, size_t);
+        double (*max)(const double*, size_t);
+    };
+    static const Kernels& kernels();
+    static const Kernels& scalar_kernels();
+
+private:
+    struct Chunk {
+        std::vector<uint64_t> words;   // bit stream, most significant bit first
+        size_t bits = 0;
+        size_t count = 0;
+        int64_t first_ts = 0;
+        int64_t last_ts = 0;
+        int64_t last_delta = 0;
+        uint64_t last_value = 0;   // bit pattern of the last double
+        int leading = -1;          // XOR window of the previous value, -1 before the first
+        int trailing = 0;
+
+        void append(int64_t ts, double value);
+        bool full() const { return bits / 8 >= kChunkBytes; }
+        // Decodes samples with ts <= to (all of them when to is INT64_MAX)
+        void decode(int64_t to, std::vector<int64_t>& ts, std::vector<double>& values) const;
+        size_t memory_bytes() const { return sizeof(Chunk) + words.capacity() * sizeof(uint64_t); }
+
+    private:
+        void write_bits(uint64_t value, int nbits);
+    };
+
+    void rewrite_chunk(std::map<int64_t, Chunk>::iterator it, int64_t ts, double value);
+
+    std::map<int64_t, Chunk> chunks_;   // keyed by first timestamp
+    size_t size_;
+    std::map<std::string, std::string> labels_;
+};
+
+#endif
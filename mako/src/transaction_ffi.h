@@ -0,0 +1,50 @@
+#ifndef _TRANSACTION_FFI_H_
+#define _TRANSACTION_FFI_H_
+
+#include <cstddef>
+#include <cstdint>
+
+// MULTI/EXEC batches handed over by the Rust front end; the layout must match
+// the #[repr(C)] structs in rust-lib/src/lib.rs
+extern "C" {
+
+const uint32_t TXN_OP_GET = 1;
+const uint32_t TXN_OP_SET = 2;
+
+struct TxnOperation {
+    uint32_t op;
+    const uint8_t* key_ptr;
+    size_t key_len;
+    const uint8_t* val_ptr;
+    size_t val_len;
+};
+
+struct TxnRequest {
+    size_t num_ops;
+    const TxnOperation* ops;
+};
+
+struct TxnOpResult {
+    bool success;
+    uint8_t* data_ptr;   // GET only; null for a missing key
+    size_t data_len;
+};
+
+struct TxnResponse {
+    bool transaction_success;
+    size_t num_results;
+    TxnOpResult* results;
+};
+
+// Called once by each Rust worker thread before it accepts connections
+void cpp_worker_thread_init(size_t thread_id);
+
+// Runs every operation under one hold of the engine lock, so no other
+// client's command lands in between. The results are released with
+// cpp_free_transaction_response.
+bool cpp_execute_transaction(const TxnRequest* request, TxnResponse* response);
+void cpp_free_transaction_response(TxnResponse* response);
+
+}
+
+#endif
@@ -0,0 +1,363 @@
+#include "vector_set.h"
+#include "cpu_features.h"
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstring>
+#include <numeric>
+#include <queue>
+#include <random>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define MAKO_X86 1
+#endif
+
+namespace {
+
+const size_t kRows = VectorSet::kBlockRows;
+
+void l2_scalar(const float* block, const float* query, size_t dim, float* out) {
+    std::fill(out, out + kRows, 0.0f);
+    for (size_t d = 0; d < dim; d++) {
+        const float* col = block + d * kRows;
+        float q = query[d];
+        for (size_t r = 0; r < kRows; r++) {
+            float diff = col[r] - q;
+            out[r] += diff * diff;
+        }
+    }
+}
+
+void dot_scalar(const float* block, const float* query, size_t dim, float* out) {
+    std::fill(out, out + kRows, 0.0f);
+    for (size_t d = 0; d < dim; d++) {
+        const float* col = block + d * kRows;
+        float q = query[d];
+        for (size_t r = 0; r < kRows; r++) {
+            out[r] += col[r] * q;
+        }
+    }
+}
+
+#ifdef MAKO_X86
+// One ymm accumulator per 8 rows: the 64 distances of a block stay in
+// registers for the whole pass over the dimensions
+__attribute__((target("avx2,fma")))
+void l2_avx2(const float* block, const float* query, size_t dim, float* out) {
+    __m256 acc[8];
+    for (int j = 0; j < 8; j++) acc[j] = _mm256_setzero_ps();
+    for (size_t d = 0; d < dim; d++) {
+        const float* col = block + d * kRows;
+        __m256 q = _mm256_set1_ps(query[d]);
+        for (int j = 0; j < 8; j++) {
+            __m256 diff = _mm256_sub_ps(_mm256_loadu_ps(col + j * 8), q);
+            acc[j] = _mm256_fmadd_ps(diff, diff, acc[j]);
+        }
+    }
+    for (int j = 0; j < 8; j++) _mm256_storeu_ps(out + j * 8, acc[j]);
+}
+
+__attribute__((target("avx2,fma")))
+void dot_avx2(const float* block, const float* query, size_t dim, float* out) {
+    __m256 acc[8];
+    for (int j = 0; j < 8; j++) acc[j] = _mm256_setzero_ps();
+    for (size_t d = 0; d < dim; d++) {
+        const float* col = block + d * kRows;
+        __m256 q = _mm256_set1_ps(query[d]);
+        for (int j = 0; j < 8; j++) {
+            acc[j] = _mm256_fmadd_ps(_mm256_loadu_ps(col + j * 8), q, acc[j]);
+        }
+    }
+    for (int j = 0; j < 8; j++) _mm256_storeu_ps(out + j * 8, acc[j]);
+}
+#endif
+
+const VectorSet::Kernels kScalar = {"scalar", l2_scalar, dot_scalar};
+#ifdef MAKO_X86
+const VectorSet::Kernels kAvx2 = {"avx2", l2_avx2, dot_avx2};
+#endif
+
+} // namespace
+
+const VectorSet::Kernels& VectorSet::kernels() {
+#ifdef MAKO_X86
+    static const Kernels& best = cpu_has_avx2() && cpu_has_fma() ? kAvx2 : kScalar;
+    return best;
+#else
+    return kScalar;
+#endif
+}
+
+bool VectorSet::parse_metric(const std::string& name, Metric& out) {
+    std::string upper = name;
+    std::transform(upper.begin(), upper.end(), upper.begin(), ::toupper);
+    if (upper == "L2") out = Metric::L2;
+    else if (upper == "IP") out = Metric::InnerProduct;
+    else if (upper == "COSINE") out = Metric::Cosine;
+    else return false;
+    return true;
+}
+
+void VectorSet::List::push(const float* vec, size_t dim, uint32_t label) {
+    size_t block = count / kRows;
+    size_t lane = count % kRows;
+    if (lane == 0) {
+        data.resize(data.size() + dim * kRows, 0.0f);
+    }
+    float* base = data.data() + block * dim * kRows + lane;
+    for (size_t d = 0; d < dim; d++) {
+        base[d * kRows] = vec[d];
+    }
+    labels.push_back(label);
+    count++;
+}
+
+void VectorSet::List::get(size_t row, size_t dim, float* out) const {
+    const float* base = data.data() + (row / kRows) * dim * kRows + row % kRows;
+    for (size_t d = 0; d < dim; d++) {
+        out[d] = base[d * kRows];
+    }
+}
+
+void VectorSet::List::swap_remove(size_t row, size_t dim) {
+    size_t last = count - 1;
+    if (row != last) {
+        std::vector<float> tmp(dim);
+        get(last, dim, tmp.data());
+        float* base = data.data() + (row / kRows) * dim * kRows + row % kRows;
+        for (size_t d = 0; d < dim; d++) {
+            base[d * kRows] = tmp[d];
+        }
+        labels[row] = labels[last];
+    }
+    // Zero the vacated lane so padded rows never look like real ones
+    float* base = data.data() + (last / kRows) * dim * kRows + last % kRows;
+    for (size_t d = 0; d < dim; d++) {
+        base[d * kRows] = 0.0f;
+    }
+    labels.pop_back();
+    count--;
+    if (count % kRows == 0) {
+        data.resize(count / kRows * dim * kRows);
+    }
+}
+
+VectorSet::VectorSet(size_t dim, Metric metric) : dim_(dim), metric_(metric), lists_(1) {
+}
+
+template <typename Visit>
+void VectorSet::scan(const List& list, const float* query, Visit&& visit) const {
+    const Kernels& k = kernels();
+    float dist[kBlockRows];
+    size_t blocks = (list.count + kRows - 1) / kRows;
+    for (size_t b = 0; b < blocks; b++) {
+        const float* block = list.data.data() + b * dim_ * kRows;
+        if (metric_ == Metric::L2) {
+            k.l2(block, query, dim_, dist);
+        } else {
+            k.dot(block, query, dim_, dist);
+            for (size_t r = 0; r < kRows; r++) dist[r] = 1.0f - dist[r];
+        }
+        size_t rows = std::min(kRows, list.count - b * kRows);
+        for (size_t r = 0; r < rows; r++) {
+            visit(b * kRows + r, dist[r]);
+        }
+    }
+}
+
+void VectorSet::prepare(const float* in, float* out) const {
+    if (in != out) {
+        std::copy(in, in + dim_, out);
+    }
+    if (metric_ != Metric::Cosine) {
+        return;
+    }
+    double norm = 0.0;
+    for (size_t d = 0; d < dim_; d++) norm += double(out[d]) * out[d];
+    if (norm > 0.0) {
+        float inv = static_cast<float>(1.0 / std::sqrt(norm));
+        for (size_t d = 0; d < dim_; d++) out[d] *= inv;
+    }
+}
+
+size_t VectorSet::nearest_list(const float* vec) const {
+    if (!has_ivf()) {
+        return 0;
+    }
+    size_t best = 0;
+    float best_dist = INFINITY;
+    scan(centroids_, vec, [&](size_t row, float dist) {
+        if (dist < best_dist) {
+            best_dist = dist;
+            best = row;
+        }
+    });
+    return best;
+}
+
+bool VectorSet::add(const std::string& id, const float* vec) {
+    bool is_new = !remove(id);
+    std::vector<float> v(dim_);
+    prepare(vec, v.data());
+
+    uint32_t label;
+    if (!free_labels_.empty()) {
+        label = free_labels_.back();
+        free_labels_.pop_back();
+        ids_[label] = id;
+    } else {
+        label = static_cast<uint32_t>(ids_.size());
+        ids_.push_back(id);
+        locations_.emplace_back();
+    }
+    labels_[id] = label;
+
+    size_t li = nearest_list(v.data());
+    lists_[li].push(v.data(), dim_, label);
+    locations_[label] = {static_cast<uint32_t>(li), static_cast<uint32_t>(lists_[li].count - 1)};
+    return is_new;
+}
+
+bool VectorSet::remove(const std::string& id) {
+    auto it = labels_.find(id);
+    if (it == labels_.end()) {
+        return false;
+    }
+    uint32_t label = it->second;
+    auto loc = locations_[label];
+    List& list = lists_[loc.first];
+    list.swap_remove(loc.second, dim_);
+    if (loc.second < list.count) {
+        locations_[list.labels[loc.second]].second = loc.second;   // the row that moved in
+    }
+    ids_[label].clear();
+    free_labels_.push_back(label);
+    labels_.erase(it);
+    return true;
+}
+
+void VectorSet::knn(const float* query, size_t k, size_t nprobe, std::vector<Match>& out) const {
+    if (k == 0 || size() == 0) {
+        return;
+    }
+    std::vector<float> q(dim_);
+    prepare(query, q.data());
+
+    // Max-heap of the k best so far; the root is the one to evict
+    std::priority_queue<std::pair<float, uint32_t>> heap;
+    auto scan_list = [&](const List& list) {
+        scan(list, q.data(), [&](size_t row, float dist) {
+            if (heap.size() < k) {
+                heap.emplace(dist, list.labels[row]);
+            } else if (dist < heap.top().first) {
+                heap.pop();
+                heap.emplace(dist, list.labels[row]);
+            }
+        });
+    };
+
+    if (!has_ivf()) {
+        scan_list(lists_[0]);
+    } else {
+        std::vector<std::pair<float, size_t>> order;
+        order.reserve(centroids_.count);
+        scan(centroids_, q.data(), [&](size_t row, float dist) { order.emplace_back(dist, row); });
+        size_t probes = std::min(std::max<size_t>(nprobe, 1), order.size());
+        std::partial_sort(order.begin(), order.begin() + probes, order.end());
+        for (size_t i = 0; i < probes; i++) {
+            scan_list(lists_[order[i].second]);
+        }
+    }
+
+    size_t first = out.size();
+    out.resize(first + heap.size());
+    for (size_t i = out.size(); i-- > first;) {
+        out[i] = {ids_[heap.top().second], heap.top().first};
+        heap.pop();
+    }
+}
+
+void VectorSet::build_ivf(size_t nlist, size_t iterations, uint64_t seed) {
+    size_t n = size();
+    if (n == 0 || nlist == 0) {
+        return;
+    }
+    nlist = std::min(nlist, n);
+
+    // Pull every row out of the SoA lists (they are rebuilt below)
+    std::vector<float> rows(n * dim_);
+    std::vector<uint32_t> row_labels;
+    row_labels.reserve(n);
+    for (const auto& list : lists_) {
+        for (size_t r = 0; r < list.count; r++) {
+            list.get(r, dim_, rows.data() + row_labels.size() * dim_);
+            row_labels.push_back(list.labels[r]);
+        }
+    }
+
+    // Lloyd's iterations on a sample, seeded with distinct random rows
+    std::mt19937_64 rng(seed);
+    std::vector<size_t> order(n);
+    std::iota(order.begin(), order.end(), 0);
+    std::shuffle(order.begin(), order.end(), rng);
+    size_t train = std::min(n, nlist * 256);
+
+    std::vector<float> centers(nlist * dim_);
+    for (size_t c = 0; c < nlist; c++) {
+        std::copy_n(rows.data() + order[c] * dim_, dim_, centers.data() + c * dim_);
+    }
+    auto load_centroids = [&]() {
+        centroids_ = List();
+        for (size_t c = 0; c < nlist; c++) {
+            centroids_.push(centers.data() + c * dim_, dim_, static_cast<uint32_t>(c));
+        }
+    };
+    std::vector<double> sums(nlist * dim_);
+    std::vector<size_t> counts(nlist);
+    for (size_t it = 0; it < iterations; it++) {
+        load_centroids();
+        std::fill(sums.begin(), sums.end(), 0.0);
+        std::fill(counts.begin(), counts.end(), 0);
+        for (size_t i = 0; i < train; i++) {
+            const float* v = rows.data() + order[i] * dim_;
+            size_t c = nearest_list(v);
+            counts[c]++;
+            for (size_t d = 0; d < dim_; d++) sums[c * dim_ + d] += v[d];
+        }
+        for (size_t c = 0; c < nlist; c++) {
+            float* center = centers.data() + c * dim_;
+            if (counts[c] == 0) {
+                // Empty cluster: restart it on a random training row
+                std::copy_n(rows.data() + order[rng() % train] * dim_, dim_, center);
+                continue;
+            }
+            for (size_t d = 0; d < dim_; d++) {
+                center[d] = static_cast<float>(sums[c * dim_ + d] / counts[c]);
+            }
+            if (metric_ == Metric::Cosine) {
+                prepare(center, center);   // spherical k-means keeps centroids unit length
+            }
+        }
+    }
+    load_centroids();
+
+    lists_.assign(nlist, List());
+    for (size_t i = 0; i < n; i++) {
+        const float* v = rows.data() + i * dim_;
+        size_t li = nearest_list(v);
+        lists_[li].push(v, dim_, row_labels[i]);
+        locations_[row_labels[i]] = {static_cast<uint32_t>(li), static_cast<uint32_t>(lists_[li].count - 1)};
+    }
+}
+
+size_t VectorSet::memory_bytes() const {
+    size_t total = centroids_.data.capacity() * sizeof(float);
+    for (const auto& list : lists_) {
+        total += list.data.capacity() * sizeof(float) + list.labels.capacity() * sizeof(uint32_t);
+    }
+    for (const auto& id : ids_) {
+        total += sizeof(std::string) + id.capacity();
+    }
+    return total + locations_.capacity() * sizeof(locations_[0]);
+}
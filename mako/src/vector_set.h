@@ -0,0 +1,91 @@
+#ifndef _VECTOR_SET_H_
+#define _VECTOR_SET_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Set of named fixed-dimension float32 vectors with k-nearest-neighbor search.
+//
+// Rows are stored in SoA blocks of kBlockRows vectors laid out dimension by
+// dimension (block[d * kBlockRows + row]), so a distance kernel streams a
+// block once and produces kBlockRows distances with vertical SIMD and no
+// horizontal reductions. Search is exact over one list until an IVF index is
+// built: k-means centroids partition the rows into lists, and a query scans
+// only the nprobe lists whose centroids are closest.
+class VectorSet {
+public:
+    enum class Metric { L2, InnerProduct, Cosine };
+
+    static const size_t kBlockRows = 64;
+    static const size_t kDefaultNprobe = 8;
+
+    struct Match {
+        std::string id;
+        float distance;   // squared L2, or 1 - similarity for IP/cosine
+    };
+
+    VectorSet(size_t dim, Metric metric);
+
+    size_t dim() const { return dim_; }
+    Metric metric() const { return metric_; }
+    size_t size() const { return ids_.size() - free_labels_.size(); }
+    size_t lists() const { return lists_.size(); }
+    bool has_ivf() const { return centroids_.count > 0; }
+    size_t memory_bytes() const;
+
+    // Returns true if the id is new (an existing id is replaced)
+    bool add(const std::string& id, const float* vec);
+    bool remove(const std::string& id);
+
+    // k nearest neighbors, closest first. nprobe only matters with an IVF index.
+    void knn(const float* query, size_t k, size_t nprobe, std::vector<Match>& out) const;
+
+    // Trains nlist k-means centroids (Lloyd's algorithm on a sample) and
+    // redistributes every row into its centroid's list
+    void build_ivf(size_t nlist, size_t iterations = 10, uint64_t seed = 1);
+
+    static bool parse_metric(const std::string& name, Metric& out);
+
+    // Distances from one query to the kBlockRows rows of a block (exposed for engine_bench)
+    struct Kernels {
+        const char* name;
+        void (*l2)(const float* block, const float* query, size_t dim, float* out);
+        void (*dot)(const float* block, const float* query, size_t dim, float* out);
+    };
+    static const Kernels& kernels();
+
+private:
+    // Rows in SoA blocks, with the label (index into ids_) of each row
+    struct List {
+        std::vector<float> data;
+        std::vector<uint32_t> labels;
+        size_t count = 0;
+
+        void push(const float* vec, size_t dim, uint32_t label);
+        // Removes row by moving the last row into its place
+        void swap_remove(size_t row, size_t dim);
+        void get(size_t row, size_t dim, float* out) const;
+    };
+
+    // Distances to every row of a list: calls visit(row, distance)
+    template <typename Visit>
+    void scan(const List& list, const float* query, Visit&& visit) const;
+    size_t nearest_list(const float* vec) const;
+    void prepare(const float* in, float* out) const;
+
+    size_t dim_;
+    Metric metric_;
+    std::vector<List> lists_;
+    List centroids_;
+
+    std::vector<std::string> ids_;                            // by label
+    std::vector<std::pair<uint32_t, uint32_t>> locations_;    // label -> (list, row)
+    std::vector<uint32_t> free_labels_;
+    std::unordered_map<std::string, uint32_t> labels_;
+};
+
+#endif
@@ -0,0 +1,196 @@
+#include "bitops.h"
+#include "check.h"
+#include "cpu_features.h"
+
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+
+// Bitmap kernels: every ISA's popcount and AND/OR/XOR/NOT against a
+// byte-at-a-time reference, over lengths that leave odd tails after the
+// 32-byte AVX2 and 8-byte word loops and over unaligned starts.
+
+namespace {
+
+std::vector<uint8_t> random_bytes(std::mt19937& rng, size_t len) {
+    std::vector<uint8_t> out(len);
+    for (auto& b : out) {
+        b = static_cast<uint8_t>(rng());
+    }
+    return out;
+}
+
+uint64_t reference_popcount(const uint8_t* data, size_t len) {
+    uint64_t total = 0;
+    for (size_t i = 0; i < len; i++) {
+        for (int bit = 0; bit < 8; bit++) {
+            total += (data[i] >> bit) & 1;
+        }
+    }
+    return total;
+}
+
+uint8_t reference_op(bitops::Op op, uint8_t a, uint8_t b) {
+    switch (op) {
+    case bitops::Op::And: return a & b;
+    case bitops::Op::Or: return a | b;
+    case bitops::Op::Xor: return a ^ b;
+    case bitops::Op::Not: return static_cast<uint8_t>(~b);
+    }
+    return 0;
+}
+
+void run_kernel(const bitops::Kernels& k, bitops::Op op, uint8_t* dst, const uint8_t* src, size_t len) {
+    switch (op) {
+    case bitops::Op::And: k.and_into(dst, src, len); break;
+    case bitops::Op::Or: k.or_into(dst, src, len); break;
+    case bitops::Op::Xor: k.xor_into(dst, src, len); break;
+    case bitops::Op::Not: k.not_into(dst, src, len); break;
+    }
+}
+
+const bitops::Isa kIsas[] = {bitops::Isa::Scalar, bitops::Isa::Popcnt, bitops::Isa::Avx2};
+const bitops::Op kOps[] = {bitops::Op::And, bitops::Op::Or, bitops::Op::Xor, bitops::Op::Not};
+
+// Lengths around the loop boundaries, including a 256-byte AVX2 popcount
+// round (8 x 32) and the byte-sum flush after it
+std::vector<size_t> test_lengths() {
+    std::vector<size_t> lens;
+    for (size_t n = 0; n <= 100; n++) {
+        lens.push_back(n);
+    }
+    for (size_t n : {127, 128, 129, 255, 256, 257, 511, 512, 513, 1023, 4099}) {
+        lens.push_back(n);
+    }
+    return lens;
+}
+
+// A buffer of all 0xff bytes, the worst case for the AVX2 byte counters
+void test_popcount_all_ones() {
+    std::vector<uint8_t> ones(4096 + 31, 0xff);
+    for (bitops::Isa isa : kIsas) {
+        const bitops::Kernels& k = bitops::kernels_for(isa);
+        for (size_t len : {size_t(256), size_t(257), size_t(4096 + 31)}) {
+            CHECK_EQ(k.popcount(ones.data(), len), uint64_t(len * 8));
+        }
+    }
+}
+
+void test_popcount_matches_reference() {
+    std::mt19937 rng(79);
+    for (size_t len : test_lengths()) {
+        std::vector<uint8_t> buf = random_bytes(rng, len + 7);
+        for (size_t offset : {0, 1, 3, 7}) {
+            const uint8_t* data = buf.data() + offset;
+            uint64_t expected = reference_popcount(data, len);
+            for (bitops::Isa isa : kIsas) {
+                CHECK_EQ(bitops::kernels_for(isa).popcount(data, len), expected);
+            }
+        }
+    }
+}
+
+// Kernels write exactly len bytes: the guard bytes around dst stay as they were
+void test_combine_matches_reference() {
+    std::mt19937 rng(7979);
+    for (size_t len : test_lengths()) {
+        std::vector<uint8_t> src = random_bytes(rng, len + 3);
+        std::vector<uint8_t> dst = random_bytes(rng, len + 5);
+        for (bitops::Op op : kOps) {
+            std::vector<uint8_t> expected = dst;
+            for (size_t i = 0; i < len; i++) {
+                expected[i + 1] = reference_op(op, dst[i + 1], src[i + 3]);
+            }
+            for (bitops::Isa isa : kIsas) {
+                std::vector<uint8_t> out = dst;
+                run_kernel(bitops::kernels_for(isa), op, out.data() + 1, src.data() + 3, len);
+                CHECK(out == expected);
+            }
+        }
+    }
+}
+
+// Multi-source BITOP across the 64KB blocks, with sources of different
+// lengths: shorter ones count as zero-padded
+void test_bitop_sources_of_different_lengths() {
+    std::mt19937 rng(97);
+    const size_t lens[] = {0, 1, 33, 65536 + 17, 3 * 65536 + 5};
+    std::vector<std::vector<uint8_t>> bufs;
+    std::vector<bitops::Source> sources;
+    for (size_t len : lens) {
+        bufs.push_back(random_bytes(rng, len));
+    }
+    for (const auto& b : bufs) {
+        sources.push_back({b.data(), b.size()});
+    }
+    const size_t max_len = lens[4];
+
+    for (bitops::Op op : kOps) {
+        std::string expected(max_len, '\0');
+        for (size_t i = 0; i < max_len; i++) {
+            uint8_t acc = bufs[0].size() > i ? bufs[0][i] : 0;
+            if (op == bitops::Op::Not) {
+                acc = static_cast<uint8_t>(~acc);
+            } else {
+                for (size_t s = 1; s < bufs.size(); s++) {
+                    acc = reference_op(op, acc, bufs[s].size() > i ? bufs[s][i] : 0);
+                }
+            }
+            expected[i] = static_cast<char>(acc);
+        }
+        // NOT takes one source; its result is that source's length
+        std::vector<bitops::Source> in = sources;
+        if (op == bitops::Op::Not) {
+            in = {sources[4]};
+            for (size_t i = 0; i < max_len; i++) {
+                expected[i] = static_cast<char>(~bufs[4][i]);
+            }
+        }
+        for (bitops::Isa isa : kIsas) {
+            std::string dst = "stale";
+            bitops::bitop(bitops::kernels_for(isa), op, in, dst);
+            CHECK(dst == expected);
+        }
+    }
+}
+
+void test_bitpos_tails() {
+    for (size_t len = 1; len <= 40; len++) {
+        for (size_t at = 0; at < len * 8; at += 5) {
+            std::vector<uint8_t> zeros(len, 0x00);
+            zeros[at / 8] |= static_cast<uint8_t>(0x80 >> (at % 8));
+            CHECK_EQ(bitops::bitpos(zeros.data(), len, true), int64_t(at));
+
+            std::vector<uint8_t> ones(len, 0xff);
+            ones[at / 8] &= static_cast<uint8_t>(~(0x80 >> (at % 8)));
+            CHECK_EQ(bitops::bitpos(ones.data(), len, false), int64_t(at));
+        }
+        std::vector<uint8_t> zeros(len, 0x00);
+        CHECK_EQ(bitops::bitpos(zeros.data(), len, true), int64_t(-1));
+    }
+}
+
+// BITCOUNT and BITOP through the engine agree with the kernels
+void test_engine_commands() {
+    KVStore kv;
+    CHECK_EQ(run(kv, "set", "a", "foobar"), "OK");
+    CHECK_EQ(run(kv, "set", "b", "abcdefghijklmnopqrstuvwxyz0123456789"), "OK");
+    CHECK_EQ(run(kv, "bitcount", "a"), "26");
+    CHECK_EQ(run(kv, "bitop", "dest", "or,a,b"), "36");
+    CHECK_EQ(run(kv, "get", "dest").substr(6), std::string("ghijklmnopqrstuvwxyz0123456789"));
+}
+
+}  // namespace
+
+int main() {
+    std::cout << "bitops_test: best kernels " << bitops::kernels().name
+              << (cpu_has_avx2() ? "" : " (AVX2 unavailable, every ISA runs scalar)") << "\n";
+    test_popcount_all_ones();
+    test_popcount_matches_reference();
+    test_combine_matches_reference();
+    test_bitop_sources_of_different_lengths();
+    test_bitpos_tails();
+    test_engine_commands();
+    return check_exit_code("bitops_test");
+}
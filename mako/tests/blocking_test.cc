@@ -0,0 +1,119 @@
+#include "check.h"
+#include "kv_store.h"
+
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+// BLPOP / BRPOP / BLMOVE and the pushes that wake them
+
+namespace {
+
+struct Wake {
+    int calls = 0;
+    bool found = false;
+    std::string key;
+    std::string value;
+
+    KVStore::BlockCallback callback() {
+        return [this](bool f, const std::string& k, const std::string& v) {
+            calls++;
+            found = f;
+            key = k;
+            value = v;
+        };
+    }
+};
+
+// A value handed straight to a blocked client still counts in the push's
+// reply, as in Redis where the client pops it once the push is done
+void test_push_reply_counts_served_values() {
+    KVStore kv;
+    Wake wake;
+    kv.blpop({"a", "q"}, 0, wake.callback());
+    CHECK_EQ(wake.calls, 0);
+    CHECK_EQ(run(kv, "lpush", "q", "v"), "1");
+    CHECK_EQ(wake.calls, 1);
+    CHECK(wake.found);
+    CHECK_EQ(wake.key, "q");
+    CHECK_EQ(wake.value, "v");
+    CHECK_EQ(run(kv, "llen", "q"), "0");
+
+    Wake first;
+    kv.brpop({"q"}, 0, first.callback());
+    CHECK_EQ(run(kv, "rpush", "q", "x,y,z"), "3");
+    CHECK_EQ(first.value, "x");
+    CHECK_EQ(run(kv, "lrange", "q", "0,-1"), "y,z");
+    CHECK_EQ(run(kv, "rpush", "q", "w"), "3");
+
+    Wake direct;
+    kv.blpop({"d"}, 0, direct.callback());
+    CHECK_EQ(kv.lpush("d", "one,piece").value, "1");
+    CHECK_EQ(direct.value, "one,piece");
+}
+
+void test_immediate_and_timeout() {
+    KVStore kv;
+    run(kv, "rpush", "l", "1,2");
+    Wake now;
+    kv.brpop({"l"}, 0, now.callback());
+    CHECK_EQ(now.calls, 1);
+    CHECK_EQ(now.value, "2");
+
+    Wake late;
+    kv.blpop({"empty"}, 1, late.callback());
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    kv.process_timers();
+    CHECK_EQ(late.calls, 1);
+    CHECK(!late.found);
+    CHECK_EQ(run(kv, "lpush", "empty", "v"), "1");
+    CHECK_EQ(late.calls, 1);
+    CHECK_EQ(run(kv, "llen", "empty"), "1");
+}
+
+void test_blmove() {
+    KVStore kv;
+    Wake moved;
+    kv.blmove("src", "dst", true, false, 0, moved.callback());
+    CHECK_EQ(run(kv, "rpush", "src", "m"), "1");
+    CHECK_EQ(moved.value, "m");
+    CHECK_EQ(run(kv, "llen", "src"), "0");
+    CHECK_EQ(run(kv, "lrange", "dst", "0,-1"), "m");
+}
+
+// A client that disconnects leaves no waiter behind to swallow a later push
+void test_cancel_and_no_wait() {
+    KVStore kv;
+    Wake gone;
+    KVStore::BlockId id = kv.blpop({"c"}, 0, gone.callback());
+    CHECK(id != 0);
+    CHECK_EQ(kv.blocked_clients(), 1u);
+    CHECK(kv.cancel_block(id));
+    CHECK_EQ(gone.calls, 1);
+    CHECK(!gone.found);
+    CHECK_EQ(kv.blocked_clients(), 0u);
+    CHECK(!kv.cancel_block(id));
+    CHECK_EQ(gone.calls, 1);
+    CHECK_EQ(run(kv, "rpush", "c", "v"), "1");
+    CHECK_EQ(run(kv, "llen", "c"), "1");
+
+    Wake served;
+    CHECK_EQ(kv.brpop({"c"}, KVStore::kNoWait, served.callback()), 0u);
+    CHECK_EQ(served.value, "v");
+    Wake empty;
+    CHECK_EQ(kv.blmove("c", "d", true, true, KVStore::kNoWait, empty.callback()), 0u);
+    CHECK_EQ(empty.calls, 1);
+    CHECK(!empty.found);
+    CHECK_EQ(kv.blocked_clients(), 0u);
+}
+
+}  // namespace
+
+int main() {
+    test_push_reply_counts_served_values();
+    test_immediate_and_timeout();
+    test_blmove();
+    test_cancel_and_no_wait();
+    return check_exit_code("blocking_test");
+}
@@ -0,0 +1,93 @@
+#include "bloom_filter.h"
+#include "check.h"
+
+#include <cstdint>
+#include <string>
+
+// Bloom filters: no false negatives, and false positive rates near the
+// configured error rate for one blocked filter at capacity and for a scalable
+// filter grown well past its first layer.
+
+namespace {
+
+const uint64_t kProbes = 200000;
+
+// Fraction of never-added items the filter claims to hold
+template <class Contains>
+double false_positive_rate(Contains contains) {
+    uint64_t hits = 0;
+    for (uint64_t i = 0; i < kProbes; i++) {
+        hits += contains("absent:" + std::to_string(i));
+    }
+    return static_cast<double>(hits) / kProbes;
+}
+
+bool rate_under(double rate, double limit, const char* what) {
+    std::cout << what << ": false positive rate " << rate * 100 << "% (limit " << limit * 100 << "%)\n";
+    return rate <= limit;
+}
+
+// A split-block filter has a somewhat higher rate than a classic one of the
+// same size; allow twice the target
+void test_blocked_filter_at_capacity() {
+    for (double error_rate : {0.01, 0.001}) {
+        const uint64_t capacity = 50000;
+        BlockedBloomFilter filter(capacity, error_rate);
+        for (uint64_t i = 0; i < capacity; i++) {
+            filter.add(ScalableBloomFilter::hash("item:" + std::to_string(i)));
+        }
+        bool all_found = true;
+        for (uint64_t i = 0; i < capacity; i++) {
+            all_found = all_found && filter.contains(ScalableBloomFilter::hash("item:" + std::to_string(i)));
+        }
+        CHECK(all_found);
+        double rate = false_positive_rate(
+            [&](const std::string& item) { return filter.contains(ScalableBloomFilter::hash(item)); });
+        CHECK(rate_under(rate, 2 * error_rate, "blocked filter"));
+    }
+}
+
+// Forty times the first layer's capacity: the layers tighten so the
+// compound rate stays near the target
+void test_scalable_filter_growth() {
+    ScalableBloomFilter filter(1000, 0.01);
+    const uint64_t items = 40000;
+    uint64_t added = 0;
+    for (uint64_t i = 0; i < items; i++) {
+        added += filter.add("item:" + std::to_string(i));
+    }
+    CHECK(filter.layers() > 3);
+    CHECK_EQ(filter.size(), added);
+    CHECK(added > items * 99 / 100);
+
+    bool all_found = true;
+    for (uint64_t i = 0; i < items; i++) {
+        all_found = all_found && filter.contains("item:" + std::to_string(i));
+        all_found = all_found && !filter.add("item:" + std::to_string(i));
+    }
+    CHECK(all_found);
+    double rate = false_positive_rate([&](const std::string& item) { return filter.contains(item); });
+    CHECK(rate_under(rate, 2 * 0.01, "scalable filter"));
+}
+
+void test_engine_commands() {
+    KVStore kv;
+    CHECK_EQ(run(kv, "bf.reserve", "bf", "0.001,100"), "OK");
+    CHECK_EQ(run(kv, "bf.reserve", "bf", "0.001,100"), "FAILED ERROR: item exists");
+    CHECK_EQ(run(kv, "bf.reserve", "bad", "1.5,100"), "FAILED ERROR: error rate must be in (0,1) and capacity positive");
+    CHECK_EQ(run(kv, "bf.add", "bf", "a"), "1");
+    CHECK_EQ(run(kv, "bf.add", "bf", "a"), "0");
+    CHECK_EQ(run(kv, "bf.madd", "bf", "a,b,c"), "0,1,1");
+    CHECK_EQ(run(kv, "bf.exists", "bf", "b"), "1");
+    CHECK_EQ(run(kv, "bf.mexists", "bf", "a,zz-not-added,c"), "1,0,1");
+    CHECK_EQ(run(kv, "bf.exists", "missing", "a"), "0");
+}
+
+}  // namespace
+
+int main() {
+    test_blocked_filter_at_capacity();
+    test_scalable_filter_growth();
+    test_engine_commands();
+    return check_exit_code("bloom_test");
+}
@@ -0,0 +1,172 @@
+#include "check.h"
+#include "bulk_load.h"
+#include "kv_store.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <utility>
+#include <vector>
+
+// BULKLOAD and DEBUG POPULATE: each format parsed on one thread and cut into
+// chunks for several, and the engine side of both
+
+namespace {
+
+bool starts_with(const std::string& s, const std::string& prefix) {
+    return s.compare(0, prefix.size(), prefix) == 0;
+}
+
+void write_file(const std::string& path, const std::string& data) {
+    FILE* f = std::fopen(path.c_str(), "wb");
+    CHECK(f != nullptr);
+    if (f != nullptr) {
+        std::fwrite(data.data(), 1, data.size(), f);
+        std::fclose(f);
+    }
+}
+
+// Rows whose values hold what a chunk cutter could mistake for a record
+// start, with some keys repeated far apart so their copies land in
+// different chunks; 3 to 5MB, so cut into that many chunks
+BulkLoader::Run tricky_rows(BulkLoader::Format format) {
+    BulkLoader::Run rows;
+    for (size_t i = 0; i < 40000; i++) {
+        std::string key = "k:" + std::to_string(i % 30000);
+        std::string value = "v" + std::to_string(i) + std::string(80, 'x');
+        switch (format) {
+        case BulkLoader::kResp: value += "\r\n*3\r\n$3\r\nSET\r\n$1\r\n"; break;
+        case BulkLoader::kCsv: value += i % 2 ? ",\"q\"\"," : ""; break;
+        default: value += std::string("\0\n\xff", 3); break;
+        }
+        rows.emplace_back(key, value);
+    }
+    rows.emplace_back("", "empty key");
+    rows.emplace_back("empty value", "");
+    return rows;
+}
+
+// Every format, whole and cut into chunks: rows come back sorted by key with
+// equal keys in file order, whichever chunk each copy was parsed in
+void test_formats(const std::string& dir) {
+    const BulkLoader::Format kFormats[] = {BulkLoader::kResp, BulkLoader::kCsv, BulkLoader::kBinary};
+    const char* const kNames[] = {"RESP", "CSV", "BINARY"};
+    for (int f = 0; f < 3; f++) {
+        BulkLoader::Run rows = tricky_rows(kFormats[f]);
+        std::string data = BulkLoader::header(kFormats[f]);
+        for (const auto& row : rows) {
+            CHECK(BulkLoader::encode(kFormats[f], row.first, row.second, data));
+        }
+        std::string path = dir + "/rows." + kNames[f];
+        write_file(path, data);
+
+        std::stable_sort(rows.begin(), rows.end(),
+                         [](const BulkLoader::Run::value_type& a, const BulkLoader::Run::value_type& b) {
+                             return a.first < b.first;
+                         });
+        for (size_t threads : {1, 4, 64}) {
+            BulkLoader::Load load;
+            std::string error;
+            bool ok = BulkLoader::read(path, std::string(kNames[f]) + ",THREADS," + std::to_string(threads), load,
+                                       error);
+            CHECK_EQ(error, "");
+            CHECK(ok);
+            // One chunk per MB at most
+            CHECK(threads == 1 ? load.threads == 1 : load.threads >= 3 && load.threads <= data.size() >> 20);
+            CHECK_EQ(load.bytes, data.size());
+            CHECK(load.rows == rows);
+        }
+    }
+}
+
+// Malformed input is reported with the offset of the record, however the
+// file was cut
+void test_malformed(const std::string& dir) {
+    auto read_error = [&](const std::string& name, const std::string& data, const std::string& args) {
+        write_file(dir + "/" + name, data);
+        BulkLoader::Load load;
+        std::string error;
+        return BulkLoader::read(dir + "/" + name, args, load, error) ? std::string("loaded") : error;
+    };
+    std::string resp;
+    BulkLoader::encode(BulkLoader::kResp, "a", "1", resp);
+    const std::string first = resp;
+    CHECK_EQ(read_error("cut.resp", resp + first.substr(0, first.size() - 1), ""),
+             "ERROR: malformed RESP record at byte " + std::to_string(first.size()) +
+                 " (only SET commands can be loaded)");
+    CHECK_EQ(read_error("get.resp", resp + "*2\r\n$3\r\nGET\r\n$1\r\na\r\n", "RESP"),
+             "ERROR: malformed RESP record at byte " + std::to_string(first.size()) +
+                 " (only SET commands can be loaded)");
+    CHECK_EQ(read_error("lower.resp", "*3\r\n$3\r\nset\r\n$1\r\na\r\n$1\r\n1\r\n", ""), "loaded");
+
+    CHECK_EQ(read_error("quote.csv", "a,1\n\"b,2\n", ""), "ERROR: malformed CSV record at byte 4");
+    CHECK_EQ(read_error("fields.csv", "a,1,2\n", ""), "ERROR: malformed CSV record at byte 0");
+    CHECK_EQ(read_error("blank.csv", "a,1\r\n\r\n\nb,\"x,\"\"y\"\r\n", ""), "loaded");
+
+    std::string bin = BulkLoader::header(BulkLoader::kBinary);
+    BulkLoader::encode(BulkLoader::kBinary, "a", "1", bin);
+    CHECK_EQ(read_error("cut.bin", bin.substr(0, bin.size() - 1), ""), "ERROR: malformed BINARY record at byte 8");
+    CHECK_EQ(read_error("magic.bin", "NOTMAKO!" + bin.substr(8), ""),
+             "ERROR: " + dir + "/magic.bin is not a BINARY load file");
+
+    CHECK_EQ(read_error("rows.txt", "a,1\n", ""),
+             "ERROR: cannot tell the format of " + dir + "/rows.txt; give RESP, CSV or BINARY");
+    CHECK_EQ(read_error("rows.txt", "a,1\n", "csv"), "loaded");
+    CHECK_EQ(read_error("rows.txt", "a,1\n", "CSV,JSON"), "ERROR: BULKLOAD takes [RESP|CSV|BINARY] [THREADS n]");
+    CHECK_EQ(read_error("rows.txt", "a,1\n", "CSV,THREADS,0"), "ERROR: THREADS must be a positive integer");
+}
+
+// A later row for a key wins, and the reply counts rows
+void test_bulkload(const std::string& dir) {
+    write_file(dir + "/load.csv", "b,2\na,1\nb,3\n");
+    KVStore kv;
+    run(kv, "set", "a", "old");
+    CHECK(starts_with(run(kv, "bulkload", dir + "/load.csv"), "rows:3,"));
+    CHECK_EQ(run(kv, "get", "a"), "1");
+    CHECK_EQ(run(kv, "get", "b"), "3");
+}
+
+// DEBUG POPULATE leaves live keys alone but replaces expired ones the maps
+// still hold, and counts only the keys it created
+void test_populate_over_existing_keys() {
+    KVStore kv;
+    run(kv, "set", "key:1", "live");
+    run(kv, "set", "key:2", "old");
+    run(kv, "expire", "key:2", "0");
+    run(kv, "hset", "key:3", "f:v");
+    run(kv, "expire", "key:3", "0");
+
+    std::string reply = run(kv, "debug.populate", "5");
+    CHECK(starts_with(reply, "keys:4,strings:4,"));
+    CHECK_EQ(run(kv, "get", "key:0"), "value:0");
+    CHECK_EQ(run(kv, "get", "key:1"), "live");
+    CHECK_EQ(run(kv, "get", "key:2"), "value:2");
+    CHECK_EQ(run(kv, "ttl", "key:2"), "-1");
+    CHECK_EQ(run(kv, "get", "key:3"), "value:3");
+    CHECK_EQ(run(kv, "exists", "key:3"), "1");
+    CHECK_EQ(run(kv, "hexists", "key:3", "f"), "0");
+
+    // Again: everything is there now
+    reply = run(kv, "debug.populate", "5");
+    CHECK(starts_with(reply, "keys:0,"));
+}
+
+}  // namespace
+
+int main() {
+    char dir_template[] = "/tmp/mako_bulk_load_test.XXXXXX";
+    const char* dir = mkdtemp(dir_template);
+    CHECK(dir != nullptr);
+    if (dir == nullptr) {
+        return check_exit_code("bulk_load_test");
+    }
+
+    test_formats(dir);
+    test_malformed(dir);
+    test_bulkload(dir);
+    test_populate_over_existing_keys();
+
+    std::system(("rm -rf '" + std::string(dir) + "'").c_str());
+    return check_exit_code("bulk_load_test");
+}
@@ -0,0 +1,56 @@
+#ifndef _CHECK_H_
+#define _CHECK_H_
+
+#include <iostream>
+#include <sstream>
+#include <string>
+
+#include "kv_store.h"
+
+// Minimal checks for the engine tests: a failed check prints where and what,
+// and the test keeps going so one run shows every failure. main() returns
+// check_exit_code(), which ctest reads as pass or fail.
+
+inline int& check_failures() {
+    static int failures = 0;
+    return failures;
+}
+
+#define CHECK(cond)                                                                        \
+    do {                                                                                   \
+        if (!(cond)) {                                                                     \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": CHECK(" #cond ") failed\n";     \
+            check_failures()++;                                                            \
+        }                                                                                  \
+    } while (0)
+
+#define CHECK_EQ(actual, expected)                                                         \
+    do {                                                                                   \
+        auto check_actual_ = (actual);                                                     \
+        auto check_expected_ = (expected);                                                 \
+        if (!(check_actual_ == check_expected_)) {                                         \
+            std::ostringstream check_out_;                                                 \
+            check_out_ << __FILE__ << ":" << __LINE__ << ": CHECK_EQ(" #actual ", " #expected \
+                       << ") failed: got '" << check_actual_ << "', expected '"            \
+                       << check_expected_ << "'\n";                                        \
+            std::cerr << check_out_.str();                                                 \
+            check_failures()++;                                                            \
+        }                                                                                  \
+    } while (0)
+
+// Runs an engine operation; the reply, or "FAILED " and the error
+inline std::string run(KVStore& kv, const std::string& op, const std::string& key, const std::string& value = "") {
+    KVStore::Result r = kv.execute_operation(op, key, value);
+    return r.success ? r.value : "FAILED " + r.value;
+}
+
+inline int check_exit_code(const char* name) {
+    if (check_failures() != 0) {
+        std::cerr << name << ": " << check_failures() << " check(s) failed\n";
+        return 1;
+    }
+    std::cout << name << ": ok\n";
+    return 0;
+}
+
+#endif
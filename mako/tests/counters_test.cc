@@ -0,0 +1,135 @@
+#include "check.h"
+#include "sharded_counter.h"
+
+#include <atomic>
+#include <climits>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Sharded counters: every increment that reports success is in the total
+// after concurrent unsharding, totals stay within their range, and sharding
+// or folding a counter moves the key's version so read replicas and other
+// version-stamped copies of the old value stop being served.
+
+namespace {
+
+// Workers add while the owner unshards mid-way: an add either reported
+// success and is in the folded total, or failed and is the caller's to retry
+void test_no_increment_lost_on_unshard() {
+    for (int round = 0; round < 20; round++) {
+        ShardedCounters counters(INT_MIN, INT_MAX);
+        counters.shard("c", 100);
+        std::atomic<int64_t> landed{0};
+        std::atomic<bool> go{false};
+        std::vector<std::thread> workers;
+        for (int t = 0; t < 4; t++) {
+            workers.emplace_back([&]() {
+                while (!go.load()) {
+                }
+                int64_t total;
+                for (int i = 0; i < 20000; i++) {
+                    if (counters.add("c", 1, total)) {
+                        landed++;
+                    }
+                }
+            });
+        }
+        go = true;
+        std::this_thread::yield();
+        int64_t folded;
+        CHECK(counters.unshard("c", folded));
+        for (auto& w : workers) {
+            w.join();
+        }
+        CHECK_EQ(folded, 100 + landed.load());
+        int64_t total;
+        CHECK(!counters.add("c", 1, total));
+        CHECK(!counters.read("c", total));
+    }
+}
+
+void test_range() {
+    ShardedCounters counters(-10, 10);
+    counters.shard("c", 9);
+    int64_t total;
+    CHECK(counters.add("c", 1, total));
+    CHECK_EQ(total, int64_t(10));
+    CHECK(!counters.add("c", 1, total));
+    CHECK(counters.read("c", total));
+    CHECK_EQ(total, int64_t(10));
+    CHECK(counters.add("c", -20, total));
+    CHECK(!counters.add("c", -1, total));
+    CHECK(counters.unshard("c", total));
+    CHECK_EQ(total, int64_t(-10));
+}
+
+// What the wrapper does before taking the engine lock
+std::string lock_free(KVStore& kv, const std::string& op, const std::string& key, const std::string& value = "") {
+    std::string result;
+    return kv.sharded_counter(op, key, value, result) ? result : "<engine>";
+}
+
+void test_versions_follow_counters() {
+    KVStore kv;
+    kv.replicas().publish({"c"});
+    CHECK_EQ(run(kv, "set", "c", "5"), "OK");
+    kv.fill_replica("c", "5");
+    std::string value;
+    CHECK(kv.read_replica("c", value));
+
+    // Sharding moves the version: the old copy is gone, and no new one is made
+    uint64_t before = kv.key_version("c");
+    CHECK_EQ(run(kv, "counter.shard", "c"), "OK");
+    CHECK(kv.key_version("c") != before);
+    CHECK(!kv.read_replica("c", value));
+    kv.fill_replica("c", "5");
+    CHECK(!kv.read_replica("c", value));
+
+    CHECK_EQ(lock_free(kv, "incr", "c"), "6");
+    CHECK_EQ(lock_free(kv, "incrby", "c", "4"), "10");
+    CHECK_EQ(lock_free(kv, "get", "c"), "10");
+    CHECK_EQ(lock_free(kv, "incr", "plain"), "<engine>");
+
+    // Folding moves it again and the engine sees the total
+    before = kv.key_version("c");
+    CHECK_EQ(run(kv, "counter.unshard", "c"), "OK");
+    CHECK(kv.key_version("c") != before);
+    CHECK_EQ(lock_free(kv, "incr", "c"), "<engine>");
+    CHECK_EQ(run(kv, "get", "c"), "10");
+    kv.fill_replica("c", "10");
+    CHECK(kv.read_replica("c", value));
+    CHECK_EQ(value, "10");
+
+    // Any other command on a sharded key folds it first
+    CHECK_EQ(run(kv, "counter.shard", "c"), "OK");
+    CHECK_EQ(lock_free(kv, "decr", "c"), "9");
+    before = kv.key_version("c");
+    CHECK_EQ(run(kv, "append", "c", "0"), "2");
+    CHECK(kv.key_version("c") != before);
+    CHECK_EQ(run(kv, "get", "c"), "90");
+    CHECK_EQ(lock_free(kv, "incr", "c"), "<engine>");
+    CHECK_EQ(run(kv, "counters", ""), "");
+}
+
+void test_shard_refusals() {
+    KVStore kv;
+    CHECK_EQ(run(kv, "set", "s", "abc"), "OK");
+    CHECK_EQ(run(kv, "counter.shard", "s"), "FAILED ERROR: value is not an integer");
+    CHECK_EQ(run(kv, "set", "t", "1"), "OK");
+    CHECK_EQ(run(kv, "expire", "t", "100"), "1");
+    CHECK_EQ(run(kv, "counter.shard", "t"), "FAILED ERROR: only integer keys without a TTL can be sharded");
+    CHECK_EQ(run(kv, "counter.unshard", "s"), "FAILED ERROR: key is not a sharded counter");
+    CHECK_EQ(run(kv, "counter.shard", "new"), "OK");
+    CHECK_EQ(run(kv, "get", "new"), "0");
+}
+
+}  // namespace
+
+int main() {
+    test_no_increment_lost_on_unshard();
+    test_range();
+    test_versions_follow_counters();
+    test_shard_refusals();
+    return check_exit_code("counters_test");
+}
@@ -0,0 +1,176 @@
+#include "check.h"
+#include "geo_set.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+
+// Geo searches: the geohash cells a search covers must hold every point the
+// exact distance test accepts. Each search is checked against a scan of every
+// stored point, with centers on the antimeridian, near the latitude limits
+// and on the equator and prime meridian, radii from zero to a quarter of the
+// earth, and points placed exactly on the radius.
+
+namespace {
+
+struct Stored {
+    std::string member;
+    GeoSet::Point point;   // as stored: the center of its geohash cell
+};
+
+bool accepts(const GeoSet::Query& q, GeoSet::Point p) {
+    if (q.by_radius) {
+        return GeoSet::distance(q.center, p) <= q.radius_m;
+    }
+    const double kPi = 3.14159265358979323846;
+    double lat_m = GeoSet::kEarthRadiusM * std::fabs(p.lat - q.center.lat) * kPi / 180.0;
+    double lon_m = GeoSet::distance({q.center.lon, p.lat}, p);
+    return lat_m <= q.height_m / 2 && lon_m <= q.width_m / 2;
+}
+
+// Members found by the search equal the scan; distances are sorted
+bool matches_scan(const GeoSet& set, const std::vector<Stored>& points, const GeoSet::Query& q) {
+    std::set<std::string> expected;
+    for (const auto& s : points) {
+        if (accepts(q, s.point)) {
+            expected.insert(s.member);
+        }
+    }
+    std::vector<GeoSet::Match> out;
+    set.search(q, out);
+    std::set<std::string> found;
+    for (const auto& m : out) {
+        found.insert(m.member);
+    }
+    bool sorted = std::is_sorted(out.begin(), out.end(), [](const GeoSet::Match& a, const GeoSet::Match& b) {
+        return a.distance_m < b.distance_m;
+    });
+    if (found != expected || out.size() != found.size() || !sorted) {
+        std::cerr << "search at " << q.center.lon << "," << q.center.lat << " "
+                  << (q.by_radius ? "radius " : "box ") << (q.by_radius ? q.radius_m : q.width_m) << "m found "
+                  << found.size() << ", scan found " << expected.size() << "\n";
+        return false;
+    }
+    return true;
+}
+
+const GeoSet::Point kCenters[] = {
+    {179.999, 0.0}, {-180.0, 45.0}, {180.0, -30.0},   // antimeridian
+    {0.0, 85.0}, {120.0, -85.05}, {-45.0, 84.9},      // latitude limits
+    {0.0, 0.0}, {0.0001, -0.0001},                    // equator and prime meridian
+    {13.4, 52.5},
+};
+
+// Points clustered around every center at several scales, plus uniform ones
+std::vector<Stored> fill(GeoSet& set, std::mt19937& rng) {
+    std::vector<Stored> points;
+    std::uniform_real_distribution<double> unit(-1.0, 1.0);
+    auto add = [&](GeoSet::Point p) {
+        p.lon = std::max(-180.0, std::min(180.0, p.lon));
+        p.lat = std::max(-GeoSet::kLatMax, std::min(GeoSet::kLatMax, p.lat));
+        std::string member = "m" + std::to_string(points.size());
+        CHECK(set.add(member, p));
+        GeoSet::Point stored;
+        CHECK(set.position(member, stored));
+        points.push_back({member, stored});
+    };
+    for (const auto& c : kCenters) {
+        for (double scale : {0.0001, 0.01, 1.0, 20.0}) {
+            for (int i = 0; i < 150; i++) {
+                double lon = c.lon + scale * unit(rng);
+                // Wrap across the antimeridian rather than clamping
+                if (lon > 180) lon -= 360;
+                if (lon < -180) lon += 360;
+                add({lon, c.lat + scale * unit(rng)});
+            }
+        }
+    }
+    for (int i = 0; i < 3000; i++) {
+        add({180.0 * unit(rng), GeoSet::kLatMax * unit(rng)});
+    }
+    return points;
+}
+
+void test_radius_matches_scan() {
+    std::mt19937 rng(87);
+    GeoSet set;
+    std::vector<Stored> points = fill(set, rng);
+    for (const auto& c : kCenters) {
+        for (double radius : {0.0, 1.0, 50.0, 1000.0, 100000.0, 2000000.0, 10000000.0}) {
+            GeoSet::Query q;
+            q.center = c;
+            q.radius_m = radius;
+            CHECK(matches_scan(set, points, q));
+        }
+        // Radii that land exactly on stored points
+        for (int i = 0; i < 20; i++) {
+            GeoSet::Query q;
+            q.center = c;
+            q.radius_m = GeoSet::distance(c, points[rng() % points.size()].point);
+            CHECK(matches_scan(set, points, q));
+        }
+    }
+}
+
+void test_box_matches_scan() {
+    std::mt19937 rng(7887);
+    GeoSet set;
+    std::vector<Stored> points = fill(set, rng);
+    for (const auto& c : kCenters) {
+        for (double w : {10.0, 5000.0, 400000.0, 3000000.0}) {
+            GeoSet::Query q;
+            q.center = c;
+            q.by_radius = false;
+            q.width_m = w;
+            q.height_m = w / 2;
+            CHECK(matches_scan(set, points, q));
+        }
+    }
+}
+
+// COUNT keeps the nearest (or farthest with DESC), after removals
+void test_count_and_remove() {
+    GeoSet set;
+    for (int i = 0; i < 100; i++) {
+        CHECK(set.add("p" + std::to_string(i), {0.001 * i, 0.0}));
+    }
+    for (int i = 0; i < 100; i += 2) {
+        CHECK(set.remove("p" + std::to_string(i)));
+    }
+    CHECK(!set.remove("p0"));
+    GeoSet::Query q;
+    q.center = {0.0, 0.0};
+    q.radius_m = 1e6;
+    q.count = 3;
+    std::vector<GeoSet::Match> out;
+    set.search(q, out);
+    CHECK_EQ(out.size(), size_t(3));
+    CHECK(out.size() == 3 && out[0].member == "p1" && out[1].member == "p3" && out[2].member == "p5");
+    q.descending = true;
+    out.clear();
+    set.search(q, out);
+    CHECK(out.size() == 3 && out[0].member == "p99" && out[1].member == "p97" && out[2].member == "p95");
+}
+
+void test_engine_commands() {
+    KVStore kv;
+    CHECK_EQ(run(kv, "geoadd", "g", "13.361389,38.115556,Palermo,15.087269,37.502669,Catania"), "2");
+    CHECK_EQ(run(kv, "geoadd", "g", "181,0,Nowhere"), "FAILED ERROR: invalid longitude,latitude pair 181,0");
+    CHECK_EQ(run(kv, "geodist", "g", "Palermo,Catania,km"), "166.2742");
+    CHECK_EQ(run(kv, "geosearch", "g", "FROMLONLAT,15,37,BYRADIUS,200,km,ASC"), "Catania:56.4413,Palermo:190.4424");
+    CHECK_EQ(run(kv, "geosearch", "g", "FROMLONLAT,15,37,BYRADIUS,100,km"), "Catania:56.4413");
+    CHECK_EQ(run(kv, "geosearch", "g", "FROMMEMBER,Palermo,BYBOX,400,400,km,DESC,COUNT,1"), "Catania:166.2742");
+}
+
+}  // namespace
+
+int main() {
+    test_radius_matches_scan();
+    test_box_matches_scan();
+    test_count_and_remove();
+    test_engine_commands();
+    return check_exit_code("geo_test");
+}
@@ -0,0 +1,140 @@
+#include "check.h"
+#include "hash_index.h"
+
+#include <algorithm>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Secondary indexes follow every hash mutation: HSET adds and moves entries,
+// HDEL and DEL drop them, expired keys stop matching, values that stop being
+// numbers leave a NUMERIC index, and IDX.CREATE backfills existing hashes.
+
+namespace {
+
+// Replies of TAG queries come from an unordered set; sort them to compare
+std::string sorted(const std::string& keys) {
+    std::vector<std::string> parts;
+    std::istringstream in(keys);
+    std::string key;
+    while (std::getline(in, key, ',')) {
+        parts.push_back(key);
+    }
+    std::sort(parts.begin(), parts.end());
+    std::string out;
+    for (const auto& p : parts) {
+        out += (out.empty() ? "" : ",") + p;
+    }
+    return out;
+}
+
+void test_numeric_index_follows_writes() {
+    KVStore kv;
+    CHECK_EQ(run(kv, "idx.create", "price", "item:,price,NUMERIC"), "OK");
+    CHECK_EQ(run(kv, "hset", "item:1", "price:10"), "1");
+    CHECK_EQ(run(kv, "hset", "item:2", "price:20"), "1");
+    CHECK_EQ(run(kv, "hset", "item:3", "price:30"), "1");
+    CHECK_EQ(run(kv, "hset", "other:1", "price:15"), "1");   // outside the prefix
+    CHECK_EQ(run(kv, "hset", "item:4", "name:x"), "1");      // another field
+    CHECK_EQ(run(kv, "idx.query", "price", "-inf,+inf"), "item:1,item:2,item:3");
+    CHECK_EQ(run(kv, "idx.query", "price", "(10,30"), "item:2,item:3");
+    CHECK_EQ(run(kv, "idx.query", "price", "10,(30"), "item:1,item:2");
+    CHECK_EQ(run(kv, "idx.query", "price", "-inf,+inf,2"), "item:1,item:2");
+
+    // An update moves the key; the old value no longer matches
+    CHECK_EQ(run(kv, "hset", "item:1", "price:25"), "0");
+    CHECK_EQ(run(kv, "idx.query", "price", "0,15"), "");
+    CHECK_EQ(run(kv, "idx.query", "price", "-inf,+inf"), "item:2,item:1,item:3");
+
+    // A value that is not a number leaves the index; a number brings it back
+    CHECK_EQ(run(kv, "hset", "item:2", "price:n/a"), "0");
+    CHECK_EQ(run(kv, "idx.query", "price", "-inf,+inf"), "item:1,item:3");
+    CHECK_EQ(run(kv, "hset", "item:2", "price:5"), "0");
+    CHECK_EQ(run(kv, "idx.query", "price", "-inf,+inf"), "item:2,item:1,item:3");
+
+    // HDEL of the field, HDEL of another field, DEL of the key
+    CHECK_EQ(run(kv, "hset", "item:3", "name:y"), "1");
+    CHECK_EQ(run(kv, "hdel", "item:3", "name"), "1");
+    CHECK_EQ(run(kv, "idx.query", "price", "30,30"), "item:3");
+    CHECK_EQ(run(kv, "hdel", "item:3", "price"), "1");
+    CHECK_EQ(run(kv, "idx.query", "price", "30,30"), "");
+    CHECK_EQ(run(kv, "del", "item:1"), "1");
+    CHECK_EQ(run(kv, "idx.query", "price", "-inf,+inf"), "item:2");
+
+    // A key recreated after DEL is indexed afresh
+    CHECK_EQ(run(kv, "hset", "item:1", "price:1"), "1");
+    CHECK_EQ(run(kv, "idx.query", "price", "-inf,+inf"), "item:1,item:2");
+}
+
+void test_tag_index_and_expiry() {
+    KVStore kv;
+    CHECK_EQ(run(kv, "idx.create", "color", "car:,color,TAG"), "OK");
+    CHECK_EQ(run(kv, "hset", "car:a", "color:red"), "1");
+    CHECK_EQ(run(kv, "hset", "car:b", "color:red"), "1");
+    CHECK_EQ(run(kv, "hset", "car:c", "color:blue"), "1");
+    CHECK_EQ(sorted(run(kv, "idx.query", "color", "red")), "car:a,car:b");
+
+    CHECK_EQ(run(kv, "hset", "car:b", "color:blue"), "0");
+    CHECK_EQ(run(kv, "idx.query", "color", "red"), "car:a");
+    CHECK_EQ(sorted(run(kv, "idx.query", "color", "blue")), "car:b,car:c");
+    CHECK_EQ(run(kv, "idx.query", "color", "Red"), "");
+
+    // An expired key stops matching before anything removes it
+    CHECK_EQ(run(kv, "expire", "car:c", "0"), "1");
+    CHECK_EQ(run(kv, "idx.query", "color", "blue"), "car:b");
+    CHECK_EQ(run(kv, "del", "car:c"), "1");
+    CHECK_EQ(run(kv, "hset", "car:c", "color:blue"), "1");
+    CHECK_EQ(sorted(run(kv, "idx.query", "color", "blue")), "car:b,car:c");
+}
+
+// IDX.CREATE indexes the hashes already there; IDX.DROP leaves them alone
+void test_backfill_and_drop() {
+    KVStore kv;
+    CHECK_EQ(run(kv, "hset", "u:1", "age:30"), "1");
+    CHECK_EQ(run(kv, "hset", "u:2", "age:40"), "1");
+    CHECK_EQ(run(kv, "hset", "u", "age:50"), "1");       // shorter than the prefix
+    CHECK_EQ(run(kv, "hset", "v:1", "age:35"), "1");
+    CHECK_EQ(run(kv, "idx.create", "age", "u:,age,NUMERIC"), "OK");
+    CHECK_EQ(run(kv, "idx.create", "age", "u:,age,NUMERIC"), "FAILED ERROR: Index already exists");
+    CHECK_EQ(run(kv, "idx.query", "age", "-inf,+inf"), "u:1,u:2");
+
+    // Two indexes over the same field with different prefixes
+    CHECK_EQ(run(kv, "idx.create", "all", ",age,NUMERIC"), "OK");
+    CHECK_EQ(run(kv, "idx.query", "all", "-inf,+inf"), "u:1,v:1,u:2,u");
+    CHECK_EQ(run(kv, "hdel", "u:1", "age"), "1");
+    CHECK_EQ(run(kv, "idx.query", "age", "-inf,+inf"), "u:2");
+    CHECK_EQ(run(kv, "idx.query", "all", "-inf,+inf"), "v:1,u:2,u");
+
+    CHECK_EQ(run(kv, "idx.drop", "age"), "OK");
+    CHECK_EQ(run(kv, "idx.query", "age", "-inf,+inf"), "FAILED ERROR: Unknown index name");
+    CHECK_EQ(run(kv, "hget", "u:2", "age"), "40");
+}
+
+// HashIndex on its own: update() with the same value twice, then removal
+void test_update_is_idempotent() {
+    HashIndex index("k", "f", HashIndex::Kind::Numeric);
+    std::string one = "1", two = "2";
+    index.update("k1", &one);
+    index.update("k1", &one);
+    index.update("k2", &two);
+    CHECK_EQ(index.size(), size_t(2));
+    std::vector<std::string> out;
+    index.range(-1e9, false, 1e9, false, 0, out);
+    CHECK_EQ(out.size(), size_t(2));
+    index.update("k1", nullptr);
+    index.update("k1", nullptr);
+    CHECK_EQ(index.size(), size_t(1));
+    out.clear();
+    index.range(-1e9, false, 1e9, false, 0, out);
+    CHECK(out == std::vector<std::string>{"k2"});
+}
+
+}  // namespace
+
+int main() {
+    test_numeric_index_follows_writes();
+    test_tag_index_and_expiry();
+    test_backfill_and_drop();
+    test_update_is_idempotent();
+    return check_exit_code("hash_index_test");
+}
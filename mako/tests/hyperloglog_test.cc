@@ -0,0 +1,138 @@
+#include "check.h"
+#include "hyperloglog.h"
+
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+
+// HyperLogLog: the sparse to dense conversion keeps every register, the
+// estimate stays within a few standard errors on both encodings, and merges
+// (PFMERGE, multi-key PFCOUNT) equal a sketch fed the union.
+
+namespace {
+
+std::vector<uint8_t> registers_of(const HyperLogLog& h) {
+    std::vector<uint8_t> regs(HyperLogLog::kRegisters, 0);
+    h.merge_into(regs.data());
+    return regs;
+}
+
+bool within(uint64_t estimate, uint64_t actual, double tolerance) {
+    double error = std::fabs(static_cast<double>(estimate) - static_cast<double>(actual)) / actual;
+    if (error > tolerance) {
+        std::cerr << "estimate " << estimate << " for " << actual << " is off by " << error * 100 << "%\n";
+        return false;
+    }
+    return true;
+}
+
+// The element that converts the sketch changes at most one register; all the
+// others carry over, and the cached estimate follows the registers
+void test_sparse_to_dense() {
+    HyperLogLog h;
+    CHECK(h.is_sparse());
+    CHECK_EQ(h.count(), uint64_t(0));
+
+    size_t n = 0;
+    std::vector<uint8_t> before;
+    while (h.is_sparse()) {
+        before = registers_of(h);
+        CHECK_EQ(h.count(), HyperLogLog::estimate(before.data()));
+        h.add("e" + std::to_string(n++));
+        CHECK(n < 10000);
+    }
+    std::vector<uint8_t> after = registers_of(h);
+    size_t changed = 0;
+    bool kept = true;
+    for (size_t i = 0; i < HyperLogLog::kRegisters; i++) {
+        kept = kept && after[i] >= before[i];
+        changed += after[i] != before[i];
+    }
+    CHECK(kept);
+    CHECK(changed <= 1);
+    CHECK(h.memory_bytes() >= HyperLogLog::kDenseBytes);
+    CHECK_EQ(h.count(), HyperLogLog::estimate(after.data()));
+    CHECK(within(h.count(), n, 0.03));
+
+    // Re-adding seen elements changes nothing in either encoding
+    for (size_t i = 0; i < n; i++) {
+        CHECK(!h.add("e" + std::to_string(i)));
+    }
+    CHECK(registers_of(h) == after);
+}
+
+// 0.81% standard error; allow four of them
+void test_accuracy() {
+    const size_t sizes[] = {10, 100, 1000, 20000, 200000};
+    for (size_t size : sizes) {
+        HyperLogLog h;
+        for (size_t i = 0; i < size; i++) {
+            h.add("member:" + std::to_string(i * 7919));
+        }
+        CHECK(within(h.count(), size, size <= 100 ? 0.02 : 0.0324));
+    }
+}
+
+void test_assign_and_max_registers() {
+    std::mt19937 rng(80);
+    std::vector<uint8_t> a(HyperLogLog::kRegisters), b(HyperLogLog::kRegisters);
+    for (size_t i = 0; i < a.size(); i++) {
+        a[i] = static_cast<uint8_t>(rng() % (HyperLogLog::kMaxRank + 1));
+        b[i] = static_cast<uint8_t>(rng() % (HyperLogLog::kMaxRank + 1));
+    }
+    std::vector<uint8_t> expected(a.size());
+    for (size_t i = 0; i < a.size(); i++) {
+        expected[i] = std::max(a[i], b[i]);
+    }
+    std::vector<uint8_t> merged = a;
+    HyperLogLog::max_registers(merged.data(), b.data());
+    CHECK(merged == expected);
+
+    // Every 6-bit value survives the dense packing
+    HyperLogLog h;
+    h.assign_registers(merged.data());
+    CHECK(!h.is_sparse());
+    CHECK(registers_of(h) == merged);
+    CHECK_EQ(h.count(), HyperLogLog::estimate(merged.data()));
+}
+
+// PFMERGE of sparse and dense sketches equals one sketch fed every element
+void test_merge() {
+    KVStore kv;
+    HyperLogLog all;
+    std::string small, large;
+    for (int i = 0; i < 50; i++) {
+        small += (i ? "," : "") + std::to_string(i);
+        all.add(std::to_string(i));
+    }
+    for (int i = 25; i < 30000; i++) {
+        large += (i > 25 ? "," : "") + std::to_string(i);
+        all.add(std::to_string(i));
+    }
+    CHECK_EQ(run(kv, "pfadd", "small", small), "1");
+    CHECK_EQ(run(kv, "pfadd", "large", large), "1");
+    CHECK_EQ(run(kv, "pfadd", "small", "0,1,2"), "0");
+
+    const std::string expected = std::to_string(all.count());
+    CHECK_EQ(run(kv, "pfcount", "small", "large"), expected);
+    CHECK_EQ(run(kv, "pfmerge", "dest", "small,large"), "OK");
+    CHECK_EQ(run(kv, "pfcount", "dest"), expected);
+    // Merging again, or into a source, adds nothing new
+    CHECK_EQ(run(kv, "pfmerge", "dest", "small"), "OK");
+    CHECK_EQ(run(kv, "pfcount", "dest"), expected);
+    CHECK_EQ(run(kv, "pfmerge", "small", "large"), "OK");
+    CHECK_EQ(run(kv, "pfcount", "small"), expected);
+    CHECK_EQ(run(kv, "pfcount", "missing"), "0");
+}
+
+}  // namespace
+
+int main() {
+    test_sparse_to_dense();
+    test_accuracy();
+    test_assign_and_max_registers();
+    test_merge();
+    return check_exit_code("hyperloglog_test");
+}
@@ -0,0 +1,168 @@
+#include "check.h"
+#include "json_doc.h"
+
+#include <random>
+#include <string>
+#include <vector>
+
+// JsonDoc::set: same-size values overwrite their bytes in place, anything
+// else is spliced and the ancestors' sizes and offset tables are patched.
+// The encoding is canonical (members sorted, children laid out in order), so
+// after every set the document must encode byte for byte like a fresh parse
+// of the expected text; a stale offset or size shows up as a difference.
+
+namespace {
+
+std::string text_of(const JsonDoc& doc, const std::string& path = "$") {
+    std::string out;
+    return doc.get(path, out) ? out : "<missing>";
+}
+
+bool encodes_as(const JsonDoc& doc, const std::string& text) {
+    JsonDoc fresh;
+    std::string error;
+    if (!fresh.parse(text, error)) {
+        std::cerr << "bad expected JSON: " << text << "\n";
+        return false;
+    }
+    if (fresh.encoding() != doc.encoding()) {
+        std::cerr << "encoding of " << text_of(doc) << " differs from a fresh parse of " << text << "\n";
+        return false;
+    }
+    return true;
+}
+
+JsonDoc parsed(const std::string& text) {
+    JsonDoc doc;
+    std::string error;
+    CHECK(doc.parse(text, error));
+    return doc;
+}
+
+struct Case {
+    const char* path;
+    const char* value;
+    JsonDoc::SetResult result;
+    const char* expected;
+};
+
+void run_cases(const char* start, const std::vector<Case>& cases) {
+    JsonDoc doc = parsed(start);
+    for (const Case& c : cases) {
+        std::string error;
+        size_t before = doc.encoding().size();
+        JsonDoc::SetResult r = doc.set(c.path, c.value, error);
+        CHECK(r == c.result);
+        if (r == JsonDoc::SetResult::InPlace) {
+            CHECK_EQ(doc.encoding().size(), before);
+        }
+        CHECK_EQ(text_of(doc), std::string(c.expected));
+        CHECK(encodes_as(doc, c.expected));
+    }
+}
+
+const JsonDoc::SetResult kInPlace = JsonDoc::SetResult::InPlace;
+const JsonDoc::SetResult kSpliced = JsonDoc::SetResult::Spliced;
+
+void test_in_place() {
+    run_cases(R"({"a":1,"b":[true,"xy",2.5],"c":{"d":null}})", {
+        {"$.a", "42", kInPlace, R"({"a":42,"b":[true,"xy",2.5],"c":{"d":null}})"},
+        {"$.a", "0.5", kInPlace, R"({"a":0.5,"b":[true,"xy",2.5],"c":{"d":null}})"},
+        {"$.b[0]", "false", kInPlace, R"({"a":0.5,"b":[false,"xy",2.5],"c":{"d":null}})"},
+        {"$.b[1]", "\"zw\"", kInPlace, R"({"a":0.5,"b":[false,"zw",2.5],"c":{"d":null}})"},
+        {"$.c.d", "true", kInPlace, R"({"a":0.5,"b":[false,"zw",2.5],"c":{"d":true}})"},
+        {"$.b[-1]", "-7", kInPlace, R"({"a":0.5,"b":[false,"zw",-7],"c":{"d":true}})"},
+    });
+}
+
+// Growing and shrinking nodes with siblings before and after them, at every
+// depth, so each ancestor's size and the offsets past the child must move
+void test_spliced() {
+    run_cases(R"({"a":1,"b":[true,"xy",{"e":[1,2],"f":"g"},3],"c":{"d":null}})", {
+        {"$.b[1]", "\"a longer string\"", kSpliced,
+         R"({"a":1,"b":[true,"a longer string",{"e":[1,2],"f":"g"},3],"c":{"d":null}})"},
+        {"$.b[2].e", "[]", kSpliced,
+         R"({"a":1,"b":[true,"a longer string",{"e":[],"f":"g"},3],"c":{"d":null}})"},
+        {"$.b[2].e", "[[1,[2,[3]]],{\"x\":\"y\"}]", kSpliced,
+         R"({"a":1,"b":[true,"a longer string",{"e":[[1,[2,[3]]],{"x":"y"}],"f":"g"},3],"c":{"d":null}})"},
+        {"$.a", "\"one\"", kSpliced,
+         R"({"a":"one","b":[true,"a longer string",{"e":[[1,[2,[3]]],{"x":"y"}],"f":"g"},3],"c":{"d":null}})"},
+        {"$.c.d", "{}", kSpliced,
+         R"({"a":"one","b":[true,"a longer string",{"e":[[1,[2,[3]]],{"x":"y"}],"f":"g"},3],"c":{"d":{}}})"},
+        {"$.b", "null", kSpliced, R"({"a":"one","b":null,"c":{"d":{}}})"},
+        {"$", "[1]", kSpliced, R"([1])"},
+    });
+}
+
+// New members go in key order: first, middle and last of the object
+void test_new_members() {
+    run_cases(R"({"m":{"c":1,"k":[2]}})", {
+        {"$.m.a", "\"first\"", kSpliced, R"({"m":{"a":"first","c":1,"k":[2]}})"},
+        {"$.m.e", "[3,4]", kSpliced, R"({"m":{"a":"first","c":1,"e":[3,4],"k":[2]}})"},
+        {"$.m.z", "{}", kSpliced, R"({"m":{"a":"first","c":1,"e":[3,4],"k":[2],"z":{}}})"},
+        {"$.m.z.q", "true", kSpliced, R"({"m":{"a":"first","c":1,"e":[3,4],"k":[2],"z":{"q":true}}})"},
+        {"$.n", "0", kSpliced, R"({"m":{"a":"first","c":1,"e":[3,4],"k":[2],"z":{"q":true}},"n":0})"},
+    });
+
+    JsonDoc doc = parsed(R"({"a":[1]})");
+    std::string error;
+    CHECK(doc.set("$.a[1]", "2", error) == JsonDoc::SetResult::NotFound);
+    CHECK(doc.set("$.x.y", "2", error) == JsonDoc::SetResult::NotFound);
+    CHECK(doc.set("$.a", "[1", error) == JsonDoc::SetResult::BadJson);
+    CHECK(encodes_as(doc, R"({"a":[1]})"));
+}
+
+// Random strings of random lengths into the leaves of a fixed shape, so most
+// sets splice by a different delta and some land in place
+void test_random_leaves() {
+    std::mt19937 rng(86);
+    const char* paths[] = {"$.k0.arr[0]", "$.k0.arr[1]", "$.k0.arr[2]", "$.k0.s",
+                           "$.k1[0]", "$.k1[1].x", "$.k2"};
+    std::vector<std::string> leaves(7, "\"\"");
+    auto render = [&]() {
+        return "{\"k0\":{\"arr\":[" + leaves[0] + "," + leaves[1] + "," + leaves[2] + "],\"s\":" + leaves[3] +
+               "},\"k1\":[" + leaves[4] + ",{\"x\":" + leaves[5] + "}],\"k2\":" + leaves[6] + "}";
+    };
+    JsonDoc doc = parsed(render());
+    bool all_match = true;
+    size_t in_place = 0;
+    for (int i = 0; i < 2000 && all_match; i++) {
+        size_t leaf = rng() % 7;
+        std::string value;
+        switch (rng() % 3) {
+        case 0: value = "\"" + std::string(rng() % 40, 'a' + static_cast<char>(rng() % 26)) + "\""; break;
+        case 1: value = std::to_string(static_cast<int>(rng() % 1000)); break;
+        case 2: value = "[" + std::to_string(rng() % 10) + ",{\"n\":\"" + std::string(rng() % 5, 'q') + "\"}]"; break;
+        }
+        std::string error;
+        JsonDoc::SetResult r = doc.set(paths[leaf], value, error);
+        in_place += r == JsonDoc::SetResult::InPlace;
+        leaves[leaf] = value;
+        all_match = (r == JsonDoc::SetResult::InPlace || r == JsonDoc::SetResult::Spliced) &&
+                    text_of(doc) == render() && encodes_as(doc, render());
+    }
+    CHECK(all_match);
+    CHECK(in_place > 0);
+}
+
+// JSON.SET / JSON.GET through the engine
+void test_engine_commands() {
+    KVStore kv;
+    CHECK_EQ(run(kv, "json.set", "j", "$,{\"a\":[1,2],\"b\":\"c\"}"), "OK");
+    CHECK_EQ(run(kv, "json.set", "j", "$.a[0],{\"x\":1,\"y\":[3]}"), "OK");
+    CHECK_EQ(run(kv, "json.set", "j", "$.b,\"d\""), "OK");
+    CHECK_EQ(run(kv, "json.get", "j", "$.a[0].y"), "[3]");
+    CHECK_EQ(run(kv, "json.get", "j"), "{\"a\":[{\"x\":1,\"y\":[3]},2],\"b\":\"d\"}");
+    CHECK_EQ(run(kv, "json.set", "j", "$.a[5],1"), "");
+}
+
+}  // namespace
+
+int main() {
+    test_in_place();
+    test_spliced();
+    test_new_members();
+    test_random_leaves();
+    test_engine_commands();
+    return check_exit_code("json_test");
+}
@@ -0,0 +1,116 @@
+#include "check.h"
+#include "kv_store.h"
+
+#include <cstdlib>
+#include <string>
+
+// EXPORT then IMPORT: every string, hash, list and set comes back with its
+// TTL, into an empty keyspace and over keys that are already there,
+// expired ones included; and EXPORT refusing keys it cannot dump.
+
+namespace {
+
+bool starts_with(const std::string& s, const std::string& prefix) {
+    return s.compare(0, prefix.size(), prefix) == 0;
+}
+
+void fill(KVStore& kv) {
+    run(kv, "set", "s:plain", "hello");
+    run(kv, "set", "s:empty", "");
+    run(kv, "set", "s:ttl", "expiring");
+    run(kv, "expire", "s:ttl", "1000");
+    run(kv, "hset", "h:one", "name:mako");
+    run(kv, "hset", "h:one", "kind:store");
+    run(kv, "rpush", "l:one", "a,b,c");
+    run(kv, "sadd", "z:one", "x,y");
+}
+
+void check_filled(KVStore& kv) {
+    CHECK_EQ(run(kv, "get", "s:plain"), "hello");
+    CHECK_EQ(run(kv, "get", "s:empty"), "");
+    CHECK_EQ(run(kv, "get", "s:ttl"), "expiring");
+    std::string ttl = run(kv, "ttl", "s:ttl");
+    CHECK(ttl == "1000" || ttl == "999");
+    CHECK_EQ(run(kv, "ttl", "s:plain"), "-1");
+    CHECK_EQ(run(kv, "hget", "h:one", "name"), "mako");
+    CHECK_EQ(run(kv, "hget", "h:one", "kind"), "store");
+    CHECK_EQ(run(kv, "lrange", "l:one", "0,-1"), "a,b,c");
+    CHECK_EQ(run(kv, "scard", "z:one"), "2");
+    CHECK_EQ(run(kv, "sismember", "z:one", "x"), "1");
+    CHECK_EQ(run(kv, "sismember", "z:one", "y"), "1");
+}
+
+}  // namespace
+
+int main() {
+    char dir_template[] = "/tmp/mako_dump_test.XXXXXX";
+    const char* dir = mkdtemp(dir_template);
+    CHECK(dir != nullptr);
+    if (dir == nullptr) {
+        return check_exit_code("keyspace_dump_test");
+    }
+
+    KVStore source;
+    fill(source);
+    std::string exported = run(source, "export", dir, "THREADS,2");
+    CHECK(starts_with(exported, "keys:6,"));
+
+    // Into an empty keyspace
+    KVStore fresh;
+    std::string imported = run(fresh, "import", dir);
+    CHECK(starts_with(imported, "keys:6,strings:3,hashes:1,lists:1,sets:1,expiring:1,"));
+    check_filled(fresh);
+
+    // Over live keys, which the dump replaces whatever their type
+    KVStore live;
+    run(live, "set", "s:plain", "old");
+    run(live, "expire", "s:plain", "50");
+    run(live, "sadd", "h:one", "member");
+    run(live, "set", "other", "kept");
+    imported = run(live, "import", dir);
+    CHECK(starts_with(imported, "keys:6,"));
+    check_filled(live);
+    CHECK_EQ(run(live, "get", "other"), "kept");
+
+    // Over expired keys the maps still hold: they go too, and the imported
+    // keys count and are visible
+    KVStore stale;
+    run(stale, "set", "s:plain", "old");
+    run(stale, "hset", "s:empty", "f:v");
+    run(stale, "rpush", "l:one", "z");
+    run(stale, "set", "other", "kept");
+    run(stale, "expire", "s:plain", "0");
+    run(stale, "expire", "s:empty", "0");
+    run(stale, "expire", "l:one", "0");
+    CHECK_EQ(run(stale, "exists", "s:plain"), "0");
+    imported = run(stale, "import", dir);
+    CHECK(starts_with(imported, "keys:6,strings:3,hashes:1,lists:1,sets:1,expiring:1,"));
+    check_filled(stale);
+    CHECK_EQ(run(stale, "exists", "s:empty"), "1");
+    CHECK_EQ(run(stale, "get", "other"), "kept");
+
+    // Keys EXPORT cannot dump fail it, and leave the last dump in place,
+    // unless PARTIAL says to go ahead without them
+    KVStore mixed;
+    fill(mixed);
+    run(mixed, "set", "s:plain", "newer");
+    run(mixed, "pfadd", "hll:one", "a,b");
+    run(mixed, "xadd", "x:one", "*,f:v");
+    std::string refused = run(mixed, "export", dir, "THREADS,2");
+    CHECK(starts_with(refused, "FAILED ERROR: 2 keys are of types EXPORT cannot dump"));
+    KVStore unchanged;
+    run(unchanged, "import", dir);
+    CHECK_EQ(run(unchanged, "get", "s:plain"), "hello");
+
+    exported = run(mixed, "export", dir, "partial,THREADS,2");
+    CHECK(starts_with(exported, "keys:6,"));
+    CHECK(exported.find(",skipped:2,") != std::string::npos);
+    KVStore without;
+    CHECK(starts_with(run(without, "import", dir), "keys:6,"));
+    CHECK_EQ(run(without, "get", "s:plain"), "newer");
+    CHECK_EQ(run(without, "exists", "hll:one"), "0");
+    CHECK_EQ(run(mixed, "export", dir, "THREADS"), "FAILED ERROR: EXPORT takes dir [THREADS n] [PARTIAL]");
+
+    std::system(("rm -rf '" + std::string(dir) + "'").c_str());
+    return check_exit_code("keyspace_dump_test");
+}
@@ -0,0 +1,126 @@
+#include "check.h"
+#include "kv_store.h"
+#include "pubsub.h"
+
+#include <string>
+#include <vector>
+
+// Subscriptions, delivery and the per-subscriber queue limit
+
+namespace {
+
+std::string pop(PubSub& ps, uint64_t client) {
+    PubSub::Message message;
+    return ps.pop_message(client, message) ? *message : "";
+}
+
+void test_delivery() {
+    PubSub ps;
+    CHECK_EQ(ps.subscribe(1, "news"), 1u);
+    CHECK_EQ(ps.psubscribe(1, "n*"), 2u);
+    CHECK_EQ(ps.subscribe(2, "news"), 1u);
+    CHECK_EQ(ps.publish("news", "hi"), 3u);
+    CHECK_EQ(ps.publish("other", "x"), 0u);
+    CHECK_EQ(pop(ps, 1), "*3\r\n$7\r\nmessage\r\n$4\r\nnews\r\n$2\r\nhi\r\n");
+    CHECK_EQ(pop(ps, 1), "*4\r\n$8\r\npmessage\r\n$2\r\nn*\r\n$4\r\nnews\r\n$2\r\nhi\r\n");
+    CHECK_EQ(pop(ps, 1), "");
+    CHECK_EQ(ps.pending(2), 1u);
+}
+
+// UNSUBSCRIBE / PUNSUBSCRIBE with no channels drop all of them
+void test_unsubscribe_all() {
+    KVStore kv;
+    CHECK_EQ(kv.subscribe(7, "a,b,c").value, "3");
+    CHECK_EQ(kv.psubscribe(7, "x*,y*").value, "5");
+    CHECK_EQ(kv.unsubscribe(7, "").value, "2");
+    CHECK_EQ(kv.pubsub().numsub("a"), 0u);
+    CHECK_EQ(kv.pubsub().numsub("c"), 0u);
+    CHECK_EQ(kv.pubsub().publish("b", "m"), 0u);
+    CHECK_EQ(kv.pubsub().publish("xy", "m"), 1u);
+    CHECK_EQ(kv.punsubscribe(7, "").value, "0");
+    CHECK_EQ(kv.pubsub().numpat(), 0u);
+    CHECK_EQ(kv.pubsub().publish("xy", "m"), 0u);
+
+    // And again once there is nothing left, or for a client never seen
+    CHECK_EQ(kv.unsubscribe(7, "").value, "0");
+    CHECK_EQ(kv.punsubscribe(8, "").value, "0");
+}
+
+// A subscriber that never drains is cut off at kMaxQueuedBytes: its backlog
+// goes, it gets nothing more and is flagged for disconnection; one that keeps
+// up is not affected
+void test_queue_limit() {
+    PubSub ps;
+    ps.subscribe(1, "c");
+    ps.subscribe(2, "c");
+    std::string payload(64 * 1024, 'p');
+    CHECK_EQ(ps.publish("c", payload), 2u);
+    PubSub::Message first;
+    CHECK(ps.pop_message(2, first));
+    size_t frame = first->size();
+    size_t fits = PubSub::kMaxQueuedBytes / frame;
+
+    for (size_t i = 1; i < fits; i++) {
+        CHECK_EQ(ps.publish("c", payload), 2u);
+        pop(ps, 2);
+    }
+    CHECK(!ps.overflowed(1));
+    CHECK_EQ(ps.pending(1), fits);
+
+    CHECK_EQ(ps.publish("c", payload), 1u);
+    CHECK(ps.overflowed(1));
+    CHECK(!ps.overflowed(2));
+    CHECK_EQ(ps.pending(1), 0u);
+    CHECK_EQ(pop(ps, 1), "");
+    CHECK_EQ(ps.publish("c", payload), 1u);
+    CHECK_EQ(ps.pending(1), 0u);
+
+    // Closing the connection clears the flag along with the subscriptions
+    ps.remove_client(1);
+    CHECK(!ps.overflowed(1));
+    CHECK_EQ(ps.numsub("c"), 1u);
+}
+
+// The connection layer is woken once per empty-to-non-empty queue and on
+// overflow, not for every message
+void test_notify() {
+    PubSub ps;
+    std::vector<uint64_t> woken;
+    ps.set_notify([&](uint64_t client) { woken.push_back(client); });
+    ps.subscribe(1, "c");
+    ps.psubscribe(2, "*");
+    ps.publish("c", "a");
+    ps.publish("c", "b");
+    CHECK_EQ(woken.size(), 2u);
+    CHECK_EQ(woken[0], 1u);
+    CHECK_EQ(woken[1], 2u);
+
+    pop(ps, 1);
+    ps.publish("c", "c");
+    CHECK_EQ(woken.size(), 2u);
+    pop(ps, 1);
+    pop(ps, 1);
+    ps.publish("d", "d");
+    ps.publish("c", "e");
+    CHECK_EQ(woken.size(), 3u);
+    CHECK_EQ(woken[2], 1u);
+
+    std::string payload(1 << 20, 'p');
+    while (!ps.overflowed(2)) {
+        ps.publish("d", payload);
+    }
+    CHECK_EQ(woken.size(), 4u);
+    CHECK_EQ(woken[3], 2u);
+    ps.publish("d", payload);
+    CHECK_EQ(woken.size(), 4u);
+}
+
+}  // namespace
+
+int main() {
+    test_delivery();
+    test_unsubscribe_all();
+    test_queue_limit();
+    test_notify();
+    return check_exit_code("pubsub_test");
+}
@@ -0,0 +1,137 @@
+#include "check.h"
+#include "read_replicas.h"
+
+#include <string>
+#include <thread>
+#include <vector>
+
+// Read replicas: a worker's copy of a hot key is served only while the key's
+// write version has not moved, so every kind of write to the key, including
+// clear() bumping every version at once, makes the next read miss.
+
+namespace {
+
+std::string replica(ReadReplicas& replicas, const std::string& key) {
+    std::string value;
+    return replicas.lookup(key, value) ? value : "<miss>";
+}
+
+void test_copy_follows_version() {
+    KeyVersions versions;
+    ReadReplicas replicas(versions);
+    replicas.publish({"hot"});
+
+    CHECK_EQ(replica(replicas, "hot"), "<miss>");
+    replicas.fill("hot", "v1");
+    CHECK_EQ(replica(replicas, "hot"), "v1");
+    CHECK_EQ(replica(replicas, "hot"), "v1");
+
+    versions.bump("hot");
+    CHECK_EQ(replica(replicas, "hot"), "<miss>");
+    // The stale copy is gone, not just skipped
+    CHECK_EQ(replica(replicas, "hot"), "<miss>");
+    replicas.fill("hot", "v2");
+    CHECK_EQ(replica(replicas, "hot"), "v2");
+
+    versions.bump_all();
+    CHECK_EQ(replica(replicas, "hot"), "<miss>");
+
+    CHECK_EQ(replicas.hits(), uint64_t(3));
+    CHECK_EQ(replicas.misses(), uint64_t(4));
+}
+
+// Only hot keys and values up to kMaxValueBytes get copies, and a key that
+// leaves the hot set drops its copy
+void test_what_is_copied() {
+    KeyVersions versions;
+    ReadReplicas replicas(versions);
+    replicas.publish({"hot", "big"});
+
+    replicas.fill("cold", "v");
+    CHECK_EQ(replica(replicas, "cold"), "<miss>");
+    replicas.fill("big", std::string(ReadReplicas::kMaxValueBytes + 1, 'x'));
+    CHECK_EQ(replica(replicas, "big"), "<miss>");
+
+    replicas.fill("hot", "v");
+    CHECK_EQ(replica(replicas, "hot"), "v");
+    replicas.publish({"big"});
+    CHECK_EQ(replica(replicas, "hot"), "<miss>");
+    replicas.publish({"hot", "big"});
+    CHECK_EQ(replica(replicas, "hot"), "<miss>");
+}
+
+// Copies are per worker: another thread fills and checks its own
+void test_copies_are_per_thread() {
+    KeyVersions versions;
+    ReadReplicas replicas(versions);
+    replicas.publish({"hot"});
+    replicas.fill("hot", "main");
+
+    std::string seen_before, seen_after;
+    std::thread other([&]() {
+        seen_before = replica(replicas, "hot");
+        replicas.fill("hot", "other");
+        seen_after = replica(replicas, "hot");
+    });
+    other.join();
+    CHECK_EQ(seen_before, "<miss>");
+    CHECK_EQ(seen_after, "other");
+    CHECK_EQ(replica(replicas, "hot"), "main");
+}
+
+// Through the engine: fill as the wrapper does after a GET, write, read again
+void test_engine_writes_invalidate() {
+    const std::vector<std::pair<std::string, std::string>> writes = {
+        {"set", "v2"}, {"append", "x"}, {"setrange", "0,y"}, {"incr", ""}, {"del", ""},
+        {"expire", "100"}, {"setbit", "3,1"},
+    };
+    for (const auto& w : writes) {
+        KVStore kv;
+        kv.replicas().publish({"k"});
+        CHECK_EQ(run(kv, "set", "k", "1"), "OK");
+        kv.fill_replica("k", "1");
+        std::string value;
+        CHECK(kv.read_replica("k", value));
+        CHECK(run(kv, w.first, "k", w.second).compare(0, 6, "FAILED") != 0);
+        if (kv.read_replica("k", value)) {
+            std::cerr << w.first << " left the replica of k current\n";
+            CHECK(false);
+        }
+    }
+
+    // clear() bumps every key's version at once
+    {
+        KVStore kv;
+        kv.replicas().publish({"k"});
+        CHECK_EQ(run(kv, "set", "k", "1"), "OK");
+        kv.fill_replica("k", "1");
+        kv.clear();
+        std::string value;
+        CHECK(!kv.read_replica("k", value));
+    }
+
+    // Writes from inside a script
+    KVStore kv;
+    kv.replicas().publish({"k"});
+    std::string sha = run(kv, "script.load", "", "k1 a1 'set' call2");
+    CHECK_EQ(run(kv, "set", "k", "1"), "OK");
+    kv.fill_replica("k", "1");
+    CHECK_EQ(run(kv, "evalsha", sha, "1,k,2"), "OK");
+    std::string value;
+    CHECK(!kv.read_replica("k", value));
+
+    // Keys with a TTL are never copied
+    CHECK_EQ(run(kv, "expire", "k", "100"), "1");
+    kv.fill_replica("k", "2");
+    CHECK(!kv.read_replica("k", value));
+}
+
+}  // namespace
+
+int main() {
+    test_copy_follows_version();
+    test_what_is_copied();
+    test_copies_are_per_thread();
+    test_engine_writes_invalidate();
+    return check_exit_code("read_replicas_test");
+}
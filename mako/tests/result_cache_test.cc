@@ -0,0 +1,136 @@
+#include "check.h"
+
+#include <string>
+
+// Result cache: an entry is served only while the versions of every key the
+// read depends on are the ones stamped before it ran, so any write to either
+// key of SINTER / SDIFF, the blocking pops, clear(), or a write that lands
+// between the read and storing its reply all keep a stale reply out.
+
+namespace {
+
+// What the wrapper does for a cacheable read: a lock-free lookup, otherwise
+// stamp, run and store. Hits come back prefixed with "hit ".
+std::string read(KVStore& kv, const std::string& op, const std::string& key, const std::string& value = "") {
+    std::string reply;
+    if (kv.cached_read(op, key, value, reply)) {
+        return "hit " + reply;
+    }
+    ResultCache::Stamp stamp = kv.read_stamp(op, key, value);
+    KVStore::Result r = kv.execute_operation(op, key, value);
+    kv.cache_read(op, key, value, stamp, r);
+    return r.value;
+}
+
+std::string stat(KVStore& kv, const std::string& name) {
+    std::string stats = run(kv, "resultcache", "") + ",";
+    size_t at = stats.find(name + ":");
+    return at == std::string::npos ? "" : stats.substr(at + name.size() + 1, stats.find(',', at) - at - name.size() - 1);
+}
+
+void test_writes_invalidate() {
+    KVStore kv;
+    CHECK_EQ(run(kv, "resultcache", "", "ON"), "OK");
+    CHECK_EQ(run(kv, "sadd", "s", "a"), "1");
+
+    std::string first = read(kv, "smembers", "s");
+    CHECK_EQ(read(kv, "smembers", "s"), "hit " + first);
+    CHECK_EQ(run(kv, "sadd", "s", "b"), "1");
+    std::string second = read(kv, "smembers", "s");
+    CHECK(second.compare(0, 4, "hit ") != 0);
+    CHECK(second != first);
+    CHECK_EQ(read(kv, "smembers", "s"), "hit " + second);
+    CHECK_EQ(stat(kv, "stale"), "1");
+
+    // A write that changes nothing still counts as a write
+    CHECK_EQ(run(kv, "sadd", "s", "a"), "0");
+    CHECK_EQ(read(kv, "smembers", "s"), second);
+
+    // Either key of a two-key read
+    CHECK_EQ(run(kv, "sadd", "t", "a"), "1");
+    std::string inter = read(kv, "sinter", "s", "t");
+    CHECK_EQ(inter, "a");
+    CHECK_EQ(read(kv, "sinter", "s", "t"), "hit a");
+    CHECK_EQ(run(kv, "sadd", "t", "b"), "1");
+    std::string grown = read(kv, "sinter", "s", "t");
+    CHECK(grown == "a,b" || grown == "b,a");
+    CHECK_EQ(run(kv, "del", "s"), "1");
+    CHECK_EQ(read(kv, "sinter", "s", "t"), "");
+    CHECK_EQ(read(kv, "sdiff", "t", "s"), read(kv, "smembers", "t"));
+
+    // clear() bumps every version
+    CHECK_EQ(run(kv, "hset", "h", "f:1"), "1");
+    CHECK_EQ(read(kv, "hgetall", "h"), "f:1");
+    CHECK_EQ(read(kv, "hgetall", "h"), "hit f:1");
+    kv.clear();
+    CHECK_EQ(read(kv, "hgetall", "h"), "");
+}
+
+// Lists change through the blocking commands too, outside execute_operation
+void test_blocking_pops_invalidate() {
+    KVStore kv;
+    CHECK_EQ(run(kv, "resultcache", "", "ON"), "OK");
+    CHECK_EQ(run(kv, "rpush", "l", "x"), "1");
+    CHECK_EQ(run(kv, "rpush", "l", "y"), "2");
+    CHECK_EQ(read(kv, "lrange", "l", "0,-1"), "x,y");
+    CHECK_EQ(read(kv, "lrange", "l", "0,-1"), "hit x,y");
+
+    kv.blpop({"l"}, 0, [](bool, const std::string&, const std::string&) {});
+    CHECK_EQ(read(kv, "lrange", "l", "0,-1"), "y");
+    CHECK_EQ(read(kv, "lrange", "m", "0,-1"), "");
+    kv.blmove("l", "m", true, false, 0, [](bool, const std::string&, const std::string&) {});
+    CHECK_EQ(read(kv, "lrange", "l", "0,-1"), "");
+    CHECK_EQ(read(kv, "lrange", "m", "0,-1"), "y");
+}
+
+// A write between running the read and storing its reply: the reply is
+// already stale, so it is not stored
+void test_write_before_store() {
+    KVStore kv;
+    CHECK_EQ(run(kv, "resultcache", "", "ON"), "OK");
+    CHECK_EQ(run(kv, "sadd", "s", "a"), "1");
+
+    ResultCache::Stamp stamp = kv.read_stamp("smembers", "s", "");
+    KVStore::Result before = kv.execute_operation("smembers", "s", "");
+    CHECK_EQ(run(kv, "sadd", "s", "b"), "1");
+    kv.cache_read("smembers", "s", "", stamp, before);
+
+    std::string reply;
+    CHECK(!kv.cached_read("smembers", "s", "", reply));
+    CHECK_EQ(stat(kv, "entries"), "0");
+}
+
+// OFF drops every entry; the budget evicts least recently used first
+void test_off_and_budget() {
+    KVStore kv;
+    CHECK_EQ(run(kv, "resultcache", "", "ON"), "OK");
+    CHECK_EQ(run(kv, "sadd", "a", "1"), "1");
+    CHECK_EQ(run(kv, "sadd", "b", "2"), "1");
+    read(kv, "smembers", "a");
+    read(kv, "smembers", "b");
+    CHECK_EQ(stat(kv, "entries"), "2");
+
+    CHECK_EQ(run(kv, "resultcache", "", "OFF"), "OK");
+    CHECK_EQ(stat(kv, "entries"), "0");
+    CHECK_EQ(read(kv, "smembers", "a"), "1");
+    CHECK_EQ(stat(kv, "entries"), "0");
+
+    CHECK_EQ(run(kv, "resultcache", "", "ON"), "OK");
+    read(kv, "smembers", "a");
+    std::string one_entry = stat(kv, "bytes");
+    CHECK_EQ(run(kv, "resultcache", "", "BUDGET," + one_entry), "OK");
+    read(kv, "smembers", "b");
+    CHECK_EQ(stat(kv, "entries"), "1");
+    CHECK_EQ(stat(kv, "evictions"), "1");
+    CHECK_EQ(read(kv, "smembers", "b"), "hit 2");
+}
+
+}  // namespace
+
+int main() {
+    test_writes_invalidate();
+    test_blocking_pops_invalidate();
+    test_write_before_store();
+    test_off_and_budget();
+    return check_exit_code("result_cache_test");
+}
@@ -0,0 +1,131 @@
+#include "check.h"
+#include "kv_store.h"
+#include "script.h"
+
+#include <string>
+#include <vector>
+
+// Scripts: the compiled if/else/then jumps, overflow and size limits, and the
+// sandbox that keeps engine calls on keys declared in KEYS
+
+namespace {
+
+// Compiles and runs source with no engine behind it; the reply, "(nil)" or
+// "FAILED " and the error
+std::string eval(const std::string& source, const std::vector<std::string>& args = {}) {
+    std::string error;
+    std::shared_ptr<const Script> script = Script::compile(source, error);
+    if (!script) {
+        return "FAILED " + error;
+    }
+    auto call = [](const std::string&, const std::string&, const std::string&, std::string&) { return false; };
+    std::string result;
+    bool found = false;
+    if (!script->run({}, args, call, result, found, error)) {
+        return "FAILED " + error;
+    }
+    return found ? result : "(nil)";
+}
+
+// Each branch runs alone, nested ifs patch their own jumps, and whatever
+// follows then runs on both paths
+void test_if_else() {
+    CHECK_EQ(eval("1 if 'yes' else 'no' then"), "yes");
+    CHECK_EQ(eval("0 if 'yes' else 'no' then"), "no");
+    CHECK_EQ(eval("'' if 'yes' else 'no' then"), "no");
+    CHECK_EQ(eval("nil if 'yes' else 'no' then"), "no");
+    CHECK_EQ(eval("5 0 if drop 6 then"), "5");
+    CHECK_EQ(eval("5 1 if drop 6 then"), "6");
+    CHECK_EQ(eval("1 if 0 if 'a' else 'b' then else 'c' then 'd' .."), "bd");
+    CHECK_EQ(eval("0 if 1 if 'a' else 'b' then else 0 if 'c' else 'd' then then"), "d");
+    CHECK_EQ(eval("a1 3 > if 'big' else a1 0 < if 'negative' else 'small' then then", {"7"}), "big");
+    CHECK_EQ(eval("a1 3 > if 'big' else a1 0 < if 'negative' else 'small' then then", {"-2"}), "negative");
+    CHECK_EQ(eval("a1 3 > if 'big' else a1 0 < if 'negative' else 'small' then then", {"2"}), "small");
+
+    CHECK_EQ(eval("1 if 2 else 3"), "FAILED ERROR: if without then");
+    CHECK_EQ(eval("1 else 2 then"), "FAILED ERROR: else without if");
+    CHECK_EQ(eval("1 if 2 else 3 else 4 then"), "FAILED ERROR: else without if");
+    CHECK_EQ(eval("then"), "FAILED ERROR: then without if");
+}
+
+void test_overflow() {
+    CHECK_EQ(eval("9223372036854775807 1 +"), "FAILED ERROR: integer overflow");
+    CHECK_EQ(eval("-9223372036854775808 1 -"), "FAILED ERROR: integer overflow");
+    CHECK_EQ(eval("4294967296 4294967296 *"), "FAILED ERROR: integer overflow");
+    CHECK_EQ(eval("-9223372036854775808 -1 /"), "FAILED ERROR: integer overflow");
+    CHECK_EQ(eval("-9223372036854775808 -1 %"), "FAILED ERROR: integer overflow");
+    CHECK_EQ(eval("1 0 /"), "FAILED ERROR: division by zero");
+    CHECK_EQ(eval("9223372036854775806 1 +"), "9223372036854775807");
+    // Past int64 a word is not a number at all
+    CHECK_EQ(eval("9223372036854775808"), "FAILED ERROR: unknown word '9223372036854775808'");
+    CHECK_EQ(eval("a1 1 +", {"9223372036854775808"}), "FAILED ERROR: value is not an integer");
+
+    std::string deep;
+    for (size_t i = 0; i < Script::kMaxStack; i++) {
+        deep += "1 ";
+    }
+    CHECK_EQ(eval(deep), "1");
+    CHECK_EQ(eval(deep + "1"), "FAILED ERROR: stack overflow");
+    CHECK_EQ(eval("1 +"), "FAILED ERROR: stack underflow");
+
+    // Doubling a 1KB string ten times reaches kMaxString, once more passes it
+    std::string doubling = "a1";
+    for (int i = 0; i < 10; i++) {
+        doubling += " dup ..";
+    }
+    std::string kb(1024, 'x');
+    CHECK_EQ(eval(doubling, {kb}).size(), Script::kMaxString);
+    CHECK_EQ(eval(doubling + " dup ..", {kb}), "FAILED ERROR: string too long");
+}
+
+// Every key a call names, in its key or its value, must be in KEYS
+void test_sandbox() {
+    KVStore kv;
+    run(kv, "sadd", "a", "1,2");
+    run(kv, "sadd", "secret", "2");
+    run(kv, "pfadd", "h1", "x");
+    run(kv, "pfadd", "hidden", "y");
+    run(kv, "set", "s1", "a");
+    run(kv, "set", "private", "b");
+
+    auto evalsha = [&](const std::string& source, const std::string& args) {
+        std::string sha = run(kv, "script.load", "", source);
+        return run(kv, "evalsha", sha, args);
+    };
+    const std::string denied = "FAILED ERROR: key 'secret' was not declared in KEYS";
+
+    CHECK_EQ(evalsha("k1 k2 'sinter' call2", "2,a,secret"), "2");
+    CHECK_EQ(evalsha("k1 'secret' 'sinter' call2", "1,a"), denied);
+    CHECK_EQ(evalsha("k1 'secret' 'sdiff' call2", "1,a"), denied);
+    CHECK_EQ(evalsha("k1 'h1,hidden' 'pfcount' call2", "1,h1"), "FAILED ERROR: key 'hidden' was not declared in KEYS");
+    CHECK_EQ(evalsha("k1 'h1,hidden' 'pfmerge' call2", "1,h1"), "FAILED ERROR: key 'hidden' was not declared in KEYS");
+    CHECK_EQ(evalsha("k1 'AND,s1,private' 'bitop' call2", "1,s1"),
+             "FAILED ERROR: key 'private' was not declared in KEYS");
+    CHECK_EQ(evalsha("k1 'AND,s1,private' 'bitop' call2", "2,s1,private"), "1");
+    CHECK_EQ(evalsha("'secret' 'smembers' call1", "0"), denied);
+    CHECK_EQ(evalsha("k1 'secret' 'SINTER' call2", "1,a"), denied);
+    CHECK_EQ(evalsha("k1 'script.flush' call1", "1,a"), "FAILED ERROR: 'script.flush' may not be called from a script");
+    // Nor can it reach undeclared keys by pattern, index or label
+    run(kv, "hset", "user:1", "age:30");
+    run(kv, "idx.create", "ages", "user:,age,NUMERIC");
+    run(kv, "ts.create", "temp", "room=a");
+    CHECK_EQ(evalsha("'*' 'keys' call1", "0"), "FAILED ERROR: 'keys' may not be called from a script");
+    CHECK_EQ(evalsha("'user:1' 'keys' call1", "1,user:1"), "FAILED ERROR: 'keys' may not be called from a script");
+    CHECK_EQ(evalsha("k1 '0,100' 'idx.query' call2", "1,ages"),
+             "FAILED ERROR: 'idx.query' may not be called from a script");
+    CHECK_EQ(evalsha("k1 'user:,age,TAG' 'idx.create' call2", "1,tags"),
+             "FAILED ERROR: 'idx.create' may not be called from a script");
+    CHECK_EQ(evalsha("k1 '-,+' 'ts.mrange' call2", "1,room=a"),
+             "FAILED ERROR: 'ts.mrange' may not be called from a script");
+    // Nothing was written by the refused calls
+    CHECK_EQ(run(kv, "pfcount", "h1"), "1");
+}
+
+}  // namespace
+
+int main() {
+    test_if_else();
+    test_overflow();
+    test_sandbox();
+    return check_exit_code("script_test");
+}
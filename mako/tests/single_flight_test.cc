@@ -0,0 +1,175 @@
+#include "check.h"
+#include "read_replicas.h"
+#include "single_flight.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+// SingleFlight: identical reads waiting at once share one run, but a caller
+// only takes a shared reply stamped at or after the key version it saw on
+// arrival, so a read issued after a write never gets the value from before it.
+
+namespace {
+
+// Holds a run inside execute() until opened
+class Gate {
+public:
+    void wait() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        entered_ = true;
+        changed_.notify_all();
+        changed_.wait(lock, [&]() { return open_; });
+    }
+    void wait_entered() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        changed_.wait(lock, [&]() { return entered_; });
+    }
+    void open() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        open_ = true;
+        changed_.notify_all();
+    }
+
+private:
+    std::mutex mutex_;
+    std::condition_variable changed_;
+    bool entered_ = false;
+    bool open_ = false;
+};
+
+SingleFlight::Reply reply_of(const std::string& value, uint64_t version) {
+    SingleFlight::Reply r;
+    r.value = value;
+    r.success = true;
+    r.version = version;
+    return r;
+}
+
+// Callers queued behind a run share it; the run happens once
+void test_identical_reads_share_a_run() {
+    SingleFlight flight;
+    Gate gate;
+    std::atomic<int> runs{0};
+    auto execute = [&]() {
+        runs++;
+        gate.wait();
+        return reply_of("v", 1);
+    };
+
+    std::vector<std::string> seen(8);
+    std::vector<std::thread> threads;
+    threads.emplace_back([&]() { seen[0] = flight.run("get", "k", "", 1, execute)->value; });
+    gate.wait_entered();
+    for (size_t i = 1; i < seen.size(); i++) {
+        threads.emplace_back([&, i]() { seen[i] = flight.run("get", "k", "", 1, execute)->value; });
+    }
+    // Give the followers time to queue behind the run before it finishes
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    gate.open();
+    for (auto& t : threads) {
+        t.join();
+    }
+    for (const auto& v : seen) {
+        CHECK_EQ(v, "v");
+    }
+    CHECK_EQ(flight.executed() + flight.coalesced(), uint64_t(seen.size()));
+    CHECK_EQ(static_cast<uint64_t>(runs.load()), flight.executed());
+    CHECK(flight.coalesced() > 0);
+
+    // Different arguments are different reads
+    flight.reset_stats();
+    flight.run("lrange", "k", "0,1", 1, [&]() { return reply_of("a", 1); });
+    flight.run("lrange", "k", "0,2", 1, [&]() { return reply_of("b", 1); });
+    CHECK_EQ(flight.executed(), uint64_t(2));
+    CHECK_EQ(flight.coalesced(), uint64_t(0));
+}
+
+// A write lands while the shared run is in flight: a caller that arrived
+// after the write runs again instead of taking the older reply, and one that
+// arrived before it may share
+void test_reply_older_than_arrival_is_not_shared() {
+    KeyVersions versions;
+    SingleFlight flight;
+    Gate gate;
+    std::string value = "old";
+    std::mutex engine;
+
+    auto execute = [&]() {
+        std::unique_lock<std::mutex> lock(engine);
+        SingleFlight::Reply r = reply_of(value, versions.get("k"));
+        lock.unlock();
+        gate.wait();
+        return r;
+    };
+
+    std::string leader, before_write, after_write;
+    std::thread t1([&]() { leader = flight.run("get", "k", "", versions.get("k"), execute)->value; });
+    gate.wait_entered();
+    uint64_t arrived_before = versions.get("k");
+    std::thread t2([&]() { before_write = flight.run("get", "k", "", arrived_before, execute)->value; });
+
+    {
+        std::lock_guard<std::mutex> lock(engine);
+        value = "new";
+        versions.bump("k");
+    }
+    std::thread t3([&]() { after_write = flight.run("get", "k", "", versions.get("k"), execute)->value; });
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    gate.open();
+    t1.join();
+    t2.join();
+    t3.join();
+
+    CHECK_EQ(leader, "old");
+    // Arriving before the write, either answer is one the read could have seen
+    CHECK(before_write == "old" || before_write == "new");
+    CHECK_EQ(after_write, "new");
+}
+
+// A run that throws wakes its waiters, which run for themselves, and leaves
+// nothing behind for later callers
+void test_throwing_run() {
+    SingleFlight flight;
+    Gate gate;
+    std::string follower;
+    bool threw = false;
+
+    std::thread leader([&]() {
+        try {
+            flight.run("get", "k", "", 0, [&]() -> SingleFlight::Reply {
+                gate.wait();
+                throw std::runtime_error("engine failed");
+            });
+        } catch (const std::runtime_error&) {
+            threw = true;
+        }
+    });
+    gate.wait_entered();
+    std::thread waiter([&]() {
+        follower = flight.run("get", "k", "", 0, [&]() { return reply_of("own", 0); })->value;
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    gate.open();
+    leader.join();
+    waiter.join();
+
+    CHECK(threw);
+    CHECK_EQ(follower, "own");
+    CHECK_EQ(flight.run("get", "k", "", 0, [&]() { return reply_of("later", 0); })->value, "later");
+}
+
+}  // namespace
+
+int main() {
+    test_identical_reads_share_a_run();
+    test_reply_older_than_arrival_is_not_shared();
+    test_throwing_run();
+    return check_exit_code("single_flight_test");
+}
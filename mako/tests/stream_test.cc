@@ -0,0 +1,188 @@
+#include "check.h"
+#include "stream.h"
+
+#include <algorithm>
+#include <random>
+#include <string>
+#include <vector>
+
+// Streams: IDs only ever grow, ranges read across packed nodes match a plain
+// vector of the same entries in both directions, and XTRIM by MAXLEN or
+// MINID removes exactly the oldest entries, mid-node or whole nodes at once.
+
+namespace {
+
+std::string describe(const std::vector<Stream::Entry>& entries) {
+    std::string out;
+    for (const auto& e : entries) {
+        out += e.id.to_string();
+        for (const auto& f : e.fields) {
+            out += "," + f.first + "=" + f.second;
+        }
+        out += ";";
+    }
+    return out;
+}
+
+std::vector<Stream::Entry> all_of(const Stream& s) {
+    std::vector<Stream::Entry> out;
+    s.range(StreamID::min(), StreamID::max(), 0, false, out);
+    return out;
+}
+
+// Entries with the first entry's field names store only values, the rest
+// store names too; both must come back as written
+std::vector<Stream::Field> fields_for(size_t i) {
+    if (i % 7 == 3) {
+        return {{"other", std::to_string(i)}};
+    }
+    if (i % 11 == 5) {
+        return {{"f", std::string(300, 'x')}, {"g", ""}, {"h", std::to_string(i)}};
+    }
+    return {{"f", std::to_string(i)}, {"g", "v"}};
+}
+
+// A stream of n entries with increasing, irregular IDs and its reference copy
+Stream make_stream(size_t n, std::vector<Stream::Entry>& reference) {
+    std::mt19937_64 rng(82);
+    Stream s;
+    StreamID id(1000, 0);
+    for (size_t i = 0; i < n; i++) {
+        id = rng() % 3 == 0 ? StreamID(id.ms, id.seq + 1 + rng() % 5) : StreamID(id.ms + 1 + rng() % 1000, 0);
+        CHECK(s.add(id, fields_for(i)));
+        reference.push_back({id, fields_for(i)});
+    }
+    return s;
+}
+
+void test_ids_only_grow() {
+    Stream s;
+    CHECK(s.add(StreamID(5, 1), {{"a", "1"}}));
+    CHECK(!s.add(StreamID(5, 1), {{"a", "2"}}));
+    CHECK(!s.add(StreamID(5, 0), {{"a", "2"}}));
+    CHECK(!s.add(StreamID(4, 9), {{"a", "2"}}));
+    CHECK(s.add(StreamID(5, 2), {{"a", "3"}}));
+    CHECK_EQ(s.length(), size_t(2));
+
+    StreamID next;
+    CHECK(s.next_auto_id(10, next));
+    CHECK(next == StreamID(10, 0));
+    // The clock is behind the last ID: one past it
+    CHECK(s.next_auto_id(3, next));
+    CHECK(next == StreamID(5, 3));
+    CHECK(StreamID(7, UINT64_MAX).next(next));
+    CHECK(next == StreamID(8, 0));
+    CHECK(!StreamID::max().next(next));
+
+    StreamID parsed;
+    CHECK(StreamID::parse("12", UINT64_MAX, parsed) && parsed == StreamID(12, UINT64_MAX));
+    CHECK(StreamID::parse("12-3", 0, parsed) && parsed == StreamID(12, 3));
+    CHECK(!StreamID::parse("12-", 0, parsed));
+    CHECK(!StreamID::parse("-3", 0, parsed));
+}
+
+void test_ranges_match_reference() {
+    std::vector<Stream::Entry> reference;
+    Stream s = make_stream(2500, reference);
+    CHECK(s.nodes() > 10);
+    CHECK_EQ(describe(all_of(s)), describe(reference));
+
+    std::mt19937 rng(282);
+    for (int round = 0; round < 200; round++) {
+        size_t a = rng() % reference.size(), b = rng() % reference.size();
+        if (a > b) std::swap(a, b);
+        size_t count = rng() % 3 == 0 ? 0 : 1 + rng() % 150;
+        // Bounds between IDs as well as on them
+        StreamID start = round % 2 ? reference[a].id : StreamID(reference[a].id.ms, 0);
+        StreamID end = reference[b].id;
+
+        std::vector<Stream::Entry> expected;
+        for (const auto& e : reference) {
+            if (start <= e.id && e.id <= end) {
+                expected.push_back(e);
+            }
+        }
+        std::vector<Stream::Entry> reversed(expected.rbegin(), expected.rend());
+        if (count && expected.size() > count) {
+            expected.resize(count);
+            reversed.resize(count);
+        }
+
+        std::vector<Stream::Entry> out;
+        s.range(start, end, count, false, out);
+        CHECK_EQ(describe(out), describe(expected));
+        out.clear();
+        s.range(start, end, count, true, out);
+        CHECK_EQ(describe(out), describe(reversed));
+    }
+
+    std::vector<Stream::Entry> out;
+    s.range(reference[10].id, reference[5].id, 0, false, out);
+    CHECK(out.empty());
+}
+
+void test_trim() {
+    std::vector<Stream::Entry> reference;
+    Stream s = make_stream(1000, reference);
+    StreamID last = s.last_id();
+
+    // Mid-node, then several whole nodes, then nothing to do
+    for (size_t maxlen : {990, 777, 400, 400, 1}) {
+        size_t removed = s.trim_maxlen(maxlen);
+        size_t before = reference.size();
+        if (reference.size() > maxlen) {
+            reference.erase(reference.begin(), reference.end() - maxlen);
+        }
+        CHECK_EQ(removed, before - reference.size());
+        CHECK_EQ(s.length(), reference.size());
+        CHECK_EQ(describe(all_of(s)), describe(reference));
+    }
+
+    std::vector<Stream::Entry> fresh;
+    Stream t = make_stream(1000, fresh);
+    for (size_t at : {3, 150, 151, 600, 999}) {
+        // An ID between entries keeps the entry after it
+        StreamID minid = at % 2 ? fresh[at].id : StreamID(fresh[at].id.ms, 0);
+        size_t before = fresh.size();
+        fresh.erase(std::remove_if(fresh.begin(), fresh.end(), [&](const Stream::Entry& e) { return e.id < minid; }),
+                    fresh.end());
+        CHECK_EQ(t.trim_minid(minid), before - fresh.size());
+        CHECK_EQ(describe(all_of(t)), describe(fresh));
+    }
+
+    // Trimming everything keeps the last ID, so IDs still only grow
+    s.trim_maxlen(0);
+    CHECK_EQ(s.length(), size_t(0));
+    CHECK(s.last_id() == last);
+    CHECK(!s.add(last, {{"a", "b"}}));
+    StreamID next;
+    CHECK(last.next(next) && s.add(next, {{"a", "b"}}));
+    CHECK_EQ(s.length(), size_t(1));
+}
+
+void test_engine_commands() {
+    KVStore kv;
+    CHECK_EQ(run(kv, "xadd", "s", "5-1,a:1"), "5-1");
+    CHECK_EQ(run(kv, "xadd", "s", "5-*,b:2"), "5-2");
+    CHECK_EQ(run(kv, "xadd", "s", "5-2,c:3"),
+             "FAILED ERROR: The ID specified in XADD is equal or smaller than the target stream top item");
+    CHECK_EQ(run(kv, "xadd", "s", "9,c:3"), "9-0");
+    CHECK_EQ(run(kv, "xrange", "s", "-,+"), "5-1,a:1;5-2,b:2;9-0,c:3");
+    CHECK_EQ(run(kv, "xrange", "s", "5,5"), "5-1,a:1;5-2,b:2");
+    CHECK_EQ(run(kv, "xrevrange", "s", "+,-,2"), "9-0,c:3;5-2,b:2");
+    CHECK_EQ(run(kv, "xtrim", "s", "MINID,5-2"), "1");
+    CHECK_EQ(run(kv, "xtrim", "s", "MAXLEN,1"), "1");
+    CHECK_EQ(run(kv, "xlen", "s"), "1");
+    CHECK_EQ(run(kv, "xadd", "s", "8-0,d:4"),
+             "FAILED ERROR: The ID specified in XADD is equal or smaller than the target stream top item");
+}
+
+}  // namespace
+
+int main() {
+    test_ids_only_grow();
+    test_ranges_match_reference();
+    test_trim();
+    test_engine_commands();
+    return check_exit_code("stream_test");
+}
@@ -0,0 +1,54 @@
+#include "check.h"
+#include "kv_store.h"
+
+#include <cstdint>
+#include <string>
+
+// SETRANGE limits: writes that would grow a value past proto-max-bulk-len
+
+namespace {
+
+const std::string kTooLong = "FAILED ERROR: string exceeds maximum allowed size (proto-max-bulk-len)";
+
+// Refused before anything is allocated, and the key is left as it was
+void test_setrange_past_limit() {
+    KVStore kv;
+    const std::string max = std::to_string(KVStore::kMaxStringSize);
+    const std::string last = std::to_string(KVStore::kMaxStringSize - 1);
+
+    CHECK_EQ(run(kv, "setrange", "s", max + ",x"), kTooLong);
+    CHECK_EQ(run(kv, "exists", "s"), "0");
+    CHECK_EQ(run(kv, "setrange", "s", last + ",xy"), kTooLong);
+    CHECK_EQ(run(kv, "exists", "s"), "0");
+
+    CHECK_EQ(run(kv, "set", "s", "abc"), "OK");
+    CHECK_EQ(run(kv, "setrange", "s", max + ",x"), kTooLong);
+    CHECK_EQ(run(kv, "get", "s"), "abc");
+}
+
+// offset + length must not wrap around on the way to the check
+void test_setrange_offset_overflow() {
+    KVStore kv;
+    CHECK_EQ(run(kv, "setrange", "s", std::to_string(INT64_MAX) + ",x"), kTooLong);
+    CHECK_EQ(run(kv, "exists", "s"), "0");
+    CHECK_EQ(run(kv, "setrange", "s", "-1,x"), "FAILED ERROR: offset is out of range");
+}
+
+// An empty write never grows the value, so any offset is fine
+void test_setrange_empty_value() {
+    KVStore kv;
+    CHECK_EQ(run(kv, "setrange", "s", std::to_string(INT64_MAX) + ","), "0");
+    CHECK_EQ(run(kv, "set", "s", "abc"), "OK");
+    CHECK_EQ(run(kv, "setrange", "s", std::to_string(KVStore::kMaxStringSize) + ","), "3");
+    CHECK_EQ(run(kv, "setrange", "s", "1,XY"), "3");
+    CHECK_EQ(run(kv, "get", "s"), "aXY");
+}
+
+}  // namespace
+
+int main() {
+    test_setrange_past_limit();
+    test_setrange_offset_overflow();
+    test_setrange_empty_value();
+    return check_exit_code("string_test");
+}
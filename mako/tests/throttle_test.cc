@@ -0,0 +1,75 @@
+#include "check.h"
+#include "kv_store.h"
+
+#include <chrono>
+#include <string>
+#include <thread>
+
+// THROTTLE against the replies redis-cell's CL.THROTTLE gives for the same
+// arguments: limited, limit, remaining, retry_after, reset_after
+
+namespace {
+
+// The example in redis-cell's README: 15 max burst, 30 per 60 seconds, so
+// one cell every 2 seconds and 16 allowed at once
+void test_burst() {
+    KVStore kv;
+    CHECK_EQ(run(kv, "throttle", "user123", "15,30,60,1"), "0,16,15,-1,2");
+    // quantity defaults to 1
+    CHECK_EQ(run(kv, "throttle", "user123", "15,30,60"), "0,16,14,-1,4");
+    for (int i = 3; i <= 16; i++) {
+        CHECK_EQ(run(kv, "throttle", "user123", "15,30,60"),
+                 "0,16," + std::to_string(16 - i) + ",-1," + std::to_string(2 * i));
+    }
+    // Burst spent: the next cell frees up in one interval, nothing is consumed
+    CHECK_EQ(run(kv, "throttle", "user123", "15,30,60"), "1,16,0,2,32");
+    CHECK_EQ(run(kv, "throttle", "user123", "15,30,60"), "1,16,0,2,32");
+    // Keys are independent
+    CHECK_EQ(run(kv, "throttle", "user456", "15,30,60"), "0,16,15,-1,2");
+}
+
+void test_quantity() {
+    KVStore kv;
+    // Quantity 0 peeks: nothing is consumed, and a new key is not stored
+    CHECK_EQ(run(kv, "throttle", "k", "15,30,60,0"), "0,16,16,-1,0");
+    CHECK_EQ(run(kv, "throttle", "k", "15,30,60,5"), "0,16,11,-1,10");
+    CHECK_EQ(run(kv, "throttle", "k", "15,30,60,0"), "0,16,11,-1,10");
+    // More than is left is refused whole
+    CHECK_EQ(run(kv, "throttle", "k", "15,30,60,12"), "1,16,11,2,10");
+    CHECK_EQ(run(kv, "throttle", "k", "15,30,60,11"), "0,16,0,-1,32");
+    // More than the burst can never be allowed, so there is no retry time
+    CHECK_EQ(run(kv, "throttle", "fresh", "15,30,60,17"), "1,16,16,-1,0");
+}
+
+// A spent key recovers as time passes: 1000 per second is one cell per ms
+void test_recovery() {
+    KVStore kv;
+    CHECK_EQ(run(kv, "throttle", "fast", "0,1000,1"), "0,1,0,-1,1");
+    CHECK_EQ(run(kv, "throttle", "fast", "0,1000,1"), "1,1,0,1,1");
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    CHECK_EQ(run(kv, "throttle", "fast", "0,1000,1"), "0,1,0,-1,1");
+}
+
+void test_errors() {
+    KVStore kv;
+    const std::string kRange = "FAILED ERROR: max_burst and quantity must be >= 0, count and period > 0";
+    CHECK_EQ(run(kv, "throttle", "k", "-1,30,60"), kRange);
+    CHECK_EQ(run(kv, "throttle", "k", "15,0,60"), kRange);
+    CHECK_EQ(run(kv, "throttle", "k", "15,30,0"), kRange);
+    CHECK_EQ(run(kv, "throttle", "k", "15,30,60,-1"), kRange);
+    CHECK_EQ(run(kv, "throttle", "k", "15,30"), "FAILED ERROR: THROTTLE needs max_burst,count,period[,quantity]");
+    CHECK_EQ(run(kv, "throttle", "k", "15,30,60,1,1"), "FAILED ERROR: THROTTLE needs max_burst,count,period[,quantity]");
+    CHECK_EQ(run(kv, "throttle", "k", "15,x,60"), "FAILED ERROR: value is not an integer");
+    CHECK_EQ(run(kv, "throttle", "k", "15,30,9223372036854775807"), "FAILED ERROR: rate out of range");
+    CHECK_EQ(run(kv, "throttle", "k", "15,2000000000,1"), "FAILED ERROR: rate out of range");
+}
+
+}  // namespace
+
+int main() {
+    test_burst();
+    test_quantity();
+    test_recovery();
+    test_errors();
+    return check_exit_code("throttle_test");
+}
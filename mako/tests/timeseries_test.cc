@@ -0,0 +1,192 @@
+#include "check.h"
+#include "timeseries.h"
+
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <map>
+#include <random>
+#include <vector>
+
+// Gorilla chunks: every sample written comes back bit for bit, whether it was
+// appended in order or re-encoded into an earlier chunk by an out-of-order or
+// duplicate timestamp. A std::map of the same writes is the reference.
+
+namespace {
+
+uint64_t bits_of(double v) {
+    uint64_t bits;
+    std::memcpy(&bits, &v, sizeof(bits));
+    return bits;
+}
+
+double double_of(uint64_t bits) {
+    double v;
+    std::memcpy(&v, &bits, sizeof(v));
+    return v;
+}
+
+// Whole series, compared sample by sample (values as bit patterns, so -0.0
+// and NaN payloads count too)
+bool same_samples(const TimeSeries& ts, const std::map<int64_t, double>& expected) {
+    std::vector<TimeSeries::Sample> out;
+    ts.range(INT64_MIN, INT64_MAX, TimeSeries::Aggregation::None, 0, out);
+    if (out.size() != expected.size() || ts.size() != expected.size()) {
+        std::cerr << "got " << out.size() << " samples (size() " << ts.size() << "), expected "
+                  << expected.size() << "\n";
+        return false;
+    }
+    size_t i = 0;
+    for (const auto& e : expected) {
+        if (out[i].ts != e.first || bits_of(out[i].value) != bits_of(e.second)) {
+            std::cerr << "sample " << i << ": got " << out[i].ts << "=" << out[i].value
+                      << ", expected " << e.first << "=" << e.second << "\n";
+            return false;
+        }
+        i++;
+    }
+    return true;
+}
+
+// Deltas hitting every delta-of-delta bucket, including the 64-bit escape,
+// and values from repeats (one bit) to arbitrary bit patterns
+void test_in_order_round_trip() {
+    std::mt19937_64 rng(83);
+    TimeSeries ts;
+    std::map<int64_t, double> expected;
+    const int64_t deltas[] = {1, 1, 1, 60, 64, 65, 300, 2048, 2049, 5000, 1LL << 33};
+    int64_t t = -1000000;
+    double v = 1.5;
+    for (int i = 0; i < 20000; i++) {
+        t += deltas[rng() % (sizeof(deltas) / sizeof(deltas[0]))];
+        switch (rng() % 5) {
+        case 0: break;                                   // repeat
+        case 1: v += 1.0; break;
+        case 2: v = double_of(rng()); break;             // any bit pattern
+        case 3: v = -0.0; break;
+        case 4: v = std::numeric_limits<double>::denorm_min(); break;
+        }
+        ts.add(t, v);
+        expected[t] = v;
+    }
+    CHECK(ts.chunks() > 1);
+    CHECK(same_samples(ts, expected));
+
+    TimeSeries::Sample last;
+    CHECK(ts.last(last));
+    CHECK_EQ(last.ts, expected.rbegin()->first);
+}
+
+// Out-of-order writes land in the chunk they fall in, before the first
+// chunk, between chunks and as duplicates (the later write wins); chunks that
+// overflow from the extra sample split
+void test_out_of_order_round_trip() {
+    std::mt19937_64 rng(3883);
+    TimeSeries ts;
+    std::map<int64_t, double> expected;
+    for (int64_t t = 0; t < 30000; t += 10) {
+        double v = static_cast<double>(rng() % 1000) / 8.0;
+        ts.add(t, v);
+        expected[t] = v;
+    }
+    size_t chunks_before = ts.chunks();
+    CHECK(chunks_before > 2);
+
+    for (int i = 0; i < 3000; i++) {
+        int64_t t = static_cast<int64_t>(rng() % 32000) - 1000;
+        double v = double_of(rng());
+        ts.add(t, v);
+        expected[t] = v;
+    }
+    ts.add(-50000, 7.0);   // new first sample
+    expected[-50000] = 7.0;
+    ts.add(100, -1.0);     // duplicate of an in-order sample
+    expected[100] = -1.0;
+
+    CHECK(same_samples(ts, expected));
+    CHECK(ts.chunks() >= chunks_before);
+
+    // Appending after the rewrites still goes to the end
+    ts.add(1000000, 2.0);
+    expected[1000000] = 2.0;
+    CHECK(same_samples(ts, expected));
+}
+
+// Sub-ranges and aggregations over chunk boundaries match the reference
+void test_range_and_aggregation() {
+    std::mt19937_64 rng(8383);
+    TimeSeries ts;
+    std::map<int64_t, double> expected;
+    for (int i = 0; i < 15000; i++) {
+        int64_t t = static_cast<int64_t>(rng() % 200000);
+        double v = static_cast<double>(rng() % 100);   // small integers: sums are exact
+        ts.add(t, v);
+        expected[t] = v;
+    }
+    CHECK(same_samples(ts, expected));
+
+    const int64_t from = 12345, to = 187654, bucket = 1000;
+    std::vector<TimeSeries::Sample> out;
+    ts.range(from, to, TimeSeries::Aggregation::None, 0, out);
+    size_t n = 0;
+    for (auto it = expected.lower_bound(from); it != expected.end() && it->first <= to; ++it) {
+        n++;
+    }
+    CHECK_EQ(out.size(), n);
+
+    std::map<int64_t, double> sums, mins, counts;
+    for (auto it = expected.lower_bound(from); it != expected.end() && it->first <= to; ++it) {
+        int64_t start = it->first - it->first % bucket;
+        sums[start] += it->second;
+        counts[start] += 1;
+        mins[start] = mins.count(start) ? std::min(mins[start], it->second) : it->second;
+    }
+    out.clear();
+    ts.range(from, to, TimeSeries::Aggregation::Sum, bucket, out);
+    CHECK(out.size() == sums.size());
+    bool sums_match = out.size() == sums.size();
+    auto s = sums.begin();
+    for (size_t i = 0; sums_match && i < out.size(); i++, ++s) {
+        sums_match = out[i].ts == s->first && out[i].value == s->second;
+    }
+    CHECK(sums_match);
+
+    out.clear();
+    ts.range(from, to, TimeSeries::Aggregation::Min, bucket, out);
+    bool mins_match = out.size() == mins.size();
+    auto m = mins.begin();
+    for (size_t i = 0; mins_match && i < out.size(); i++, ++m) {
+        mins_match = out[i].ts == m->first && out[i].value == m->second;
+    }
+    CHECK(mins_match);
+
+    out.clear();
+    ts.range(from, to, TimeSeries::Aggregation::Count, bucket, out);
+    bool counts_match = out.size() == counts.size();
+    auto c = counts.begin();
+    for (size_t i = 0; counts_match && i < out.size(); i++, ++c) {
+        counts_match = out[i].ts == c->first && out[i].value == c->second;
+    }
+    CHECK(counts_match);
+}
+
+// TS.ADD out of order through the engine, read back with TS.RANGE
+void test_engine_commands() {
+    KVStore kv;
+    CHECK_EQ(run(kv, "ts.create", "t"), "OK");
+    CHECK_EQ(run(kv, "ts.add", "t", "30,3"), "30");
+    CHECK_EQ(run(kv, "ts.add", "t", "10,1"), "10");
+    CHECK_EQ(run(kv, "ts.add", "t", "20,2"), "20");
+    CHECK_EQ(run(kv, "ts.add", "t", "20,2.5"), "20");
+    CHECK_EQ(run(kv, "ts.range", "t", "-,+"), "10:1,20:2.5,30:3");
+}
+
+}  // namespace
+
+int main() {
+    test_in_order_round_trip();
+    test_out_of_order_round_trip();
+    test_range_and_aggregation();
+    test_engine_commands();
+    return check_exit_code("timeseries_test");
+}
@@ -0,0 +1,210 @@
+#include "check.h"
+#include "vector_set.h"
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+// Vector search: exact KNN agrees with a brute-force scan in double precision
+// for every metric and for dimensions that leave SIMD tails, an IVF index
+// probed on every list still returns the exact answer (also after rows are
+// added, replaced and removed under it), and fewer probes keep most of the
+// true neighbors on clustered data.
+
+namespace {
+
+typedef std::map<std::string, std::vector<float>> Rows;
+
+double reference_distance(VectorSet::Metric metric, const std::vector<float>& a, const std::vector<float>& b) {
+    double l2 = 0, dot = 0, na = 0, nb = 0;
+    for (size_t d = 0; d < a.size(); d++) {
+        l2 += (double(a[d]) - b[d]) * (double(a[d]) - b[d]);
+        dot += double(a[d]) * b[d];
+        na += double(a[d]) * a[d];
+        nb += double(b[d]) * b[d];
+    }
+    switch (metric) {
+    case VectorSet::Metric::L2: return l2;
+    case VectorSet::Metric::InnerProduct: return 1.0 - dot;
+    case VectorSet::Metric::Cosine: return 1.0 - dot / std::sqrt(na * nb);
+    }
+    return 0;
+}
+
+// Float sums in a different order than the reference: compare with a
+// tolerance relative to the magnitudes involved
+bool close(double a, double b) {
+    return std::fabs(a - b) <= 1e-3 * std::max(1.0, std::fabs(b));
+}
+
+// The answer is right if its distances are the k smallest reference
+// distances and each id's distance is its own (ties may swap ids)
+bool matches_brute_force(const VectorSet& set, VectorSet::Metric metric, const Rows& rows,
+                         const std::vector<float>& query, size_t k, size_t nprobe) {
+    std::vector<double> all;
+    for (const auto& r : rows) {
+        all.push_back(reference_distance(metric, query, r.second));
+    }
+    std::sort(all.begin(), all.end());
+    std::vector<VectorSet::Match> out;
+    set.knn(query.data(), k, nprobe, out);
+    if (out.size() != std::min(k, rows.size())) {
+        std::cerr << "got " << out.size() << " matches\n";
+        return false;
+    }
+    for (size_t i = 0; i < out.size(); i++) {
+        auto row = rows.find(out[i].id);
+        if (row == rows.end() || !close(out[i].distance, reference_distance(metric, query, row->second)) ||
+            !close(out[i].distance, all[i])) {
+            std::cerr << "match " << i << " (" << out[i].id << ", " << out[i].distance << ") expected distance "
+                      << all[i] << "\n";
+            return false;
+        }
+    }
+    return true;
+}
+
+std::vector<float> random_vector(std::mt19937& rng, size_t dim) {
+    std::normal_distribution<float> n(0.0f, 1.0f);
+    std::vector<float> v(dim);
+    for (auto& x : v) x = n(rng);
+    return v;
+}
+
+// Points around a few centers, so IVF lists have something to find
+Rows clustered_rows(std::mt19937& rng, size_t dim, size_t count, size_t clusters) {
+    std::vector<std::vector<float>> centers;
+    for (size_t c = 0; c < clusters; c++) {
+        std::vector<float> center = random_vector(rng, dim);
+        for (auto& x : center) x *= 10.0f;
+        centers.push_back(center);
+    }
+    Rows rows;
+    for (size_t i = 0; i < count; i++) {
+        std::vector<float> v = random_vector(rng, dim);
+        const std::vector<float>& center = centers[i % clusters];
+        for (size_t d = 0; d < dim; d++) v[d] += center[d];
+        rows["r" + std::to_string(i)] = v;
+    }
+    return rows;
+}
+
+const VectorSet::Metric kMetrics[] = {VectorSet::Metric::L2, VectorSet::Metric::InnerProduct,
+                                      VectorSet::Metric::Cosine};
+
+void test_exact_knn() {
+    std::mt19937 rng(84);
+    for (size_t dim : {1, 3, 8, 17, 130}) {
+        for (VectorSet::Metric metric : kMetrics) {
+            VectorSet set(dim, metric);
+            Rows rows;
+            // Not a multiple of kBlockRows: the last block is partial
+            for (size_t i = 0; i < 3 * VectorSet::kBlockRows + 5; i++) {
+                rows["r" + std::to_string(i)] = random_vector(rng, dim);
+            }
+            for (const auto& r : rows) {
+                CHECK(set.add(r.first, r.second.data()));
+            }
+            for (int q = 0; q < 10; q++) {
+                CHECK(matches_brute_force(set, metric, rows, random_vector(rng, dim), 10, 0));
+            }
+            CHECK(matches_brute_force(set, metric, rows, random_vector(rng, dim), rows.size() + 10, 0));
+        }
+    }
+}
+
+void test_ivf_all_probes_is_exact() {
+    std::mt19937 rng(4884);
+    const size_t dim = 24, lists = 16;
+    for (VectorSet::Metric metric : kMetrics) {
+        Rows rows = clustered_rows(rng, dim, 2000, 12);
+        VectorSet set(dim, metric);
+        for (const auto& r : rows) {
+            set.add(r.first, r.second.data());
+        }
+        set.build_ivf(lists);
+        CHECK(set.has_ivf());
+        CHECK_EQ(set.size(), rows.size());
+        for (int q = 0; q < 10; q++) {
+            CHECK(matches_brute_force(set, metric, rows, random_vector(rng, dim), 10, lists));
+        }
+
+        // Rows added, replaced and removed after the index was built
+        for (size_t i = 0; i < 300; i++) {
+            std::string id = "r" + std::to_string(rng() % 2500);
+            if (i % 3 == 0 && rows.count(id)) {
+                CHECK(set.remove(id));
+                rows.erase(id);
+            } else {
+                std::vector<float> v = random_vector(rng, dim);
+                CHECK_EQ(set.add(id, v.data()), rows.count(id) == 0);
+                rows[id] = v;
+            }
+        }
+        CHECK_EQ(set.size(), rows.size());
+        CHECK(!set.remove("never-added"));
+        for (int q = 0; q < 10; q++) {
+            CHECK(matches_brute_force(set, metric, rows, random_vector(rng, dim), 10, lists));
+        }
+    }
+}
+
+// Probing 2 of 32 lists, queries near the data still find most of
+// their true neighbors
+void test_ivf_recall() {
+    std::mt19937 rng(8448);
+    const size_t dim = 32, k = 10;
+    Rows rows = clustered_rows(rng, dim, 4000, 16);
+    VectorSet exact(dim, VectorSet::Metric::L2), ivf(dim, VectorSet::Metric::L2);
+    for (const auto& r : rows) {
+        exact.add(r.first, r.second.data());
+        ivf.add(r.first, r.second.data());
+    }
+    ivf.build_ivf(32);
+
+    size_t found = 0, wanted = 0;
+    for (int q = 0; q < 50; q++) {
+        std::vector<float> query = rows["r" + std::to_string(rng() % rows.size())];
+        for (auto& x : query) x += 0.1f * random_vector(rng, 1)[0];
+        std::vector<VectorSet::Match> truth, approx;
+        exact.knn(query.data(), k, 0, truth);
+        ivf.knn(query.data(), k, 2, approx);
+        for (const auto& t : truth) {
+            wanted++;
+            found += std::any_of(approx.begin(), approx.end(),
+                                 [&](const VectorSet::Match& m) { return m.id == t.id; });
+        }
+    }
+    double recall = static_cast<double>(found) / wanted;
+    std::cout << "vector_test: IVF recall@" << k << " with 2 of 32 lists: " << recall << "\n";
+    CHECK(recall >= 0.85);
+}
+
+void test_engine_commands() {
+    KVStore kv;
+    CHECK_EQ(run(kv, "vec.create", "v", "2,L2"), "OK");
+    CHECK_EQ(run(kv, "vec.add", "v", "a,0,0"), "1");
+    CHECK_EQ(run(kv, "vec.add", "v", "b,3,4"), "1");
+    CHECK_EQ(run(kv, "vec.add", "v", "c,1,0"), "1");
+    CHECK_EQ(run(kv, "vec.add", "v", "c,1,1"), "0");
+    CHECK_EQ(run(kv, "vec.card", "v"), "3");
+    CHECK_EQ(run(kv, "vec.knn", "v", "2,0,0"), "a:0,c:2");
+    CHECK_EQ(run(kv, "vec.ivf", "v", "2"), "OK");
+    CHECK_EQ(run(kv, "vec.knn", "v", "3,3,4,2"), "b:0,c:13,a:25");
+    CHECK_EQ(run(kv, "vec.del", "v", "b"), "1");
+    CHECK_EQ(run(kv, "vec.knn", "v", "1,3,4,2"), "c:13");
+    CHECK_EQ(run(kv, "vec.add", "v", "d,1"), "FAILED ERROR: vector dimension mismatch, expected 2");
+}
+
+}  // namespace
+
+int main() {
+    test_exact_knn();
+    test_ivf_all_probes_is_exact();
+    test_ivf_recall();
+    test_engine_commands();
+    return check_exit_code("vector_test");
+}